@@ -0,0 +1,102 @@
+#include "pch.hpp"
+
+class CanChangeDetectorTest : public ::testing::Test {
+protected:
+
+    CanChangeDetectorTest() {
+        detector.SetSignals(0x100, { CanChangeSignal{ "Button", 0, 1 }, CanChangeSignal{ "Speed", 8, 16 }, CanChangeSignal{ "Counter", 60, 4 } });
+    }
+
+    virtual ~CanChangeDetectorTest() {
+    }
+
+    CanChangeDetector detector;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+};
+
+TEST_F(CanChangeDetectorTest, BitMask) {
+    EXPECT_EQ(CanChangeDetector::GetBitMask(0, 1), 0x8000000000000000ULL);
+    EXPECT_EQ(CanChangeDetector::GetBitMask(8, 16), 0x00FFFF0000000000ULL);
+    EXPECT_EQ(CanChangeDetector::GetBitMask(0, 64), ~0ULL);
+    EXPECT_EQ(CanChangeDetector::GetBitMask(60, 8), 0x000000000000000FULL);
+    EXPECT_EQ(CanChangeDetector::GetBitMask(64, 1), 0);
+    EXPECT_EQ(CanChangeDetector::FormatMask(0x0010000000000001ULL), "00 10 00 00 00 00 00 01");
+}
+
+TEST_F(CanChangeDetectorTest, Toggles) {
+    uint8_t data[8] = {};
+    detector.OnFrame(0x100, data, sizeof(data), now);
+    EXPECT_EQ(detector.GetChangedMask(0x100), 0);  /* First frame isn't a change */
+
+    data[0] = 0x80;
+    detector.OnFrame(0x100, data, sizeof(data), now + std::chrono::milliseconds(10));
+    data[0] = 0x00;
+    detector.OnFrame(0x100, data, sizeof(data), now + std::chrono::milliseconds(20));
+    detector.OnFrame(0x100, data, sizeof(data), now + std::chrono::milliseconds(30));
+
+    EXPECT_EQ(detector.GetChangedMask(0x100), 0x8000000000000000ULL);
+    const CanChangeState* state = detector.GetState(0x100);
+    ASSERT_NE(state, nullptr);
+    EXPECT_EQ(state->toggle_counts[0], 2);
+    EXPECT_EQ(state->toggle_counts[1], 0);
+    EXPECT_EQ(state->last_changes[0], now + std::chrono::milliseconds(20));
+    EXPECT_EQ(state->last_change, now + std::chrono::milliseconds(20));
+
+    std::vector<CanChangeReport> reports = detector.GetChangedSinceMark();
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].frame_id, 0x100);
+    EXPECT_EQ(reports[0].toggle_count, 2);
+    ASSERT_EQ(reports[0].signals.size(), 1);
+    EXPECT_EQ(reports[0].signals[0], "Button");
+}
+
+TEST_F(CanChangeDetectorTest, SignalsAndShortFrames) {
+    uint8_t data[8] = {};
+    detector.OnFrame(0x100, data, sizeof(data), now);
+    data[2] = 0x01;
+    data[7] = 0x03;
+    detector.OnFrame(0x100, data, sizeof(data), now);
+
+    std::vector<CanChangeReport> reports = detector.GetChangedSinceMark();
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].changed_mask, 0x0000010000000003ULL);
+    ASSERT_EQ(reports[0].signals.size(), 2);
+    EXPECT_EQ(reports[0].signals[0], "Speed");
+    EXPECT_EQ(reports[0].signals[1], "Counter");
+
+    uint8_t short_data[2] = { 0x00, 0x01 };
+    detector.OnFrame(0x200, short_data, sizeof(short_data), now);
+    short_data[1] = 0x03;
+    detector.OnFrame(0x200, short_data, sizeof(short_data), now);
+    EXPECT_EQ(detector.GetChangedMask(0x200), 0x0002000000000000ULL);
+    EXPECT_EQ(detector.GetState(0x200)->toggle_counts[14], 1);
+}
+
+TEST_F(CanChangeDetectorTest, Mark) {
+    uint8_t data[8] = {};
+    detector.OnFrame(0x100, data, sizeof(data), now);
+    detector.OnFrame(0x200, data, sizeof(data), now);
+    data[1] = 0xFF;
+    detector.OnFrame(0x100, data, sizeof(data), now + std::chrono::milliseconds(5));
+    detector.OnFrame(0x200, data, sizeof(data), now + std::chrono::milliseconds(10));
+    std::vector<CanChangeReport> reports = detector.GetChangedSinceMark();
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[0].frame_id, 0x200);  /* Last changed first */
+
+    detector.Mark(now + std::chrono::milliseconds(20));
+    EXPECT_EQ(detector.GetMarkTime(), now + std::chrono::milliseconds(20));
+    EXPECT_TRUE(detector.GetChangedSinceMark().empty());
+    EXPECT_EQ(detector.GetChangedMask(0x100), 0);
+
+    detector.OnFrame(0x100, data, sizeof(data), now + std::chrono::milliseconds(30));  /* Same data */
+    data[3] = 0x10;
+    detector.OnFrame(0x200, data, sizeof(data), now + std::chrono::milliseconds(40));
+    reports = detector.GetChangedSinceMark();
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].frame_id, 0x200);
+    EXPECT_EQ(reports[0].changed_mask, 0x0000001000000000ULL);
+    EXPECT_EQ(reports[0].toggle_count, 1);
+
+    detector.Clear();
+    EXPECT_EQ(detector.GetState(0x200), nullptr);
+}
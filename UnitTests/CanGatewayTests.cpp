@@ -0,0 +1,127 @@
+#include "pch.hpp"
+
+class CanGatewayTest : public ::testing::Test {
+protected:
+
+    CanGatewayTest() {
+        gateway.SetEnabled(true);
+    }
+
+    virtual ~CanGatewayTest() {
+    }
+
+    CanGateway gateway;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+};
+
+TEST_F(CanGatewayTest, Rules) {
+    EXPECT_TRUE(gateway.SetRulesFromString("7E0:Drop, 18DAF110:18DAF220:10, 18DA0000/1FFF0000:18DB0000, 100/700:200:00FF=0001"));
+    EXPECT_EQ(gateway.GetRulesAsString(), "7E0:Drop, 18DAF110:18DAF220:10, 18DA0000/1FFF0000:18DB0000, 100/700:200:00FF=0001");
+
+    uint8_t data[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+    uint32_t frame_id = 0x7E0;
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now));
+
+    frame_id = 0x123;
+    ASSERT_TRUE(gateway.Process(frame_id, data, sizeof(data), now));
+    EXPECT_EQ(frame_id, 0x223);  /* Only bits of the mask are rewritten */
+    EXPECT_EQ(data[0], 0x11);
+    EXPECT_EQ(data[1], 0x01);
+    EXPECT_EQ(data[2], 0x33);
+
+    frame_id = 0x18DAF110;
+    EXPECT_TRUE(gateway.Process(frame_id, data, sizeof(data), now));
+    EXPECT_EQ(frame_id, 0x18DAF220);
+
+    frame_id = 0x18DA10F1;
+    EXPECT_TRUE(gateway.Process(frame_id, data, sizeof(data), now));
+    EXPECT_EQ(frame_id, 0x18DB10F1);
+
+    frame_id = 0x456;
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now));
+    EXPECT_EQ(frame_id, 0x456);
+
+    std::vector<CanGatewayCounters> counters = gateway.GetCounters();
+    ASSERT_EQ(counters.size(), 4);
+    EXPECT_EQ(counters[0].matched, 1);
+    EXPECT_EQ(counters[0].dropped, 1);
+    EXPECT_EQ(counters[1].forwarded, 1);
+    EXPECT_EQ(counters[2].forwarded, 1);
+    EXPECT_EQ(counters[3].forwarded, 1);
+}
+
+TEST_F(CanGatewayTest, FirstMatchWins) {
+    EXPECT_TRUE(gateway.SetRulesFromString("123:Drop, 100/700:200"));
+    uint8_t data[1] = { 0 };
+    uint32_t frame_id = 0x123;
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now));
+    frame_id = 0x124;
+    EXPECT_TRUE(gateway.Process(frame_id, data, sizeof(data), now));
+
+    gateway.SetEnabled(false);
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now));
+}
+
+TEST_F(CanGatewayTest, RateLimit) {
+    EXPECT_TRUE(gateway.SetRulesFromString("123:321:100"));  /* 10 ms interval */
+    uint8_t data[2] = { 0 };
+    size_t forwarded = 0;
+    for(int i = 0; i != 1000; i++)  /* 1 second of a 1 ms periodic frame */
+    {
+        uint32_t frame_id = 0x123;
+        forwarded += gateway.Process(frame_id, data, sizeof(data), now + std::chrono::milliseconds(i));
+    }
+    EXPECT_GE(forwarded, 100);
+    EXPECT_LE(forwarded, 101);
+
+    std::vector<CanGatewayCounters> counters = gateway.GetCounters();
+    EXPECT_EQ(counters[0].matched, 1000);
+    EXPECT_EQ(counters[0].forwarded + counters[0].rate_limited, 1000);
+
+    gateway.ResetCounters();
+    EXPECT_EQ(gateway.GetCounters()[0].matched, 0);
+}
+
+TEST_F(CanGatewayTest, InvalidRules) {
+    EXPECT_FALSE(gateway.SetRulesFromString("123:Drop:10, 456, 789:300:0F=1, XYZ:300, 100:300:abc, 200:300"));
+    EXPECT_EQ(gateway.GetRulesAsString(), "200:300");
+
+    /* There is only one CAN channel, rules which keep the ID would duplicate frames on the same bus */
+    EXPECT_FALSE(gateway.SetRulesFromString("200:Forward, 300:Forward:00FF=0001, 400:400, 500/700:523, 600:700"));
+    EXPECT_EQ(gateway.GetRulesAsString(), "600:700");
+}
+
+TEST_F(CanGatewayTest, EchoesAreNotForwarded) {
+    EXPECT_TRUE(gateway.SetRulesFromString("100/700:200, 200/700:100"));  /* Each route is the source of the other one */
+    uint8_t data[2] = { 0x11, 0x22 };
+    uint32_t frame_id = 0x123;
+    ASSERT_TRUE(gateway.Process(frame_id, data, sizeof(data), now));
+    EXPECT_EQ(frame_id, 0x223);
+
+    /* Forwarded frame is received back from the bus */
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now + std::chrono::milliseconds(1)));
+    EXPECT_EQ(frame_id, 0x223);
+    EXPECT_EQ(gateway.GetEchoCount(), 1);
+
+    /* Only one echo is expected per forwarded frame, the next one is sent by someone else */
+    EXPECT_TRUE(gateway.Process(frame_id, data, sizeof(data), now + std::chrono::milliseconds(2)));
+    EXPECT_EQ(frame_id, 0x123);
+    EXPECT_FALSE(gateway.Process(frame_id, data, sizeof(data), now + std::chrono::milliseconds(3)));
+    EXPECT_EQ(gateway.GetEchoCount(), 2);
+
+    /* Different payload with the same ID isn't an echo */
+    frame_id = 0x123;
+    ASSERT_TRUE(gateway.Process(frame_id, data, sizeof(data), now + std::chrono::milliseconds(4)));
+    uint8_t other_data[2] = { 0x11, 0x33 };
+    EXPECT_TRUE(gateway.Process(frame_id, other_data, sizeof(other_data), now + std::chrono::milliseconds(5)));
+    EXPECT_EQ(frame_id, 0x123);
+
+    /* Echo doesn't come back in time, the same frame is forwarded again */
+    frame_id = 0x223;
+    EXPECT_TRUE(gateway.Process(frame_id, data, sizeof(data), now + CAN_GATEWAY_ECHO_TIMEOUT + std::chrono::milliseconds(10)));
+    EXPECT_EQ(frame_id, 0x123);
+    EXPECT_EQ(gateway.GetEchoCount(), 2);
+
+    gateway.ResetCounters();
+    EXPECT_EQ(gateway.GetEchoCount(), 0);
+}
@@ -0,0 +1,122 @@
+#include "pch.hpp"
+
+class CanLogFilterTest : public ::testing::Test {
+protected:
+
+    CanLogFilterTest() {
+        get_comment = [this](uint32_t frame_id, uint8_t direction)
+            {
+                comment_calls++;
+                return frame_id == 0x321 ? std::string("Engine Speed") : std::string();
+            };
+    }
+
+    virtual ~CanLogFilterTest() {
+    }
+
+    bool Match(uint32_t frame_id, uint8_t direction, std::vector<uint8_t> data = {})
+    {
+        return filter.Match(frame_id, direction, data.data(), data.size(), get_comment);
+    }
+
+    CanLogFilter filter;
+    CanLogCommentProvider get_comment;
+    size_t comment_calls = 0;
+    std::string error;
+};
+
+TEST_F(CanLogFilterTest, EmptyFilterMatchesEverything)
+{
+    ASSERT_TRUE(filter.Compile("  ", error));
+    EXPECT_TRUE(filter.IsEmpty());
+    EXPECT_TRUE(Match(0x123, 0));
+    EXPECT_EQ(comment_calls, 0);
+}
+
+TEST_F(CanLogFilterTest, IdsAndRanges)
+{
+    ASSERT_TRUE(filter.Compile("id:123 0x7FF ID:18DAF110", error));
+    EXPECT_EQ(filter.GetIdList(), std::vector<uint32_t>({ 0x123, 0x7FF, 0x18DAF110 }));
+    EXPECT_TRUE(Match(0x123, 0));
+    EXPECT_TRUE(Match(0x7FF, 1));
+    EXPECT_TRUE(Match(0x18DAF110, 1));
+    EXPECT_FALSE(Match(0x124, 0));
+    EXPECT_FALSE(Match(0x18DAF111, 0));
+
+    ASSERT_TRUE(filter.Compile("id:700-800 rx", error));
+    EXPECT_TRUE(filter.GetIdList().empty());  /* Ranges can't be looked up in the index */
+    EXPECT_TRUE(Match(0x700, 1));
+    EXPECT_TRUE(Match(0x800, 1));
+    EXPECT_FALSE(Match(0x801, 1));
+    EXPECT_FALSE(Match(0x700, 0));
+}
+
+TEST_F(CanLogFilterTest, CommentIsResolvedOncePerId)
+{
+    ASSERT_TRUE(filter.Compile("engine speed", error));
+    for(int i = 0; i != 100; i++)
+    {
+        EXPECT_TRUE(Match(0x321, 1));
+        EXPECT_FALSE(Match(0x18DAF110, 1));
+    }
+    EXPECT_EQ(comment_calls, 2);
+
+    filter.InvalidateCache();
+    EXPECT_TRUE(Match(0x321, 1));
+    EXPECT_EQ(comment_calls, 3);
+
+    ASSERT_TRUE(filter.Compile("\"BE\" 0xBE", error));  /* Quoted text is always a comment */
+    EXPECT_TRUE(filter.GetIdList().empty());
+    EXPECT_TRUE(Match(0xBE, 0));
+    EXPECT_FALSE(Match(0x123, 0));
+}
+
+TEST_F(CanLogFilterTest, WordsWithoutPrefixAreComments)
+{
+    get_comment = [](uint32_t frame_id, uint8_t direction)
+        {
+            switch(frame_id)
+            {
+                case 0x100: return std::string("ABS wheel speed");
+                case 0x200: return std::string("DEAD beef 123");
+                default: return std::string();
+            }
+        };
+
+    /* Words which could be parsed as hex IDs are searched in comments only */
+    for(auto& [pattern, frame_id] : std::vector<std::pair<std::string, uint32_t>>{ { "beef", 0xBEEF }, { "dead", 0xDEAD }, { "123", 0x123 } })
+    {
+        ASSERT_TRUE(filter.Compile(pattern, error));
+        EXPECT_TRUE(filter.GetIdList().empty());
+        EXPECT_FALSE(Match(frame_id, 1));
+        EXPECT_TRUE(Match(0x200, 1));
+    }
+
+    ASSERT_TRUE(filter.Compile("ABS", error));
+    EXPECT_TRUE(Match(0x100, 1));
+    EXPECT_FALSE(Match(0x200, 1));
+    ASSERT_TRUE(filter.Compile("123", error));
+    EXPECT_TRUE(Match(0x200, 1));
+    EXPECT_FALSE(Match(0x100, 1));
+
+    /* IDs and comment are alternatives */
+    ASSERT_TRUE(filter.Compile("id:300 beef", error));
+    EXPECT_TRUE(Match(0x300, 1));
+    EXPECT_TRUE(Match(0x200, 1));
+    EXPECT_FALSE(Match(0x100, 1));
+
+    EXPECT_FALSE(filter.Compile("id:xyz", error));
+    EXPECT_FALSE(filter.Compile("id:200-100", error));
+}
+
+TEST_F(CanLogFilterTest, DataBytes)
+{
+    ASSERT_TRUE(filter.Compile("[1]==0x62 [2]&0xF0==0x20", error));
+    EXPECT_TRUE(Match(0x7E8, 1, { 0x05, 0x62, 0x2F, 0x00 }));
+    EXPECT_FALSE(Match(0x7E8, 1, { 0x05, 0x62, 0x30, 0x00 }));
+    EXPECT_FALSE(Match(0x7E8, 1, { 0x05, 0x62 }));
+
+    EXPECT_FALSE(filter.Compile("[1]=0x62", error));
+    EXPECT_FALSE(filter.Compile("[1]==0x100", error));
+    EXPECT_FALSE(filter.Compile("\"unclosed", error));
+}
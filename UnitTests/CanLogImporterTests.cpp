@@ -0,0 +1,141 @@
+#include "pch.hpp"
+
+class CanLogImporterTest : public ::testing::Test {
+protected:
+
+    CanLogImporterTest() {
+    }
+
+    virtual ~CanLogImporterTest() {
+    }
+
+    /* Import text through a temporary file, like it comes from the disk */
+    std::vector<CanRecordingFrame> ImportText(const std::string& text, const std::string& extension, CanLogImportResult& result)
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / ("CanLogImporterTest" + extension);
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << text;
+        }
+
+        std::vector<CanRecordingFrame> frames;
+        CanLogImporter importer;
+        bool ret = importer.Import(path, [&frames](const std::vector<CanRecordingFrame>& batch)
+            {
+                frames.insert(frames.end(), batch.begin(), batch.end());
+                return true;
+            }, result);
+        std::filesystem::remove(path);
+        EXPECT_TRUE(ret);
+        return frames;
+    }
+};
+
+TEST_F(CanLogImporterTest, Candump) {
+    CanLogImporter importer;
+    importer.Reset(CLIF_CANDUMP);
+    CanRecordingFrame frame;
+
+    ASSERT_EQ(importer.ParseLine("(1436509052.249713) vcan0 044#2A366C2BBA", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 0);
+    EXPECT_EQ(frame.frame_id, 0x44);
+    EXPECT_EQ(frame.direction, CAN_LOG_DIR_RX);
+    ASSERT_EQ(frame.size, 5);
+    EXPECT_EQ(frame.data[0], 0x2A);
+    EXPECT_EQ(frame.data[4], 0xBA);
+
+    ASSERT_EQ(importer.ParseLine("(1436509052.250713) can0 18DAF110#0210030000000000 T\r", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 1000);
+    EXPECT_EQ(frame.frame_id, 0x18DAF110);
+    EXPECT_EQ(frame.direction, CAN_LOG_DIR_TX);
+    EXPECT_EQ(frame.size, 8);
+
+    ASSERT_EQ(importer.ParseLine("(1436509052.3) can0 123#", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 50287);
+    EXPECT_EQ(frame.size, 0);
+
+    EXPECT_EQ(importer.ParseLine("(1436509052.4) can0 123#R", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("(1436509052.4) can0 123##1112233", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("(1436509052.4) can0 20000080#0000000000000000", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("(1436509052.4) can0 1234#00", frame), CLIL_INVALID);
+    EXPECT_EQ(importer.ParseLine("(1436509052.4) can0 123#0", frame), CLIL_INVALID);
+    EXPECT_EQ(importer.ParseLine("1436509052.4 can0 123#00", frame), CLIL_INVALID);
+    EXPECT_EQ(importer.ParseLine("", frame), CLIL_IGNORED);
+}
+
+TEST_F(CanLogImporterTest, Asc) {
+    CanLogImporter importer;
+    importer.Reset(CLIF_ASC);
+    CanRecordingFrame frame;
+
+    EXPECT_EQ(importer.ParseLine("date Wed Jun 10 10:15:30.000 am 2020", frame), CLIL_IGNORED);
+    EXPECT_EQ(importer.ParseLine("base hex  timestamps absolute", frame), CLIL_IGNORED);
+    EXPECT_EQ(importer.ParseLine("Begin Triggerblock Wed Jun 10 10:15:30.000 am 2020", frame), CLIL_IGNORED);
+    EXPECT_EQ(importer.ParseLine("   0.000000 Start of measurement", frame), CLIL_IGNORED);
+
+    ASSERT_EQ(importer.ParseLine("   0.001234 1  123             Rx   d 8 01 02 03 04 05 06 07 FF  Length = 0 BitCount = 0 ID = 291", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 1234);
+    EXPECT_EQ(frame.frame_id, 0x123);
+    EXPECT_EQ(frame.direction, CAN_LOG_DIR_RX);
+    ASSERT_EQ(frame.size, 8);
+    EXPECT_EQ(frame.data[7], 0xFF);
+
+    ASSERT_EQ(importer.ParseLine("   0.002500 2  18DAF110x       Tx   d 3 02 10 03", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 2500);
+    EXPECT_EQ(frame.frame_id, 0x18DAF110);
+    EXPECT_EQ(frame.direction, CAN_LOG_DIR_TX);
+    EXPECT_EQ(frame.size, 3);
+
+    EXPECT_EQ(importer.ParseLine("   0.003000 1  ErrorFrame", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("   0.004000 1  456             Rx   r", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("   0.005000 CANFD   1 Rx        123  0 0 8 8 01 02 03 04 05 06 07 08", frame), CLIL_UNSUPPORTED);
+    EXPECT_EQ(importer.ParseLine("   0.006000 1  Statistic: D 0 R 0 XD 0 XR 0 E 0 O 0 B 0.00%", frame), CLIL_IGNORED);
+    EXPECT_EQ(importer.ParseLine("   0.007000 1  123             Rx   d 8 01 02", frame), CLIL_INVALID);
+    EXPECT_EQ(importer.ParseLine("End TriggerBlock", frame), CLIL_IGNORED);
+}
+
+TEST_F(CanLogImporterTest, AscDecimalRelative) {
+    CanLogImporter importer;
+    importer.Reset(CLIF_ASC);
+    CanRecordingFrame frame;
+
+    EXPECT_EQ(importer.ParseLine("base dec  timestamps relative", frame), CLIL_IGNORED);
+    ASSERT_EQ(importer.ParseLine("1.000000 1  291  Rx   d 2 255 16", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.frame_id, 0x123);
+    EXPECT_EQ(frame.data[0], 0xFF);
+    EXPECT_EQ(frame.data[1], 0x10);
+    ASSERT_EQ(importer.ParseLine("0.500000 1  291  Rx   d 2 255 16", frame), CLIL_FRAME);
+    EXPECT_EQ(frame.timestamp, 1500000);
+    EXPECT_EQ(importer.ParseLine("0.500000 1  291  Rx   d 1 256", frame), CLIL_INVALID);
+}
+
+TEST_F(CanLogImporterTest, ImportFile) {
+    std::string text;
+    for(uint32_t i = 0; i != 10000; i++)
+        text += std::format("({}.{:06}) can0 {:03X}#{:02X}00\n", 1000 + i / 1000, (i % 1000) * 1000, i % 0x800, i & 0xFF);
+    text += "(1010.000000) can0 7FF#01";  /* Last line without newline */
+
+    CanLogImportResult result;
+    std::vector<CanRecordingFrame> frames = ImportText(text, ".txt", result);
+    EXPECT_EQ(result.frames, 10001);
+    EXPECT_EQ(result.invalid_lines, 0);
+    EXPECT_EQ(result.bytes, text.length());
+    ASSERT_EQ(frames.size(), 10001);
+    EXPECT_EQ(frames[1234].timestamp, 1234000);
+    EXPECT_EQ(frames[1234].frame_id, 1234);
+    EXPECT_EQ(frames.back().timestamp, 10000000);
+    EXPECT_EQ(frames.back().frame_id, 0x7FF);
+}
+
+TEST_F(CanLogImporterTest, UnknownFormat) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "CanLogImporterTest.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "\n\nsomething else\n";
+    }
+
+    CanLogImportResult result;
+    CanLogImporter importer;
+    EXPECT_FALSE(importer.Import(path, [](const std::vector<CanRecordingFrame>&) { return true; }, result));
+    std::filesystem::remove(path);
+}
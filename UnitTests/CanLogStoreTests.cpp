@@ -0,0 +1,94 @@
+#include "pch.hpp"
+
+class CanLogStoreTest : public ::testing::Test {
+protected:
+
+    CanLogStoreTest() {
+    }
+
+    virtual ~CanLogStoreTest() {
+    }
+
+    bool Add(uint32_t frame_id, uint8_t value, std::chrono::milliseconds time) {
+        uint8_t data[2] = { value, static_cast<uint8_t>(frame_id) };
+        std::chrono::steady_clock::time_point timepoint = start + time;
+        return store.Add(CAN_LOG_DIR_RX, frame_id, data, sizeof(data), timepoint);
+    }
+
+    CanLogStore store;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+TEST_F(CanLogStoreTest, IndexMatchesLog) {
+    const uint32_t frame_ids[] = { 0x123, 0x7E8, 0x18DAF110, 0x123, 0x123, 0x7E8 };
+    for(size_t i = 0; i != std::size(frame_ids); i++)
+        ASSERT_TRUE(Add(frame_ids[i], static_cast<uint8_t>(i), std::chrono::milliseconds(i)));
+    ASSERT_EQ(store.size(), std::size(frame_ids));
+
+    EXPECT_EQ(store.GetOffsetsForFrame(0x123), CanLogOffsets({ 0, 3, 4 }));
+    EXPECT_EQ(store.GetOffsetsForFrame(0x7E8), CanLogOffsets({ 1, 5 }));
+    EXPECT_EQ(store.GetCountForFrame(0x18DAF110), 1);
+    EXPECT_TRUE(store.GetOffsetsForFrame(0x456).empty());
+
+    size_t total = 0;
+    for(uint32_t frame_id : { 0x123u, 0x7E8u, 0x18DAF110u })
+    {
+        for(uint32_t offset : store.GetOffsetsForFrame(frame_id))
+        {
+            EXPECT_EQ(store[offset].frame_id, frame_id);
+            EXPECT_EQ(store[offset].data[0], offset);
+            total++;
+        }
+    }
+    EXPECT_EQ(total, store.size());
+
+    EXPECT_EQ(store.FindNext(0x123, 0), 3);
+    EXPECT_EQ(store.FindNext(0x123, 4), std::nullopt);
+    EXPECT_EQ(store.FindPrevious(0x7E8, 5), 1);
+    EXPECT_EQ(store.FindPrevious(0x7E8, 1), std::nullopt);
+    EXPECT_EQ(store.GetTimeRangeForFrame(0x123, start + std::chrono::milliseconds(1), start + std::chrono::milliseconds(4)), CanLogOffsets({ 3 }));
+}
+
+TEST_F(CanLogStoreTest, OffsetsAreCopied) {
+    ASSERT_TRUE(Add(0x123, 0, std::chrono::milliseconds(0)));
+    CanLogOffsets offsets = store.GetOffsetsForFrame(0x123);
+    for(uint32_t i = 1; i != 1000; i++)  /* Index grows and rehashes meanwhile */
+        ASSERT_TRUE(Add(i % 2 ? 0x123 : 0x200 + i, static_cast<uint8_t>(i), std::chrono::milliseconds(i)));
+    EXPECT_EQ(offsets, CanLogOffsets({ 0 }));
+    EXPECT_EQ(store.GetCountForFrame(0x123), 501);
+}
+
+TEST_F(CanLogStoreTest, Clear) {
+    for(uint32_t i = 0; i != 100; i++)
+        ASSERT_TRUE(Add(0x100 + i % 10, static_cast<uint8_t>(i), std::chrono::milliseconds(i)));
+    store.Clear();
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(store.GetCountForFrame(0x100), 0);
+    EXPECT_EQ(store.FindNext(0x100, 0), std::nullopt);
+
+    ASSERT_TRUE(Add(0x105, 0xAA, std::chrono::milliseconds(0)));
+    EXPECT_EQ(store.size(), 1);
+    EXPECT_EQ(store.GetOffsetsForFrame(0x105), CanLogOffsets({ 0 }));
+    EXPECT_EQ(store[0].data[0], 0xAA);
+}
+
+TEST_F(CanLogStoreTest, ChunkBoundary) {
+    /* Frames around the end of the first chunk have to be reachable by offset and through the index */
+    const size_t count = CAN_LOG_CHUNK_SIZE + 10;
+    for(size_t i = 0; i != count; i++)
+        ASSERT_TRUE(Add(i % 2 ? 0x100 : 0x200, static_cast<uint8_t>(i), std::chrono::milliseconds(i)));
+    ASSERT_EQ(store.size(), count);
+
+    for(size_t offset = CAN_LOG_CHUNK_SIZE - 3; offset != CAN_LOG_CHUNK_SIZE + 3; offset++)
+    {
+        EXPECT_EQ(store[offset].frame_id, offset % 2 ? 0x100 : 0x200);
+        EXPECT_EQ(store[offset].data[0], static_cast<uint8_t>(offset));
+    }
+
+    EXPECT_EQ(store.GetCountForFrame(0x100), count / 2);
+    EXPECT_EQ(store.FindNext(0x100, CAN_LOG_CHUNK_SIZE - 1), CAN_LOG_CHUNK_SIZE + 1);
+    EXPECT_EQ(store.FindPrevious(0x200, CAN_LOG_CHUNK_SIZE + 1), CAN_LOG_CHUNK_SIZE);
+    CanLogOffsets offsets = store.GetOffsetsForFrame(0x200);
+    EXPECT_TRUE(std::is_sorted(offsets.begin(), offsets.end()));
+    EXPECT_EQ(offsets.back(), count - 2);
+}
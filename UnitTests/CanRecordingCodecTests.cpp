@@ -0,0 +1,142 @@
+#include "pch.hpp"
+
+class CanRecordingCodecTest : public ::testing::Test {
+protected:
+
+    CanRecordingCodecTest() {
+    }
+
+    virtual ~CanRecordingCodecTest() {
+    }
+
+    /* Periodic traffic with a counter, a slowly changing signal and some jitter, like a real bus */
+    std::vector<CanRecordingFrame> GenerateTraffic(size_t count)
+    {
+        std::vector<CanRecordingFrame> frames;
+        uint32_t ids[] = { 0x100, 0x123, 0x3A0, 0x18DAF110 };
+        uint64_t periods[] = { 10000, 20000, 100000, 50000 };
+        std::mt19937 rng(42);
+        for(uint64_t t = 0; frames.size() < count; t += 1000)
+        {
+            for(size_t i = 0; i != std::size(ids); i++)
+            {
+                if(t % periods[i])
+                    continue;
+                CanRecordingFrame frame;
+                frame.timestamp = t + rng() % 3;
+                frame.frame_id = ids[i];
+                frame.direction = i % 2;
+                frame.size = i == 3 ? 3 : 8;
+                frame.data[0] = static_cast<uint8_t>(frames.size() / 64);
+                frame.data[1] = static_cast<uint8_t>(t / periods[i]);  /* Counter */
+                frame.data[2] = 0xAA;
+                if(frame.size == 8)
+                    frame.data[7] = static_cast<uint8_t>(i);
+                frames.push_back(frame);
+            }
+        }
+        frames.resize(count);
+        return frames;
+    }
+
+    void ExpectEqual(const std::vector<CanRecordingFrame>& expected, const std::vector<CanRecordingFrame>& frames)
+    {
+        ASSERT_EQ(expected.size(), frames.size());
+        for(size_t i = 0; i != frames.size(); i++)
+        {
+            EXPECT_EQ(expected[i].timestamp, frames[i].timestamp);
+            EXPECT_EQ(expected[i].frame_id, frames[i].frame_id);
+            EXPECT_EQ(expected[i].direction, frames[i].direction);
+            EXPECT_EQ(expected[i].size, frames[i].size);
+            EXPECT_EQ(expected[i].data, frames[i].data);
+        }
+    }
+};
+
+TEST_F(CanRecordingCodecTest, LzRoundTrip)
+{
+    std::mt19937 rng(1);
+    for(size_t len : { 0, 3, 4, 100, 70000 })
+    {
+        std::vector<uint8_t> in(len);
+        for(size_t i = 0; i != len; i++)
+            in[i] = i % 1000 < 500 ? static_cast<uint8_t>(i % 7) : static_cast<uint8_t>(rng());  /* Repetitive and random parts */
+
+        std::vector<uint8_t> compressed, out;
+        CanRecordingLz::Compress(in.data(), in.size(), compressed);
+        ASSERT_TRUE(CanRecordingLz::Decompress(compressed.data(), compressed.size(), out, in.size()));
+        EXPECT_EQ(in, out);
+    }
+
+    std::vector<uint8_t> in(1000, 0x55), compressed, out;
+    CanRecordingLz::Compress(in.data(), in.size(), compressed);
+    EXPECT_LT(compressed.size(), 20);
+    EXPECT_FALSE(CanRecordingLz::Decompress(compressed.data(), compressed.size(), out, 999));  /* Larger than expected */
+    compressed[2] = 0xFF;  /* Offset points before the start */
+    out.clear();
+    EXPECT_FALSE(CanRecordingLz::Decompress(compressed.data(), compressed.size(), out, 1000));
+}
+
+TEST_F(CanRecordingCodecTest, RoundTripAndSize)
+{
+    std::vector<CanRecordingFrame> frames = GenerateTraffic(20000);
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    CanRecordingWriter writer(ss);
+    for(auto& i : frames)
+        ASSERT_TRUE(writer.Add(i));
+    ASSERT_TRUE(writer.Flush());
+    EXPECT_LT(writer.GetWrittenSize(), frames.size() * 4);  /* CSV needs about 60 bytes per frame */
+
+    CanRecordingReader reader(ss);
+    ASSERT_TRUE(reader.ReadHeader());
+    std::vector<CanRecordingFrame> decoded;
+    while(reader.ReadNextBlock(decoded))
+    {
+    }
+    ExpectEqual(frames, decoded);
+}
+
+TEST_F(CanRecordingCodecTest, SeekToBlock)
+{
+    std::vector<CanRecordingFrame> frames = GenerateTraffic(1000);
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    CanRecordingWriter writer(ss, 300);
+    for(auto& i : frames)
+        ASSERT_TRUE(writer.Add(i));
+    ASSERT_TRUE(writer.Flush());
+
+    CanRecordingReader reader(ss);
+    ASSERT_TRUE(reader.ReadHeader());
+    std::vector<CanRecordingBlockInfo> blocks;
+    ASSERT_TRUE(reader.ReadIndex(blocks));
+    ASSERT_EQ(blocks.size(), 4);
+    EXPECT_EQ(blocks[3].frame_count, 100);
+    EXPECT_EQ(blocks[2].first_timestamp, frames[600].timestamp);
+    EXPECT_EQ(blocks[2].last_timestamp, frames[899].timestamp);
+
+    std::vector<CanRecordingFrame> decoded;
+    ASSERT_TRUE(reader.ReadBlock(blocks[2], decoded));
+    ExpectEqual(std::vector<CanRecordingFrame>(frames.begin() + 600, frames.begin() + 900), decoded);
+}
+
+TEST_F(CanRecordingCodecTest, CorruptedBlock)
+{
+    std::vector<CanRecordingFrame> frames = GenerateTraffic(100);
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    CanRecordingWriter writer(ss);
+    for(auto& i : frames)
+        writer.Add(i);
+    writer.Flush();
+
+    std::string data = ss.str();
+    data[data.size() - 5] ^= 0x01;
+    std::stringstream corrupted(data, std::ios::in | std::ios::binary);
+    CanRecordingReader reader(corrupted);
+    ASSERT_TRUE(reader.ReadHeader());
+    std::vector<CanRecordingFrame> decoded;
+    EXPECT_FALSE(reader.ReadNextBlock(decoded));
+
+    std::stringstream not_recording("Time,Direction,FrameID,DataSize,Data,Comment\n", std::ios::in | std::ios::binary);
+    CanRecordingReader csv_reader(not_recording);
+    EXPECT_FALSE(csv_reader.ReadHeader());
+}
@@ -0,0 +1,161 @@
+#include "pch.hpp"
+
+class CanScriptCompilerTest : public ::testing::Test {
+protected:
+
+    CanScriptCompilerTest() {
+        symbols.frames["VEHICLE_INFO"] = { 0x123, 8 };
+        symbols.frames["DTOOL_TO_XXX"] = { 0x7DA, 8 };
+        symbols.signals["VehicleHasClutch"] = { 0x123, 0, 1, CSST_UNSIGNED };
+        symbols.signals["Speed"] = { 0x123, 8, 16, CSST_UNSIGNED };
+        symbols.signals["Temperature"] = { 0x123, 24, 8, CSST_SIGNED };
+    }
+
+    virtual ~CanScriptCompilerTest() {
+    }
+
+    bool Compile(const std::string& script)
+    {
+        errors.clear();
+        return CanScriptCompiler::Compile(script, symbols, program, errors);
+    }
+
+    std::vector<CanScriptOpcode> Opcodes() const
+    {
+        std::vector<CanScriptOpcode> ret;
+        for(auto& i : program.code)
+            ret.push_back(i.opcode);
+        return ret;
+    }
+
+    CanScriptSymbols symbols;
+    CanScriptProgram program;
+    std::vector<std::string> errors;
+};
+
+TEST_F(CanScriptCompilerTest, LegacyScript)
+{
+    ASSERT_TRUE(Compile("# Comment\nSetFrameFieldRaw DTOOL_TO_XXX 0x03222000AAAAAAA\nWaitForFrame DTOOL_TO_XXX 120000\n\nSetFrameField VehicleHasClutch 0x1\nSendFrame VEHICLE_INFO\nSleep 500\n"));
+    EXPECT_EQ(Opcodes(), std::vector<CanScriptOpcode>({ CSO_SET_FRAME_RAW, CSO_PUSH_CONST, CSO_WAIT_FRAME, CSO_PUSH_CONST, CSO_SET_SIGNAL,
+        CSO_SEND_FRAME, CSO_PUSH_CONST, CSO_SLEEP, CSO_HALT }));
+    EXPECT_EQ(program.frames.size(), 2);
+    std::array<uint8_t, 8> raw = { 0x03, 0x22, 0x20, 0x00, 0xAA, 0xAA, 0xAA, 0xAA };
+    EXPECT_EQ(program.raw_data[0].data, raw);
+    EXPECT_EQ(program.constants[program.code[6].operand].AsInt(), 500000);  /* Sleep is converted to microseconds */
+    EXPECT_EQ(program.lines[5], 6);
+}
+
+TEST_F(CanScriptCompilerTest, ConstantFolding)
+{
+    ASSERT_TRUE(Compile("x = 2 * (3 + 4) - -1\ny = 1 << 4 | 1\nz = 7 / 2.0\n"));
+    EXPECT_EQ(Opcodes(), std::vector<CanScriptOpcode>({ CSO_PUSH_CONST, CSO_STORE_VAR, CSO_PUSH_CONST, CSO_STORE_VAR, CSO_PUSH_CONST, CSO_STORE_VAR, CSO_HALT }));
+    EXPECT_EQ(program.constants[program.code[0].operand].AsInt(), 15);
+    EXPECT_EQ(program.constants[program.code[2].operand].AsInt(), 17);
+    EXPECT_DOUBLE_EQ(program.constants[program.code[4].operand].AsDouble(), 3.5);
+    EXPECT_EQ(program.max_stack, 3);  /* Depth before folding */
+}
+
+TEST_F(CanScriptCompilerTest, SignalsAreResolvedOnce)
+{
+    ASSERT_TRUE(Compile("SetSignal Speed $Speed + 10\nSetSignal Temperature -$Temperature\nSendFrame Speed\n"));
+    EXPECT_EQ(program.frames.size(), 1);
+    EXPECT_EQ(program.frames[0].frame_id, 0x123);
+    EXPECT_EQ(program.frames[0].name, "VEHICLE_INFO");
+    ASSERT_EQ(program.signals.size(), 2);
+    EXPECT_EQ(program.signals[0].offset, 8);
+    EXPECT_EQ(program.signals[1].type, CSST_SIGNED);
+}
+
+TEST_F(CanScriptCompilerTest, LoopJumpsStayInProgram)
+{
+    ASSERT_TRUE(Compile("i = 0\nLoop 10\n  If i % 2 == 0\n    Continue\n  Else\n    i += 1\n  EndIf\n  While i > 5\n    Break\n  EndWhile\nEndLoop\nstart:\nGoto start\n"));
+    for(auto& i : program.code)
+    {
+        if(i.opcode == CSO_JUMP || i.opcode == CSO_JUMP_IF_FALSE)
+        {
+            EXPECT_LT(i.operand, program.code.size());
+        }
+    }
+    EXPECT_EQ(program.variables.size(), 2);  /* i and the hidden loop counter */
+}
+
+TEST_F(CanScriptCompilerTest, Errors)
+{
+    EXPECT_FALSE(Compile("x = y + 1\nSetSignal Unknown 1\nIf 1\nGoto nowhere\nSetFrameField Speed 1+2\nSleep 1 / 0\nBogus 1\n"));
+    ASSERT_EQ(errors.size(), 7);
+    EXPECT_TRUE(errors[0].starts_with("Line 1:"));
+    EXPECT_TRUE(errors[1].starts_with("Line 2:"));
+    EXPECT_TRUE(errors[2].starts_with("Line 5:"));
+    EXPECT_TRUE(errors[3].starts_with("Line 6:"));
+    EXPECT_TRUE(errors[4].starts_with("Line 7:"));
+    EXPECT_TRUE(errors[5].starts_with("Line 3:"));  /* Unclosed If */
+    EXPECT_TRUE(errors[6].starts_with("Line 4:"));  /* Unknown label */
+}
+
+TEST_F(CanScriptCompilerTest, ValueArithmetic)
+{
+    CanScriptValue result;
+    ASSERT_TRUE(CanScriptValue::ApplyBinary(CSO_ADD, CanScriptValue(static_cast<int64_t>(1)), CanScriptValue(0.5), result));
+    EXPECT_TRUE(result.is_float);
+    EXPECT_DOUBLE_EQ(result.f, 1.5);
+
+    ASSERT_TRUE(CanScriptValue::ApplyBinary(CSO_DIV, CanScriptValue(static_cast<int64_t>(7)), CanScriptValue(static_cast<int64_t>(2)), result));
+    EXPECT_FALSE(result.is_float);
+    EXPECT_EQ(result.i, 3);
+
+    EXPECT_FALSE(CanScriptValue::ApplyBinary(CSO_MOD, CanScriptValue(static_cast<int64_t>(7)), CanScriptValue(static_cast<int64_t>(0)), result));
+
+    ASSERT_TRUE(CanScriptValue::ApplyBinary(CSO_BIT_AND, CanScriptValue(255.9), CanScriptValue(static_cast<int64_t>(0x0F)), result));
+    EXPECT_EQ(result.i, 0x0F);
+
+    ASSERT_TRUE(CanScriptValue::ApplyUnary(CSO_NOT, CanScriptValue(static_cast<int64_t>(5)), result));
+    EXPECT_EQ(result.i, 0);
+}
+
+TEST_F(CanScriptCompilerTest, WaitForConditions)
+{
+    ASSERT_TRUE(Compile("r = WaitFor 0x123[2]&0x0F==5 and DTOOL_TO_XXX/FF00FF=0300A0 || 0x456 Timeout 20\nWaitFor VEHICLE_INFO\n"));
+    EXPECT_EQ(Opcodes(), std::vector<CanScriptOpcode>({ CSO_PUSH_CONST, CSO_WAIT_CONDITION, CSO_STORE_VAR, CSO_PUSH_CONST, CSO_WAIT_CONDITION, CSO_POP, CSO_HALT }));
+    ASSERT_EQ(program.wait_conditions.size(), 2);
+
+    const CanScriptWaitCondition& condition = program.wait_conditions[0];
+    ASSERT_EQ(condition.predicates.size(), 3);
+    EXPECT_EQ(condition.predicates[0].frame_id, 0x123);
+    EXPECT_EQ(condition.predicates[0].len, 3);
+    EXPECT_EQ(condition.predicates[0].mask[0], 0);
+    EXPECT_EQ(condition.predicates[0].mask[2], 0x0F);
+    EXPECT_EQ(condition.predicates[1].frame_id, 0x7DA);
+    EXPECT_EQ(condition.predicates[1].value[2], 0xA0);
+    EXPECT_EQ(condition.predicates[2].len, 0);
+    EXPECT_EQ(condition.alternatives, std::vector<uint64_t>({ 0b011, 0b100 }));
+    EXPECT_EQ(condition.by_id.size(), 3);
+    EXPECT_EQ(program.constants[program.code[0].operand].AsInt(), 20);
+    EXPECT_EQ(program.constants[program.code[3].operand].AsInt(), -1);  /* No timeout */
+    EXPECT_EQ(program.frames.size(), 3);  /* Same frame isn't added twice */
+
+    EXPECT_FALSE(Compile("WaitFor\nWaitFor 0x123[9]==1\nWaitFor 0x123[0]=0x100\nWaitFor 0x123/FF=1122\nWaitFor 0x123 xor 0x456\n"));
+    EXPECT_EQ(errors.size(), 5);
+}
+
+TEST_F(CanScriptCompilerTest, WaitConditionMatching)
+{
+    ASSERT_TRUE(Compile("WaitFor 0x123[2]&0x0F==5 && 0x123[0]==1 or 0x456\n"));
+    const CanScriptWaitCondition& condition = program.wait_conditions[0];
+    auto candidates = [&condition](uint32_t frame_id)
+    {
+        auto it = std::find_if(condition.by_id.begin(), condition.by_id.end(), [frame_id](auto& p) { return p.first == frame_id; });
+        return it == condition.by_id.end() ? 0 : it->second;
+    };
+
+    uint64_t latched = 0;
+    uint8_t data1[] = { 0x00, 0x00, 0xF5 };
+    EXPECT_EQ(condition.OnFrame(candidates(0x123), latched, data1, sizeof(data1)), 0);
+    EXPECT_EQ(latched, 0b001);
+    uint8_t data2[] = { 0x01 };  /* Too short for the first predicate */
+    EXPECT_EQ(condition.OnFrame(candidates(0x123), latched, data2, sizeof(data2)), 1);  /* Predicates are latched, they don't have to match in the same frame */
+
+    latched = 0;
+    EXPECT_EQ(condition.OnFrame(candidates(0x456), latched, data2, sizeof(data2)), 2);
+    latched = 0;
+    EXPECT_EQ(condition.OnFrame(candidates(0x789), latched, data1, sizeof(data1)), 0);
+}
@@ -0,0 +1,90 @@
+#include "pch.hpp"
+
+class CanSignalDecoderTest : public ::testing::Test {
+protected:
+
+    CanSignalDecoderTest() {
+    }
+
+    virtual ~CanSignalDecoderTest() {
+    }
+
+    CanSignalDefinition MakeSignal(CanBitfieldType type, uint8_t offset, uint8_t size)
+    {
+        CanSignalDefinition signal;
+        signal.type = type;
+        signal.offset = offset;
+        signal.size = size;
+        return signal;
+    }
+};
+
+TEST_F(CanSignalDecoderTest, DecodeTypes) {
+    uint8_t data[8] = { 0x12, 0xFE, 0x01, 0x00, 0x3F, 0x80, 0x00, 0x00 };
+    double value = 0.0;
+
+    ASSERT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_UI8, 0, 8), data, sizeof(data), value));
+    EXPECT_EQ(value, 0x12);
+    ASSERT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_I8, 8, 8), data, sizeof(data), value));
+    EXPECT_EQ(value, -2);
+    ASSERT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_I16, 8, 4), data, sizeof(data), value));
+    EXPECT_EQ(value, -1);  /* Sign extended from it's bit length */
+    ASSERT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_UI16, 16, 16), data, sizeof(data), value));
+    EXPECT_EQ(value, 0x0100);
+    ASSERT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_FLOAT, 32, 32), data, sizeof(data), value));
+    EXPECT_EQ(value, 1.0);
+}
+
+TEST_F(CanSignalDecoderTest, SignalOutsideOfFrame) {
+    uint8_t data[2] = { 0xFF, 0xFF };
+    double value = 0.0;
+    EXPECT_TRUE(CanSignalDecoder::Decode(MakeSignal(CBT_UI16, 0, 16), data, sizeof(data), value));
+    EXPECT_FALSE(CanSignalDecoder::Decode(MakeSignal(CBT_UI16, 8, 16), data, sizeof(data), value));
+}
+
+TEST_F(CanSignalDecoderTest, TypeNames) {
+    EXPECT_EQ(CanSignalDecoder::GetTypeFromString("int16_t"), CBT_I16);
+    EXPECT_EQ(CanSignalDecoder::GetTypeFromString("double"), CBT_DOUBLE);
+    EXPECT_EQ(CanSignalDecoder::GetTypeFromString("invalid"), CBT_INVALID);
+    EXPECT_EQ(CanSignalDecoder::GetTypeFromString("uint128_t"), CBT_INVALID);
+    EXPECT_EQ(CanSignalDecoder::GetStringFromType(CBT_UI32), "uint32_t");
+}
+
+TEST_F(CanSignalDecoderTest, LoadMapping) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "CanSignalDecoderTest.xml";
+    {
+        std::ofstream out(path);
+        out << "<CanFrameMapping>"
+            "<Frame><ID>200</ID><Name>Second</Name><Size>8</Size><Direction>R</Direction>"
+            "<Mapping offset=\"8\" len=\"8\" type=\"uint8_t\">B</Mapping>"
+            "<Mapping offset=\"0\" len=\"8\" type=\"uint8_t\">A</Mapping>"
+            "<Mapping offset=\"16\" len=\"8\" type=\"bogus\">Invalid</Mapping>"
+            "</Frame>"
+            "<Frame><ID>1A0</ID><Name>First</Name><Size>8</Size><Direction>T</Direction>"
+            "<Mapping offset=\"0\" len=\"16\" type=\"int16_t\">C</Mapping>"
+            "</Frame>"
+            "</CanFrameMapping>";
+    }
+
+    CanSignalDecoder decoder;
+    ASSERT_TRUE(decoder.LoadMapping(path));
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(decoder.GetFrames().size(), 2);
+    EXPECT_EQ(decoder.GetSignalCount(), 3);
+    EXPECT_EQ(decoder.FindFrame(0x123), nullptr);
+
+    const CanFrameDefinition* first = decoder.FindFrame(0x1A0);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first->name, "First");
+    ASSERT_EQ(first->signals.size(), 1);
+    EXPECT_EQ(first->signals[0].index, 0);
+
+    const CanFrameDefinition* second = decoder.FindFrame(0x200);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(second->signals.size(), 2);
+    EXPECT_EQ(second->signals[0].name, "A");  /* Sorted by offset */
+    EXPECT_EQ(second->signals[0].index, 1);
+    EXPECT_EQ(second->signals[1].name, "B");
+    EXPECT_EQ(second->signals[1].index, 2);
+}
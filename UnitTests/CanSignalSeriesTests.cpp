@@ -0,0 +1,105 @@
+#include "pch.hpp"
+
+class CanSignalSeriesTest : public ::testing::Test {
+protected:
+
+    CanSignalSeriesTest() : series("Speed", 65536) {
+    }
+
+    virtual ~CanSignalSeriesTest() {
+    }
+
+    CanSignalSeries series;
+    std::vector<CanSignalPoint> out;
+};
+
+TEST_F(CanSignalSeriesTest, RawPoints) {
+    for(int64_t i = 0; i != 100; i++)
+        series.Add(i * 1000, static_cast<double>(i));
+    EXPECT_EQ(series.GetSize(), 100);
+    EXPECT_EQ(series.GetLevelCount(), 5);
+
+    series.Query(10000, 19000, 100, out);
+    ASSERT_EQ(out.size(), 10);
+    EXPECT_EQ(out.front().time, 10000);
+    EXPECT_EQ(out.back().time, 19000);
+    EXPECT_EQ(out.back().value, 19.0);
+
+    int64_t first, last;
+    ASSERT_TRUE(series.GetTimeRange(first, last));
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 99000);
+
+    series.Query(200000, 300000, 100, out);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST_F(CanSignalSeriesTest, Lttb) {
+    std::vector<CanSignalPoint> in;
+    for(int64_t i = 0; i != 1000; i++)
+        in.push_back(CanSignalPoint{ i, i == 500 ? 100.0 : 0.0 });
+
+    CanSignalSeries::Lttb(in, 10, out);
+    ASSERT_EQ(out.size(), 10);
+    EXPECT_EQ(out.front().time, 0);
+    EXPECT_EQ(out.back().time, 999);
+    EXPECT_TRUE(std::any_of(out.begin(), out.end(), [](const CanSignalPoint& p) { return p.value == 100.0; }));  /* Spike is kept */
+    EXPECT_TRUE(std::is_sorted(out.begin(), out.end(), [](const CanSignalPoint& a, const CanSignalPoint& b) { return a.time < b.time; }));
+}
+
+TEST_F(CanSignalSeriesTest, LttbSpikeOnSlope) {
+    /* Points of the slope are on one line, only the spike makes a triangle */
+    std::vector<CanSignalPoint> in;
+    for(int64_t i = 0; i != 1000; i++)
+        in.push_back(CanSignalPoint{ i * 1000, static_cast<double>(i) + (i == 333 ? 20.0 : 0.0) });
+
+    CanSignalSeries::Lttb(in, 20, out);
+    ASSERT_EQ(out.size(), 20);
+    EXPECT_TRUE(std::any_of(out.begin(), out.end(), [](const CanSignalPoint& p) { return p.time == 333000 && p.value == 353.0; }));
+}
+
+TEST_F(CanSignalSeriesTest, LttbSine) {
+    /* 4 periods of 250 points, each peak and valley has to be kept */
+    constexpr double pi = 3.14159265358979323846;
+    std::vector<CanSignalPoint> in;
+    for(int64_t i = 0; i != 1000; i++)
+        in.push_back(CanSignalPoint{ 1'700'000'000'000'000 + i * 1000, std::sin(2.0 * pi * static_cast<double>(i) / 250.0) });
+
+    CanSignalSeries::Lttb(in, 100, out);
+    ASSERT_EQ(out.size(), 100);
+    for(int64_t period = 0; period != 4; period++)
+    {
+        int64_t begin = in[period * 250].time;
+        int64_t end = begin + 250 * 1000;
+        auto in_period = [begin, end](const CanSignalPoint& p) { return p.time >= begin && p.time < end; };
+        EXPECT_TRUE(std::any_of(out.begin(), out.end(), [&](const CanSignalPoint& p) { return in_period(p) && p.value > 0.99; })) << "Peak of period " << period;
+        EXPECT_TRUE(std::any_of(out.begin(), out.end(), [&](const CanSignalPoint& p) { return in_period(p) && p.value < -0.99; })) << "Valley of period " << period;
+    }
+}
+
+TEST_F(CanSignalSeriesTest, Pyramid) {
+    /* 1 kHz signal for 10 minutes, ring keeps the last 65536 points only */
+    for(int64_t i = 0; i != 600000; i++)
+        series.Add(i * 1000, i == 100000 ? 1000.0 : static_cast<double>(i % 100));
+    EXPECT_EQ(series.GetSize(), 65536);
+
+    int64_t first, last;
+    ASSERT_TRUE(series.GetTimeRange(first, last));
+    EXPECT_LT(first, 100000000);  /* Coarse levels reach back further than the raw ring */
+    EXPECT_EQ(last, 599999000);
+
+    series.Query(first, last, 500, out);
+    EXPECT_LE(out.size(), 500);
+    EXPECT_GT(out.size(), 100);
+    EXPECT_TRUE(std::any_of(out.begin(), out.end(), [](const CanSignalPoint& p) { return p.value == 1000.0; }));  /* Spike survives the min/max levels */
+    EXPECT_TRUE(std::is_sorted(out.begin(), out.end(), [](const CanSignalPoint& a, const CanSignalPoint& b) { return a.time < b.time; }));
+    EXPECT_GE(out.back().time, 599000000);  /* Newest points which aren't in a closed bucket yet are included */
+
+    /* Short window of the newest data comes from the raw ring */
+    series.Query(last - 100000, last, 500, out);
+    ASSERT_EQ(out.size(), 101);
+    EXPECT_EQ(out.front().time, last - 100000);
+
+    series.Clear();
+    EXPECT_FALSE(series.GetTimeRange(first, last));
+}
@@ -0,0 +1,189 @@
+#include "pch.hpp"
+
+class CanStressGeneratorTest : public ::testing::Test {
+protected:
+
+    CanStressGeneratorTest() {
+        config.id_min = 0x100;
+        config.id_max = 0x100;
+        config.dlc_min = 8;
+        config.dlc_max = 8;
+        config.seed = 1234;
+    }
+
+    virtual ~CanStressGeneratorTest() {
+    }
+
+    virtual void SetUp() {
+        generator = std::make_unique<CanStressGenerator>([this](uint32_t frame_id, const uint8_t* data, uint8_t size)
+            {
+                frames.push_back({ frame_id, std::vector<uint8_t>(data, data + size) });
+                return accept;
+            });
+    }
+
+    virtual void TearDown()
+    {
+        frames.clear();
+    }
+
+    /* Poll in steps for the given time */
+    void Run(std::chrono::milliseconds step, std::chrono::milliseconds length)
+    {
+        for(auto t = std::chrono::milliseconds(0); t <= length; t += step)
+            generator->Poll(start + t);
+    }
+
+    CanStressConfig config;
+    std::unique_ptr<CanStressGenerator> generator;
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> frames;
+    bool accept = true;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::time_point(std::chrono::hours(1));
+};
+
+TEST_F(CanStressGeneratorTest, FrameBits)
+{
+    /* Nominal length plus at most one stuff bit per 4 bits of the stuffed part */
+    uint8_t zeros[8] = {};
+    uint8_t alternating[8] = { 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55 };
+    for(uint8_t size = 0; size <= 8; size++)
+    {
+        uint32_t std_bits = CanStressGenerator::GetFrameBits(0x123, zeros, size);
+        EXPECT_GE(std_bits, 47U + 8 * size);
+        EXPECT_LE(std_bits, 47U + 8 * size + (34 + 8 * size - 1) / 4);
+
+        uint32_t ext_bits = CanStressGenerator::GetFrameBits(0x18DAF110, zeros, size);
+        EXPECT_GE(ext_bits, 67U + 8 * size);
+        EXPECT_LE(ext_bits, 67U + 8 * size + (54 + 8 * size - 1) / 4);
+    }
+
+    /* Long runs of zeros are stuffed, alternating bits aren't */
+    EXPECT_GT(CanStressGenerator::GetFrameBits(0x123, zeros, 8), CanStressGenerator::GetFrameBits(0x123, alternating, 8));
+    EXPECT_GE(CanStressGenerator::GetFrameBits(0x123, zeros, 8), 47U + 64 + 64 / 5);
+}
+
+TEST_F(CanStressGeneratorTest, Rate)
+{
+    config.rate = 1000.0;
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+
+    /* Same number of frames regardless of polling period */
+    Run(std::chrono::milliseconds(5), std::chrono::milliseconds(1000));
+    EXPECT_EQ(frames.size(), 1001);
+    EXPECT_EQ(generator->GetStats().sent, 1001);
+    EXPECT_EQ(generator->GetStats().overruns, 0);
+
+    frames.clear();
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    Run(std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+    EXPECT_EQ(frames.size(), 1001);
+}
+
+TEST_F(CanStressGeneratorTest, BusLoad)
+{
+    config.bus_load = 50.0;
+    config.bitrate = 500000;
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    Run(std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+
+    /* Half of the bits of one second, within one frame */
+    CanStressStats stats = generator->GetStats();
+    EXPECT_NEAR(static_cast<double>(stats.bits), 250000.0, 160.0);
+    EXPECT_EQ(stats.sent, frames.size());
+}
+
+TEST_F(CanStressGeneratorTest, Modes)
+{
+    config.id_mode = CSIM_INCREMENT;
+    config.id_max = 0x102;
+    config.dlc_mode = CSDM_SWEEP;
+    config.dlc_min = 1;
+    config.dlc_max = 3;
+    config.payload_mode = CSPM_INCREMENT;
+    config.count = 6;
+    config.burst_size = 10;
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    EXPECT_FALSE(generator->Poll(start));
+    EXPECT_FALSE(generator->IsRunning());
+
+    ASSERT_EQ(frames.size(), 6);
+    for(size_t i = 0; i != frames.size(); i++)
+    {
+        EXPECT_EQ(frames[i].first, 0x100 + i % 3);
+        EXPECT_EQ(frames[i].second.size(), 1 + i % 3);
+        EXPECT_EQ(frames[i].second[0], i);
+    }
+}
+
+TEST_F(CanStressGeneratorTest, Random)
+{
+    config.id_mode = CSIM_RANDOM;
+    config.id_max = 0x1FF;
+    config.dlc_mode = CSDM_RANDOM;
+    config.dlc_min = 1;
+    config.payload_mode = CSPM_RANDOM;
+    config.count = 100;
+    config.burst_size = 100;
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    generator->Poll(start);
+    auto first_run = frames;
+
+    /* Same seed generates the same frames */
+    frames.clear();
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    generator->Poll(start);
+    EXPECT_EQ(frames, first_run);
+    EXPECT_EQ(generator->GetStats().seed, 1234);
+
+    for(auto& [frame_id, data] : frames)
+    {
+        EXPECT_GE(frame_id, 0x100);
+        EXPECT_LE(frame_id, 0x1FF);
+        EXPECT_GE(data.size(), 1);
+        EXPECT_LE(data.size(), 8);
+    }
+}
+
+TEST_F(CanStressGeneratorTest, Mutate)
+{
+    config.payload_mode = CSPM_MUTATE;
+    config.count = 100;
+    config.burst_size = 100;
+    EXPECT_FALSE(generator->Reset(config, {}, start));  /* No seed */
+
+    uint8_t data[4] = { 0x11, 0x22, 0x33, 0x44 };
+    std::vector<CanData> seeds = { CanData(0x7E0, sizeof(data), data) };
+    ASSERT_TRUE(generator->Reset(config, std::move(seeds), start));
+    generator->Poll(start);
+
+    ASSERT_EQ(frames.size(), 100);
+    size_t changed = 0;
+    for(auto& [frame_id, frame_data] : frames)
+    {
+        EXPECT_EQ(frame_id, 0x7E0);
+        if(frame_data != std::vector<uint8_t>(data, data + sizeof(data)))
+            changed++;
+    }
+    EXPECT_GT(changed, 50);
+}
+
+TEST_F(CanStressGeneratorTest, DropsAndOverruns)
+{
+    config.rate = 100.0;
+    ASSERT_TRUE(generator->Reset(config, {}, start));
+    accept = false;
+    generator->Poll(start);
+    generator->Poll(start + std::chrono::milliseconds(500));  /* Thread wasn't scheduled for a long time */
+
+    CanStressStats stats = generator->GetStats();
+    EXPECT_EQ(stats.generated, 2);
+    EXPECT_EQ(stats.dropped, 2);
+    EXPECT_EQ(stats.sent, 0);
+    EXPECT_EQ(stats.overruns, 1);
+
+    config.id_min = 0x200;  /* Invalid range */
+    EXPECT_FALSE(generator->Reset(config, {}, start));
+    config.id_min = 0x100;
+    config.dlc_min = 0;
+    EXPECT_FALSE(generator->Reset(config, {}, start));
+}
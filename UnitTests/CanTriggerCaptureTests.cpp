@@ -0,0 +1,113 @@
+#include "pch.hpp"
+
+class CanTriggerCaptureTest : public ::testing::Test {
+protected:
+
+    CanTriggerCaptureTest() {
+        capture.SetRingSize(100);
+        capture.SetWindow(std::chrono::milliseconds(50), std::chrono::milliseconds(20));
+    }
+
+    virtual ~CanTriggerCaptureTest() {
+    }
+
+    /* Send one frame every millisecond */
+    void SendFrames(uint32_t frame_id, size_t count, uint8_t first_byte = 0)
+    {
+        for(size_t i = 0; i != count; i++)
+        {
+            uint8_t data[] = { first_byte, 0x00 };
+            now += std::chrono::milliseconds(1);
+            capture.OnFrame(1, frame_id, data, sizeof(data), now);
+            capture.Poll(now);
+        }
+    }
+
+    CanTriggerCapture capture;
+    std::chrono::steady_clock::time_point now;
+    std::vector<CanCaptureEvent> events;
+};
+
+TEST_F(CanTriggerCaptureTest, TriggerString)
+{
+    EXPECT_TRUE(capture.SetTriggersFromString("7e8/00ff=0062, error,Missing:123:100, Did:7E8:f190 # comment"));
+    EXPECT_EQ(capture.GetTriggersAsString(), "7E8/00FF=0062, Error, Missing:123:100, Did:7E8:F190");
+
+    EXPECT_FALSE(capture.SetTriggersFromString("7E8/FF=0062, Missing:123, Bogus, 456"));
+    EXPECT_EQ(capture.GetTriggersAsString(), "456");  /* Valid ones are kept */
+}
+
+TEST_F(CanTriggerCaptureTest, PreAndPostTriggerWindow)
+{
+    ASSERT_TRUE(capture.SetTriggersFromString("456/F0=A0"));
+    capture.Arm(true, now);
+    SendFrames(0x123, 200);
+    SendFrames(0x456, 1, 0xA5);
+    SendFrames(0x123, 40);
+    SendFrames(0x456, 1, 0x05);  /* Data doesn't match */
+    SendFrames(0x123, 10);
+
+    ASSERT_TRUE(capture.TakeEvents(events));
+    ASSERT_EQ(events.size(), 1);
+    const CanCaptureEvent& event = events[0];
+    EXPECT_EQ(event.number, 1);
+    EXPECT_EQ(event.trigger, "456/F0=A0");
+    EXPECT_EQ(event.pre_trigger_count, 51);  /* 50 ms before the trigger and the trigger frame */
+    EXPECT_EQ(event.frames[event.pre_trigger_count - 1].frame_id, 0x456);
+    EXPECT_EQ(event.frames.size(), 51 + 20);
+    EXPECT_FALSE(capture.TakeEvents(events));
+}
+
+TEST_F(CanTriggerCaptureTest, MissingFrameFiresOncePerGap)
+{
+    ASSERT_TRUE(capture.SetTriggersFromString("Missing:123:10"));
+    capture.Arm(true, now);
+    SendFrames(0x123, 30);
+    EXPECT_EQ(capture.GetEventCount(), 0);
+    SendFrames(0x456, 100);
+    EXPECT_EQ(capture.GetEventCount(), 1);
+    SendFrames(0x123, 1);
+    SendFrames(0x456, 100);
+    EXPECT_EQ(capture.GetEventCount(), 2);
+
+    ASSERT_TRUE(capture.TakeEvents(events));
+    EXPECT_EQ(events.size(), 2);
+}
+
+TEST_F(CanTriggerCaptureTest, ErrorAndDidResponse)
+{
+    ASSERT_TRUE(capture.SetTriggersFromString("Error, Did:7E8:F190"));
+    capture.SetWindow(std::chrono::milliseconds(50), std::chrono::milliseconds(0));
+    capture.Arm(true, now);
+    SendFrames(0x123, 10);
+    capture.OnErrorFrame(now);
+
+    uint8_t response[] = { 0x62, 0xF1, 0x90, 'V', 'I', 'N' };
+    capture.OnIsoTpData(0x7E9, response, sizeof(response), now);  /* Different ECU */
+    capture.OnIsoTpData(0x7E8, response, sizeof(response), now);
+
+    ASSERT_TRUE(capture.TakeEvents(events));
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(events[0].trigger, "Error");
+    EXPECT_EQ(events[0].pre_trigger_count, 10);
+    EXPECT_EQ(events[1].trigger, "Did:7E8:F190");
+}
+
+TEST_F(CanTriggerCaptureTest, MemoryIsBounded)
+{
+    ASSERT_TRUE(capture.SetTriggersFromString("123"));
+    capture.SetWindow(std::chrono::milliseconds(1000000), std::chrono::milliseconds(1000000));
+    capture.Arm(true, now);
+    SendFrames(0x456, 1000);
+    SendFrames(0x123, 1);
+    SendFrames(0x456, 1000);
+    SendFrames(0x123, 1);
+    SendFrames(0x456, 10);
+    capture.Arm(false, now);  /* Disarming completes the running event */
+
+    ASSERT_TRUE(capture.TakeEvents(events));
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(events[0].pre_trigger_count, 100);
+    EXPECT_EQ(events[0].frames.size(), 200);  /* Post-trigger frames are limited to the ring size too */
+    EXPECT_EQ(events[1].frames.size(), 110);
+}
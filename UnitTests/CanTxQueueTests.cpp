@@ -0,0 +1,231 @@
+#include "pch.hpp"
+
+class CanTxQueueTest : public ::testing::Test {
+protected:
+
+    CanTxQueueTest() : queue(4) {
+    }
+
+    virtual ~CanTxQueueTest() {
+    }
+
+    void Fill(uint32_t first_id, size_t count) {
+        for(size_t i = 0; i != count; i++) {
+            uint8_t data[2] = { static_cast<uint8_t>(i), 0xAA };
+            queue.Push(first_id + static_cast<uint32_t>(i), sizeof(data), data);
+        }
+    }
+
+    uint32_t PopFrameId() {
+        CanData frame;
+        uint64_t sequence;
+        if(!queue.Front(frame, sequence))
+            return 0;
+        queue.Pop(sequence);
+        return frame.frame_id;
+    }
+
+    CanTxQueue queue;
+};
+
+TEST_F(CanTxQueueTest, Fifo) {
+    Fill(0x100, 3);
+    EXPECT_EQ(queue.GetSize(), 3);
+
+    CanData frame;
+    uint64_t sequence;
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.frame_id, 0x100);
+    EXPECT_EQ(frame.data_len, 2);
+    EXPECT_EQ(frame.data[1], 0xAA);
+    EXPECT_EQ(queue.GetSize(), 3);  /* Front doesn't remove the frame */
+
+    EXPECT_EQ(PopFrameId(), 0x100);
+    EXPECT_EQ(PopFrameId(), 0x101);
+    EXPECT_EQ(PopFrameId(), 0x102);
+    EXPECT_FALSE(queue.Front(frame, sequence));
+
+    uint8_t long_data[12] = {};
+    EXPECT_TRUE(queue.Push(0x200, sizeof(long_data), long_data));
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.data_len, MAX_CAN_FRAME_DATA_LEN);
+}
+
+TEST_F(CanTxQueueTest, DropOldest) {
+    Fill(0x100, 6);
+    EXPECT_EQ(queue.GetSize(), 4);
+    EXPECT_EQ(PopFrameId(), 0x102);
+
+    CanTxQueueCounters counters = queue.GetCounters();
+    EXPECT_EQ(counters.pushed, 6);
+    EXPECT_EQ(counters.dropped_oldest, 2);
+    EXPECT_EQ(counters.dropped_newest, 0);
+    EXPECT_EQ(counters.high_watermark, 4);
+}
+
+TEST_F(CanTxQueueTest, DropOldestWhileSending) {
+    Fill(0x100, 4);
+    CanData frame;
+    uint64_t sequence;
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    Fill(0x200, 1);  /* Overwrites the frame which is being sent */
+    queue.Pop(sequence);
+    EXPECT_EQ(queue.GetSize(), 4);
+    EXPECT_EQ(PopFrameId(), 0x101);
+}
+
+TEST_F(CanTxQueueTest, DropNewest) {
+    EXPECT_TRUE(queue.SetOverflowPolicyFromString("DropNewest"));
+    EXPECT_EQ(queue.GetOverflowPolicyAsString(), "DropNewest");
+    Fill(0x100, 6);
+    EXPECT_EQ(PopFrameId(), 0x100);
+    EXPECT_EQ(queue.GetCounters().dropped_newest, 2);
+    EXPECT_EQ(queue.GetCounters().GetDropped(), 2);
+
+    queue.ResetCounters();
+    EXPECT_EQ(queue.GetCounters().pushed, 0);
+}
+
+TEST_F(CanTxQueueTest, Block) {
+    EXPECT_TRUE(queue.SetOverflowPolicyFromString("Block:1000"));
+    EXPECT_EQ(queue.GetOverflowPolicyAsString(), "Block:1000");
+    Fill(0x100, 4);
+
+    std::jthread consumer([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        PopFrameId();
+    });
+    uint8_t data[1] = {};
+    EXPECT_TRUE(queue.Push(0x200, sizeof(data), data));  /* Waits for the consumer */
+    consumer.join();
+    EXPECT_EQ(queue.GetSize(), 4);
+
+    queue.SetOverflowPolicy(CTOP_BLOCK, std::chrono::milliseconds(1));
+    EXPECT_FALSE(queue.Push(0x201, sizeof(data), data));
+    EXPECT_EQ(queue.GetCounters().dropped_newest, 1);
+}
+
+TEST_F(CanTxQueueTest, BlockNotAllowed) {
+    /* Callers holding a lock the consumer needs can't wait, the frame is dropped without waiting for the timeout */
+    queue.SetOverflowPolicy(CTOP_BLOCK, std::chrono::milliseconds(1000));
+    Fill(0x100, 4);
+    uint8_t data[1] = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.Push(0x200, sizeof(data), data, false));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_EQ(queue.GetCounters().dropped_newest, 1);
+    EXPECT_EQ(queue.GetSize(), 4);
+}
+
+TEST_F(CanTxQueueTest, InvalidPolicy) {
+    EXPECT_FALSE(queue.SetOverflowPolicyFromString("Drop"));
+    EXPECT_FALSE(queue.SetOverflowPolicyFromString("Block:abc"));
+    EXPECT_EQ(queue.GetOverflowPolicyAsString(), "DropOldest");
+    EXPECT_TRUE(queue.SetOverflowPolicyFromString("Block"));
+    EXPECT_EQ(queue.GetOverflowPolicyAsString(), "Block:10");
+}
+
+TEST_F(CanTxQueueTest, Capacity) {
+    Fill(0x100, 3);
+    queue.SetCapacity(0);
+    EXPECT_EQ(queue.GetCapacity(), 1);
+    EXPECT_EQ(queue.GetSize(), 0);
+    Fill(0x100, 2);
+    EXPECT_EQ(PopFrameId(), 0x101);
+
+    queue.Clear();
+    EXPECT_EQ(queue.GetSize(), 0);
+}
+
+TEST_F(CanTxQueueTest, Arbitration) {
+    queue.SetCapacity(8);
+    EXPECT_TRUE(queue.SetOrderFromString("Arbitration"));
+    EXPECT_EQ(queue.GetOrderAsString(), "Arbitration");
+
+    uint8_t data[1] = {};
+    for(uint32_t frame_id : { 0x7DF, 0x100, 0x18DAF110, 0x7DF, 0x050, 0x100 }) {
+        data[0]++;
+        queue.Push(frame_id, sizeof(data), data);
+    }
+
+    CanData frame;
+    uint64_t sequence;
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.frame_id, 0x050);
+    queue.Pop(sequence);
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.frame_id, 0x100);
+    EXPECT_EQ(frame.data[0], 2);  /* FIFO within the same ID */
+    queue.Pop(sequence);
+    EXPECT_EQ(PopFrameId(), 0x100);
+    EXPECT_EQ(PopFrameId(), 0x18DAF110);  /* Base ID is 0x636 */
+    EXPECT_EQ(PopFrameId(), 0x7DF);
+    EXPECT_EQ(PopFrameId(), 0x7DF);
+
+    /* Higher priority frame arrives while the front one is being sent */
+    queue.Push(0x300, sizeof(data), data);
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    queue.Push(0x200, sizeof(data), data);
+    queue.Pop(sequence);
+    EXPECT_EQ(PopFrameId(), 0x200);
+    EXPECT_EQ(queue.GetSize(), 0);
+
+    queue.Push(0x300, sizeof(data), data);
+    queue.Push(0x200, sizeof(data), data);
+    queue.SetOrder(CTOO_FIFO);
+    EXPECT_EQ(PopFrameId(), 0x300);
+}
+
+TEST_F(CanTxQueueTest, ArbitrationKey) {
+    EXPECT_LT(CanTxQueue::GetArbitrationKey(0x100), CanTxQueue::GetArbitrationKey(0x101));
+    EXPECT_LT(CanTxQueue::GetArbitrationKey(0x7FF), CanTxQueue::GetArbitrationKey(0x1FFC0000));  /* Same base ID, standard wins */
+    EXPECT_GT(CanTxQueue::GetArbitrationKey(0x7FF), CanTxQueue::GetArbitrationKey(0x1FFBFFFF));
+    EXPECT_LT(CanTxQueue::GetArbitrationKey(0x18DAF110), CanTxQueue::GetArbitrationKey(0x18DAF111));
+}
+
+TEST_F(CanTxQueueTest, Coalesce) {
+    EXPECT_TRUE(queue.SetCoalescedIdsFromString("100, 18DAF110"));
+    EXPECT_EQ(queue.GetCoalescedIdsAsString(), "100, 18DAF110");
+
+    uint8_t data[1] = { 1 };
+    queue.Push(0x100, sizeof(data), data);
+    queue.Push(0x200, sizeof(data), data);
+    data[0] = 2;
+    queue.Push(0x100, sizeof(data), data);
+    EXPECT_EQ(queue.GetSize(), 2);
+    EXPECT_EQ(queue.GetCounters().coalesced, 1);
+
+    CanData frame;
+    uint64_t sequence;
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.frame_id, 0x100);  /* Keeps its place */
+    EXPECT_EQ(frame.data[0], 2);
+
+    /* Frame being sent isn't changed, the new one is queued */
+    data[0] = 3;
+    queue.Push(0x100, sizeof(data), data);
+    data[0] = 4;
+    queue.Push(0x100, sizeof(data), data);
+    queue.Pop(sequence);
+    EXPECT_EQ(queue.GetSize(), 2);
+    EXPECT_EQ(PopFrameId(), 0x200);
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.data[0], 4);
+}
+
+TEST_F(CanTxQueueTest, CoalesceQueuedFrames) {
+    uint8_t data[1] = { 1 };
+    queue.Push(0x100, sizeof(data), data);
+    queue.Push(0x100, sizeof(data), data);
+    EXPECT_FALSE(queue.SetCoalescedIdsFromString("100, XYZ"));
+    EXPECT_EQ(queue.GetCoalescedIdsAsString(), "100");
+
+    data[0] = 2;
+    queue.Push(0x100, sizeof(data), data);
+    EXPECT_EQ(queue.GetSize(), 2);
+    EXPECT_EQ(PopFrameId(), 0x100);
+    CanData frame;
+    uint64_t sequence;
+    ASSERT_TRUE(queue.Front(frame, sequence));
+    EXPECT_EQ(frame.data[0], 2);  /* Newest queued frame is updated */
+}
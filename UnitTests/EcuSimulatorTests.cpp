@@ -0,0 +1,231 @@
+#include "pch.hpp"
+
+class EcuSimulatorTest : public ::testing::Test {
+protected:
+
+    EcuSimulatorTest() {
+        config.response_latency = std::chrono::microseconds(0);
+        config.dids[0xF190] = { { 'W', 'A', 'U', 'Z', 'Z', 'Z', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '1' }, 0, false };
+        config.dids[0x1234] = { { 0x12, 0x34 }, 0, true };
+        config.dids[0x2222] = { { 0x01 }, 0x22, true };
+        config.dids[0xF201] = { { 0xAB, 0xCD }, 0, false };
+        config.memory.push_back({ 0x1000, std::vector<uint8_t>(0x100, 0xFF) });
+    }
+
+    virtual ~EcuSimulatorTest() {
+    }
+
+    void Send(const std::vector<uint8_t>& frame)
+    {
+        std::vector<uint8_t> padded = frame;
+        padded.resize(8, 0xCC);
+        sim->OnFrameReceived(config.request_id, padded.data(), static_cast<uint8_t>(padded.size()), now);
+        sim->Poll(now);
+    }
+
+    virtual void SetUp() {
+        sim = std::make_unique<EcuSimulator>(config, [this](uint32_t frame_id, const uint8_t* data, uint8_t size)
+            {
+                frames.push_back({ frame_id, std::vector<uint8_t>(data, data + size) });
+            });
+    }
+
+    virtual void TearDown()
+    {
+        frames.clear();
+    }
+
+    EcuSimulatorConfig config;
+    std::unique_ptr<EcuSimulator> sim;
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> frames;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+};
+
+TEST_F(EcuSimulatorTest, SessionControlReportsTiming)
+{
+    Send({ 0x02, 0x10, 0x03 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].first, config.response_id);
+    EXPECT_EQ(frames[0].second, std::vector<uint8_t>({ 0x06, 0x50, 0x03, 0x00, 0x32, 0x01, 0xF4, 0xAA }));
+    EXPECT_EQ(sim->GetSession(), 3);
+}
+
+TEST_F(EcuSimulatorTest, SessionFallsBackAfterS3Timeout)
+{
+    Send({ 0x02, 0x10, 0x03 });
+    now += config.s3_timeout;
+    sim->Poll(now);
+    EXPECT_EQ(sim->GetSession(), 1);
+}
+
+TEST_F(EcuSimulatorTest, TesterPresentSuppressed)
+{
+    Send({ 0x02, 0x3E, 0x80 });
+    EXPECT_TRUE(frames.empty());
+    Send({ 0x02, 0x3E, 0x00 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[1], 0x7E);
+}
+
+TEST_F(EcuSimulatorTest, ReadMultipleDids)
+{
+    Send({ 0x05, 0x22, 0x12, 0x34, 0x22, 0x22 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second, std::vector<uint8_t>({ 0x05, 0x62, 0x12, 0x34, 0x12, 0x34, 0xAA, 0xAA }));
+
+    frames.clear();
+    Send({ 0x03, 0x22, 0x22, 0x22 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second, std::vector<uint8_t>({ 0x03, 0x7F, 0x22, 0x22, 0xAA, 0xAA, 0xAA, 0xAA }));
+
+    frames.clear();
+    Send({ 0x03, 0x22, 0xDE, 0xAD });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[3], 0x31);
+}
+
+TEST_F(EcuSimulatorTest, MaxDidsPerRequest)
+{
+    config.max_dids_per_request = 1;
+    SetUp();
+    Send({ 0x05, 0x22, 0x12, 0x34, 0xF1, 0x90 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[3], 0x13);
+}
+
+TEST_F(EcuSimulatorTest, MultiFrameResponseWithFlowControl)
+{
+    Send({ 0x03, 0x22, 0xF1, 0x90 });  /* 20 bytes response */
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[0], 0x10);
+    EXPECT_EQ(frames[0].second[1], 20);
+
+    Send({ 0x30, 0x01, 0x00 });  /* Block size 1 */
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(frames[1].second[0], 0x21);
+
+    Send({ 0x30, 0x00, 0x00 });
+    ASSERT_EQ(frames.size(), 3);
+    EXPECT_EQ(frames[2].second[0], 0x22);
+
+    std::vector<uint8_t> payload(frames[0].second.begin() + 2, frames[0].second.end());
+    payload.insert(payload.end(), frames[1].second.begin() + 1, frames[1].second.end());
+    payload.insert(payload.end(), frames[2].second.begin() + 1, frames[2].second.begin() + 1 + (20 - payload.size()));
+    EXPECT_EQ(payload[0], 0x62);
+    EXPECT_EQ(payload[3], 'W');
+    EXPECT_EQ(payload[19], '1');
+}
+
+TEST_F(EcuSimulatorTest, SeparationTimeIsRespected)
+{
+    Send({ 0x03, 0x22, 0xF1, 0x90 });
+    Send({ 0x30, 0x00, 0x05 });  /* STmin 5ms */
+    EXPECT_EQ(frames.size(), 2);
+    now += std::chrono::milliseconds(4);
+    sim->Poll(now);
+    EXPECT_EQ(frames.size(), 2);
+    now += std::chrono::milliseconds(1);
+    sim->Poll(now);
+    EXPECT_EQ(frames.size(), 3);
+}
+
+TEST_F(EcuSimulatorTest, ResponsePendingBurst)
+{
+    config.pending_count = 2;
+    config.pending_interval = std::chrono::milliseconds(10);
+    SetUp();
+    Send({ 0x03, 0x22, 0x12, 0x34 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[3], 0x78);
+
+    now += std::chrono::milliseconds(10);
+    sim->Poll(now);
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(frames[1].second[3], 0x78);
+
+    now += std::chrono::milliseconds(10);
+    sim->Poll(now);
+    ASSERT_EQ(frames.size(), 3);
+    EXPECT_EQ(frames[2].second[1], 0x62);
+    EXPECT_EQ(sim->GetStats().negative_responses, 0);
+}
+
+TEST_F(EcuSimulatorTest, WriteDid)
+{
+    Send({ 0x05, 0x2E, 0x12, 0x34, 0xBE, 0xEF });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[1], 0x6E);
+    EXPECT_EQ(sim->GetDids().at(0x1234).data, std::vector<uint8_t>({ 0xBE, 0xEF }));
+
+    frames.clear();
+    Send({ 0x04, 0x2E, 0x12, 0x34, 0xBE });
+    EXPECT_EQ(frames[0].second[3], 0x13);
+
+    frames.clear();
+    Send({ 0x04, 0x2E, 0xF1, 0x90, 0x00 });
+    EXPECT_EQ(frames[0].second[3], 0x31);
+}
+
+TEST_F(EcuSimulatorTest, ReadMemoryByAddress)
+{
+    Send({ 0x05, 0x23, 0x12, 0x10, 0x00, 0x04 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second, std::vector<uint8_t>({ 0x05, 0x63, 0xFF, 0xFF, 0xFF, 0xFF, 0xAA, 0xAA }));
+
+    frames.clear();
+    Send({ 0x05, 0x23, 0x12, 0x10, 0xFF, 0x04 });
+    EXPECT_EQ(frames[0].second[3], 0x31);
+}
+
+TEST_F(EcuSimulatorTest, PeriodicDidRequiresSession)
+{
+    Send({ 0x03, 0x2A, 0x03, 0x01 });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[3], 0x7F);
+
+    config.periodic_id = 0x5AA;
+    SetUp();
+    frames.clear();
+    Send({ 0x02, 0x10, 0x03 });
+    Send({ 0x03, 0x2A, 0x03, 0x01 });
+    ASSERT_EQ(frames.size(), 3);
+    EXPECT_EQ(frames[1].second[1], 0x6A);
+    EXPECT_EQ(frames[2].first, 0x5AA);
+    EXPECT_EQ(frames[2].second, std::vector<uint8_t>({ 0x01, 0xAB, 0xCD, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA }));
+
+    now += config.periodic_rates[2];
+    sim->Poll(now);
+    EXPECT_EQ(frames.size(), 4);
+
+    Send({ 0x02, 0x2A, 0x04 });
+    now += config.periodic_rates[2];
+    sim->Poll(now);
+    EXPECT_EQ(frames.size(), 5);  /* Only the stop response */
+}
+
+TEST_F(EcuSimulatorTest, Download)
+{
+    Send({ 0x02, 0x10, 0x02 });
+    frames.clear();
+    Send({ 0x06, 0x34, 0x00, 0x12, 0x10, 0x00, 0x0A });
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second, std::vector<uint8_t>({ 0x04, 0x74, 0x20, 0x04, 0x02, 0xAA, 0xAA, 0xAA }));
+
+    frames.clear();
+    Send({ 0x10, 0x0C, 0x36, 0x01, 0x00, 0x01, 0x02, 0x03 });  /* 10 bytes in 2 frames */
+    ASSERT_EQ(frames.size(), 1);
+    EXPECT_EQ(frames[0].second[0], 0x30);
+    Send({ 0x21, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09 });
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(frames[1].second[1], 0x76);
+
+    frames.clear();
+    Send({ 0x03, 0x36, 0x01, 0x00 });
+    EXPECT_EQ(frames[0].second[3], 0x73);
+
+    frames.clear();
+    Send({ 0x01, 0x37 });
+    EXPECT_EQ(frames[0].second[1], 0x77);
+    EXPECT_EQ(sim->GetMemory()[0].data[9], 0x09);
+    EXPECT_EQ(sim->GetMemory()[0].data[10], 0xFF);
+}
@@ -8,14 +8,21 @@
 
 #include "gtest/gtest.h"
 
+#include <bit>
 #include <chrono>
+#include <filesystem>
 #include <stack>
 #include <iostream>
 #include <fstream>
 #include <limits>
+#include <random>
+#include <sstream>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/crc.hpp>
+#include <boost/endian.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
 #include <boost/archive/iterators/binary_from_base64.hpp>
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
@@ -51,8 +58,22 @@ enum LogLevel
 #include "../src/StringToCEscaper.hpp"
 #include "../src/DirectoryBackup.hpp"
 #include "../src/Utils.hpp"
+#include "../src/EcuSimulator.hpp"
+#include "../src/CanScriptCompiler.hpp"
+#include "../src/CanLogFilter.hpp"
+#include "../src/CanTriggerCapture.hpp"
+#include "../src/CanRecordingCodec.hpp"
+#include "../src/CanSignalDecoder.hpp"
+#include "../src/CanLogImporter.hpp"
+#include "../src/CanLogStore.hpp"
+#include "../src/CanGateway.hpp"
+#include "../src/CanTxQueue.hpp"
+#include "../src/CanChangeDetector.hpp"
+#include "../src/CanSignalSeries.hpp"
+#include "../src/CanStressGenerator.hpp"
 
 extern "C"
 {
 #include "../libs/sha256/sha256.h"
+#include "../libs/bitfield/bitfield.h"
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "pch.hpp"
+
+void CanChangeDetector::SetSignals(uint32_t frame_id, std::vector<CanChangeSignal>&& signals)
+{
+    for(auto& signal : signals)
+        signal.mask = GetBitMask(signal.offset, signal.size);
+    m_Signals[frame_id] = std::move(signals);
+}
+
+void CanChangeDetector::OnFrame(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now)
+{
+    uint8_t bytes[sizeof(uint64_t)] = {};
+    memcpy(bytes, data, std::min<size_t>(size, sizeof(bytes)));
+    uint64_t value = boost::endian::load_big_u64(bytes);
+
+    CanChangeState& state = m_States[frame_id];
+    if(state.mark_epoch != m_MarkEpoch)
+    {
+        state.mark_epoch = m_MarkEpoch;
+        state.changed_mask = 0;
+        state.toggle_counts.fill(0);
+    }
+
+    if(!state.has_data)
+    {
+        state.has_data = true;
+        state.data = value;
+        return;
+    }
+
+    uint64_t changed = state.data ^ value;
+    state.data = value;
+    if(!changed)
+        return;
+
+    state.changed_mask |= changed;
+    state.last_change = now;
+    while(changed)
+    {
+        int bit = std::countl_zero(changed);  /* Bit offset like in the mapping */
+        state.toggle_counts[bit]++;
+        state.last_changes[bit] = now;
+        changed &= ~(1ULL << (CAN_CHANGE_DETECTOR_BITS - 1 - bit));
+    }
+}
+
+void CanChangeDetector::Mark(std::chrono::steady_clock::time_point now)
+{
+    m_MarkEpoch++;
+    m_MarkTime = now;
+}
+
+uint64_t CanChangeDetector::GetChangedMask(uint32_t frame_id) const
+{
+    const CanChangeState* state = GetState(frame_id);
+    return state && state->mark_epoch == m_MarkEpoch ? state->changed_mask : 0;
+}
+
+const CanChangeState* CanChangeDetector::GetState(uint32_t frame_id) const
+{
+    auto it = m_States.find(frame_id);
+    return it != m_States.end() ? &it->second : nullptr;
+}
+
+std::vector<CanChangeReport> CanChangeDetector::GetChangedSinceMark() const
+{
+    std::vector<CanChangeReport> ret;
+    for(auto& [frame_id, state] : m_States)
+    {
+        if(state.mark_epoch != m_MarkEpoch || !state.changed_mask)
+            continue;
+
+        CanChangeReport report;
+        report.frame_id = frame_id;
+        report.changed_mask = state.changed_mask;
+        report.last_change = state.last_change;
+        for(auto& count : state.toggle_counts)
+            report.toggle_count += count;
+
+        auto signals = m_Signals.find(frame_id);
+        if(signals != m_Signals.end())
+        {
+            for(auto& signal : signals->second)
+            {
+                if(signal.mask & state.changed_mask)
+                    report.signals.push_back(signal.name);
+            }
+        }
+        ret.push_back(std::move(report));
+    }
+
+    std::sort(ret.begin(), ret.end(), [](const CanChangeReport& a, const CanChangeReport& b) { return a.last_change > b.last_change; });
+    return ret;
+}
+
+void CanChangeDetector::Clear()
+{
+    m_States.clear();
+}
+
+uint64_t CanChangeDetector::GetBitMask(uint8_t offset, uint8_t size)
+{
+    if(!size || offset >= CAN_CHANGE_DETECTOR_BITS)
+        return 0;
+
+    uint64_t ret = ~0ULL >> offset;
+    if(offset + size < CAN_CHANGE_DETECTOR_BITS)
+        ret &= ~(~0ULL >> (offset + size));
+    return ret;
+}
+
+std::string CanChangeDetector::FormatMask(uint64_t mask)
+{
+    std::string ret;
+    for(int i = sizeof(mask) - 1; i >= 0; i--)
+    {
+        if(!ret.empty())
+            ret += ' ';
+        ret += std::format("{:02X}", static_cast<uint8_t>(mask >> (i * 8)));
+    }
+    return ret;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Number of tracked bits of a frame */
+constexpr size_t CAN_CHANGE_DETECTOR_BITS = 64;
+
+class CanChangeSignal
+{
+public:
+    // !\brief Signal name
+    std::string name;
+
+    // !\brief Bit offset in the frame, 0 is the most significant bit of the first byte like in the mapping
+    uint8_t offset = 0;
+
+    // !\brief Bit length
+    uint8_t size = 0;
+
+    // !\brief Bits of the signal, see CanChangeDetector::GetBitMask
+    uint64_t mask = 0;
+};
+
+class CanChangeState
+{
+public:
+    // !\brief Last data, loaded as big endian, so bit offset 0 is the most significant bit
+    uint64_t data = 0;
+
+    // !\brief Is data received yet?
+    bool has_data = false;
+
+    // !\brief Mark epoch where the fields below were reset last time
+    uint64_t mark_epoch = 0;
+
+    // !\brief Bits changed since the mark
+    uint64_t changed_mask = 0;
+
+    // !\brief Toggle counters of bits since the mark, indexed by bit offset
+    std::array<uint32_t, CAN_CHANGE_DETECTOR_BITS> toggle_counts = {};
+
+    // !\brief Time of the last change of bits, indexed by bit offset, kept across marks
+    std::array<std::chrono::steady_clock::time_point, CAN_CHANGE_DETECTOR_BITS> last_changes = {};
+
+    // !\brief Time of the last change of the frame
+    std::chrono::steady_clock::time_point last_change;
+};
+
+class CanChangeReport
+{
+public:
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Bits changed since the mark
+    uint64_t changed_mask = 0;
+
+    // !\brief Sum of bit toggles since the mark
+    uint32_t toggle_count = 0;
+
+    // !\brief Time of the last change
+    std::chrono::steady_clock::time_point last_change;
+
+    // !\brief Names of mapped signals which contain changed bits
+    std::vector<std::string> signals;
+};
+
+/* Tracks which bits of received frames change, XOR of successive payloads with O(1) work per frame */
+class CanChangeDetector
+{
+public:
+    // !\brief Set mapped signals of a frame
+    // !\param frame_id [in] CAN Frame ID
+    // !\param signals [in] Signals, mask is calculated here
+    void SetSignals(uint32_t frame_id, std::vector<CanChangeSignal>&& signals);
+
+    // !\brief Remove every mapped signal
+    void ClearSignals() { m_Signals.clear(); }
+
+    // !\brief Handle received frame
+    // !\param frame_id [in] CAN Frame ID
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length, missing bytes are handled as zero
+    // !\param now [in] Time of reception
+    void OnFrame(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Start a new observation window, "changed since mark" and toggle counters start from zero
+    // !\param now [in] Current time
+    void Mark(std::chrono::steady_clock::time_point now);
+
+    // !\brief Get time of the mark
+    std::chrono::steady_clock::time_point GetMarkTime() const { return m_MarkTime; }
+
+    // !\brief Get bits changed since the mark
+    // !\param frame_id [in] CAN Frame ID
+    uint64_t GetChangedMask(uint32_t frame_id) const;
+
+    // !\brief Get state of a frame
+    // !\return State or nullptr if the frame hasn't been received, changed_mask and toggle_counts belong to an older mark if it hasn't been received since the mark
+    const CanChangeState* GetState(uint32_t frame_id) const;
+
+    // !\brief Get frames changed since the mark, the last changed one first
+    std::vector<CanChangeReport> GetChangedSinceMark() const;
+
+    // !\brief Forget received frames
+    void Clear();
+
+    // !\brief Get mask of bits, bit offset 0 is the most significant bit like in CanChangeState::data
+    // !\param offset [in] Bit offset
+    // !\param size [in] Bit length
+    static uint64_t GetBitMask(uint8_t offset, uint8_t size);
+
+    // !\brief Format changed bits as hex bytes, eg. "00 10 00 00 00 00 00 00"
+    static std::string FormatMask(uint64_t mask);
+
+private:
+    // !\brief State of frames [frame_id] = state
+    std::unordered_map<uint32_t, CanChangeState> m_States;
+
+    // !\brief Mapped signals [frame_id] = signals
+    std::unordered_map<uint32_t, std::vector<CanChangeSignal>> m_Signals;
+
+    // !\brief Incremented by every mark, states of older epochs are reset when the frame is received again
+    uint64_t m_MarkEpoch = 0;
+
+    // !\brief Time of the mark
+    std::chrono::steady_clock::time_point m_MarkTime;
+};
@@ -96,6 +96,7 @@ void CanDeviceLawicel::ProcessReceivedFrames(std::mutex& rx_mutex)
             {
                 m_CircBuff.erase(m_CircBuff.begin(), m_CircBuff.end());
                 LOG(LogLevel::Warning, "Invalid CAN data received! Erasing circular buffer");
+                CanSerialPort::Get()->OnErrorFrame();
             }
         }
         else  /* If no valid data was received, wait for the next iteration */
@@ -105,7 +106,7 @@ void CanDeviceLawicel::ProcessReceivedFrames(std::mutex& rx_mutex)
     }
 }
 
-size_t CanDeviceLawicel::PrepareSendDataFormat(const std::shared_ptr<CanData>& data_ptr, char* out, size_t max_size, bool& remove_from_queue)
+size_t CanDeviceLawicel::PrepareSendDataFormat(const CanData& frame, char* out, size_t max_size, bool& remove_from_queue)
 {
     size_t send_size = 0;
     switch(device_state)
@@ -146,9 +147,9 @@ size_t CanDeviceLawicel::PrepareSendDataFormat(const std::shared_ptr<CanData>& d
         {
             remove_from_queue = true;
             std::string out_hex;
-            boost::algorithm::hex(data_ptr->data, data_ptr->data + data_ptr->data_len, std::back_inserter(out_hex));
+            boost::algorithm::hex(frame.data, frame.data + frame.data_len, std::back_inserter(out_hex));
 
-            std::string out_str = std::format("{}{:X}{}{}\r", data_ptr->frame_id < 0x7FF ? 't' : 'T', data_ptr->frame_id, data_ptr->data_len, out_hex);
+            std::string out_str = std::format("{}{:X}{}{}\r", frame.frame_id < 0x7FF ? 't' : 'T', frame.frame_id, frame.data_len, out_hex);
             send_size = out_str.length();
             memcpy(out, out_str.c_str(), out_str.length());
             break;
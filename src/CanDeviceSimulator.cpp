@@ -0,0 +1,160 @@
+#include "pch.hpp"
+
+constexpr auto SIMULATOR_MAX_IDLE_TIME = 100ms;
+
+CanDeviceSimulator::CanDeviceSimulator(const std::filesystem::path& config_path)
+{
+    EcuSimulatorConfig config;
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    if(can_handler)
+    {
+        config.request_id = can_handler->GetDefaultEcuId();
+        config.response_id = can_handler->GetIsoTpResponseFrameId();
+    }
+    LoadConfig(config_path, config);
+
+    /* Frames are delivered by the worker thread, calling AddToRxQueue directly from PrepareSendDataFormat would deadlock on CanSerialPort's mutex */
+    m_Simulator = std::make_unique<EcuSimulator>(config, [this](uint32_t frame_id, const uint8_t* data, uint8_t size)
+        {
+            m_PendingFrames.push_back({ frame_id, std::vector<uint8_t>(data, data + size) });
+        });
+
+    m_Worker = std::make_unique<std::jthread>(std::bind_front(&CanDeviceSimulator::WorkerThread, this));
+    utils::SetThreadName(*m_Worker, "EcuSimulator");
+
+    LOG(LogLevel::Notification, "ECU simulator started, request ID: {:X}, response ID: {:X}, DIDs: {}", config.request_id, config.response_id, config.dids.size());
+}
+
+CanDeviceSimulator::~CanDeviceSimulator()
+{
+    m_Worker.reset(nullptr);
+
+    const EcuSimulatorStats& stats = m_Simulator->GetStats();
+    LOG(LogLevel::Normal, "ECU simulator stopped, requests: {}, responses: {} (negative: {}), RX: {} frames, {} bytes, TX: {} frames, {} bytes",
+        stats.requests, stats.responses, stats.negative_responses, stats.rx_frames, stats.rx_bytes, stats.tx_frames, stats.tx_bytes);
+}
+
+void CanDeviceSimulator::ProcessReceivedFrames(std::mutex& rx_mutex)
+{
+    /* Frames are received by WorkerThread, there is no serial data to process */
+}
+
+size_t CanDeviceSimulator::PrepareSendDataFormat(const CanData& frame, char* out, size_t size, bool& remove_from_queue)
+{
+    remove_from_queue = true;
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_Simulator->OnFrameReceived(frame.frame_id, frame.data, frame.data_len, std::chrono::steady_clock::now());
+        m_IsFrameReceived = true;  /* Next event time might have been changed */
+    }
+    m_Cv.notify_all();
+    return 0;
+}
+
+void CanDeviceSimulator::WorkerThread(std::stop_token token)
+{
+    while(!token.stop_requested())
+    {
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> frames;
+        {
+            std::unique_lock lock(m_Mutex);
+            std::chrono::steady_clock::time_point next = std::min(m_Simulator->GetNextEventTime(), std::chrono::steady_clock::now() + SIMULATOR_MAX_IDLE_TIME);
+            m_Cv.wait_until(lock, token, next, [this]() { return m_IsFrameReceived; });
+            m_IsFrameReceived = false;
+
+            m_Simulator->Poll(std::chrono::steady_clock::now());
+            std::swap(frames, m_PendingFrames);
+        }
+
+        for(auto& [frame_id, data] : frames)
+            CanSerialPort::Get()->AddToRxQueue(frame_id, static_cast<uint8_t>(data.size()), data.data());
+    }
+}
+
+bool CanDeviceSimulator::LoadConfig(const std::filesystem::path& path, EcuSimulatorConfig& config)
+{
+    if(!std::filesystem::exists(path))
+    {
+        LOG(LogLevel::Warning, "ECU simulator config is missing ({}), using default configuration without DIDs", path.generic_string());
+        return false;
+    }
+
+    bool ret = true;
+    boost::property_tree::ptree pt;
+    try
+    {
+        read_xml(path.generic_string(), pt);
+        const boost::property_tree::ptree& sim = pt.get_child("EcuSimulator");
+
+        auto read_hex = [&sim](const char* key, uint32_t& value)
+        {
+            boost::optional<std::string> str = sim.get_optional<std::string>(key);
+            if(str)
+                value = std::stoul(*str, nullptr, 16);
+        };
+        read_hex("RequestId", config.request_id);
+        read_hex("ResponseId", config.response_id);
+        read_hex("PeriodicId", config.periodic_id);
+
+        config.response_latency = std::chrono::microseconds(sim.get<int64_t>("ResponseLatency", config.response_latency.count()));
+        config.pending_count = sim.get<uint16_t>("PendingCount", config.pending_count);
+        config.pending_interval = std::chrono::microseconds(sim.get<int64_t>("PendingInterval", config.pending_interval.count()));
+        config.block_size = static_cast<uint8_t>(sim.get<uint16_t>("BlockSize", config.block_size));
+        config.st_min = static_cast<uint8_t>(sim.get<uint16_t>("StMin", config.st_min));
+        config.max_dids_per_request = sim.get<size_t>("MaxDidsPerRequest", config.max_dids_per_request);
+        config.p2 = sim.get<uint16_t>("P2", config.p2);
+        config.p2_star = sim.get<uint16_t>("P2Star", config.p2_star);
+        config.s3_timeout = std::chrono::milliseconds(sim.get<int64_t>("S3", config.s3_timeout.count()));
+        config.max_block_len = sim.get<uint16_t>("MaxBlockLength", config.max_block_len);
+
+        auto dids = sim.get_child_optional("Dids");
+        if(dids)
+        {
+            for(const boost::property_tree::ptree::value_type& v : *dids)
+            {
+                if(v.first != "Did")
+                    continue;
+
+                std::string did_str = v.second.get<std::string>("<xmlattr>.id");
+                uint16_t did = static_cast<uint16_t>(std::stoul(did_str, nullptr, 16));
+
+                EcuSimulatorDid entry;
+                entry.nrc = static_cast<uint8_t>(std::stoul(v.second.get<std::string>("<xmlattr>.nrc", "0"), nullptr, 16));
+                entry.writable = v.second.get<bool>("<xmlattr>.writable", true);
+
+                std::string hex = v.second.get_value<std::string>();
+                boost::algorithm::erase_all(hex, " ");
+                boost::algorithm::unhex(hex, std::back_inserter(entry.data));
+                config.dids[did] = std::move(entry);
+            }
+        }
+
+        auto memory = sim.get_child_optional("Memory");
+        if(memory)
+        {
+            for(const boost::property_tree::ptree::value_type& v : *memory)
+            {
+                if(v.first != "Region")
+                    continue;
+
+                EcuSimulatorMemory region;
+                region.address = std::stoul(v.second.get<std::string>("<xmlattr>.address"), nullptr, 16);
+                size_t size = std::stoul(v.second.get<std::string>("<xmlattr>.size"), nullptr, 16);
+                uint8_t fill = static_cast<uint8_t>(std::stoul(v.second.get<std::string>("<xmlattr>.fill", "FF"), nullptr, 16));
+                region.data.resize(size, fill);
+                config.memory.push_back(std::move(region));
+            }
+        }
+    }
+    catch(const boost::property_tree::xml_parser_error& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}, {}", e.filename(), e.what());
+        ret = false;
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}", e.what());
+        ret = false;
+    }
+    return ret;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <inttypes.h>
+#include <condition_variable>
+#include <filesystem>
+#include <thread>
+#include <ICanDevice.hpp>
+#include "EcuSimulator.hpp"
+
+constexpr const char* ECU_SIMULATOR_CONFIG_FILENAME = "EcuSimulator.xml";
+
+class CanDeviceSimulator : public ICanDevice
+{
+public:
+    CanDeviceSimulator(const std::filesystem::path& config_path);
+    ~CanDeviceSimulator();
+
+    void ProcessReceivedFrames(std::mutex& rx_mutex) override;
+    size_t PrepareSendDataFormat(const CanData& frame, char* out, size_t size, bool& remove_from_queue) override;
+
+    // !\brief Load simulated ECU configuration
+    // !\param path [in] Path to XML file
+    // !\param config [out] Configuration, values missing from the file are left untouched
+    static bool LoadConfig(const std::filesystem::path& path, EcuSimulatorConfig& config);
+
+private:
+    // !\brief Worker thread, delivers simulated ECU frames to CanSerialPort
+    void WorkerThread(std::stop_token token);
+
+    // !\brief Simulated ECU
+    std::unique_ptr<EcuSimulator> m_Simulator;
+
+    // !\brief Frames sent by the simulated ECU, waiting for delivery
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> m_PendingFrames;
+
+    // !\brief Has a frame been received since the last poll?
+    bool m_IsFrameReceived = false;
+
+    // !\brief Mutex for simulated ECU
+    std::mutex m_Mutex;
+
+    // !\brief Conditional variable for worker thread
+    std::condition_variable_any m_Cv;
+
+    // !\brief Worker thread
+    std::unique_ptr<std::jthread> m_Worker;
+};
@@ -49,6 +49,7 @@ void CanDeviceStm32::ProcessReceivedFrames(std::mutex& rx_mutex)
                     hex.clear();
                     utils::ConvertHexBufferToString(uart_data, sizeof(uart_data), hex);
                     LOG(LogLevel::Verbose, "Full Data buffer: {}", hex);
+                    CanSerialPort::Get()->OnErrorFrame();
                 }
                 m_CircBuff.erase(m_CircBuff.begin(), m_CircBuff.begin() + sizeof(UartCanData));
             }
@@ -61,15 +62,15 @@ void CanDeviceStm32::ProcessReceivedFrames(std::mutex& rx_mutex)
     }
 }
 
-size_t CanDeviceStm32::PrepareSendDataFormat(const std::shared_ptr<CanData>& data_ptr, char* out, size_t max_size, bool& remove_from_queue)
+size_t CanDeviceStm32::PrepareSendDataFormat(const CanData& frame, char* out, size_t max_size, bool& remove_from_queue)
 {
     UartCanData* d = reinterpret_cast<UartCanData*>(out);
     assert(max_size >= sizeof(*d));
 
     d->magic_number = MAGIC_NUMBER_SEND_DATA_TO_CAN_BUS;
-    d->frame_id = data_ptr->frame_id;
-    d->data_len = data_ptr->data_len;
-    memcpy(d->data, data_ptr->data, d->data_len);
+    d->frame_id = frame.frame_id;
+    d->data_len = frame.data_len;
+    memcpy(d->data, frame.data, d->data_len);
     d->crc = utils::crc16_modbus((void*)d, sizeof(*d) - sizeof(UartCanData::crc));
     remove_from_queue = true;
     return sizeof(*d);
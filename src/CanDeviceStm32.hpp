@@ -13,7 +13,7 @@ public:
     ~CanDeviceStm32();
 
     void ProcessReceivedFrames(std::mutex& rx_mutex) override;
-    size_t PrepareSendDataFormat(const std::shared_ptr<CanData>& data_ptr, char* out, size_t size, bool& remove_from_queue) override;
+    size_t PrepareSendDataFormat(const CanData& frame, char* out, size_t size, bool& remove_from_queue) override;
 
 private:
     boost::circular_buffer<char>& m_CircBuff;
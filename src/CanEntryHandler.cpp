@@ -1,10 +1,47 @@
 #include "pch.hpp"
 
+/* RX snapshot is published at most this often, it's the refresh rate of the GUI */
+constexpr auto CAN_RX_SNAPSHOT_INTERVAL = 10ms;
+
+/* Collects frames sent on this thread while CanEntryHandler::m is held and pushes them to the TX queue when it's destroyed,
+   declared before the lock, so it's destroyed after unlocking. The Block overflow policy can't wait with m held,
+   because the consumer takes m in OnFrameSent before it frees a slot */
+class CanDeferredTxFrames
+{
+public:
+    CanDeferredTxFrames() : m_Previous(current)
+    {
+        current = this;
+    }
+
+    ~CanDeferredTxFrames()
+    {
+        current = m_Previous;
+        for(const CanData& frame : m_Frames)
+            CanSerialPort::Get()->AddToTxQueue(frame.frame_id, frame.data_len, frame.data);
+    }
+
+    void Add(uint32_t frame_id, uint8_t data_len, const uint8_t* data)
+    {
+        m_Frames.emplace_back(frame_id, data_len, data);
+    }
+
+    // !\brief Collector of the current thread, nullptr if frames are pushed immediately
+    static thread_local CanDeferredTxFrames* current;
+
+private:
+    CanDeferredTxFrames* m_Previous;
+    std::vector<CanData> m_Frames;
+};
+
+thread_local CanDeferredTxFrames* CanDeferredTxFrames::current = nullptr;
+
 CanEntryHandler::CanEntryHandler(ICanEntryLoader& loader, ICanRxEntryLoader& rx_loader, ICanMappingLoader& mapping_loader) :
     m_CanEntryLoader(loader), m_CanRxEntryLoader(rx_loader), m_CanMappingLoader(mapping_loader)
 {
     start_time = std::chrono::steady_clock::now();
     isotp_init_link(&link, m_DefaultEcuId, m_Isotp_Sendbuf, sizeof(m_Isotp_Sendbuf), m_Isotp_Recvbuf, sizeof(m_Isotp_Recvbuf));
+    m_RxSnapshot.store(std::make_shared<const CanRxSnapshotTable>());
 }
 
 CanEntryHandler::~CanEntryHandler()
@@ -15,6 +52,7 @@ CanEntryHandler::~CanEntryHandler()
     }
     
     m_worker.reset(nullptr);
+    m_ImportWorker.reset(nullptr);
 }
 
 bool XmlCanEntryLoader::Load(const std::filesystem::path& path, std::vector<std::unique_ptr<CanTxEntry>>& e)
@@ -405,18 +443,12 @@ bool XmlCanMappingLoader::Save(const std::filesystem::path& path, CanMapping& ma
 
 CanBitfieldType XmlCanMappingLoader::GetTypeFromString(const std::string_view& input)
 {
-    auto ret = std::find_if(m_CanBitfieldTypeMap.cbegin(), m_CanBitfieldTypeMap.cend(), [&input](const auto& item) { return item.second == input; });
-    if(ret == m_CanBitfieldTypeMap.cend())
-        return CanBitfieldType::CBT_INVALID;
-    return ret->first;
+    return CanSignalDecoder::GetTypeFromString(input);
 }
 
 const std::string_view XmlCanMappingLoader::GetStringFromType(CanBitfieldType type)
 {
-    auto it = m_CanBitfieldTypeMap.find(type);
-    if(it != m_CanBitfieldTypeMap.end())
-        return it->second;
-    return m_CanBitfieldTypeMap[CBT_INVALID];
+    return CanSignalDecoder::GetStringFromType(type);
 }
 
 std::pair<int64_t, int64_t> XmlCanMappingLoader::GetMinMaxForType(CanBitfieldType type)
@@ -444,10 +476,15 @@ void CanEntryHandler::LoadFiles()
 
 void CanEntryHandler::WorkerThread(std::stop_token token)
 {
+    std::vector<CanCaptureEvent> capture_events;
+    std::vector<CanRxSnapshot> changed_rx;
+    bool is_rx_snapshot_due = false, is_rx_rebuild = false;
     while(!token.stop_requested())
     {
         {
+            CanDeferredTxFrames tx_frames;  /* Periodic frames and ISO-TP frames of isotp_poll are pushed after unlocking */
             std::unique_lock lock{ m };
+            m_cv.wait_for(lock, token, 1ms, []() { return 0 == 1; });
             std::chrono::steady_clock::time_point time_now = std::chrono::steady_clock::now();
             for(auto& i : entries)
             {
@@ -455,7 +492,7 @@ void CanEntryHandler::WorkerThread(std::stop_token token)
                 {
                     if(i->single_shot)  /* Do not check time in case of singleshot */
                     {
-                        CanSerialPort::Get()->AddToTxQueue(i->id, i->data.size(), i->data.data());
+                        tx_frames.Add(i->id, i->data.size(), i->data.data());
                         i->single_shot = false;
                     }
                     else
@@ -464,15 +501,36 @@ void CanEntryHandler::WorkerThread(std::stop_token token)
                         if(elapsed > i->period)
                         {
                             i->last_execution = std::chrono::steady_clock::now();
-                            CanSerialPort::Get()->AddToTxQueue(i->id, i->data.size(), i->data.data());
+                            tx_frames.Add(i->id, i->data.size(), i->data.data());
                         }
                     }
                 }
             }
 
-            m_cv.wait_for(lock, token, 1ms, []() { return 0 == 1; });
             isotp_poll(&link);
+            for(auto& [response_id, channel] : m_IsoTpChannels)
+                isotp_poll(&channel->link);
+
+            m_Capture.Poll(std::chrono::steady_clock::now());
+            m_Capture.TakeEvents(capture_events);
+
+            is_rx_snapshot_due = time_now - m_LastRxSnapshot >= CAN_RX_SNAPSHOT_INTERVAL && (!m_ChangedRxIds.empty() || m_IsRxSnapshotStale);
+            if(is_rx_snapshot_due)
+            {
+                m_LastRxSnapshot = time_now;
+                is_rx_rebuild = CollectChangedRxEntries(changed_rx);
+            }
+        }
+
+        if(is_rx_snapshot_due)  /* Built without holding the lock, the RX path only waits for copying the changed entries */
+        {
+            PublishRxSnapshot(changed_rx, is_rx_rebuild);
+            changed_rx.clear();
         }
+
+        for(auto& event : capture_events)  /* Saved without holding the lock, so the RX path isn't blocked by file writing */
+            SaveCaptureEvent(event);
+        capture_events.clear();
     }
     DBG("exit");
 }
@@ -488,10 +546,10 @@ void CanEntryHandler::OnFrameSent(uint32_t frame_id, uint8_t data_len, uint8_t*
             if((MyFrame*)(wxGetApp().is_init_finished))
             {
                 i->count++;
+                m_ChangedTxIds.insert(frame_id);  /* GUI picks it up at the next refresh */
                 MyFrame* frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
                 if(frame && frame->is_initialized)
                 {
-                    frame->can_panel->sender->can_grid_tx->UpdateTxCounter(frame_id, i->count);
                     if(is_recoding)
                     {
                         if(i->log_level >= m_RecodingLogLevel)
@@ -501,7 +559,7 @@ void CanEntryHandler::OnFrameSent(uint32_t frame_id, uint8_t data_len, uint8_t*
                                 i->last_execution = std::chrono::steady_clock::now();
                             }
 
-                            m_LogEntries.push_back(std::make_unique<CanLogEntry>(CAN_LOG_DIR_TX, frame_id, data, data_len, i->last_execution));
+                            m_LogEntries.Add(CAN_LOG_DIR_TX, frame_id, data, data_len, i->last_execution);
                         }
                     }
                 }
@@ -511,11 +569,11 @@ void CanEntryHandler::OnFrameSent(uint32_t frame_id, uint8_t data_len, uint8_t*
         }
     }
 
+    std::chrono::steady_clock::time_point time_now = std::chrono::steady_clock::now();
     if(!found && is_recoding) /* Append frame to log also if it's not defined in TX list */
-    {
-        std::chrono::steady_clock::time_point time_now = std::chrono::steady_clock::now();
-        m_LogEntries.push_back(std::make_unique<CanLogEntry>(CAN_LOG_DIR_TX, frame_id, data, data_len, time_now));
-    }
+        m_LogEntries.Add(CAN_LOG_DIR_TX, frame_id, data, data_len, time_now);
+
+    m_Capture.OnFrame(CAN_LOG_DIR_TX, frame_id, data, data_len, time_now);
 
     NotifyFrameOnBus(frame_id, data, data_len);
 
@@ -540,11 +598,24 @@ void CanEntryHandler::OnFrameReceived(uint32_t frame_id, uint8_t data_len, uint8
     }
     m_rxData[frame_id]->last_execution = std::chrono::steady_clock::now();
     m_rxData[frame_id]->log_level = m_RxLogLevels.contains(frame_id) ? m_RxLogLevels[frame_id] : 1;  /* TODO: this is ugly and wastes resources as fuck, redesign it */
+    m_ChangedRxIds.insert(frame_id);
     rx_frame_cnt++;
     if(is_recoding)
     {
         if(m_rxData[frame_id]->log_level >= m_RecodingLogLevel)
-            m_LogEntries.push_back(std::make_unique<CanLogEntry>(CAN_LOG_DIR_RX, frame_id, data, data_len, m_rxData[frame_id]->last_execution));
+            m_LogEntries.Add(CAN_LOG_DIR_RX, frame_id, data, data_len, m_rxData[frame_id]->last_execution);
+    }
+    m_Capture.OnFrame(CAN_LOG_DIR_RX, frame_id, data, data_len, time_now);
+    m_ChangeDetector.OnFrame(frame_id, data, data_len, time_now);
+    if(auto it = m_SignalSeriesDefs.find(frame_id); it != m_SignalSeriesDefs.end())
+    {
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(time_now - start_time).count();
+        for(auto& signal : it->second)
+        {
+            double value = 0.0;
+            if(CanSignalDecoder::Decode(signal, data, data_len, value))
+                m_SignalSeries[signal.index]->Add(elapsed, value);
+        }
     }
 
     if(frame_id == m_IsoTpResponseId)
@@ -558,6 +629,19 @@ void CanEntryHandler::OnFrameReceived(uint32_t frame_id, uint8_t data_len, uint8
             m_UdsFrames.push_back(std::string((const char*)m_uds_recv_data, recv_size));
             last_uds_frame_received = std::chrono::steady_clock::now();
 
+            m_Capture.OnIsoTpData(frame_id, m_uds_recv_data, recv_size, time_now);
+            NotifyIsoTpData(frame_id, m_uds_recv_data, recv_size);
+        }
+    }
+    else if(auto it = m_IsoTpChannels.find(frame_id); it != m_IsoTpChannels.end())
+    {
+        IsoTpLink* channel_link = &it->second->link;
+        isotp_on_can_message(channel_link, data, data_len);
+
+        uint16_t recv_size = 0;
+        if(isotp_receive(channel_link, m_uds_recv_data, sizeof(m_uds_recv_data), &recv_size) == ISOTP_RET_OK)
+        {
+            m_Capture.OnIsoTpData(frame_id, m_uds_recv_data, recv_size, time_now);
             NotifyIsoTpData(frame_id, m_uds_recv_data, recv_size);
         }
     }
@@ -567,6 +651,12 @@ void CanEntryHandler::OnFrameReceived(uint32_t frame_id, uint8_t data_len, uint8
     m_cv.notify_all();
 }
 
+void CanEntryHandler::OnErrorFrame()
+{
+    std::scoped_lock lock{ m };
+    m_Capture.OnErrorFrame(std::chrono::steady_clock::now());
+}
+
 void CanEntryHandler::ToggleAutoSend(bool toggle)
 {
     auto_send = toggle;
@@ -580,7 +670,7 @@ void CanEntryHandler::ToggleRecording(bool toggle, bool is_pause)
     if(!is_pause && !toggle)
     {
         tx_frame_cnt = rx_frame_cnt = 0;
-        m_LogEntries.clear();
+        m_LogEntries.Clear();
     }
 }
 
@@ -588,7 +678,90 @@ void CanEntryHandler::ClearRecording()
 {
     std::scoped_lock lock{ m };
     tx_frame_cnt = rx_frame_cnt = 0;
-    m_LogEntries.clear();
+    m_LogEntries.Clear();
+}
+
+void CanEntryHandler::TakeChangedTxIds(std::unordered_set<uint32_t>& tx_ids)
+{
+    tx_ids.clear();
+    std::scoped_lock lock{ m };
+    std::swap(tx_ids, m_ChangedTxIds);
+}
+
+void CanEntryHandler::RemoveRxEntry(uint32_t frame_id)
+{
+    std::scoped_lock lock{ m };
+    m_rxData.erase(frame_id);
+    m_IsRxSnapshotStale = true;
+}
+
+void CanEntryHandler::ClearRxEntries()
+{
+    std::scoped_lock lock{ m };
+    m_rxData.clear();
+    m_ChangeDetector.Clear();
+    m_IsRxSnapshotStale = true;
+}
+
+void CanEntryHandler::SetRxComment(uint32_t frame_id, const std::string& comment)
+{
+    std::scoped_lock lock{ m };
+    rx_entry_comment[frame_id] = comment;
+    m_ChangedRxIds.insert(frame_id);
+    m_CommentVersion++;
+}
+
+bool CanEntryHandler::CollectChangedRxEntries(std::vector<CanRxSnapshot>& changed)
+{
+    bool is_rebuild = m_IsRxSnapshotStale;
+    auto collect = [this, &changed](uint32_t frame_id, const CanRxData& data)
+    {
+        CanRxSnapshot& snapshot = changed.emplace_back();
+        snapshot.frame_id = frame_id;
+        snapshot.data = data.data;
+        snapshot.period = data.period;
+        snapshot.count = data.count;
+        snapshot.log_level = data.log_level;
+        snapshot.favourite_level = data.favourite_level;
+        if(auto comment = rx_entry_comment.find(frame_id); comment != rx_entry_comment.end())
+            snapshot.comment = comment->second;
+    };
+
+    if(is_rebuild)
+    {
+        changed.reserve(m_rxData.size());
+        for(auto& [frame_id, data] : m_rxData)
+            collect(frame_id, *data);
+    }
+    else
+    {
+        changed.reserve(m_ChangedRxIds.size());
+        for(uint32_t frame_id : m_ChangedRxIds)
+        {
+            auto it = m_rxData.find(frame_id);
+            if(it != m_rxData.end())
+                collect(frame_id, *it->second);
+        }
+    }
+    m_ChangedRxIds.clear();
+    m_IsRxSnapshotStale = false;
+    return is_rebuild;
+}
+
+void CanEntryHandler::PublishRxSnapshot(std::vector<CanRxSnapshot>& changed, bool is_rebuild)
+{
+    /* Only the worker thread publishes, so the previous table can't be replaced meanwhile */
+    std::shared_ptr<const CanRxSnapshotTable> previous = m_RxSnapshot.load();
+    std::shared_ptr<CanRxSnapshotTable> table = is_rebuild ? std::make_shared<CanRxSnapshotTable>() : std::make_shared<CanRxSnapshotTable>(*previous);
+    table->version = previous->version + 1;
+    if(is_rebuild)
+        table->rebuild_version = table->version;
+    for(auto& i : changed)
+    {
+        i.version = table->version;
+        table->entries[i.frame_id] = std::move(i);
+    }
+    m_RxSnapshot.store(std::move(table));
 }
 
 void CanEntryHandler::SendDataFrame(uint32_t frame_id, uint8_t* data, uint16_t size)
@@ -598,9 +771,38 @@ void CanEntryHandler::SendDataFrame(uint32_t frame_id, uint8_t* data, uint16_t s
 
 void CanEntryHandler::SendIsoTpFrame(uint32_t frame_id, uint8_t* data, uint16_t size)
 {
+    CanDeferredTxFrames tx_frames;
     isotp_send_with_id(&link, frame_id, data, size);
 }
 
+bool CanEntryHandler::OpenIsoTpChannel(uint32_t send_id, uint32_t response_id)
+{
+    std::scoped_lock lock{ m };
+    if(response_id == m_IsoTpResponseId || m_IsoTpChannels.contains(response_id))
+        return false;
+
+    m_IsoTpChannels[response_id] = std::make_unique<IsoTpChannel>(send_id, response_id);
+    return true;
+}
+
+void CanEntryHandler::CloseIsoTpChannel(uint32_t response_id)
+{
+    std::scoped_lock lock{ m };
+    m_IsoTpChannels.erase(response_id);
+}
+
+bool CanEntryHandler::SendIsoTpFrameOnChannel(uint32_t response_id, uint8_t* data, uint16_t size)
+{
+    CanDeferredTxFrames tx_frames;
+    std::scoped_lock lock{ m };
+    auto it = m_IsoTpChannels.find(response_id);
+    if(it == m_IsoTpChannels.end())
+        return false;
+
+    isotp_send(&it->second->link, data, size);
+    return true;
+}
+
 bool CanEntryHandler::LoadTxList(std::filesystem::path& path)
 {
     std::scoped_lock lock{ m };
@@ -609,6 +811,7 @@ bool CanEntryHandler::LoadTxList(std::filesystem::path& path)
     
     entries.clear();
     bool ret = m_CanEntryLoader.Load(path, entries);
+    m_CommentVersion++;
     if(ret)
     {
         if(auto_send)
@@ -642,6 +845,8 @@ bool CanEntryHandler::LoadRxList(std::filesystem::path& path)
 
     rx_entry_comment.clear();
     bool ret = m_CanRxEntryLoader.Load(path, rx_entry_comment, m_RxLogLevels);
+    m_IsRxSnapshotStale = true;  /* Comments are part of the snapshot */
+    m_CommentVersion++;
     return ret;
 }
 
@@ -662,6 +867,8 @@ bool CanEntryHandler::LoadMapping(std::filesystem::path& path)
 
     m_mapping.clear();
     bool ret = m_CanMappingLoader.Load(path, m_mapping, m_frame_name_mapping, m_frame_size_mapping, m_frame_direction_mapping);
+    UpdateChangeDetectorSignals();
+    UpdateSignalSeries();
     return ret;
 }
 
@@ -671,32 +878,165 @@ bool CanEntryHandler::SaveMapping(std::filesystem::path& path)
     if(path.empty())
         path = default_mapping;
     bool ret = m_CanMappingLoader.Save(path, m_mapping, m_frame_name_mapping, m_frame_size_mapping, m_frame_direction_mapping);
+    UpdateChangeDetectorSignals();  /* Mapping may have been edited */
+    UpdateSignalSeries();
     return ret;
 }
 
+void CanEntryHandler::UpdateChangeDetectorSignals()
+{
+    m_ChangeDetector.ClearSignals();
+    for(auto& [frame_id, maps] : m_mapping)
+    {
+        std::vector<CanChangeSignal> signals;
+        for(auto& [offset, map] : maps)
+            signals.push_back(CanChangeSignal{ map->m_Name, offset, map->m_Size });
+        m_ChangeDetector.SetSignals(frame_id, std::move(signals));
+    }
+}
+
+void CanEntryHandler::UpdateSignalSeries()
+{
+    std::vector<std::unique_ptr<CanSignalSeries>> old_series = std::move(m_SignalSeries);
+    m_SignalSeries.clear();
+    m_SignalSeriesDefs.clear();
+    for(auto& frame_id : m_SignalSeriesIds)
+    {
+        auto maps = m_mapping.find(frame_id);
+        if(maps == m_mapping.end())
+            continue;
+
+        std::vector<CanSignalDefinition> signals;
+        for(auto& [offset, map] : maps->second)
+        {
+            std::string name = std::format("{:X} {}", frame_id, map->m_Name);
+            auto it = std::find_if(old_series.begin(), old_series.end(), [&name](const std::unique_ptr<CanSignalSeries>& series) 
+                { return series && series->GetName() == name; });
+            if(it != old_series.end())
+                m_SignalSeries.push_back(std::move(*it));  /* Keep recorded points */
+            else
+                m_SignalSeries.push_back(std::make_unique<CanSignalSeries>(name, m_SignalSeriesSize));
+            signals.push_back(CanSignalDefinition{ map->m_Name, map->m_Type, offset, map->m_Size, static_cast<uint32_t>(m_SignalSeries.size() - 1) });
+        }
+        m_SignalSeriesDefs[frame_id] = std::move(signals);
+    }
+}
+
+bool CanEntryHandler::SetSignalSeriesIdsFromString(const std::string& str)
+{
+    std::vector<std::string> entries;
+    boost::split(entries, str.substr(0, str.find('#')), boost::is_any_of(","));
+
+    bool ret = true;
+    std::set<uint32_t> frame_ids;
+    for(auto& entry : entries)
+    {
+        boost::algorithm::trim(entry);
+        if(entry.empty())
+            continue;
+
+        size_t pos = 0;
+        try
+        {
+            uint32_t frame_id = static_cast<uint32_t>(std::stoul(entry, &pos, 16));
+            if(pos != entry.length())
+                throw std::invalid_argument("not a hex number");
+            frame_ids.insert(frame_id);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid signal series frame ID, exception: {} ({})", e.what(), entry);
+            ret = false;
+        }
+    }
+
+    std::scoped_lock lock{ m };
+    m_SignalSeriesIds = std::move(frame_ids);
+    UpdateSignalSeries();
+    return ret;
+}
+
+std::string CanEntryHandler::GetSignalSeriesIdsAsString()
+{
+    std::scoped_lock lock{ m };
+    std::string ret;
+    for(auto& frame_id : m_SignalSeriesIds)
+    {
+        if(!ret.empty())
+            ret += ", ";
+        ret += std::format("{:X}", frame_id);
+    }
+    return ret;
+}
+
+void CanEntryHandler::SetSignalSeriesSize(size_t size)
+{
+    std::scoped_lock lock{ m };
+    m_SignalSeriesSize = std::max<size_t>(size, 1);
+    m_SignalSeries.clear();  /* Recreated with the new size */
+    UpdateSignalSeries();
+}
+
+size_t CanEntryHandler::GetSignalSeriesSize()
+{
+    std::scoped_lock lock{ m };
+    return m_SignalSeriesSize;
+}
+
+std::vector<std::string> CanEntryHandler::GetSignalSeriesNames()
+{
+    std::scoped_lock lock{ m };
+    std::vector<std::string> ret;
+    for(auto& series : m_SignalSeries)
+        ret.push_back(series->GetName());
+    return ret;
+}
+
+bool CanEntryHandler::QuerySignalSeries(size_t index, int64_t from, int64_t to, size_t max_points, std::vector<CanSignalPoint>& out)
+{
+    std::scoped_lock lock{ m };
+    out.clear();
+    if(index >= m_SignalSeries.size())
+        return false;
+
+    m_SignalSeries[index]->Query(from, to, max_points, out);
+    return true;
+}
+
+bool CanEntryHandler::GetSignalSeriesTimeRange(size_t index, int64_t& first, int64_t& last)
+{
+    std::scoped_lock lock{ m };
+    return index < m_SignalSeries.size() && m_SignalSeries[index]->GetTimeRange(first, last);
+}
+
 bool CanEntryHandler::SaveRecordingToFile(std::filesystem::path& path)
 {
     std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
     std::scoped_lock lock{ m };
     bool ret = false;
-    if(!m_LogEntries.empty())
+    if(!m_LogEntries.empty() && path.extension() == CAN_RECORDING_EXTENSION)
+    {
+        ret = SaveCompressedRecording(path);
+    }
+    else if(!m_LogEntries.empty())
     {
         std::ofstream out(path, std::ofstream::binary);
         if(out.is_open())
         {
             out << "Time,Direction,FrameID,DataSize,Data,Comment\n";
-            for(auto& i : m_LogEntries)
+            for(size_t n = 0; n != m_LogEntries.size(); n++)
             {
+                const CanLogEntry& i = m_LogEntries[n];
                 std::string hex;
-                utils::ConvertHexBufferToString(i->data, hex);
-                uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(i->last_execution - start_time).count();
-                out << std::format("{:.3f},{},{:X},{},{}", static_cast<double>(elapsed) / 1000.0, i->direction == 0 ? "TX" : "RX", 
-                    static_cast<uint32_t>(i->frame_id), i->data.size(), hex);
+                utils::ConvertHexBufferToString(i.data, hex);
+                uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(i.last_execution - start_time).count();
+                out << std::format("{:.3f},{},{:X},{},{}", static_cast<double>(elapsed) / 1000.0, i.direction == 0 ? "TX" : "RX", 
+                    static_cast<uint32_t>(i.frame_id), i.data.size(), hex);
 
                 std::string* comment = nullptr;
-                if(i->direction == 0) /* TX */
+                if(i.direction == 0) /* TX */
                 {
-                    auto tx_entry_opt = FindTxCanEntryByFrame(i->frame_id);
+                    auto tx_entry_opt = FindTxCanEntryByFrame(i.frame_id);
                     if(tx_entry_opt.has_value())
                     {
                         comment = &tx_entry_opt->get().comment;
@@ -704,8 +1044,8 @@ bool CanEntryHandler::SaveRecordingToFile(std::filesystem::path& path)
                 }
                 else  /* RX */
                 {
-                    if(rx_entry_comment.contains(i->frame_id))
-                        comment = &rx_entry_comment[i->frame_id];
+                    if(rx_entry_comment.contains(i.frame_id))
+                        comment = &rx_entry_comment[i.frame_id];
                 }
                 if(comment && !comment->empty())
                     out << "," << *comment << "\n";
@@ -733,51 +1073,237 @@ bool CanEntryHandler::SaveRecordingToFile(std::filesystem::path& path)
     return ret;
 }
 
-void CanEntryHandler::GenerateLogForFrame(uint32_t frame_id, bool is_rx, std::vector<std::string>& log)
+bool CanEntryHandler::SaveCompressedRecording(const std::filesystem::path& path)
 {
-    if(!m_LogEntries.empty())
+    std::ofstream out(path, std::ofstream::binary);
+    if(!out.is_open())
+    {
+        LOG(LogLevel::Error, "Failed to open file for saving CAN recording: {}", path.generic_string());
+        return false;
+    }
+
+    CanRecordingWriter writer(out);
+    for(size_t n = 0; n != m_LogEntries.size(); n++)
+    {
+        const CanLogEntry& i = m_LogEntries[n];
+        CanRecordingFrame frame;
+        frame.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(i.last_execution - start_time).count();
+        frame.frame_id = i.frame_id;
+        frame.direction = i.direction;
+        frame.size = static_cast<uint8_t>(std::min(i.data.size(), frame.data.size()));
+        std::copy(i.data.begin(), i.data.begin() + frame.size, frame.data.begin());
+        writer.Add(frame);
+    }
+
+    if(!writer.Flush())
     {
-        for(auto& i : m_LogEntries)
+        LOG(LogLevel::Error, "Failed to write CAN recording: {}", path.generic_string());
+        return false;
+    }
+    LOG(LogLevel::Verbose, "CAN recording compressed: {} frames, {} bytes", m_LogEntries.size(), writer.GetWrittenSize());
+    return true;
+}
+
+bool CanEntryHandler::ImportRecording(const std::filesystem::path& path)
+{
+    if(m_IsImportRunning.exchange(true))
+    {
+        LOG(LogLevel::Warning, "CAN log import is already running");
+        return false;
+    }
+
+    {
+        std::scoped_lock lock{ m };
+        is_recoding = false;
+        tx_frame_cnt = rx_frame_cnt = 0;
+        m_LogEntries.Clear();
+    }
+    m_ImportWorker = std::make_unique<std::jthread>(std::bind_front(&CanEntryHandler::ImportWorker, this), path);
+    if(m_ImportWorker)
+        utils::SetThreadName(*m_ImportWorker, "CanLogImport");
+    return true;
+}
+
+void CanEntryHandler::ImportWorker(std::stop_token token, std::filesystem::path path)
+{
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    CanLogImportResult result;
+    bool ret = false;
+    if(path.extension() == CAN_RECORDING_EXTENSION)
+    {
+        std::ifstream in(path, std::ios::binary);
+        CanRecordingReader reader(in);
+        ret = in.is_open() && reader.ReadHeader();
+        std::vector<CanRecordingFrame> frames;
+        while(ret && !token.stop_requested() && reader.ReadNextBlock(frames))
         {
-            if(i->frame_id == frame_id)
+            ret = AddImportedFrames(frames);
+            result.frames += frames.size();
+            frames.clear();
+        }
+        if(!ret)
+            LOG(LogLevel::Error, "Failed to read compressed recording: {}", path.generic_string());
+    }
+    else
+    {
+        CanLogImporter importer;
+        ret = importer.Import(path, [this, &token](const std::vector<CanRecordingFrame>& frames)
             {
-                std::string out;
-                std::string hex;
-                utils::ConvertHexBufferToString(i->data, hex);
-                uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(i->last_execution - start_time).count();  /* Looks like there is a bug with fmt alingment */
-                out = std::format("{:<6.03f}{:<6}{:<6X}{:<6}{:<6}", static_cast<double>(elapsed) / 1000.0, i->direction == 0 ? "TX" : "RX", 
-                    static_cast<uint32_t>(i->frame_id), i->data.size(), hex);
+                return !token.stop_requested() && AddImportedFrames(frames);
+            }, result);
+    }
 
-                std::string* comment = nullptr;
-                if(i->direction == 0) /* TX */
-                {
-                    auto tx_entry_opt = FindTxCanEntryByFrame(i->frame_id);
-                    if(tx_entry_opt.has_value())
-                    {
-                        comment = &tx_entry_opt->get().comment;
-                    }
-                }
-                else  /* RX */
-                {
-                    if(rx_entry_comment.contains(i->frame_id))
-                        comment = &rx_entry_comment[i->frame_id];
-                }
-                if(comment && !comment->empty())
-                    out += std::format("   {:^6}", *comment);
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    int64_t dif = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    LOG(LogLevel::Notification, "Imported {} frames from {} in {:.3f}ms, {} unsupported frames and {} invalid lines skipped", result.frames, path.generic_string(),
+        static_cast<double>(dif) / 1000000.0, result.unsupported_frames, result.invalid_lines);
 
-                log.push_back(std::move(out));
+    if(ret && !token.stop_requested())
+    {
+        MyFrame* frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
+        std::unique_lock lock(frame->mtx);
+        frame->pending_msgs.push_back({ static_cast<uint8_t>(PopupMsgIds::CanLogImported), dif, path.generic_string(), result.frames });
+    }
+    m_IsImportRunning = false;
+}
+
+bool CanEntryHandler::AddImportedFrames(const std::vector<CanRecordingFrame>& frames)
+{
+    std::scoped_lock lock{ m };
+    for(auto& i : frames)
+    {
+        std::chrono::steady_clock::time_point timepoint = start_time + std::chrono::microseconds(i.timestamp);
+        if(!m_LogEntries.Add(i.direction, i.frame_id, const_cast<uint8_t*>(i.data.data()), i.size, timepoint))
+        {
+            LOG(LogLevel::Error, "CAN recording is full, import stopped");
+            return false;
+        }
+    }
+    return true;
+}
+
+void CanEntryHandler::ToggleCapture(bool toggle)
+{
+    std::scoped_lock lock{ m };
+    m_Capture.Arm(toggle, std::chrono::steady_clock::now());
+}
+
+bool CanEntryHandler::IsCaptureArmed()
+{
+    std::scoped_lock lock{ m };
+    return m_Capture.IsArmed();
+}
+
+std::vector<CanChangeReport> CanEntryHandler::MarkChanges(std::chrono::steady_clock::time_point& previous_mark)
+{
+    std::scoped_lock lock{ m };
+    std::vector<CanChangeReport> ret = m_ChangeDetector.GetChangedSinceMark();
+    previous_mark = m_ChangeDetector.GetMarkTime();
+    m_ChangeDetector.Mark(std::chrono::steady_clock::now());
+    return ret;
+}
+
+bool CanEntryHandler::SaveCaptureEvent(const CanCaptureEvent& event)
+{
+    std::map<std::pair<uint32_t, uint8_t>, std::string> comments;  /* [(frame_id, direction)] = comment */
+    {
+        std::scoped_lock lock{ m };
+        for(auto& i : event.frames)
+        {
+            auto [it, is_inserted] = comments.try_emplace({ i.frame_id, i.direction });
+            if(!is_inserted)
+                continue;
+            if(i.direction == CAN_LOG_DIR_TX)
+            {
+                auto tx_entry_opt = FindTxCanEntryByFrame(i.frame_id);
+                if(tx_entry_opt.has_value())
+                    it->second = tx_entry_opt->get().comment;
+            }
+            else if(auto comment_it = rx_entry_comment.find(i.frame_id); comment_it != rx_entry_comment.end())
+            {
+                it->second = comment_it->second;
             }
         }
     }
+
+    std::error_code ec;
+    std::filesystem::create_directories(capture_directory, ec);
+
+    char timestamp[32];
+    time_t rawtime = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y.%m.%d_%H_%M_%S", localtime(&rawtime));
+    std::filesystem::path path = capture_directory / std::format("CanCapture_{}_{}.csv", timestamp, event.number);
+
+    std::ofstream out(path, std::ofstream::binary);
+    if(!out.is_open())
+    {
+        LOG(LogLevel::Error, "Failed to open file for saving CAN capture: {}", path.generic_string());
+        return false;
+    }
+
+    /* Time is relative to the trigger, pre-trigger frames have negative time */
+    out << "# Trigger: " << event.trigger << ", pre-trigger frames: " << event.pre_trigger_count << "\n";
+    out << "Time,Direction,FrameID,DataSize,Data,Comment\n";
+    for(auto& i : event.frames)
+    {
+        std::string hex;
+        utils::ConvertHexBufferToString(reinterpret_cast<const char*>(i.data.data()), i.size, hex);
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(i.time - event.trigger_time).count();
+        out << std::format("{:.3f},{},{:X},{},{},{}\n", static_cast<double>(elapsed) / 1000.0, i.direction == CAN_LOG_DIR_TX ? "TX" : "RX",
+            i.frame_id, i.size, hex, comments[{ i.frame_id, i.direction }]);
+    }
+    out.flush();
+    LOG(LogLevel::Notification, "CAN capture #{} ({}) saved to {}, {} frames", event.number, event.trigger, path.generic_string(), event.frames.size());
+    return true;
 }
 
-template <typename T> void CanEntryHandler::HandleBitReading(uint32_t frame_id, bool is_rx, std::unique_ptr<CanMap>& m, size_t offset, CanBitfieldInfo& info)
+void CanEntryHandler::GenerateLogForFrame(uint32_t frame_id, bool is_rx, std::vector<std::string>& log)
+{
+    /* Index is modified by the RX path, the frames can be read without the lock */
+    CanLogOffsets offsets;
+    {
+        std::scoped_lock lock{ m };
+        offsets = m_LogEntries.GetOffsetsForFrame(frame_id);
+    }
+    log.reserve(log.size() + offsets.size());
+    for(uint32_t offset : offsets)
+    {
+        const CanLogEntry& i = m_LogEntries[offset];
+        std::string out;
+        std::string hex;
+        utils::ConvertHexBufferToString(i.data, hex);
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(i.last_execution - start_time).count();  /* Looks like there is a bug with fmt alingment */
+        out = std::format("{:<6.03f}{:<6}{:<6X}{:<6}{:<6}", static_cast<double>(elapsed) / 1000.0, i.direction == 0 ? "TX" : "RX", 
+            static_cast<uint32_t>(i.frame_id), i.data.size(), hex);
+
+        std::string* comment = nullptr;
+        if(i.direction == 0) /* TX */
+        {
+            auto tx_entry_opt = FindTxCanEntryByFrame(i.frame_id);
+            if(tx_entry_opt.has_value())
+            {
+                comment = &tx_entry_opt->get().comment;
+            }
+        }
+        else  /* RX */
+        {
+            if(rx_entry_comment.contains(i.frame_id))
+                comment = &rx_entry_comment[i.frame_id];
+        }
+        if(comment && !comment->empty())
+            out += std::format("   {:^6}", *comment);
+
+        log.push_back(std::move(out));
+    }
+}
+
+template <typename T> void CanEntryHandler::HandleBitReading(uint32_t frame_id, const CanRxSnapshot* rx_entry, bool is_rx, std::unique_ptr<CanMap>& m, size_t offset, CanBitfieldInfo& info)
 {
     if(is_rx)
     {
-        if(m_rxData.contains(frame_id))
+        if(rx_entry)
         {
-            uint64_t value = get_bitfield(m_rxData[frame_id]->data.data(), m_rxData[frame_id]->data.size(), offset, m->m_Size);
+            uint64_t value = get_bitfield(rx_entry->data.data(), rx_entry->data.size(), offset, m->m_Size);
             T extracted_data = static_cast<T>(value);
             info.push_back({
                 std::format("{}         (offset: {}, size: {}, range: {} - {})", m->m_Name, offset, m->m_Size, m->m_MinVal, m->m_MaxVal), std::to_string(extracted_data), m.get() });
@@ -817,6 +1343,14 @@ template <typename T> void CanEntryHandler::HandleBitWriting(uint32_t frame_id,
 CanBitfieldInfo CanEntryHandler::GetMapForFrameId(uint32_t frame_id, bool is_rx)
 {
     CanBitfieldInfo info;
+    std::shared_ptr<const CanRxSnapshotTable> rx_snapshot = is_rx ? GetRxSnapshot() : nullptr;  /* Every signal is decoded from the same frame */
+    const CanRxSnapshot* rx_entry = nullptr;
+    if(rx_snapshot)
+    {
+        auto it = rx_snapshot->entries.find(frame_id);
+        if(it != rx_snapshot->entries.end())
+            rx_entry = &it->second;
+    }
     if(m_mapping.contains(frame_id))
     {
         for(auto &[offset, m] : m_mapping[frame_id])
@@ -827,52 +1361,52 @@ CanBitfieldInfo CanEntryHandler::GetMapForFrameId(uint32_t frame_id, bool is_rx)
                 case CBT_BOOL:
                 case CBT_UI8:
                 {
-                    HandleBitReading<uint8_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<uint8_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_I8:
                 {
-                    HandleBitReading<int8_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<int8_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_UI16:
                 {
-                    HandleBitReading<uint16_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<uint16_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_I16:
                 {
-                    HandleBitReading<int16_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<int16_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_UI32:
                 {
-                    HandleBitReading<uint32_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<uint32_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_I32:
                 {
-                    HandleBitReading<int32_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<int32_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_UI64:
                 {
-                    HandleBitReading<uint64_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<uint64_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_I64:
                 {
-                    HandleBitReading<int64_t>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<int64_t>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_FLOAT:
                 {
-                    HandleBitReading<float>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<float>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 case CBT_DOUBLE:
                 {
-                    HandleBitReading<double>(frame_id, is_rx, m, offset, info);
+                    HandleBitReading<double>(frame_id, rx_entry, is_rx, m, offset, info);
                     break;
                 }
                 default:
@@ -1026,6 +1560,10 @@ extern "C" uint32_t isotp_user_get_ms(void)
 
 extern "C" int isotp_user_send_can(const uint32_t arbitration_id, const uint8_t * data, const uint8_t size)
 {
-    CanSerialPort::Get()->AddToTxQueue(arbitration_id, size, (uint8_t*)data);
+    /* Without a collector it's called from the RX path (flow control) with m held, which can't wait for free space */
+    if(CanDeferredTxFrames::current)
+        CanDeferredTxFrames::current->Add(arbitration_id, size, data);
+    else
+        CanSerialPort::Get()->AddToTxQueue(arbitration_id, size, (uint8_t*)data, false);
     return 0;
 }
\ No newline at end of file
@@ -3,10 +3,18 @@
 #include "utils/CSingleton.hpp"
 #include <filesystem>
 #include <list>
+#include <set>
 #include <boost/optional.hpp>
 
 #include "ICanEntry.hpp"
 #include "ICanObserver.hpp"
+#include "CanLogStore.hpp"
+#include "CanTriggerCapture.hpp"
+#include "CanRecordingCodec.hpp"
+#include "CanSignalDecoder.hpp"
+#include "CanLogImporter.hpp"
+#include "CanChangeDetector.hpp"
+#include "CanSignalSeries.hpp"
 
 extern "C"
 {
@@ -16,30 +24,8 @@ extern "C"
 
 #include "IBasicGuiCustomization.hpp"
 
-constexpr uint8_t CAN_LOG_DIR_TX = 0;
-constexpr uint8_t CAN_LOG_DIR_RX = 1;
-
 constexpr size_t MAX_ISOTP_FRAME_LEN = 4096;
 
-class CanEntryBase
-{
-public:
-    CanEntryBase() = default;
-    CanEntryBase(uint8_t* data_, uint8_t data_len)
-    {
-        if(data_ && data_len)
-            data.insert(data.end(), data_, data_ + data_len);
-    }
-
-    CanEntryBase(const CanEntryBase& from) :
-        data(from.data)
-    {
-
-    }
-    std::vector<uint8_t> data{};
-    std::chrono::steady_clock::time_point last_execution;
-};
-
 class CanEntryTransmitInfo
 {
 public:
@@ -58,7 +44,7 @@ public:
     }
 
     uint32_t period{};
-    size_t count{};
+    std::atomic<size_t> count{};  /* Read by the GUI without locking */
     uint8_t log_level{};
     uint8_t favourite_level{};
 };
@@ -122,30 +108,45 @@ public:
     }
 };
 
-class CanLogEntry : public CanEntryBase
+class CanRxSnapshot
 {
 public:
-    CanLogEntry(uint8_t dir, uint32_t frame_id_, uint8_t* data_, uint8_t data_len, std::chrono::steady_clock::time_point& timepoint) :
-        CanEntryBase(data_, data_len)
-    {
-        frame_id = frame_id_ & 0x1FFFFFFF;
-        direction = dir & 1;
-        last_execution = timepoint;
-    }
-    union
-    {
-        uint32_t frame_id_and_direction = 0;
-        struct
-        {
-            uint32_t frame_id : 29;
-            uint8_t direction : 1;  /* 0 = sent, 1 = received */
-        };
-    };
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Last received data
+    std::vector<uint8_t> data;
+
+    // !\brief Period in ms
+    uint32_t period = 0;
+
+    // !\brief Number of received frames
+    size_t count = 0;
+
+    // !\brief Log level
+    uint8_t log_level = 0;
+
+    // !\brief Favourite level
+    uint8_t favourite_level = 0;
+
+    // !\brief Comment
+    std::string comment;
+
+    // !\brief Version of the snapshot table where it was changed last time
+    uint64_t version = 0;
 };
 
-enum CanBitfieldType : uint8_t
+class CanRxSnapshotTable
 {
-    CBT_BOOL, CBT_UI8, CBT_I8, CBT_UI16, CBT_I16, CBT_UI32, CBT_I32, CBT_UI64, CBT_I64, CBT_FLOAT, CBT_DOUBLE, CBT_INVALID
+public:
+    // !\brief Incremented by every publish
+    uint64_t version = 0;
+
+    // !\brief Version when the table was rebuilt from scratch, entries which were published before may have been removed
+    uint64_t rebuild_version = 0;
+
+    // !\brief RX entries [frame_id] = snapshot
+    std::unordered_map<uint32_t, CanRxSnapshot> entries;
 };
 
 class CanMap : public BasicGuiTextCustomization
@@ -214,22 +215,6 @@ public:
     static std::pair<int64_t, int64_t> GetMinMaxForType(CanBitfieldType type);
 
 private:
-    static inline std::map<CanBitfieldType, std::string> m_CanBitfieldTypeMap
-    {
-        {CBT_BOOL, "bool"},
-        {CBT_UI8, "uint8_t"},
-        {CBT_I8, "int8_t"},
-        {CBT_UI16, "uint16_t"},
-        {CBT_I16, "int16_t"},
-        {CBT_UI32, "uint32_t"},
-        {CBT_I32, "int32_t"},
-        {CBT_UI64, "uint64_t"},
-        {CBT_I64, "int64_t"},
-        {CBT_FLOAT, "float"},
-        {CBT_DOUBLE, "double"},
-        {CBT_INVALID, "invalid"}
-    };    
-    
     static inline std::map<CanBitfieldType, std::pair<int64_t, int64_t>> m_CanTypeSizes  /* TODO: use int128_t for size from boost::multiprecision */
     {
         {CBT_BOOL, {0, 1}},
@@ -247,6 +232,28 @@ private:
     };
 };
 
+class IsoTpChannel
+{
+public:
+    IsoTpChannel(uint32_t send_id, uint32_t response_id_) :
+        response_id(response_id_)
+    {
+        isotp_init_link(&link, send_id, send_buf, sizeof(send_buf), recv_buf, sizeof(recv_buf));
+    }
+
+    // !\brief ISO-TP Link
+    IsoTpLink link;
+
+    // !\brief Response Frame ID
+    uint32_t response_id;
+
+    // !\brief ISO-TP Transmit buffer
+    uint8_t send_buf[MAX_ISOTP_FRAME_LEN];
+
+    // !\brief ISO-TP Receiving buffer
+    uint8_t recv_buf[MAX_ISOTP_FRAME_LEN];
+};
+
 class ICanSubscriber 
 {
 public:
@@ -301,6 +308,9 @@ public:
 
     // !\brief Called when a can frame was received
     void OnFrameReceived(uint32_t frame_id, uint8_t data_len, uint8_t* data);
+
+    // !\brief Called when the CAN device reports an error or corrupted frame
+    void OnErrorFrame();
     
     // !\brief Toggle automatic sending of all CAN frames which period isn't null
     // !\param toggle [in] Toggle auto send?
@@ -338,6 +348,23 @@ public:
     // !\param size [in] Data size
     void SendIsoTpFrame(uint32_t frame_id, uint8_t* data, uint16_t size);
 
+    // !\brief Open an additional ISO-TP channel, so more ECUs can be addressed at the same time
+    // !\param send_id [in] CAN Frame ID of requests
+    // !\param response_id [in] CAN Frame ID of responses
+    // !\return False if a channel is already open for response_id or it's the response ID of the default link
+    bool OpenIsoTpChannel(uint32_t send_id, uint32_t response_id);
+
+    // !\brief Close ISO-TP channel
+    // !\param response_id [in] CAN Frame ID of responses
+    void CloseIsoTpChannel(uint32_t response_id);
+
+    // !\brief Send ISO-TP frame over the channel which receives responses on response_id
+    // !\param response_id [in] CAN Frame ID of responses
+    // !\param data [in] Data to send
+    // !\param size [in] Data size
+    // !\return False if there is no channel for response_id
+    bool SendIsoTpFrameOnChannel(uint32_t response_id, uint8_t* data, uint16_t size);
+
     // !\brief Load TX list from a file
     // !\param path [in] File path to load
     // !\return Is load was successfull?
@@ -364,10 +391,94 @@ public:
     // !\param path [in] File path to save
     bool SaveMapping(std::filesystem::path& path);
 
-    // !\brief Save recorded data to file
+    // !\brief Save recorded data to file, CAN_RECORDING_EXTENSION files are saved in compressed format, everything else as CSV
     // !\param path [in] File path to save
     bool SaveRecordingToFile(std::filesystem::path& path);
 
+    // !\brief Take Frame IDs of TX entries sent since the last call, called by the GUI at display refresh rate
+    // !\param tx_ids [out] Frame IDs, counters can be read from the entries
+    void TakeChangedTxIds(std::unordered_set<uint32_t>& tx_ids);
+
+    // !\brief Get last published RX snapshot, it doesn't lock the handler and the returned table is never modified
+    std::shared_ptr<const CanRxSnapshotTable> GetRxSnapshot() const { return m_RxSnapshot.load(); }
+
+    // !\brief Remove RX entry
+    // !\param frame_id [in] CAN Frame ID
+    void RemoveRxEntry(uint32_t frame_id);
+
+    // !\brief Remove every RX entry
+    void ClearRxEntries();
+
+    // !\brief Set comment of RX entry
+    // !\param frame_id [in] CAN Frame ID
+    // !\param comment [in] Comment
+    void SetRxComment(uint32_t frame_id, const std::string& comment);
+
+    // !\brief Has to be called after a TX comment is edited directly in the entry
+    void OnTxCommentChanged() { m_CommentVersion++; }
+
+    // !\brief Get version of comments, it's incremented on every change, so cached comment matches can be dropped
+    uint64_t GetCommentVersion() const { return m_CommentVersion; }
+
+    // !\brief Import candump (.log), Vector ASC (.asc) or compressed recording into the recording in the background
+    // !\details Recording is stopped and cleared first, imported frames appear in the log while the import is running
+    // !\param path [in] File path to import
+    // !\return False if an import is already running
+    bool ImportRecording(const std::filesystem::path& path);
+
+    // !\brief Is an import running?
+    bool IsImportRunning() const { return m_IsImportRunning; }
+
+    // !\brief Arm or disarm trigger-based capture
+    // !\param toggle [in] Arm?
+    void ToggleCapture(bool toggle);
+
+    // !\brief Is trigger-based capture armed?
+    bool IsCaptureArmed();
+
+    // !\brief Set a new mark of the change detector
+    // !\param previous_mark [out] Time of the previous mark
+    // !\return Received frames changed since the previous mark, the last changed one first
+    std::vector<CanChangeReport> MarkChanges(std::chrono::steady_clock::time_point& previous_mark);
+
+    // !\brief Set Frame IDs whose mapped signals are recorded into time series
+    // !\param str [in] Frame IDs in hex, separated by comma
+    // !\return False if an ID is invalid, valid ones are applied anyway
+    bool SetSignalSeriesIdsFromString(const std::string& str);
+
+    // !\brief Get Frame IDs whose mapped signals are recorded into time series
+    std::string GetSignalSeriesIdsAsString();
+
+    // !\brief Set number of raw points kept per signal, existing series are cleared
+    // !\param size [in] Number of points
+    void SetSignalSeriesSize(size_t size);
+
+    // !\brief Get number of raw points kept per signal
+    size_t GetSignalSeriesSize();
+
+    // !\brief Get names of recorded signals, "FRAME_ID SIGNAL_NAME", the index is used by QuerySignalSeries
+    std::vector<std::string> GetSignalSeriesNames();
+
+    // !\brief Get downsampled points of a recorded signal
+    // !\param index [in] Signal index, see GetSignalSeriesNames
+    // !\param from [in] Start of the window in microseconds since start time
+    // !\param to [in] End of the window in microseconds since start time
+    // !\param max_points [in] Maximum number of points, eg. width of the plot in pixels
+    // !\param out [out] Points in time order
+    // !\return False if the index is invalid
+    bool QuerySignalSeries(size_t index, int64_t from, int64_t to, size_t max_points, std::vector<CanSignalPoint>& out);
+
+    // !\brief Get time range of a recorded signal
+    // !\param index [in] Signal index, see GetSignalSeriesNames
+    // !\param first [out] Time of the oldest stored point in microseconds since start time
+    // !\param last [out] Time of the newest stored point in microseconds since start time
+    // !\return False if the index is invalid or the signal has no points
+    bool GetSignalSeriesTimeRange(size_t index, int64_t& first, int64_t& last);
+
+    // !\brief Save pre and post-trigger window of a capture event to capture_directory
+    // !\param event [in] Capture event
+    bool SaveCaptureEvent(const CanCaptureEvent& event);
+
     // !\brief Get recording level
     uint8_t GetRecordingLogLevel() { return m_RecodingLogLevel; }
 
@@ -448,8 +559,17 @@ public:
     // !\brief Frame ID log levels
     std::unordered_map<uint32_t, uint8_t> m_RxLogLevels;
 
-    // !\brief CAN Log entries (both TX & RX)
-    std::vector<std::unique_ptr<CanLogEntry>> m_LogEntries;
+    // !\brief CAN Log entries (both TX & RX), indexed by Frame ID
+    CanLogStore m_LogEntries;
+
+    // !\brief Trigger-based capture with pre-trigger ring, independent from recording, guarded by m
+    CanTriggerCapture m_Capture;
+
+    // !\brief Change detection of received frames, guarded by m
+    CanChangeDetector m_ChangeDetector;
+
+    // !\brief Directory where capture events are saved
+    std::filesystem::path capture_directory = "Can";
 
     // !\brief Path to default TX list
     std::filesystem::path default_tx_list = "TxList.xml";
@@ -479,8 +599,38 @@ public:
     void AssignNewBufferToTxEntry(uint32_t frame_id, uint8_t* buffer, size_t size);
 
 private:
+    // !\brief Save recorded data in compressed format, m has to be locked
+    // !\param path [in] File path to save
+    bool SaveCompressedRecording(const std::filesystem::path& path);
+
+    // !\brief Import worker thread
+    // !\param token [in] Stop token, the import is aborted when the handler is destroyed
+    // !\param path [in] File path to import
+    void ImportWorker(std::stop_token token, std::filesystem::path path);
+
+    // !\brief Append imported frames to the recording
+    // !\param frames [in] Frames
+    // !\return False if the recording is full
+    bool AddImportedFrames(const std::vector<CanRecordingFrame>& frames);
+
     // !\brief Handle bit reading of a frame
-    template <typename T> void HandleBitReading(uint32_t frame_id, bool is_rx, std::unique_ptr<CanMap>& m, size_t offset, CanBitfieldInfo& info);
+    template <typename T> void HandleBitReading(uint32_t frame_id, const CanRxSnapshot* rx_entry, bool is_rx, std::unique_ptr<CanMap>& m, size_t offset, CanBitfieldInfo& info);
+
+    // !\brief Collect changed RX entries for the next snapshot, m has to be locked
+    // !\param changed [out] Changed entries, every entry if the snapshot is stale
+    // !\return True if the snapshot has to be rebuilt from scratch
+    bool CollectChangedRxEntries(std::vector<CanRxSnapshot>& changed);
+
+    // !\brief Publish new RX snapshot from the previous one and the changed entries, it's called without holding m
+    // !\param changed [in] Changed entries
+    // !\param is_rebuild [in] Rebuild from scratch?
+    void PublishRxSnapshot(std::vector<CanRxSnapshot>& changed, bool is_rebuild);
+
+    // !\brief Pass signals of the mapping to the change detector, m has to be locked
+    void UpdateChangeDetectorSignals();
+
+    // !\brief Create time series for mapped signals of m_SignalSeriesIds, series of unchanged signals are kept, m has to be locked
+    void UpdateSignalSeries();
 
     // !\brief Handle bit writing of a frame
     template <typename T> void HandleBitWriting(uint32_t frame_id, uint8_t& pos, uint8_t offset, uint8_t size, uint8_t* byte_array, std::vector<std::string>& new_data);
@@ -509,18 +659,57 @@ private:
     // !\brief RX Frame count
     uint64_t rx_frame_cnt = 0;
 
+    // !\brief Frame IDs of TX entries sent since the last TakeChangedTxIds
+    std::unordered_set<uint32_t> m_ChangedTxIds;
+
+    // !\brief Frame IDs of RX entries changed since the last published snapshot
+    std::unordered_set<uint32_t> m_ChangedRxIds;
+
+    // !\brief Has the RX snapshot to be rebuilt from scratch? (entries were removed or comments reloaded)
+    bool m_IsRxSnapshotStale = false;
+
+    // !\brief Last time when the RX snapshot was published
+    std::chrono::steady_clock::time_point m_LastRxSnapshot;
+
+    // !\brief Published RX snapshot, replaced as a whole by the worker thread, so readers don't need the lock
+    std::atomic<std::shared_ptr<const CanRxSnapshotTable>> m_RxSnapshot;
+
     // !\brief Exit worker thread?
     //std::stop_source stop_source;
 
     // !\brief Worker thread
     std::unique_ptr<std::jthread> m_worker;
 
+    // !\brief Import thread
+    std::unique_ptr<std::jthread> m_ImportWorker;
+
+    // !\brief Is an import running?
+    std::atomic<bool> m_IsImportRunning = false;
+
+    // !\brief Version of TX and RX comments
+    std::atomic<uint64_t> m_CommentVersion = 0;
+
     // !\brief Conditional variable for main thread exiting
     std::condition_variable_any m_cv;
 
+    // !\brief Additional ISO-TP channels [response_id] = channel
+    std::map<uint32_t, std::unique_ptr<IsoTpChannel>> m_IsoTpChannels;
+
     // !\brief Starting time
     std::chrono::steady_clock::time_point start_time;
 
+    // !\brief Time series of recorded signals, guarded by m
+    std::vector<std::unique_ptr<CanSignalSeries>> m_SignalSeries;
+
+    // !\brief Recorded signals [frame_id] = signals, index is the index in m_SignalSeries
+    std::unordered_map<uint32_t, std::vector<CanSignalDefinition>> m_SignalSeriesDefs;
+
+    // !\brief Frame IDs whose mapped signals are recorded
+    std::set<uint32_t> m_SignalSeriesIds;
+
+    // !\brief Number of raw points kept per signal
+    size_t m_SignalSeriesSize = 262144;
+
     // !\brief CAN mapping container
     CanMapping m_mapping;
 
@@ -0,0 +1,301 @@
+#include "pch.hpp"
+
+/* Mask of a Frame ID which has to match exactly */
+constexpr uint32_t CAN_GATEWAY_EXACT_ID_MASK = 0x1FFFFFFF;
+
+/* Parse hex number, unlike std::stoul the whole string has to be a number */
+static uint32_t ParseGatewayHex(const std::string& str)
+{
+    size_t pos = 0;
+    uint32_t ret = static_cast<uint32_t>(std::stoul(str, &pos, 16));
+    if(pos != str.length())
+        throw std::invalid_argument("not a hex number");
+    return ret;
+}
+
+CanGateway::CanGateway()
+{
+    m_StdRules.fill(CAN_GATEWAY_NO_RULE);
+}
+
+bool CanGateway::SetRulesFromString(const std::string& str)
+{
+    std::vector<std::string> entries;
+    boost::split(entries, str.substr(0, str.find('#')), boost::is_any_of(","));
+
+    bool ret = true;
+    std::vector<CanGatewayRule> rules;
+    for(auto& entry : entries)
+    {
+        boost::algorithm::trim(entry);
+        if(entry.empty())
+            continue;
+
+        std::vector<std::string> params;
+        boost::split(params, entry, boost::is_any_of(":"));
+        try
+        {
+            if(params.size() < 2 || rules.size() >= CAN_GATEWAY_NO_RULE)
+            {
+                LOG(LogLevel::Error, "Invalid gateway rule format: {}, expected ID[/MASK]:Drop or ID[/MASK]:NEW_ID[:PATCH][:RATE]", entry);
+                ret = false;
+                continue;
+            }
+
+            CanGatewayRule rule;
+            size_t slash = params[0].find('/');
+            if(slash != std::string::npos)
+                rule.id_mask = ParseGatewayHex(params[0].substr(slash + 1)) & CAN_GATEWAY_EXACT_ID_MASK;
+            rule.id = ParseGatewayHex(params[0].substr(0, slash)) & rule.id_mask;
+
+            if(boost::iequals(params[1], "Drop"))
+            {
+                rule.action = CGA_DROP;
+            }
+            else
+            {
+                /* There is only one CAN channel, a frame forwarded with the same ID would be a duplicate on the bus it came from */
+                rule.action = CGA_REWRITE;
+                rule.new_id = boost::iequals(params[1], "Forward") ? rule.id : ParseGatewayHex(params[1]) & CAN_GATEWAY_EXACT_ID_MASK;
+                if((rule.new_id & rule.id_mask) == rule.id)
+                {
+                    LOG(LogLevel::Error, "Invalid gateway rule: {}, frames are forwarded to the same bus, so the rule has to change the ID", entry);
+                    ret = false;
+                    continue;
+                }
+            }
+
+            bool is_valid = rule.action != CGA_DROP || params.size() == 2;
+            for(size_t i = 2; i < params.size() && is_valid; i++)
+            {
+                size_t equal = params[i].find('=');
+                if(equal == std::string::npos)
+                {
+                    size_t pos = 0;
+                    rule.max_rate = static_cast<uint32_t>(std::stoul(params[i], &pos, 10));
+                    is_valid = pos == params[i].length();
+                    continue;
+                }
+
+                std::string mask = params[i].substr(0, equal);
+                std::string value = params[i].substr(equal + 1);
+                if(mask.empty() || mask.length() != value.length() || mask.length() % 2 || mask.length() > rule.patch_mask.size() * 2)
+                {
+                    is_valid = false;
+                    break;
+                }
+
+                rule.patch_len = static_cast<uint8_t>(mask.length() / 2);
+                for(uint8_t n = 0; n != rule.patch_len; n++)
+                {
+                    rule.patch_mask[n] = static_cast<uint8_t>(ParseGatewayHex(mask.substr(n * 2, 2)));
+                    rule.patch_value[n] = static_cast<uint8_t>(ParseGatewayHex(value.substr(n * 2, 2))) & rule.patch_mask[n];
+                }
+            }
+
+            if(!is_valid)
+            {
+                LOG(LogLevel::Error, "Invalid gateway rule: {}, patch has to be MASK=VALUE with the same length, rate is frames per second, Drop doesn't take parameters", entry);
+                ret = false;
+                continue;
+            }
+
+            if(rule.max_rate)
+                rule.interval = std::chrono::nanoseconds(std::chrono::seconds(1)) / rule.max_rate;
+            rules.push_back(rule);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid gateway rule format, exception: {} ({})", e.what(), entry);
+            ret = false;
+        }
+    }
+
+    std::scoped_lock lock(m_Mutex);
+    m_Rules = std::move(rules);
+    Compile();
+    return ret;
+}
+
+std::string CanGateway::GetRulesAsString()
+{
+    std::scoped_lock lock(m_Mutex);
+    std::string ret;
+    for(auto& rule : m_Rules)
+    {
+        if(!ret.empty())
+            ret += ", ";
+        ret += RuleToString(rule);
+    }
+    return ret;
+}
+
+std::string CanGateway::RuleToString(const CanGatewayRule& rule)
+{
+    std::string ret = std::format("{:X}", rule.id);
+    if(rule.id_mask != CAN_GATEWAY_EXACT_ID_MASK)
+        ret += std::format("/{:X}", rule.id_mask);
+
+    if(rule.action == CGA_DROP)
+        return ret + ":Drop";
+    ret += std::format(":{:X}", rule.new_id);
+
+    if(rule.patch_len)
+    {
+        std::string mask, value;
+        for(uint8_t i = 0; i != rule.patch_len; i++)
+        {
+            mask += std::format("{:02X}", rule.patch_mask[i]);
+            value += std::format("{:02X}", rule.patch_value[i]);
+        }
+        ret += ":" + mask + "=" + value;
+    }
+    if(rule.max_rate)
+        ret += std::format(":{}", rule.max_rate);
+    return ret;
+}
+
+uint16_t CanGateway::FindRule(uint32_t frame_id) const
+{
+    for(size_t i = 0; i != m_Rules.size(); i++)
+    {
+        if(m_Rules[i].Match(frame_id))
+            return static_cast<uint16_t>(i);
+    }
+    return CAN_GATEWAY_NO_RULE;
+}
+
+void CanGateway::Compile()
+{
+    for(uint32_t frame_id = 0; frame_id != CAN_GATEWAY_STD_IDS; frame_id++)
+        m_StdRules[frame_id] = FindRule(frame_id);
+    m_ExtRules.clear();
+    m_Forwarded.clear();
+    m_ForwardedCnt = 0;
+}
+
+bool CanGateway::IsEcho(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now)
+{
+    auto it = m_Forwarded.find(frame_id);
+    if(it == m_Forwarded.end())
+        return false;
+
+    std::deque<CanGatewayForwardedFrame>& frames = it->second;
+    while(!frames.empty() && now - frames.front().time > CAN_GATEWAY_ECHO_TIMEOUT)
+    {
+        frames.pop_front();
+        m_ForwardedCnt--;
+    }
+
+    auto frame_it = std::find_if(frames.begin(), frames.end(), [data, size](const CanGatewayForwardedFrame& f)
+        {
+            return f.size == size && std::equal(data, data + size, f.data.begin());
+        });
+    bool is_echo = frame_it != frames.end();
+    if(is_echo)
+    {
+        frames.erase(frame_it);
+        m_ForwardedCnt--;
+        m_EchoCnt++;
+    }
+
+    if(frames.empty())
+        m_Forwarded.erase(it);
+    return is_echo;
+}
+
+bool CanGateway::Process(uint32_t& frame_id, uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now)
+{
+    if(!m_IsEnabled)
+        return false;
+
+    std::scoped_lock lock(m_Mutex);
+    /* Forwarded frames can come back if the device reports its own frames, they're never forwarded again, so rules can't loop */
+    if(!m_Forwarded.empty() && IsEcho(frame_id, data, size, now))
+        return false;
+
+    uint16_t index;
+    if(frame_id < CAN_GATEWAY_STD_IDS)
+    {
+        index = m_StdRules[frame_id];
+    }
+    else
+    {
+        auto it = m_ExtRules.find(frame_id);
+        if(it == m_ExtRules.end())
+        {
+            if(m_ExtRules.size() >= CAN_GATEWAY_MAX_CACHED_EXT_IDS)
+                m_ExtRules.clear();
+            it = m_ExtRules.emplace(frame_id, FindRule(frame_id)).first;
+        }
+        index = it->second;
+    }
+
+    if(index == CAN_GATEWAY_NO_RULE)
+        return false;
+
+    CanGatewayRule& rule = m_Rules[index];
+    rule.counters.matched++;
+    if(rule.action == CGA_DROP)
+    {
+        rule.counters.dropped++;
+        return false;
+    }
+
+    if(rule.max_rate)
+    {
+        if(now + rule.interval < rule.next_allowed)
+        {
+            rule.counters.rate_limited++;
+            return false;
+        }
+        rule.next_allowed = std::max(rule.next_allowed, now) + rule.interval;
+    }
+
+    for(uint8_t i = 0; i < rule.patch_len && i < size; i++)
+        data[i] = (data[i] & ~rule.patch_mask[i]) | rule.patch_value[i];
+
+    frame_id = (frame_id & ~rule.id_mask) | (rule.new_id & rule.id_mask);
+
+    if(m_ForwardedCnt >= CAN_GATEWAY_MAX_PENDING_ECHOES)
+    {
+        m_Forwarded.clear();
+        m_ForwardedCnt = 0;
+    }
+    CanGatewayForwardedFrame forwarded;
+    forwarded.time = now;
+    forwarded.size = std::min<uint8_t>(size, static_cast<uint8_t>(forwarded.data.size()));
+    std::copy(data, data + forwarded.size, forwarded.data.begin());
+    m_Forwarded[frame_id].push_back(forwarded);
+    m_ForwardedCnt++;
+
+    rule.counters.forwarded++;
+    return true;
+}
+
+std::vector<CanGatewayCounters> CanGateway::GetCounters()
+{
+    std::scoped_lock lock(m_Mutex);
+    std::vector<CanGatewayCounters> ret;
+    ret.reserve(m_Rules.size());
+    for(auto& rule : m_Rules)
+        ret.push_back(rule.counters);
+    return ret;
+}
+
+void CanGateway::ResetCounters()
+{
+    std::scoped_lock lock(m_Mutex);
+    for(auto& rule : m_Rules)
+    {
+        rule.counters = CanGatewayCounters();
+        rule.next_allowed = std::chrono::steady_clock::time_point();
+    }
+    m_EchoCnt = 0;
+}
+
+uint64_t CanGateway::GetEchoCount()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_EchoCnt;
+}
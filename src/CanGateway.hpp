@@ -0,0 +1,180 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Standard (11 bit) IDs have a precompiled rule table, extended ones are cached on first use */
+constexpr size_t CAN_GATEWAY_STD_IDS = 2048;
+
+/* Extended ID cache is dropped when it grows above this, so random IDs can't eat the memory */
+constexpr size_t CAN_GATEWAY_MAX_CACHED_EXT_IDS = 65536;
+
+/* Rule index of IDs which don't match any rule */
+constexpr uint16_t CAN_GATEWAY_NO_RULE = 0xFFFF;
+
+/* Forwarded frames received back within this time are echoes of the gateway's own frames */
+constexpr std::chrono::milliseconds CAN_GATEWAY_ECHO_TIMEOUT{ 1000 };
+
+/* Forwarded frames kept for echo detection are dropped when there are more than this */
+constexpr size_t CAN_GATEWAY_MAX_PENDING_ECHOES = 4096;
+
+enum CanGatewayAction : uint8_t
+{
+    CGA_DROP,     /* Frame isn't forwarded */
+    CGA_REWRITE   /* Frame is forwarded with new ID, data can be patched */
+};
+
+class CanGatewayCounters
+{
+public:
+    // !\brief Number of frames which matched the rule
+    uint64_t matched = 0;
+
+    // !\brief Number of forwarded frames
+    uint64_t forwarded = 0;
+
+    // !\brief Number of frames dropped by the rule
+    uint64_t dropped = 0;
+
+    // !\brief Number of frames dropped by rate limiting
+    uint64_t rate_limited = 0;
+};
+
+class CanGatewayForwardedFrame
+{
+public:
+    // !\brief Time of forwarding
+    std::chrono::steady_clock::time_point time;
+
+    // !\brief Data length
+    uint8_t size = 0;
+
+    // !\brief Forwarded data
+    std::array<uint8_t, 8> data = {};
+};
+
+class CanGatewayRule
+{
+public:
+    // !\brief Does the Frame ID match?
+    bool Match(uint32_t frame_id) const { return (frame_id & id_mask) == id; }
+
+    // !\brief Frame ID after masking
+    uint32_t id = 0;
+
+    // !\brief Frame ID mask
+    uint32_t id_mask = 0x1FFFFFFF;
+
+    // !\brief Action
+    CanGatewayAction action = CGA_REWRITE;
+
+    // !\brief New Frame ID, bits of id_mask are replaced, the rest is kept from the received ID
+    uint32_t new_id = 0;
+
+    // !\brief Number of patched bytes
+    uint8_t patch_len = 0;
+
+    // !\brief Patch mask, bits set here are replaced
+    std::array<uint8_t, 8> patch_mask = {};
+
+    // !\brief Patch value
+    std::array<uint8_t, 8> patch_value = {};
+
+    // !\brief Maximum number of forwarded frames per second, 0 = unlimited
+    uint32_t max_rate = 0;
+
+    // !\brief Minimum time between forwarded frames, calculated from max_rate
+    std::chrono::nanoseconds interval{};
+
+    // !\brief Earliest time of the next forwarded frame, one interval of burst is tolerated for jitter of periodic frames
+    std::chrono::steady_clock::time_point next_allowed;
+
+    // !\brief Counters
+    CanGatewayCounters counters;
+};
+
+class CanGateway
+{
+public:
+    CanGateway();
+
+    // !\brief Set rules from settings string, entries separated by comma, first matching rule wins:
+    // !       ID[/MASK]:Drop - Don't forward
+    // !       ID[/MASK]:NEW_ID[:PATCH][:RATE] - Forward with new ID
+    // !       IDs, masks and patches are in hex, PATCH is MASK=VALUE of data bytes (eg. 00FF=0005), RATE is the maximum number of frames per second
+    // !       Eg. "7E0:Drop, 100/700:200:00FF=0001:100" forwards 1xx as 2xx with the second byte set to 1, at most 100 frames per second
+    // !       Frames are forwarded to the bus they were received on, so a rule has to change the ID, otherwise it would only duplicate the frame
+    // !\param str [in] Rules
+    // !\return False if any of the rules is invalid, the valid ones are set
+    bool SetRulesFromString(const std::string& str);
+
+    // !\brief Get rules as settings string
+    std::string GetRulesAsString();
+
+    // !\brief Enable or disable gateway
+    void SetEnabled(bool is_enabled) { m_IsEnabled = is_enabled; }
+
+    // !\brief Is gateway enabled?
+    bool IsEnabled() const { return m_IsEnabled; }
+
+    // !\brief Process received frame, called from the RX dispatch path, echoes of forwarded frames aren't forwarded again
+    // !\param frame_id [in] CAN Frame ID, it's replaced with the forwarded ID
+    // !\param data [in] Frame data, it's replaced with the forwarded data
+    // !\param size [in] Frame data length
+    // !\param now [in] Time of reception
+    // !\return True if the frame has to be forwarded
+    bool Process(uint32_t& frame_id, uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Get counters of rules, in rule order
+    std::vector<CanGatewayCounters> GetCounters();
+
+    // !\brief Reset counters of rules
+    void ResetCounters();
+
+    // !\brief Get number of received echoes of forwarded frames, which weren't forwarded again
+    uint64_t GetEchoCount();
+
+private:
+    // !\brief Find first matching rule without the lookup tables
+    uint16_t FindRule(uint32_t frame_id) const;
+
+    // !\brief Build lookup tables from m_Rules
+    void Compile();
+
+    // !\brief Is the frame an echo of a forwarded one? The matching forwarded frame is forgotten
+    bool IsEcho(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Convert rule to settings format
+    static std::string RuleToString(const CanGatewayRule& rule);
+
+    // !\brief Is gateway enabled?
+    std::atomic<bool> m_IsEnabled = false;
+
+    // !\brief Rules
+    std::vector<CanGatewayRule> m_Rules;
+
+    // !\brief Index of matching rule of standard IDs
+    std::array<uint16_t, CAN_GATEWAY_STD_IDS> m_StdRules;
+
+    // !\brief Index of matching rule of extended IDs [frame_id] = rule index
+    std::unordered_map<uint32_t, uint16_t> m_ExtRules;
+
+    // !\brief Frames forwarded in the last CAN_GATEWAY_ECHO_TIMEOUT [frame_id] = frames in order of forwarding
+    std::unordered_map<uint32_t, std::deque<CanGatewayForwardedFrame>> m_Forwarded;
+
+    // !\brief Number of frames in m_Forwarded
+    size_t m_ForwardedCnt = 0;
+
+    // !\brief Number of received echoes
+    uint64_t m_EchoCnt = 0;
+
+    // !\brief Mutex for rules and counters
+    std::mutex m_Mutex;
+};
@@ -0,0 +1,193 @@
+#include "pch.hpp"
+
+static bool ParseFilterNumber(std::string_view text, uint32_t& value, int base)
+{
+    if(text.starts_with("0x") || text.starts_with("0X"))
+    {
+        text.remove_prefix(2);
+        base = 16;
+    }
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool CanLogFilter::Compile(const std::string& pattern, std::string& error)
+{
+    *this = CanLogFilter{};
+    std::vector<std::string> comment_words;
+    bool is_id_list = true;
+    size_t pos = 0;
+    while(pos < pattern.size())
+    {
+        if(std::isspace(static_cast<unsigned char>(pattern[pos])))
+        {
+            pos++;
+            continue;
+        }
+
+        if(pattern[pos] == '"')
+        {
+            size_t end = pattern.find('"', pos + 1);
+            if(end == std::string::npos)
+            {
+                error = "Missing closing quote";
+                return false;
+            }
+            comment_words.push_back(pattern.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+            continue;
+        }
+
+        size_t end = std::min(pattern.find_first_of(" \t", pos), pattern.size());
+        std::string_view word = std::string_view(pattern).substr(pos, end - pos);
+        pos = end;
+
+        if(boost::iequals(word, "tx") || boost::iequals(word, "rx"))
+        {
+            uint8_t direction = boost::iequals(word, "tx") ? 0 : 1;
+            if(m_Direction.has_value() && *m_Direction != direction)
+                m_Direction.reset();  /* Both of them are given */
+            else
+                m_Direction = direction;
+            m_IsEmpty = false;
+            continue;
+        }
+
+        if(word.starts_with('['))  /* [n]==value or [n]&mask==value */
+        {
+            CanLogDataPredicate predicate;
+            size_t close = word.find(']');
+            size_t eq = word.find("==");
+            uint32_t index = 0, mask = 0xFF, value = 0;
+            std::string_view mask_str = close < eq ? word.substr(close + 1, eq - close - 1) : std::string_view();
+            if(close == std::string_view::npos || eq == std::string_view::npos || eq < close || !ParseFilterNumber(word.substr(1, close - 1), index, 10) ||
+                (!mask_str.empty() && (!mask_str.starts_with('&') || !ParseFilterNumber(mask_str.substr(1), mask, 10))) ||
+                !ParseFilterNumber(word.substr(eq + 2), value, 10) || index > 63 || mask > 0xFF || value > 0xFF)
+            {
+                error = std::format("Invalid data filter: {}, use [index]==value or [index]&mask==value", word);
+                return false;
+            }
+            predicate.index = static_cast<uint8_t>(index);
+            predicate.mask = static_cast<uint8_t>(mask);
+            predicate.value = static_cast<uint8_t>(value & mask);
+            m_Data.push_back(predicate);
+            m_IsEmpty = false;
+            continue;
+        }
+
+        /* Only prefixed words are Frame IDs, so comment text like "ABS" or "123" is still searched in comments */
+        bool is_id = word.size() > 3 && boost::istarts_with(word, "id:");
+        std::string_view id_str = is_id ? word.substr(3) : word;
+        uint32_t first = 0, last = 0;
+        size_t dash = id_str.find('-');
+        bool is_range = dash != std::string_view::npos;
+        bool is_valid_id = ParseFilterNumber(id_str.substr(0, dash), first, 16) && (!is_range || ParseFilterNumber(id_str.substr(dash + 1), last, 16)) &&
+            first <= 0x1FFFFFFF && (!is_range || (first <= last && last <= 0x1FFFFFFF));
+        if(is_id && !is_valid_id)
+        {
+            error = std::format("Invalid Frame ID filter: {}, use id:123, id:100-1FF or 0x123", word);
+            return false;
+        }
+
+        if(is_valid_id && (is_id || word.starts_with("0x") || word.starts_with("0X")))
+        {
+            if(!is_range)
+            {
+                last = first;
+                m_IdList.push_back(first);
+            }
+            else
+            {
+                is_id_list = false;
+            }
+
+            for(uint32_t id = first; id <= std::min<uint32_t>(last, CAN_LOG_FILTER_STD_IDS - 1); id++)
+                m_StdIds.set(id);
+
+            if(last >= CAN_LOG_FILTER_STD_IDS)
+            {
+                uint32_t ext_first = std::max<uint32_t>(first, CAN_LOG_FILTER_STD_IDS);
+                if(ext_first == last)
+                    m_ExtIds.insert(last);
+                else
+                    m_ExtRanges.push_back({ ext_first, last });
+            }
+            m_HasIdTerms = true;
+            m_IsEmpty = false;
+            continue;
+        }
+
+        comment_words.push_back(std::string(word));
+    }
+
+    m_Comment = boost::algorithm::join(comment_words, " ");  /* Text with spaces is searched as one */
+    if(!m_Comment.empty())
+    {
+        m_HasIdTerms = true;
+        m_IsEmpty = false;
+        is_id_list = false;
+    }
+
+    if(!is_id_list)
+        m_IdList.clear();
+    return true;
+}
+
+bool CanLogFilter::Match(uint32_t frame_id, uint8_t direction, const uint8_t* data, size_t size, const CanLogCommentProvider& get_comment)
+{
+    if(m_IsEmpty)
+        return true;
+
+    if(m_Direction.has_value() && *m_Direction != direction)
+        return false;
+
+    for(const CanLogDataPredicate& predicate : m_Data)
+    {
+        if(predicate.index >= size || (data[predicate.index] & predicate.mask) != predicate.value)
+            return false;
+    }
+
+    if(!m_HasIdTerms)
+        return true;
+
+    uint8_t dir = direction & 1;
+    if(frame_id < CAN_LOG_FILTER_STD_IDS)
+    {
+        if(!m_StdChecked[dir][frame_id])
+        {
+            m_StdChecked[dir].set(frame_id);
+            m_StdMatched[dir][frame_id] = MatchId(frame_id, dir, get_comment);
+        }
+        return m_StdMatched[dir][frame_id];
+    }
+
+    auto [it, is_inserted] = m_ExtMatched[dir].try_emplace(frame_id, false);
+    if(is_inserted)
+        it->second = MatchId(frame_id, dir, get_comment);
+    return it->second;
+}
+
+void CanLogFilter::InvalidateCache()
+{
+    for(uint8_t dir = 0; dir != 2; dir++)
+    {
+        m_StdChecked[dir].reset();
+        m_StdMatched[dir].reset();
+        m_ExtMatched[dir].clear();
+    }
+}
+
+bool CanLogFilter::MatchId(uint32_t frame_id, uint8_t direction, const CanLogCommentProvider& get_comment) const
+{
+    if(frame_id < CAN_LOG_FILTER_STD_IDS)
+    {
+        if(m_StdIds[frame_id])
+            return true;
+    }
+    else if(m_ExtIds.contains(frame_id) || std::any_of(m_ExtRanges.begin(), m_ExtRanges.end(), [frame_id](auto& r) { return frame_id >= r.first && frame_id <= r.second; }))
+    {
+        return true;
+    }
+
+    return !m_Comment.empty() && get_comment && boost::icontains(get_comment(frame_id, direction), m_Comment);
+}
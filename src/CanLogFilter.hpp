@@ -0,0 +1,102 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <bitset>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* Standard (11 bit) IDs are looked up in bitmaps, extended ones in hash sets */
+constexpr size_t CAN_LOG_FILTER_STD_IDS = 2048;
+
+class CanLogDataPredicate
+{
+public:
+    // !\brief Byte index
+    uint8_t index = 0;
+
+    // !\brief Mask applied to the byte
+    uint8_t mask = 0xFF;
+
+    // !\brief Expected value after masking
+    uint8_t value = 0;
+};
+
+/* Returns comment of a frame, parameters are Frame ID and direction */
+using CanLogCommentProvider = std::function<std::string(uint32_t, uint8_t)>;
+
+class CanLogFilter
+{
+public:
+    // !\brief Compile filter text
+    // !\details Terms are separated by whitespace:
+    // !         id:123, 0x123 - Frame ID (hex), id:100-1FF, 0x100-1FF - Frame ID range, words without prefix are comment text
+    // !         tx, rx - Direction
+    // !         [2]==0x05, [2]&0x0F==5 - Data byte
+    // !         Everything else is searched in the comment of the frame, "quoted text" is always a comment
+    // !         Frame IDs and comment are alternatives, direction and data bytes have to match too
+    // !\param pattern [in] Filter text
+    // !\param error [out] Error message
+    // !\return False if the filter text is invalid
+    bool Compile(const std::string& pattern, std::string& error);
+
+    // !\brief Is the filter empty, so every frame matches?
+    bool IsEmpty() const { return m_IsEmpty; }
+
+    // !\brief Does the frame match the filter?
+    // !\param frame_id [in] CAN Frame ID
+    // !\param direction [in] Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length
+    // !\param get_comment [in] Called only once per Frame ID and direction, the result is cached
+    bool Match(uint32_t frame_id, uint8_t direction, const uint8_t* data, size_t size, const CanLogCommentProvider& get_comment);
+
+    // !\brief Frame IDs which can match, empty if the filter isn't restricted to a list of IDs (ranges or comment are used)
+    const std::vector<uint32_t>& GetIdList() const { return m_IdList; }
+
+    // !\brief Forget cached ID matches, has to be called when comments are changed
+    void InvalidateCache();
+
+private:
+    // !\brief Evaluate Frame ID terms without cache
+    bool MatchId(uint32_t frame_id, uint8_t direction, const CanLogCommentProvider& get_comment) const;
+
+    // !\brief Is the filter empty?
+    bool m_IsEmpty = true;
+
+    // !\brief Are there Frame ID or comment terms?
+    bool m_HasIdTerms = false;
+
+    // !\brief Direction filter, empty = both
+    std::optional<uint8_t> m_Direction;
+
+    // !\brief Standard Frame IDs given in the filter
+    std::bitset<CAN_LOG_FILTER_STD_IDS> m_StdIds;
+
+    // !\brief Extended Frame IDs given in the filter
+    std::unordered_set<uint32_t> m_ExtIds;
+
+    // !\brief Extended Frame ID ranges given in the filter [first, last]
+    std::vector<std::pair<uint32_t, uint32_t>> m_ExtRanges;
+
+    // !\brief Frame IDs given one by one, used for building the view from the per-ID index
+    std::vector<uint32_t> m_IdList;
+
+    // !\brief Text searched in comments, case insensitive
+    std::string m_Comment;
+
+    // !\brief Data byte predicates
+    std::vector<CanLogDataPredicate> m_Data;
+
+    // !\brief Cached ID matches of standard IDs by direction
+    std::array<std::bitset<CAN_LOG_FILTER_STD_IDS>, 2> m_StdChecked;
+    std::array<std::bitset<CAN_LOG_FILTER_STD_IDS>, 2> m_StdMatched;
+
+    // !\brief Cached ID matches of extended IDs by direction [frame_id] = is matched
+    std::array<std::unordered_map<uint32_t, bool>, 2> m_ExtMatched;
+};
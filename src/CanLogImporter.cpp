@@ -0,0 +1,376 @@
+#include "pch.hpp"
+
+/* Candump prints extended IDs with 8 digits, error frames have CAN_ERR_FLAG set in the ID */
+constexpr uint32_t CAN_LOG_IMPORT_CANDUMP_ERR_FLAG = 0x20000000;
+constexpr uint32_t CAN_LOG_IMPORT_EXT_ID_MASK = 0x1FFFFFFF;
+
+/* Timestamps are stored in microseconds */
+constexpr uint8_t CAN_LOG_IMPORT_TIME_DIGITS = 6;
+
+static inline void SkipSpaces(std::string_view& str)
+{
+    size_t n = 0;
+    while(n < str.length() && (str[n] == ' ' || str[n] == '\t'))
+        n++;
+    str.remove_prefix(n);
+}
+
+/* Take next whitespace separated token */
+static inline std::string_view NextToken(std::string_view& str)
+{
+    SkipSpaces(str);
+    size_t n = 0;
+    while(n < str.length() && str[n] != ' ' && str[n] != '\t')
+        n++;
+    std::string_view token = str.substr(0, n);
+    str.remove_prefix(n);
+    return token;
+}
+
+/* Value of hex digits by character, -1 for everything else */
+static constexpr std::array<int8_t, 256> s_HexDigits = []()
+{
+    std::array<int8_t, 256> ret{};
+    ret.fill(-1);
+    for(int i = 0; i != 10; i++)
+        ret['0' + i] = static_cast<int8_t>(i);
+    for(int i = 0; i != 6; i++)
+    {
+        ret['a' + i] = static_cast<int8_t>(10 + i);
+        ret['A' + i] = static_cast<int8_t>(10 + i);
+    }
+    return ret;
+}();
+
+static inline int HexDigit(char c)
+{
+    return s_HexDigits[static_cast<uint8_t>(c)];
+}
+
+/* Parse whole token as hex or decimal number */
+static inline bool ParseNumber(std::string_view str, uint32_t& value, bool is_hex)
+{
+    if(str.empty() || str.length() > (is_hex ? 8 : 10))
+        return false;
+
+    uint64_t ret = 0;
+    for(char c : str)
+    {
+        int digit = is_hex ? HexDigit(c) : (c >= '0' && c <= '9' ? c - '0' : -1);
+        if(digit < 0)
+            return false;
+        ret = ret * (is_hex ? 16 : 10) + digit;
+    }
+    if(ret > std::numeric_limits<uint32_t>::max())
+        return false;
+    value = static_cast<uint32_t>(ret);
+    return true;
+}
+
+/* Parse "seconds.fraction" into microseconds without going through floating point, extra fraction digits are truncated */
+static inline bool ParseTimestamp(std::string_view str, uint64_t& timestamp)
+{
+    uint64_t seconds = 0;
+    size_t n = 0;
+    for(; n < str.length() && str[n] >= '0' && str[n] <= '9'; n++)
+        seconds = seconds * 10 + (str[n] - '0');
+    if(n == 0 || n > 12)
+        return false;
+
+    uint64_t fraction = 0;
+    uint8_t digits = 0;
+    if(n < str.length() && str[n] == '.')
+    {
+        for(n++; n < str.length() && str[n] >= '0' && str[n] <= '9'; n++)
+        {
+            if(digits < CAN_LOG_IMPORT_TIME_DIGITS)
+            {
+                fraction = fraction * 10 + (str[n] - '0');
+                digits++;
+            }
+        }
+    }
+    if(n != str.length())
+        return false;
+
+    for(; digits < CAN_LOG_IMPORT_TIME_DIGITS; digits++)
+        fraction *= 10;
+    timestamp = seconds * 1000000 + fraction;
+    return true;
+}
+
+CanLogImportFormat CanLogImporter::DetectFormat(const std::filesystem::path& path, std::string_view first_line)
+{
+    std::string extension = path.extension().string();
+    if(boost::iequals(extension, ".asc"))
+        return CLIF_ASC;
+    if(boost::iequals(extension, ".log"))
+        return CLIF_CANDUMP;
+
+    SkipSpaces(first_line);
+    if(first_line.starts_with('('))
+        return CLIF_CANDUMP;
+    if(first_line.starts_with("date") || first_line.starts_with("base") || first_line.starts_with("Begin") || first_line.starts_with("//"))
+        return CLIF_ASC;
+    return CLIF_UNKNOWN;
+}
+
+void CanLogImporter::Reset(CanLogImportFormat format)
+{
+    m_Format = format;
+    m_FirstTimestamp = 0;
+    m_HasFirstTimestamp = false;
+    m_IsHex = true;
+    m_IsRelative = false;
+    m_LastTimestamp = 0;
+}
+
+CanLogImportLineType CanLogImporter::ParseLine(std::string_view line, CanRecordingFrame& frame)
+{
+    if(!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    switch(m_Format)
+    {
+        case CLIF_CANDUMP:
+            return ParseCandumpLine(line, frame);
+        case CLIF_ASC:
+            return ParseAscLine(line, frame);
+        default:
+            return CLIL_INVALID;
+    }
+}
+
+CanLogImportLineType CanLogImporter::ParseCandumpLine(std::string_view line, CanRecordingFrame& frame)
+{
+    SkipSpaces(line);
+    if(line.empty())
+        return CLIL_IGNORED;
+
+    size_t close = line.find(')');
+    if(line.front() != '(' || close == std::string_view::npos)
+        return CLIL_INVALID;
+
+    uint64_t timestamp = 0;
+    if(!ParseTimestamp(line.substr(1, close - 1), timestamp))
+        return CLIL_INVALID;
+    line.remove_prefix(close + 1);
+
+    NextToken(line);  /* Interface */
+    std::string_view can_frame = NextToken(line);
+    std::string_view flags = NextToken(line);  /* Optional direction (T/R) of newer candump versions */
+
+    size_t hash = can_frame.find('#');
+    if(hash == std::string_view::npos)
+        return CLIL_INVALID;
+
+    std::string_view id_str = can_frame.substr(0, hash);
+    std::string_view data_str = can_frame.substr(hash + 1);
+    uint32_t frame_id = 0;
+    if((id_str.length() != 3 && id_str.length() != 8) || !ParseNumber(id_str, frame_id, true))
+        return CLIL_INVALID;
+    if(frame_id & CAN_LOG_IMPORT_CANDUMP_ERR_FLAG)
+        return CLIL_UNSUPPORTED;
+    if(data_str.starts_with('#') || data_str.starts_with('R') || data_str.starts_with('r'))  /* CAN FD or remote frame */
+        return CLIL_UNSUPPORTED;
+
+    frame.data.fill(0);
+    uint8_t size = 0;
+    for(size_t i = 0; i < data_str.length(); )
+    {
+        if(data_str[i] == '.')  /* Byte separator of candump -L with -S */
+        {
+            i++;
+            continue;
+        }
+
+        int high = HexDigit(data_str[i]);
+        int low = i + 1 < data_str.length() ? HexDigit(data_str[i + 1]) : -1;
+        if(high < 0 || low < 0)
+            return CLIL_INVALID;
+        if(size == frame.data.size())
+            return CLIL_UNSUPPORTED;
+        frame.data[size++] = static_cast<uint8_t>((high << 4) | low);
+        i += 2;
+    }
+
+    if(!m_HasFirstTimestamp)
+    {
+        m_FirstTimestamp = timestamp;
+        m_HasFirstTimestamp = true;
+    }
+    frame.timestamp = timestamp >= m_FirstTimestamp ? timestamp - m_FirstTimestamp : 0;
+    frame.frame_id = frame_id & CAN_LOG_IMPORT_EXT_ID_MASK;
+    frame.direction = flags == "T" ? CAN_LOG_DIR_TX : CAN_LOG_DIR_RX;
+    frame.size = size;
+    return CLIL_FRAME;
+}
+
+CanLogImportLineType CanLogImporter::ParseAscLine(std::string_view line, CanRecordingFrame& frame)
+{
+    SkipSpaces(line);
+    if(line.empty())
+        return CLIL_IGNORED;
+
+    if(line.front() < '0' || line.front() > '9')  /* Header, eg. "base hex  timestamps absolute" */
+    {
+        std::string_view keyword = NextToken(line);
+        if(keyword == "base")
+        {
+            m_IsHex = NextToken(line) != "dec";
+            if(NextToken(line) == "timestamps")
+                m_IsRelative = NextToken(line) == "relative";
+        }
+        return CLIL_IGNORED;
+    }
+
+    uint64_t timestamp = 0;
+    if(!ParseTimestamp(NextToken(line), timestamp))
+        return CLIL_INVALID;
+    if(m_IsRelative)
+        timestamp += m_LastTimestamp;
+    m_LastTimestamp = timestamp;
+
+    std::string_view channel = NextToken(line);
+    if(channel == "CANFD")
+        return CLIL_UNSUPPORTED;
+
+    uint32_t channel_num = 0;
+    if(!ParseNumber(channel, channel_num, false))  /* Events like "Start of measurement" */
+        return CLIL_IGNORED;
+
+    std::string_view id_str = NextToken(line);
+    if(id_str == "ErrorFrame")
+        return CLIL_UNSUPPORTED;
+
+    if(id_str.ends_with('x'))  /* Extended ID */
+        id_str.remove_suffix(1);
+
+    uint32_t frame_id = 0;
+    if(!ParseNumber(id_str, frame_id, m_IsHex))  /* Status events, eg. "Statistic:" */
+        return CLIL_IGNORED;
+
+    std::string_view dir = NextToken(line);
+    if(dir != "Rx" && dir != "Tx")
+        return dir == "TxRq" ? CLIL_IGNORED : CLIL_INVALID;
+
+    std::string_view type = NextToken(line);
+    if(type == "r" || type == "R")
+        return CLIL_UNSUPPORTED;
+    if(type != "d" && type != "D")
+        return CLIL_INVALID;
+
+    uint32_t dlc = 0;
+    if(!ParseNumber(NextToken(line), dlc, true))
+        return CLIL_INVALID;
+
+    frame.data.fill(0);
+    frame.size = static_cast<uint8_t>(std::min<uint32_t>(dlc, static_cast<uint32_t>(frame.data.size())));  /* DLC 9-15 means 8 bytes in classic CAN */
+    for(uint8_t i = 0; i != frame.size; i++)
+    {
+        uint32_t byte = 0;
+        if(!ParseNumber(NextToken(line), byte, m_IsHex) || byte > 0xFF)
+            return CLIL_INVALID;
+        frame.data[i] = static_cast<uint8_t>(byte);
+    }
+
+    frame.timestamp = timestamp;
+    frame.frame_id = frame_id & CAN_LOG_IMPORT_EXT_ID_MASK;
+    frame.direction = dir == "Tx" ? CAN_LOG_DIR_TX : CAN_LOG_DIR_RX;
+    return CLIL_FRAME;
+}
+
+bool CanLogImporter::Import(const std::filesystem::path& path, const CanLogImportCallback& callback, CanLogImportResult& result)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open())
+    {
+        LOG(LogLevel::Error, "Failed to open file for import: {}", path.generic_string());
+        return false;
+    }
+
+    Reset(CLIF_UNKNOWN);
+    std::vector<char> buffer(CAN_LOG_IMPORT_BUFFER_SIZE);
+    std::vector<CanRecordingFrame> frames;
+    frames.reserve(CAN_LOG_IMPORT_BATCH_SIZE);
+    size_t used = 0;
+    bool is_eof = false;
+    while(!is_eof)
+    {
+        in.read(buffer.data() + used, buffer.size() - used);
+        size_t end = used + static_cast<size_t>(in.gcount());
+        result.bytes += static_cast<uint64_t>(in.gcount());
+        is_eof = !in;
+
+        std::string_view data(buffer.data(), end);
+        if(m_Format == CLIF_UNKNOWN)
+        {
+            std::string_view first_line;
+            for(size_t line_start = 0; line_start < end; )  /* First non-empty line */
+            {
+                size_t newline = data.find('\n', line_start);
+                first_line = data.substr(line_start, newline == std::string_view::npos ? std::string_view::npos : newline - line_start);
+                if(first_line.find_first_not_of(" \t\r") != std::string_view::npos || newline == std::string_view::npos)
+                    break;
+                line_start = newline + 1;
+            }
+
+            Reset(DetectFormat(path, first_line));
+            if(m_Format == CLIF_UNKNOWN)
+            {
+                LOG(LogLevel::Error, "Unknown log format: {}, expected candump (.log) or Vector ASC (.asc)", path.generic_string());
+                return false;
+            }
+        }
+
+        size_t pos = 0;
+        while(pos < end)
+        {
+            size_t newline = data.find('\n', pos);
+            if(newline == std::string_view::npos && !is_eof)  /* Incomplete line, it's completed by the next read */
+                break;
+
+            size_t line_end = newline == std::string_view::npos ? end : newline;
+            CanRecordingFrame frame;
+            switch(ParseLine(data.substr(pos, line_end - pos), frame))
+            {
+                case CLIL_FRAME:
+                {
+                    frames.push_back(frame);
+                    result.frames++;
+                    if(frames.size() == CAN_LOG_IMPORT_BATCH_SIZE)
+                    {
+                        if(!callback(frames))
+                            return false;
+                        frames.clear();
+                    }
+                    break;
+                }
+                case CLIL_UNSUPPORTED:
+                    result.unsupported_frames++;
+                    break;
+                case CLIL_INVALID:
+                    result.invalid_lines++;
+                    break;
+                default:
+                    break;
+            }
+            pos = line_end + 1;
+        }
+
+        used = pos < end ? end - pos : 0;
+        if(used == buffer.size())  /* Line doesn't fit into the buffer, it can't be a frame */
+        {
+            result.invalid_lines++;
+            used = 0;
+        }
+        else if(used)
+        {
+            std::memmove(buffer.data(), buffer.data() + pos, used);
+        }
+    }
+
+    if(!frames.empty() && !callback(frames))
+        return false;
+    return true;
+}
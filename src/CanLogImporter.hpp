@@ -0,0 +1,97 @@
+#pragma once
+
+#include <inttypes.h>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+/* Size of a file read at once, lines are parsed directly from this buffer */
+constexpr size_t CAN_LOG_IMPORT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+/* Number of frames passed to the callback at once */
+constexpr size_t CAN_LOG_IMPORT_BATCH_SIZE = 4096;
+
+enum CanLogImportFormat : uint8_t
+{
+    CLIF_UNKNOWN,
+    CLIF_CANDUMP,  /* SocketCAN candump -l: (1436509052.249713) can0 123#11223344 */
+    CLIF_ASC       /* Vector ASC: 0.001234 1  123  Rx   d 8 01 02 03 04 05 06 07 08 */
+};
+
+enum CanLogImportLineType : uint8_t
+{
+    CLIL_FRAME,        /* Frame parsed */
+    CLIL_IGNORED,      /* Header, comment or event which isn't a frame */
+    CLIL_UNSUPPORTED,  /* Error, remote or CAN FD frame, these can't be stored in the recording */
+    CLIL_INVALID       /* Malformed line */
+};
+
+class CanLogImportResult
+{
+public:
+    // !\brief Number of imported frames
+    uint64_t frames = 0;
+
+    // !\brief Number of error, remote and CAN FD frames which were skipped
+    uint64_t unsupported_frames = 0;
+
+    // !\brief Number of malformed lines
+    uint64_t invalid_lines = 0;
+
+    // !\brief Number of bytes read
+    uint64_t bytes = 0;
+};
+
+/* Receives a batch of imported frames in file order, returns false to abort the import */
+using CanLogImportCallback = std::function<bool(const std::vector<CanRecordingFrame>&)>;
+
+class CanLogImporter
+{
+public:
+    // !\brief Detect format from file extension (.log, .asc) or the first line of the file
+    // !\param path [in] File path
+    // !\param first_line [in] First non-empty line of the file
+    static CanLogImportFormat DetectFormat(const std::filesystem::path& path, std::string_view first_line);
+
+    // !\brief Import file, it's read in blocks so the file size isn't limited by the memory
+    // !\param path [in] File path
+    // !\param callback [in] Called with batches of frames
+    // !\param result [out] Number of imported and skipped frames
+    // !\return False if the file can't be read, the format is unknown or the callback aborted the import
+    bool Import(const std::filesystem::path& path, const CanLogImportCallback& callback, CanLogImportResult& result);
+
+    // !\brief Start parsing a new file
+    // !\param format [in] Format of the file
+    void Reset(CanLogImportFormat format);
+
+    // !\brief Parse line, header lines of ASC change the number base and timestamp mode
+    // !\param line [in] Line without newline
+    // !\param frame [out] Parsed frame, timestamp is relative to the first frame (candump) or the start of measurement (ASC)
+    CanLogImportLineType ParseLine(std::string_view line, CanRecordingFrame& frame);
+
+private:
+    // !\brief Parse candump line
+    CanLogImportLineType ParseCandumpLine(std::string_view line, CanRecordingFrame& frame);
+
+    // !\brief Parse ASC line
+    CanLogImportLineType ParseAscLine(std::string_view line, CanRecordingFrame& frame);
+
+    // !\brief Format of the file
+    CanLogImportFormat m_Format = CLIF_UNKNOWN;
+
+    // !\brief Timestamp of the first candump frame, candump timestamps are absolute
+    uint64_t m_FirstTimestamp = 0;
+
+    // !\brief Has the first candump frame been seen?
+    bool m_HasFirstTimestamp = false;
+
+    // !\brief Are ASC IDs and data in hex? ("base hex" or "base dec" in header)
+    bool m_IsHex = true;
+
+    // !\brief Are ASC timestamps relative to the previous event? ("timestamps relative" in header)
+    bool m_IsRelative = false;
+
+    // !\brief Timestamp of the previous ASC event
+    uint64_t m_LastTimestamp = 0;
+};
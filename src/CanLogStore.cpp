@@ -0,0 +1,76 @@
+#include "pch.hpp"
+
+CanLogStore::CanLogStore() = default;
+
+CanLogStore::~CanLogStore() = default;
+
+bool CanLogStore::Add(uint8_t dir, uint32_t frame_id, uint8_t* data, uint8_t data_len, std::chrono::steady_clock::time_point& timepoint)
+{
+    size_t offset = m_Size.load(std::memory_order_relaxed);
+    size_t chunk = offset / CAN_LOG_CHUNK_SIZE;
+    if(chunk == CAN_LOG_MAX_CHUNKS)
+        return false;
+
+    if(!m_Chunks)
+        m_Chunks = std::make_unique<std::unique_ptr<CanLogChunk>[]>(CAN_LOG_MAX_CHUNKS);
+    if(!m_Chunks[chunk])
+        m_Chunks[chunk] = std::make_unique<CanLogChunk>();
+
+    std::unique_ptr<CanLogEntry>& entry = (*m_Chunks[chunk])[offset % CAN_LOG_CHUNK_SIZE];
+    entry = std::make_unique<CanLogEntry>(dir, frame_id, data, data_len, timepoint);
+    m_Index[entry->frame_id].push_back(static_cast<uint32_t>(offset));
+    m_Size.store(offset + 1, std::memory_order_release);  /* Publish the frame to readers */
+    return true;
+}
+
+void CanLogStore::Clear()
+{
+    m_Size = 0;
+    m_Chunks.reset();
+    m_Index.clear();
+}
+
+const CanLogOffsets& CanLogStore::FindOffsets(uint32_t frame_id) const
+{
+    static const CanLogOffsets empty_offsets;
+    auto it = m_Index.find(frame_id);
+    return it != m_Index.end() ? it->second : empty_offsets;
+}
+
+CanLogOffsets CanLogStore::GetOffsetsForFrame(uint32_t frame_id) const
+{
+    return FindOffsets(frame_id);
+}
+
+size_t CanLogStore::GetCountForFrame(uint32_t frame_id) const
+{
+    return FindOffsets(frame_id).size();
+}
+
+CanLogOffsets CanLogStore::GetTimeRangeForFrame(uint32_t frame_id, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) const
+{
+    const CanLogOffsets& offsets = FindOffsets(frame_id);
+    auto first = std::lower_bound(offsets.begin(), offsets.end(), from, [this](uint32_t offset, const std::chrono::steady_clock::time_point& t)
+        { return (*this)[offset].last_execution < t; });
+    auto last = std::lower_bound(first, offsets.end(), to, [this](uint32_t offset, const std::chrono::steady_clock::time_point& t)
+        { return (*this)[offset].last_execution < t; });
+    return CanLogOffsets(first, last);
+}
+
+std::optional<size_t> CanLogStore::FindNext(uint32_t frame_id, size_t offset) const
+{
+    const CanLogOffsets& offsets = FindOffsets(frame_id);
+    auto it = std::upper_bound(offsets.begin(), offsets.end(), offset, [](size_t value, uint32_t element) { return value < element; });
+    if(it == offsets.end())
+        return {};
+    return *it;
+}
+
+std::optional<size_t> CanLogStore::FindPrevious(uint32_t frame_id, size_t offset) const
+{
+    const CanLogOffsets& offsets = FindOffsets(frame_id);
+    auto it = std::lower_bound(offsets.begin(), offsets.end(), offset, [](uint32_t element, size_t value) { return element < value; });
+    if(it == offsets.begin())
+        return {};
+    return *std::prev(it);
+}
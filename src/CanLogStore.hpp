@@ -0,0 +1,130 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CanEntryBase
+{
+public:
+    CanEntryBase() = default;
+    CanEntryBase(uint8_t* data_, uint8_t data_len)
+    {
+        if(data_ && data_len)
+            data.insert(data.end(), data_, data_ + data_len);
+    }
+
+    CanEntryBase(const CanEntryBase& from) :
+        data(from.data)
+    {
+
+    }
+    std::vector<uint8_t> data{};
+    std::chrono::steady_clock::time_point last_execution;
+};
+
+class CanLogEntry : public CanEntryBase
+{
+public:
+    CanLogEntry(uint8_t dir, uint32_t frame_id_, uint8_t* data_, uint8_t data_len, std::chrono::steady_clock::time_point& timepoint) :
+        CanEntryBase(data_, data_len)
+    {
+        frame_id = frame_id_ & 0x1FFFFFFF;
+        direction = dir & 1;
+        last_execution = timepoint;
+    }
+    union
+    {
+        uint32_t frame_id_and_direction = 0;
+        struct
+        {
+            uint32_t frame_id : 29;
+            uint8_t direction : 1;  /* 0 = sent, 1 = received */
+        };
+    };
+};
+
+/* Offsets into the log are 32 bit to halve the memory used by the index, it's enough for 4 billion frames */
+using CanLogOffsets = std::vector<uint32_t>;
+
+/* Frames are stored in fixed size chunks, so appending never moves the already logged frames and the GUI can read them while new ones arrive */
+constexpr size_t CAN_LOG_CHUNK_SIZE = 65536;
+constexpr size_t CAN_LOG_MAX_CHUNKS = 65536;
+
+using CanLogChunk = std::array<std::unique_ptr<CanLogEntry>, CAN_LOG_CHUNK_SIZE>;
+
+class CanLogStore
+{
+public:
+    CanLogStore();
+    ~CanLogStore();
+
+    // !\brief Append frame to the log and to the index of it's Frame ID
+    // !\param dir [in] Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    // !\param frame_id [in] CAN Frame ID
+    // !\param data [in] Frame data
+    // !\param data_len [in] Frame data length
+    // !\param timepoint [in] Time of the frame, frames of the same ID have to be appended in time order
+    // !\return False if the log is full
+    bool Add(uint8_t dir, uint32_t frame_id, uint8_t* data, uint8_t data_len, std::chrono::steady_clock::time_point& timepoint);
+
+    // !\brief Remove every frame from the log, frames mustn't be read by other threads meanwhile
+    void Clear();
+
+    // !\brief Number of frames in the log, frames below this can be read from other threads without locking
+    // !\details Only the frames, the index is modified by Add, so it has to be read under the lock of the writer (CanEntryHandler::m)
+    size_t size() const { return m_Size.load(std::memory_order_acquire); }
+
+    // !\brief Is the log empty?
+    bool empty() const { return size() == 0; }
+
+    // !\brief Get frame at given offset
+    const CanLogEntry& operator[](size_t offset) const { return *(*m_Chunks[offset / CAN_LOG_CHUNK_SIZE])[offset % CAN_LOG_CHUNK_SIZE]; }
+
+    // !\brief Get offsets of every frame with given Frame ID in log order, called under the lock of the writer
+    // !\param frame_id [in] CAN Frame ID
+    // !\return Copy of the offsets, empty if the frame isn't in the log. The frames can be read after unlocking
+    CanLogOffsets GetOffsetsForFrame(uint32_t frame_id) const;
+
+    // !\brief Get number of logged frames with given Frame ID, called under the lock of the writer
+    size_t GetCountForFrame(uint32_t frame_id) const;
+
+    // !\brief Get offsets of frames with given Frame ID which were logged in [from, to), called under the lock of the writer
+    // !\param frame_id [in] CAN Frame ID
+    // !\param from [in] Start of the time range
+    // !\param to [in] End of the time range
+    // !\return Copy of the offsets
+    CanLogOffsets GetTimeRangeForFrame(uint32_t frame_id, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) const;
+
+    // !\brief Find next occurrence of Frame ID after given offset, called under the lock of the writer
+    // !\param frame_id [in] CAN Frame ID
+    // !\param offset [in] Offset to search from (exclusive)
+    // !\return Offset of the next occurrence, empty if there is no more
+    std::optional<size_t> FindNext(uint32_t frame_id, size_t offset) const;
+
+    // !\brief Find previous occurrence of Frame ID before given offset, called under the lock of the writer
+    // !\param frame_id [in] CAN Frame ID
+    // !\param offset [in] Offset to search from (exclusive)
+    // !\return Offset of the previous occurrence, empty if there is no more
+    std::optional<size_t> FindPrevious(uint32_t frame_id, size_t offset) const;
+
+private:
+    // !\brief Get offsets of given Frame ID in the index
+    // !\return Empty offsets if the frame isn't in the log, it's valid until the next Add or Clear
+    const CanLogOffsets& FindOffsets(uint32_t frame_id) const;
+
+    // !\brief Chunks of logged frames (both TX & RX), the table is allocated with the first frame
+    std::unique_ptr<std::unique_ptr<CanLogChunk>[]> m_Chunks;
+
+    // !\brief Number of logged frames
+    std::atomic<size_t> m_Size{};
+
+    // !\brief Offsets of frames by Frame ID [frame_id] = offsets
+    std::unordered_map<uint32_t, CanLogOffsets> m_Index;
+};
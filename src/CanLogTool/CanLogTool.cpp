@@ -0,0 +1,443 @@
+#include "pch.hpp"
+
+/* Append value to binary output in little endian */
+template <typename T> static void AppendLittle(std::string& out, T value)
+{
+    boost::endian::native_to_little_inplace(value);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendLittle(std::string& out, double value)
+{
+    AppendLittle(out, std::bit_cast<uint64_t>(value));
+}
+
+void CanIdStatistics::Add(uint64_t timestamp, uint8_t direction, uint8_t size)
+{
+    if(count == 0)
+    {
+        first_timestamp = timestamp;
+    }
+    else
+    {
+        uint64_t period = timestamp - last_timestamp;
+        min_period = std::min(min_period, period);
+        max_period = std::max(max_period, period);
+    }
+    last_timestamp = timestamp;
+    count++;
+    if(direction == CAN_LOG_DIR_TX)
+        tx_count++;
+    min_size = std::min(min_size, size);
+    max_size = std::max(max_size, size);
+}
+
+void CanIdStatistics::Merge(const CanIdStatistics& next)
+{
+    if(next.count == 0)
+        return;
+
+    if(count == 0)
+    {
+        *this = next;
+        return;
+    }
+
+    uint64_t gap = next.first_timestamp - last_timestamp;
+    min_period = std::min({ min_period, next.min_period, gap });
+    max_period = std::max({ max_period, next.max_period, gap });
+    last_timestamp = next.last_timestamp;
+    count += next.count;
+    tx_count += next.tx_count;
+    min_size = std::min(min_size, next.min_size);
+    max_size = std::max(max_size, next.max_size);
+}
+
+CanLogTool::CanLogTool(const CanLogToolOptions& options) :
+    m_Options(options)
+{
+    m_Options.threads = std::max<size_t>(m_Options.threads, 1);
+}
+
+bool CanLogTool::Run()
+{
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    if(!m_Options.mapping.empty() && !m_Decoder.LoadMapping(m_Options.mapping))
+        return false;
+
+    std::string error;
+    if(!m_Filter.Compile(m_Options.filter, error))
+    {
+        LOG(LogLevel::Error, "Invalid filter: {}", error);
+        return false;
+    }
+
+    if(!OpenInput() || !OpenOutputs())
+        return false;
+
+    m_Results.resize(m_ChunkCount);
+    std::vector<std::jthread> workers;
+    for(size_t i = 0; i != std::min(m_Options.threads, std::max<size_t>(m_ChunkCount, 1)); i++)
+        workers.emplace_back(&CanLogTool::WorkerThread, this);
+
+    bool ret = true;
+    for(; m_NextWrite != m_ChunkCount; )
+    {
+        std::unique_ptr<CanLogChunkResult> result;
+        {
+            std::unique_lock lock(m_Mutex);
+            m_Cv.wait(lock, [this] { return m_Results[m_NextWrite] != nullptr; });
+            result = std::move(m_Results[m_NextWrite]);
+        }
+
+        if(!result->is_ok)  /* Corrupted chunks are skipped, the rest is still worth analyzing */
+            ret = false;
+        bool is_written = WriteResult(*result);
+        if(!is_written)
+        {
+            LOG(LogLevel::Error, "Failed to write output");
+            ret = false;
+        }
+
+        {
+            std::scoped_lock lock(m_Mutex);
+            m_NextWrite++;
+            if(!is_written)  /* Workers stop after their current chunk */
+                m_ChunkCount = m_NextWrite;
+        }
+        m_Cv.notify_all();
+    }
+    workers.clear();
+
+    if(m_Writer && !m_Writer->Flush())
+    {
+        LOG(LogLevel::Error, "Failed to write output: {}", m_Options.output.generic_string());
+        ret = false;
+    }
+    if(ret && !m_Options.stats.empty())
+        ret = WriteStatistics();
+
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    int64_t dif = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+    LOG(LogLevel::Normal, "Processed {} frames ({} IDs) in {} ms with {} threads, {} frames written to sub-log", m_FrameCount, m_Stats.size(), dif,
+        m_Options.threads, m_OutputFrameCount);
+    return ret;
+}
+
+bool CanLogTool::OpenInput()
+{
+    m_IsCompressed = m_Options.input.extension() == CAN_RECORDING_EXTENSION;
+    try
+    {
+        if(m_IsCompressed)
+        {
+            std::ifstream in(m_Options.input, std::ios::binary);
+            CanRecordingReader reader(in);
+            if(!in.is_open() || !reader.ReadHeader() || !reader.ReadIndex(m_Blocks))
+            {
+                LOG(LogLevel::Error, "Failed to read compressed recording: {}", m_Options.input.generic_string());
+                return false;
+            }
+            m_ChunkCount = (m_Blocks.size() + CAN_LOG_TOOL_BLOCKS_PER_CHUNK - 1) / CAN_LOG_TOOL_BLOCKS_PER_CHUNK;
+        }
+        else
+        {
+            if(std::filesystem::file_size(m_Options.input) == 0)
+                return true;
+
+            m_CsvFile = boost::interprocess::file_mapping(m_Options.input.generic_string().c_str(), boost::interprocess::read_only);
+            m_CsvRegion = boost::interprocess::mapped_region(m_CsvFile, boost::interprocess::read_only);
+
+            /* Chunks are cut at line ends, so every worker parses whole lines */
+            const char* data = static_cast<const char*>(m_CsvRegion.get_address());
+            size_t size = m_CsvRegion.get_size();
+            m_CsvChunks.push_back(0);
+            while(m_CsvChunks.back() != size)
+            {
+                size_t end = std::min(m_CsvChunks.back() + CAN_LOG_TOOL_CSV_CHUNK_SIZE, size);
+                const char* newline = static_cast<const char*>(memchr(data + end, '\n', size - end));
+                m_CsvChunks.push_back(newline ? newline - data + 1 : size);
+            }
+            m_ChunkCount = m_CsvChunks.size() - 1;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Failed to open input: {}, exception: {}", m_Options.input.generic_string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool CanLogTool::OpenOutputs()
+{
+    if(!m_Options.signals.empty())
+    {
+        m_SignalsOut.open(m_Options.signals, std::ofstream::binary);
+        if(!m_SignalsOut.is_open())
+        {
+            LOG(LogLevel::Error, "Failed to open signal output: {}", m_Options.signals.generic_string());
+            return false;
+        }
+
+        if(m_Options.signal_format == CLT_SIGNALS_BINARY)
+        {
+            std::string header;
+            AppendLittle(header, CAN_LOG_TOOL_SIGNAL_MAGIC);
+            AppendLittle(header, CAN_LOG_TOOL_SIGNAL_VERSION);
+            AppendLittle(header, m_Decoder.GetSignalCount());
+            for(auto& [frame_id, frame] : m_Decoder.GetFrames())
+            {
+                for(auto& signal : frame.signals)
+                {
+                    AppendLittle(header, frame_id);
+                    AppendLittle(header, static_cast<uint16_t>(signal.name.length()));
+                    header += signal.name;
+                }
+            }
+            m_SignalsOut << header;
+        }
+        else
+        {
+            m_SignalsOut << "Time,FrameID,Frame,Signal,Value\n";
+        }
+    }
+
+    if(!m_Options.output.empty())
+    {
+        m_Out.open(m_Options.output, std::ofstream::binary);
+        if(!m_Out.is_open())
+        {
+            LOG(LogLevel::Error, "Failed to open output: {}", m_Options.output.generic_string());
+            return false;
+        }
+
+        if(m_Options.output.extension() == CAN_RECORDING_EXTENSION)
+            m_Writer = std::make_unique<CanRecordingWriter>(m_Out);
+        else
+            m_Out << "Time,Direction,FrameID,DataSize,Data,Comment\n";
+    }
+    return true;
+}
+
+void CanLogTool::WorkerThread()
+{
+    CanLogFilter filter = m_Filter;
+    std::ifstream in;
+    if(m_IsCompressed)
+        in.open(m_Options.input, std::ios::binary);
+
+    for(;;)
+    {
+        size_t index = 0;
+        {
+            std::unique_lock lock(m_Mutex);
+            m_Cv.wait(lock, [this] { return m_NextChunk >= m_ChunkCount || m_NextChunk < m_NextWrite + m_Options.threads * CAN_LOG_TOOL_CHUNKS_IN_FLIGHT; });
+            if(m_NextChunk >= m_ChunkCount)
+                break;
+            index = m_NextChunk++;
+        }
+
+        std::unique_ptr<CanLogChunkResult> result = std::make_unique<CanLogChunkResult>();
+        ProcessChunk(index, filter, in, *result);
+        {
+            std::scoped_lock lock(m_Mutex);
+            m_Results[index] = std::move(result);
+        }
+        m_Cv.notify_all();
+    }
+}
+
+void CanLogTool::ProcessChunk(size_t index, CanLogFilter& filter, std::ifstream& in, CanLogChunkResult& result)
+{
+    if(m_IsCompressed)
+    {
+        CanRecordingReader reader(in);
+        std::vector<CanRecordingFrame> frames;
+        size_t last = std::min((index + 1) * CAN_LOG_TOOL_BLOCKS_PER_CHUNK, m_Blocks.size());
+        for(size_t i = index * CAN_LOG_TOOL_BLOCKS_PER_CHUNK; i != last; i++)
+        {
+            frames.clear();
+            if(!reader.ReadBlock(m_Blocks[i], frames))
+            {
+                LOG(LogLevel::Error, "Corrupted block at offset {} in {}", m_Blocks[i].offset, m_Options.input.generic_string());
+                result.is_ok = false;
+                in.clear();
+                continue;
+            }
+
+            for(auto& frame : frames)
+                HandleFrame(frame, filter, result);
+        }
+    }
+    else
+    {
+        const char* data = static_cast<const char*>(m_CsvRegion.get_address());
+        std::string_view chunk(data + m_CsvChunks[index], m_CsvChunks[index + 1] - m_CsvChunks[index]);
+        while(!chunk.empty())
+        {
+            size_t newline = chunk.find('\n');
+            std::string_view line = chunk.substr(0, newline);
+            chunk.remove_prefix(newline == std::string_view::npos ? chunk.length() : newline + 1);
+
+            CanRecordingFrame frame;
+            if(ParseCsvLine(line, frame))
+                HandleFrame(frame, filter, result);
+        }
+    }
+}
+
+void CanLogTool::HandleFrame(const CanRecordingFrame& frame, CanLogFilter& filter, CanLogChunkResult& result)
+{
+    result.frame_count++;
+    if(!filter.IsEmpty() && !filter.Match(frame.frame_id, frame.direction, frame.data.data(), frame.size,
+        [this](uint32_t frame_id, uint8_t) { return GetFrameName(frame_id); }))
+        return;
+
+    result.stats[frame.frame_id].Add(frame.timestamp, frame.direction, frame.size);
+    if(!m_Options.output.empty())
+        result.frames.push_back(frame);
+
+    if(m_Options.signals.empty())
+        return;
+
+    const CanFrameDefinition* frame_def = m_Decoder.FindFrame(frame.frame_id);
+    if(!frame_def)
+        return;
+
+    for(auto& signal : frame_def->signals)
+    {
+        double value = 0.0;
+        if(!CanSignalDecoder::Decode(signal, frame.data.data(), frame.size, value))
+            continue;
+
+        if(m_Options.signal_format == CLT_SIGNALS_BINARY)
+        {
+            AppendLittle(result.signals, frame.timestamp);
+            AppendLittle(result.signals, signal.index);
+            AppendLittle(result.signals, value);
+        }
+        else
+        {
+            result.signals += std::format("{:.6f},{:X},{},{},{}\n", static_cast<double>(frame.timestamp) / 1000000.0, frame.frame_id, frame_def->name,
+                signal.name, value);
+        }
+    }
+}
+
+bool CanLogTool::WriteResult(CanLogChunkResult& result)
+{
+    m_FrameCount += result.frame_count;
+    for(auto& [frame_id, stats] : result.stats)
+        m_Stats[frame_id].Merge(stats);
+
+    if(m_SignalsOut.is_open())
+    {
+        m_SignalsOut.write(result.signals.data(), result.signals.size());
+        if(!m_SignalsOut)
+            return false;
+    }
+
+    if(m_Out.is_open())
+    {
+        m_OutputFrameCount += result.frames.size();
+        for(auto& frame : result.frames)
+        {
+            if(m_Writer)
+            {
+                if(!m_Writer->Add(frame))
+                    return false;
+            }
+            else
+            {
+                std::string hex;
+                for(uint8_t i = 0; i != frame.size; i++)
+                    hex += std::format("{:02X}{}", frame.data[i], i + 1 != frame.size ? " " : "");
+                m_Out << std::format("{:.3f},{},{:X},{},{},{}\n", static_cast<double>(frame.timestamp / 1000) / 1000.0, frame.direction == CAN_LOG_DIR_TX ? "TX" : "RX",
+                    frame.frame_id, frame.size, hex, GetFrameName(frame.frame_id));
+            }
+        }
+        if(!m_Out)
+            return false;
+    }
+    return true;
+}
+
+bool CanLogTool::WriteStatistics()
+{
+    std::ofstream file;
+    if(m_Options.stats != "-")
+    {
+        file.open(m_Options.stats, std::ofstream::binary);
+        if(!file.is_open())
+        {
+            LOG(LogLevel::Error, "Failed to open statistics output: {}", m_Options.stats.generic_string());
+            return false;
+        }
+    }
+
+    std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+    out << "FrameID,Name,Count,TxCount,RxCount,FirstTime,LastTime,MinPeriodMs,AvgPeriodMs,MaxPeriodMs,MinSize,MaxSize\n";
+    for(auto& [frame_id, stats] : m_Stats)
+    {
+        bool has_period = stats.count > 1;
+        double avg_period = has_period ? static_cast<double>(stats.last_timestamp - stats.first_timestamp) / static_cast<double>(stats.count - 1) : 0.0;
+        out << std::format("{:X},{},{},{},{},{:.6f},{:.6f},{:.3f},{:.3f},{:.3f},{},{}\n", frame_id, GetFrameName(frame_id), stats.count, stats.tx_count,
+            stats.count - stats.tx_count, static_cast<double>(stats.first_timestamp) / 1000000.0, static_cast<double>(stats.last_timestamp) / 1000000.0,
+            has_period ? static_cast<double>(stats.min_period) / 1000.0 : 0.0, avg_period / 1000.0, static_cast<double>(stats.max_period) / 1000.0,
+            stats.min_size, stats.max_size);
+    }
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+std::string CanLogTool::GetFrameName(uint32_t frame_id) const
+{
+    const CanFrameDefinition* frame = m_Decoder.FindFrame(frame_id);
+    return frame ? frame->name : std::string();
+}
+
+bool CanLogTool::ParseCsvLine(std::string_view line, CanRecordingFrame& frame)
+{
+    if(!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+
+    std::array<std::string_view, 5> fields;
+    for(auto& field : fields)  /* Comment is ignored, it may contain commas */
+    {
+        size_t comma = line.find(',');
+        if(comma == std::string_view::npos && &field != &fields.back())
+            return false;
+        field = line.substr(0, comma);
+        line.remove_prefix(comma == std::string_view::npos ? line.length() : comma + 1);
+    }
+
+    double time = 0.0;
+    uint32_t data_size = 0;
+    auto [time_end, time_ec] = std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), time);
+    auto [id_end, id_ec] = std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), frame.frame_id, 16);
+    auto [size_end, size_ec] = std::from_chars(fields[3].data(), fields[3].data() + fields[3].size(), data_size);
+    if(time_ec != std::errc() || id_ec != std::errc() || size_ec != std::errc() || data_size > frame.data.size())
+        return false;
+
+    if(fields[1] == "TX")
+        frame.direction = CAN_LOG_DIR_TX;
+    else if(fields[1] == "RX")
+        frame.direction = CAN_LOG_DIR_RX;
+    else
+        return false;
+
+    frame.timestamp = static_cast<uint64_t>(time * 1000000.0 + 0.5);
+    frame.size = static_cast<uint8_t>(data_size);
+    frame.data.fill(0);
+    std::string_view hex = fields[4];
+    for(uint8_t i = 0; i != frame.size; i++)
+    {
+        while(!hex.empty() && hex.front() == ' ')
+            hex.remove_prefix(1);
+        if(hex.length() < 2 || std::from_chars(hex.data(), hex.data() + 2, frame.data[i], 16).ec != std::errc())
+            return false;
+        hex.remove_prefix(2);
+    }
+    return true;
+}
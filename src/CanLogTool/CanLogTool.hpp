@@ -0,0 +1,226 @@
+#pragma once
+
+#include <inttypes.h>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/* Signal time series binary file identifier, "CSIG" in little endian */
+constexpr uint32_t CAN_LOG_TOOL_SIGNAL_MAGIC = 0x47495343;
+constexpr uint8_t CAN_LOG_TOOL_SIGNAL_VERSION = 1;
+
+/* Compressed recording blocks processed by a worker at once */
+constexpr size_t CAN_LOG_TOOL_BLOCKS_PER_CHUNK = 16;
+
+/* Size of a CSV log chunk processed by a worker at once, it's extended to the end of the line */
+constexpr size_t CAN_LOG_TOOL_CSV_CHUNK_SIZE = 16 * 1024 * 1024;
+
+/* Processed chunks waiting to be written per worker, limits the memory when the output is slower than the workers */
+constexpr size_t CAN_LOG_TOOL_CHUNKS_IN_FLIGHT = 4;
+
+enum CanLogToolSignalFormat : uint8_t
+{
+    CLT_SIGNALS_CSV,     /* Time,FrameID,Frame,Signal,Value */
+    CLT_SIGNALS_BINARY   /* Header with signal names followed by fixed size little endian records */
+};
+
+class CanLogToolOptions
+{
+public:
+    // !\brief Input recording, compressed (.canrec) or CSV saved by the CAN log panel
+    std::filesystem::path input;
+
+    // !\brief Frame mapping, signals aren't decoded without it
+    std::filesystem::path mapping;
+
+    // !\brief Filter in CAN log panel format, applied to every output
+    std::string filter;
+
+    // !\brief Per-ID statistics output, "-" = stdout
+    std::filesystem::path stats;
+
+    // !\brief Decoded signal time series output
+    std::filesystem::path signals;
+
+    // !\brief Format of the signal time series
+    CanLogToolSignalFormat signal_format = CLT_SIGNALS_CSV;
+
+    // !\brief Filtered sub-log output, compressed if the extension is .canrec, CSV otherwise
+    std::filesystem::path output;
+
+    // !\brief Number of worker threads
+    size_t threads = 1;
+};
+
+class CanIdStatistics
+{
+public:
+    // !\brief Add frame, frames have to be added in time order
+    // !\param timestamp [in] Time of the frame in microseconds
+    // !\param direction [in] Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    // !\param size [in] Data length
+    void Add(uint64_t timestamp, uint8_t direction, uint8_t size);
+
+    // !\brief Merge statistics of the next chunk, the time between the chunks counts as a period too
+    // !\param next [in] Statistics of a later chunk
+    void Merge(const CanIdStatistics& next);
+
+    // !\brief Number of frames
+    uint64_t count = 0;
+
+    // !\brief Number of sent frames
+    uint64_t tx_count = 0;
+
+    // !\brief Timestamp of the first frame
+    uint64_t first_timestamp = 0;
+
+    // !\brief Timestamp of the last frame
+    uint64_t last_timestamp = 0;
+
+    // !\brief Shortest time between two frames
+    uint64_t min_period = std::numeric_limits<uint64_t>::max();
+
+    // !\brief Longest time between two frames
+    uint64_t max_period = 0;
+
+    // !\brief Smallest data length
+    uint8_t min_size = std::numeric_limits<uint8_t>::max();
+
+    // !\brief Largest data length
+    uint8_t max_size = 0;
+};
+
+class CanLogChunkResult
+{
+public:
+    // !\brief Statistics by Frame ID
+    std::unordered_map<uint32_t, CanIdStatistics> stats;
+
+    // !\brief Signal time series in the output format
+    std::string signals;
+
+    // !\brief Frames of the filtered sub-log
+    std::vector<CanRecordingFrame> frames;
+
+    // !\brief Number of frames in the chunk, including the filtered out ones
+    uint64_t frame_count = 0;
+
+    // !\brief Was the chunk read successfully?
+    bool is_ok = true;
+};
+
+class CanLogTool
+{
+public:
+    CanLogTool(const CanLogToolOptions& options);
+
+    // !\brief Process input and write the outputs
+    // !\return False on error
+    bool Run();
+
+    // !\brief Parse line of a CSV log (Time,Direction,FrameID,DataSize,Data,Comment)
+    // !\param line [in] Line without newline
+    // !\param frame [out] Parsed frame
+    // !\return False if the line isn't a valid frame, eg. the header
+    static bool ParseCsvLine(std::string_view line, CanRecordingFrame& frame);
+
+private:
+    // !\brief Open input and split it into chunks
+    bool OpenInput();
+
+    // !\brief Open output files and write their headers
+    bool OpenOutputs();
+
+    // !\brief Worker thread, processes the next chunk until every chunk is taken
+    void WorkerThread();
+
+    // !\brief Process frames of a chunk
+    // !\param index [in] Chunk index
+    // !\param filter [in] Worker's own copy of the filter, it caches matches
+    // !\param in [in] Worker's own stream of a compressed recording
+    // !\param result [out] Result
+    void ProcessChunk(size_t index, CanLogFilter& filter, std::ifstream& in, CanLogChunkResult& result);
+
+    // !\brief Handle frame of a chunk
+    void HandleFrame(const CanRecordingFrame& frame, CanLogFilter& filter, CanLogChunkResult& result);
+
+    // !\brief Write result of a chunk, chunks have to be written in order
+    bool WriteResult(CanLogChunkResult& result);
+
+    // !\brief Write per-ID statistics
+    bool WriteStatistics();
+
+    // !\brief Get frame name from mapping
+    std::string GetFrameName(uint32_t frame_id) const;
+
+    // !\brief Options
+    CanLogToolOptions m_Options;
+
+    // !\brief Signal decoder
+    CanSignalDecoder m_Decoder;
+
+    // !\brief Compiled filter, copied by every worker
+    CanLogFilter m_Filter;
+
+    // !\brief Is the input a compressed recording?
+    bool m_IsCompressed = false;
+
+    // !\brief Blocks of compressed recording
+    std::vector<CanRecordingBlockInfo> m_Blocks;
+
+    // !\brief Memory mapped CSV log
+    boost::interprocess::file_mapping m_CsvFile;
+
+    // !\brief Mapped region of the CSV log
+    boost::interprocess::mapped_region m_CsvRegion;
+
+    // !\brief Chunk boundaries of the CSV log, chunk N is [N, N + 1)
+    std::vector<size_t> m_CsvChunks;
+
+    // !\brief Number of chunks
+    size_t m_ChunkCount = 0;
+
+    // !\brief Next chunk to be taken by a worker
+    size_t m_NextChunk = 0;
+
+    // !\brief Next chunk to be written
+    size_t m_NextWrite = 0;
+
+    // !\brief Processed chunks waiting to be written
+    std::vector<std::unique_ptr<CanLogChunkResult>> m_Results;
+
+    // !\brief Mutex for chunk scheduling
+    std::mutex m_Mutex;
+
+    // !\brief Condition variable for chunk scheduling
+    std::condition_variable m_Cv;
+
+    // !\brief Merged statistics by Frame ID
+    std::map<uint32_t, CanIdStatistics> m_Stats;
+
+    // !\brief Signal time series output
+    std::ofstream m_SignalsOut;
+
+    // !\brief Sub-log output
+    std::ofstream m_Out;
+
+    // !\brief Compressed sub-log writer
+    std::unique_ptr<CanRecordingWriter> m_Writer;
+
+    // !\brief Number of processed frames
+    uint64_t m_FrameCount = 0;
+
+    // !\brief Number of frames in the sub-log
+    uint64_t m_OutputFrameCount = 0;
+};
@@ -0,0 +1,65 @@
+#include "pch.hpp"
+
+int main(int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+
+    CanLogToolOptions options;
+    std::string signal_format;
+    po::options_description desc("Headless CAN log analysis\nUsage: CanLogTool [options] <recording.canrec|recording.csv>\nOptions");
+    desc.add_options()
+        ("help,h", "Show help")
+        ("input,i", po::value(&options.input), "Input recording, compressed (.canrec) or CSV saved by the CAN log panel")
+        ("mapping,m", po::value(&options.mapping), "Frame mapping (FrameMapping.xml) for frame names and signal decoding")
+        ("filter,f", po::value(&options.filter), "Filter in CAN log panel format, eg. \"tx id:100-1FF [0]==0x05\"")
+        ("stats,s", po::value(&options.stats), "Write per-ID statistics as CSV, \"-\" = stdout (default when no other output is given)")
+        ("signals", po::value(&options.signals), "Write decoded signal time series")
+        ("signal-format", po::value(&signal_format)->default_value("csv"), "Signal time series format: csv or binary")
+        ("output,o", po::value(&options.output), "Write filtered sub-log, compressed if the extension is .canrec, CSV otherwise")
+        ("threads,j", po::value(&options.threads)->default_value(std::max<size_t>(std::thread::hardware_concurrency(), 1)), "Number of worker threads")
+        ("quiet,q", "Print errors only");
+
+    po::positional_options_description positional;
+    positional.add("input", 1);
+
+    po::variables_map vm;
+    try
+    {
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Invalid arguments: {}", e.what());
+        return 1;
+    }
+
+    if(vm.count("help") || options.input.empty())
+    {
+        std::cout << desc << '\n';
+        return vm.count("help") ? 0 : 1;
+    }
+
+    if(vm.count("quiet"))
+        can_log_tool_log_level = LogLevel::Error;
+
+    if(boost::iequals(signal_format, "binary"))
+        options.signal_format = CLT_SIGNALS_BINARY;
+    else if(!boost::iequals(signal_format, "csv"))
+    {
+        LOG(LogLevel::Error, "Invalid signal format: {}, expected csv or binary", signal_format);
+        return 1;
+    }
+
+    if(!options.signals.empty() && options.mapping.empty())
+    {
+        LOG(LogLevel::Error, "Signal decoding requires frame mapping (--mapping)");
+        return 1;
+    }
+
+    if(options.stats.empty() && options.signals.empty() && options.output.empty())
+        options.stats = "-";
+
+    CanLogTool tool(options);
+    return tool.Run() ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/* Precompiled header of the headless CAN log tool, it must not pull in wxWidgets or anything from the GUI */
+
+#ifndef _WIN32
+#include <fmt/format.h>
+namespace std
+{
+	template <typename... T>
+	std::string format(fmt::format_string<T...> fmt_, T&&... args)
+	{
+		return fmt::format(fmt_, std::forward<T>(args)...);
+	}
+}
+#else
+#include <format>
+#endif
+
+#include <boost/algorithm/string.hpp>
+#include <boost/crc.hpp>
+#include <boost/endian.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+#include <boost/program_options.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <inttypes.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+extern "C"
+{
+	#include <bitfield/bitfield.h>
+}
+
+enum LogLevel
+{
+    Debug,
+    Verbose,
+    Normal,
+    Notification,
+    Warning,
+    Error,
+    Critical
+};
+
+/* Minimum level printed to stderr, set from the command line */
+inline LogLevel can_log_tool_log_level = LogLevel::Normal;
+
+/* Same interface as the LOG of Logger.hpp, messages go to stderr */
+template <typename... Ts>
+struct LOG
+{
+    LOG(LogLevel lvl, std::string_view format_str, Ts&&... ts)
+    {
+        if(lvl < can_log_tool_log_level)
+            return;
+#ifdef _WIN32
+        std::cerr << std::vformat(format_str, std::make_format_args(ts...)) << '\n';
+#else
+        std::cerr << fmt::vformat(format_str, fmt::make_format_args(ts...)) << '\n';
+#endif
+    }
+    ~LOG() = default;
+};
+
+template <typename S, typename... Ts>
+LOG(LogLevel lvl, S&&, Ts&&...) -> LOG<Ts...>;
+
+#include "../CanLogFilter.hpp"
+#include "../CanRecordingCodec.hpp"
+#include "../CanSignalDecoder.hpp"
+#include "CanLogTool.hpp"
+
+using namespace std::chrono_literals;
@@ -0,0 +1,439 @@
+#include "pch.hpp"
+
+/* Frame record: flags, varint Frame ID (new ID) or slot, [zigzag varint time residual], [changed byte mask, changed bytes XOR'ed] */
+constexpr uint8_t CAN_RECORDING_FLAG_SIZE_MASK = 0x0F;
+constexpr uint8_t CAN_RECORDING_FLAG_RX = 0x10;
+constexpr uint8_t CAN_RECORDING_FLAG_NEW_ID = 0x20;
+constexpr uint8_t CAN_RECORDING_FLAG_SAME_DATA = 0x40;
+constexpr uint8_t CAN_RECORDING_FLAG_ON_TIME = 0x80;
+
+/* Longest frame record: flags + 5 byte ID + 10 byte residual + mask + 8 data bytes */
+constexpr size_t CAN_RECORDING_MAX_RECORD_SIZE = 25;
+
+constexpr size_t CAN_RECORDING_FILE_HEADER_SIZE = 8;
+constexpr size_t CAN_RECORDING_BLOCK_HEADER_SIZE = 36;
+
+/* LZ sequence: token (literal length << 4 | match length - 4), [length extension], literals, 16 bit offset, [length extension] */
+constexpr size_t CAN_RECORDING_LZ_MIN_MATCH = 4;
+constexpr size_t CAN_RECORDING_LZ_MAX_OFFSET = 65535;
+constexpr size_t CAN_RECORDING_LZ_HASH_BITS = 12;
+constexpr uint32_t CAN_RECORDING_LZ_EMPTY = UINT32_MAX;
+
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for(uint8_t shift = 0; shift < 64; shift += 7)
+    {
+        if(p == end)
+            return false;
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+template <typename T> static void PutLe(uint8_t*& p, T value)
+{
+    boost::endian::native_to_little_inplace(value);
+    memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+}
+
+template <typename T> static T GetLe(const uint8_t*& p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return boost::endian::little_to_native(value);
+}
+
+static uint32_t Crc32(const std::vector<uint8_t>& data)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+static void PutLzLength(std::vector<uint8_t>& out, size_t len)
+{
+    for(; len >= 255; len -= 255)
+        out.push_back(255);
+    out.push_back(static_cast<uint8_t>(len));
+}
+
+static bool GetLzLength(const uint8_t*& p, const uint8_t* end, size_t& len)
+{
+    uint8_t byte;
+    do
+    {
+        if(p == end)
+            return false;
+        byte = *p++;
+        len += byte;
+    } while(byte == 255);
+    return true;
+}
+
+static void PutLzSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_len, size_t offset, size_t match_len)
+{
+    size_t match_code = match_len ? match_len - CAN_RECORDING_LZ_MIN_MATCH : 0;
+    out.push_back(static_cast<uint8_t>((std::min<size_t>(literal_len, 15) << 4) | std::min<size_t>(match_code, 15)));
+    if(literal_len >= 15)
+        PutLzLength(out, literal_len - 15);
+    out.insert(out.end(), literals, literals + literal_len);
+
+    if(match_len)
+    {
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if(match_code >= 15)
+            PutLzLength(out, match_code - 15);
+    }
+}
+
+void CanRecordingLz::Compress(const uint8_t* in, size_t len, std::vector<uint8_t>& out)
+{
+    std::array<uint32_t, 1 << CAN_RECORDING_LZ_HASH_BITS> table;
+    table.fill(CAN_RECORDING_LZ_EMPTY);
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while(pos + CAN_RECORDING_LZ_MIN_MATCH <= len)
+    {
+        uint32_t word;
+        memcpy(&word, in + pos, sizeof(word));
+        uint32_t hash = (word * 2654435761u) >> (32 - CAN_RECORDING_LZ_HASH_BITS);
+        uint32_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(pos);
+
+        if(candidate != CAN_RECORDING_LZ_EMPTY && pos - candidate <= CAN_RECORDING_LZ_MAX_OFFSET && !memcmp(in + candidate, in + pos, CAN_RECORDING_LZ_MIN_MATCH))
+        {
+            size_t match_len = CAN_RECORDING_LZ_MIN_MATCH;
+            while(pos + match_len < len && in[candidate + match_len] == in[pos + match_len])
+                match_len++;
+
+            PutLzSequence(out, in + anchor, pos - anchor, pos - candidate, match_len);
+            pos += match_len;
+            anchor = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+
+    if(anchor != len)  /* Last sequence has only literals */
+        PutLzSequence(out, in + anchor, len - anchor, 0, 0);
+}
+
+bool CanRecordingLz::Decompress(const uint8_t* in, size_t len, std::vector<uint8_t>& out, size_t max_len)
+{
+    const uint8_t* p = in;
+    const uint8_t* end = in + len;
+    size_t start = out.size();
+    while(p != end)
+    {
+        uint8_t token = *p++;
+        size_t literal_len = token >> 4;
+        if(literal_len == 15 && !GetLzLength(p, end, literal_len))
+            return false;
+        if(static_cast<size_t>(end - p) < literal_len || out.size() - start + literal_len > max_len)
+            return false;
+        out.insert(out.end(), p, p + literal_len);
+        p += literal_len;
+
+        if(p == end)
+            break;
+
+        if(end - p < 2)
+            return false;
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t match_len = (token & 0x0F) + CAN_RECORDING_LZ_MIN_MATCH;
+        if((token & 0x0F) == 15 && !GetLzLength(p, end, match_len))
+            return false;
+        if(offset == 0 || offset > out.size() - start || out.size() - start + match_len > max_len)
+            return false;
+
+        size_t from = out.size() - offset;
+        for(size_t i = 0; i != match_len; i++)  /* Byte by byte, the match can overlap with itself */
+            out.push_back(out[from + i]);
+    }
+    return true;
+}
+
+CanRecordingWriter::CanRecordingWriter(std::ostream& out, size_t frames_per_block) :
+    m_Out(out), m_FramesPerBlock(std::max<size_t>(frames_per_block, 1))
+{
+    uint8_t header[CAN_RECORDING_FILE_HEADER_SIZE] = {};
+    uint8_t* p = header;
+    PutLe<uint32_t>(p, CAN_RECORDING_MAGIC);
+    PutLe<uint8_t>(p, CAN_RECORDING_VERSION);
+    m_Out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    m_Written = sizeof(header);
+    m_Raw.reserve(m_FramesPerBlock * CAN_RECORDING_MAX_RECORD_SIZE);
+}
+
+bool CanRecordingWriter::Add(const CanRecordingFrame& frame)
+{
+    if(m_Block.frame_count == 0)
+    {
+        m_Block.first_timestamp = frame.timestamp;
+        m_PrevTimestamp = frame.timestamp;
+    }
+
+    uint8_t size = std::min<uint8_t>(frame.size, static_cast<uint8_t>(frame.data.size()));
+    auto [it, is_new] = m_Slots.try_emplace(frame.frame_id, static_cast<uint32_t>(m_States.size()));
+    if(is_new)
+        m_States.emplace_back();
+    CanRecordingIdState& state = m_States[it->second];
+
+    /* Periodic frames usually arrive one period after the previous one, only the jitter is stored */
+    int64_t expected = is_new ? static_cast<int64_t>(m_PrevTimestamp) : static_cast<int64_t>(state.last_timestamp) + state.period;
+    int64_t residual = static_cast<int64_t>(frame.timestamp) - expected;
+
+    std::array<uint8_t, 8> diff = {};
+    uint8_t changed = 0;
+    for(uint8_t i = 0; i != size; i++)
+    {
+        diff[i] = frame.data[i] ^ state.data[i];
+        if(diff[i])
+            changed |= 1 << i;
+    }
+
+    uint8_t flags = size;
+    if(frame.direction)
+        flags |= CAN_RECORDING_FLAG_RX;
+    if(is_new)
+        flags |= CAN_RECORDING_FLAG_NEW_ID;
+    if(!changed)
+        flags |= CAN_RECORDING_FLAG_SAME_DATA;
+    if(!residual)
+        flags |= CAN_RECORDING_FLAG_ON_TIME;
+
+    m_Raw.push_back(flags);
+    PutVarint(m_Raw, is_new ? frame.frame_id : it->second);
+    if(residual)
+        PutVarint(m_Raw, (static_cast<uint64_t>(residual) << 1) ^ static_cast<uint64_t>(residual >> 63));  /* Zigzag */
+    if(changed)
+    {
+        m_Raw.push_back(changed);
+        for(uint8_t i = 0; i != size; i++)
+        {
+            if(diff[i])
+                m_Raw.push_back(diff[i]);
+        }
+    }
+
+    if(!is_new)
+        state.period = static_cast<int64_t>(frame.timestamp - state.last_timestamp);
+    state.last_timestamp = frame.timestamp;
+    state.data.fill(0);
+    std::copy(frame.data.begin(), frame.data.begin() + size, state.data.begin());
+
+    m_PrevTimestamp = frame.timestamp;
+    m_Block.last_timestamp = frame.timestamp;
+    m_Block.frame_count++;
+    if(m_Block.frame_count >= m_FramesPerBlock)
+        return Flush();
+    return m_Out.good();
+}
+
+bool CanRecordingWriter::Flush()
+{
+    if(m_Block.frame_count == 0)
+        return m_Out.good();
+
+    m_Compressed.clear();
+    CanRecordingLz::Compress(m_Raw.data(), m_Raw.size(), m_Compressed);
+
+    uint8_t header[CAN_RECORDING_BLOCK_HEADER_SIZE];
+    uint8_t* p = header;
+    PutLe<uint32_t>(p, CAN_RECORDING_BLOCK_MAGIC);
+    PutLe<uint32_t>(p, m_Block.frame_count);
+    PutLe<uint32_t>(p, static_cast<uint32_t>(m_Raw.size()));
+    PutLe<uint32_t>(p, static_cast<uint32_t>(m_Compressed.size()));
+    PutLe<uint64_t>(p, m_Block.first_timestamp);
+    PutLe<uint64_t>(p, m_Block.last_timestamp);
+    PutLe<uint32_t>(p, Crc32(m_Raw));
+    m_Out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    m_Out.write(reinterpret_cast<const char*>(m_Compressed.data()), m_Compressed.size());
+    m_Written += sizeof(header) + m_Compressed.size();
+
+    m_Raw.clear();
+    m_Slots.clear();
+    m_States.clear();
+    m_Block = CanRecordingBlockInfo();
+    return m_Out.good();
+}
+
+CanRecordingReader::CanRecordingReader(std::istream& in) :
+    m_In(in)
+{
+
+}
+
+bool CanRecordingReader::ReadHeader()
+{
+    uint8_t header[CAN_RECORDING_FILE_HEADER_SIZE];
+    if(!m_In.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+
+    const uint8_t* p = header;
+    uint32_t magic = GetLe<uint32_t>(p);
+    uint8_t version = GetLe<uint8_t>(p);
+    return magic == CAN_RECORDING_MAGIC && version == CAN_RECORDING_VERSION;
+}
+
+bool CanRecordingReader::ReadBlockHeader(CanRecordingBlockInfo& block)
+{
+    block.offset = static_cast<uint64_t>(m_In.tellg());
+    uint8_t header[CAN_RECORDING_BLOCK_HEADER_SIZE];
+    if(!m_In.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+
+    const uint8_t* p = header;
+    uint32_t magic = GetLe<uint32_t>(p);
+    block.frame_count = GetLe<uint32_t>(p);
+    block.raw_size = GetLe<uint32_t>(p);
+    block.compressed_size = GetLe<uint32_t>(p);
+    block.first_timestamp = GetLe<uint64_t>(p);
+    block.last_timestamp = GetLe<uint64_t>(p);
+    block.crc = GetLe<uint32_t>(p);
+
+    /* Sizes are checked before anything is allocated for them */
+    size_t max_raw_size = static_cast<size_t>(block.frame_count) * CAN_RECORDING_MAX_RECORD_SIZE;
+    return magic == CAN_RECORDING_BLOCK_MAGIC && block.raw_size <= max_raw_size && block.compressed_size <= max_raw_size + max_raw_size / 8 + 16;
+}
+
+bool CanRecordingReader::ReadIndex(std::vector<CanRecordingBlockInfo>& blocks)
+{
+    std::streampos pos = m_In.tellg();
+    bool ret = true;
+    while(m_In.peek() != std::char_traits<char>::eof())
+    {
+        CanRecordingBlockInfo block;
+        if(!ReadBlockHeader(block) || !m_In.seekg(block.compressed_size, std::ios_base::cur))
+        {
+            ret = false;
+            break;
+        }
+        blocks.push_back(block);
+    }
+    m_In.clear();
+    m_In.seekg(pos);
+    return ret;
+}
+
+bool CanRecordingReader::ReadBlock(const CanRecordingBlockInfo& block, std::vector<CanRecordingFrame>& frames)
+{
+    m_In.clear();
+    if(!m_In.seekg(block.offset))
+        return false;
+    return ReadNextBlock(frames);
+}
+
+bool CanRecordingReader::ReadNextBlock(std::vector<CanRecordingFrame>& frames)
+{
+    CanRecordingBlockInfo block;
+    if(!ReadBlockHeader(block))
+        return false;
+
+    m_Compressed.resize(block.compressed_size);
+    if(!m_In.read(reinterpret_cast<char*>(m_Compressed.data()), m_Compressed.size()))
+        return false;
+
+    m_Raw.clear();
+    if(!CanRecordingLz::Decompress(m_Compressed.data(), m_Compressed.size(), m_Raw, block.raw_size) || m_Raw.size() != block.raw_size || Crc32(m_Raw) != block.crc)
+        return false;
+    return DecodeBlock(block, m_Raw, frames);
+}
+
+bool CanRecordingReader::DecodeBlock(const CanRecordingBlockInfo& block, const std::vector<uint8_t>& raw, std::vector<CanRecordingFrame>& frames)
+{
+    std::vector<uint32_t> ids;
+    std::vector<CanRecordingIdState> states;
+    uint64_t prev_timestamp = block.first_timestamp;
+
+    const uint8_t* p = raw.data();
+    const uint8_t* end = raw.data() + raw.size();
+    for(uint32_t n = 0; n != block.frame_count; n++)
+    {
+        if(p == end)
+            return false;
+        uint8_t flags = *p++;
+
+        CanRecordingFrame frame;
+        frame.size = flags & CAN_RECORDING_FLAG_SIZE_MASK;
+        frame.direction = (flags & CAN_RECORDING_FLAG_RX) ? 1 : 0;
+        if(frame.size > frame.data.size())
+            return false;
+
+        uint64_t id_or_slot;
+        if(!GetVarint(p, end, id_or_slot))
+            return false;
+
+        bool is_new = flags & CAN_RECORDING_FLAG_NEW_ID;
+        if(is_new)
+        {
+            ids.push_back(static_cast<uint32_t>(id_or_slot));
+            states.emplace_back();
+            id_or_slot = states.size() - 1;
+        }
+        else if(id_or_slot >= states.size())
+        {
+            return false;
+        }
+        CanRecordingIdState& state = states[id_or_slot];
+        frame.frame_id = ids[id_or_slot];
+
+        int64_t residual = 0;
+        if(!(flags & CAN_RECORDING_FLAG_ON_TIME))
+        {
+            uint64_t zigzag;
+            if(!GetVarint(p, end, zigzag))
+                return false;
+            residual = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        }
+        int64_t expected = is_new ? static_cast<int64_t>(prev_timestamp) : static_cast<int64_t>(state.last_timestamp) + state.period;
+        frame.timestamp = static_cast<uint64_t>(expected + residual);
+
+        std::copy(state.data.begin(), state.data.begin() + frame.size, frame.data.begin());
+        if(!(flags & CAN_RECORDING_FLAG_SAME_DATA))
+        {
+            if(p == end)
+                return false;
+            uint8_t changed = *p++;
+            for(uint8_t i = 0; i != frame.size; i++)
+            {
+                if(changed & (1 << i))
+                {
+                    if(p == end)
+                        return false;
+                    frame.data[i] ^= *p++;
+                }
+            }
+        }
+
+        if(!is_new)
+            state.period = static_cast<int64_t>(frame.timestamp - state.last_timestamp);
+        state.last_timestamp = frame.timestamp;
+        state.data = frame.data;
+
+        prev_timestamp = frame.timestamp;
+        frames.push_back(frame);
+    }
+    return p == end;
+}
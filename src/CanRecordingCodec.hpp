@@ -0,0 +1,190 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/* Direction of logged frames */
+constexpr uint8_t CAN_LOG_DIR_TX = 0;
+constexpr uint8_t CAN_LOG_DIR_RX = 1;
+
+/* File and block identifiers, "CANR" and "CBLK" in little endian */
+constexpr uint32_t CAN_RECORDING_MAGIC = 0x524E4143;
+constexpr uint32_t CAN_RECORDING_BLOCK_MAGIC = 0x4B4C4243;
+constexpr uint8_t CAN_RECORDING_VERSION = 1;
+
+/* Extension of compressed CAN recordings */
+constexpr const char* CAN_RECORDING_EXTENSION = ".canrec";
+
+/* Every block can be decoded on it's own, smaller blocks make seeking finer but compress worse */
+constexpr size_t CAN_RECORDING_FRAMES_PER_BLOCK = 4096;
+
+class CanRecordingFrame
+{
+public:
+    // !\brief Time of the frame in microseconds, relative to the start of the recording
+    uint64_t timestamp = 0;
+
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    uint8_t direction = 0;
+
+    // !\brief Data length
+    uint8_t size = 0;
+
+    // !\brief Frame data, bytes after size are zero
+    std::array<uint8_t, 8> data = {};
+};
+
+class CanRecordingBlockInfo
+{
+public:
+    // !\brief Offset of the block header in the file
+    uint64_t offset = 0;
+
+    // !\brief Number of frames in the block
+    uint32_t frame_count = 0;
+
+    // !\brief Size of the block after delta encoding
+    uint32_t raw_size = 0;
+
+    // !\brief Size of the block after LZ compression, as stored in the file
+    uint32_t compressed_size = 0;
+
+    // !\brief Timestamp of the first frame
+    uint64_t first_timestamp = 0;
+
+    // !\brief Timestamp of the last frame
+    uint64_t last_timestamp = 0;
+
+    // !\brief CRC32 of the delta encoded block
+    uint32_t crc = 0;
+};
+
+class CanRecordingIdState
+{
+public:
+    // !\brief Timestamp of the previous frame with this ID
+    uint64_t last_timestamp = 0;
+
+    // !\brief Time between the last two frames, the next frame is expected after this
+    int64_t period = 0;
+
+    // !\brief Data of the previous frame, payloads are stored XOR'ed against it
+    std::array<uint8_t, 8> data = {};
+};
+
+class CanRecordingLz
+{
+public:
+    // !\brief Compress buffer with byte oriented LZ77
+    // !\param in [in] Input
+    // !\param len [in] Input length
+    // !\param out [out] Compressed data, appended
+    static void Compress(const uint8_t* in, size_t len, std::vector<uint8_t>& out);
+
+    // !\brief Decompress buffer compressed with Compress
+    // !\param in [in] Compressed data
+    // !\param len [in] Compressed data length
+    // !\param out [out] Decompressed data, appended
+    // !\param max_len [in] Maximum size of decompressed data
+    // !\return False if compressed data is corrupted
+    static bool Decompress(const uint8_t* in, size_t len, std::vector<uint8_t>& out, size_t max_len);
+};
+
+class CanRecordingWriter
+{
+public:
+    // !\brief Start writing recording, file header is written immediately
+    // !\param out [in] Output stream, has to be opened in binary mode
+    // !\param frames_per_block [in] Number of frames in a block
+    CanRecordingWriter(std::ostream& out, size_t frames_per_block = CAN_RECORDING_FRAMES_PER_BLOCK);
+
+    // !\brief Add frame, a block is compressed and written when it's full
+    // !\return False on write error
+    bool Add(const CanRecordingFrame& frame);
+
+    // !\brief Write the partially filled block
+    // !\return False on write error
+    bool Flush();
+
+    // !\brief Get number of bytes written so far
+    uint64_t GetWrittenSize() const { return m_Written; }
+
+private:
+    // !\brief Output stream
+    std::ostream& m_Out;
+
+    // !\brief Number of frames in a block
+    size_t m_FramesPerBlock;
+
+    // !\brief Delta encoded frames of the current block
+    std::vector<uint8_t> m_Raw;
+
+    // !\brief Compressed block, kept to avoid allocations
+    std::vector<uint8_t> m_Compressed;
+
+    // !\brief Header of the current block
+    CanRecordingBlockInfo m_Block;
+
+    // !\brief Timestamp of the previous frame in the block
+    uint64_t m_PrevTimestamp = 0;
+
+    // !\brief Slots of Frame IDs seen in the current block [frame_id] = slot
+    std::unordered_map<uint32_t, uint32_t> m_Slots;
+
+    // !\brief State of Frame IDs by slot
+    std::vector<CanRecordingIdState> m_States;
+
+    // !\brief Number of bytes written
+    uint64_t m_Written = 0;
+};
+
+class CanRecordingReader
+{
+public:
+    // !\brief Start reading recording
+    // !\param in [in] Input stream, has to be opened in binary mode
+    CanRecordingReader(std::istream& in);
+
+    // !\brief Check file header
+    // !\return False if it isn't a CAN recording or it's version isn't supported
+    bool ReadHeader();
+
+    // !\brief Collect block headers without decoding the blocks, stream position is restored
+    // !\param blocks [out] Blocks in file order
+    // !\return False if the file is corrupted
+    bool ReadIndex(std::vector<CanRecordingBlockInfo>& blocks);
+
+    // !\brief Decode block at given position
+    // !\param block [in] Block from ReadIndex
+    // !\param frames [out] Frames of the block, appended
+    // !\return False if the block is corrupted
+    bool ReadBlock(const CanRecordingBlockInfo& block, std::vector<CanRecordingFrame>& frames);
+
+    // !\brief Decode the next block
+    // !\param frames [out] Frames of the block, appended
+    // !\return False at the end of the file or if the block is corrupted
+    bool ReadNextBlock(std::vector<CanRecordingFrame>& frames);
+
+private:
+    // !\brief Read block header at the current position
+    bool ReadBlockHeader(CanRecordingBlockInfo& block);
+
+    // !\brief Decode delta encoded block
+    static bool DecodeBlock(const CanRecordingBlockInfo& block, const std::vector<uint8_t>& raw, std::vector<CanRecordingFrame>& frames);
+
+    // !\brief Input stream
+    std::istream& m_In;
+
+    // !\brief Compressed block, kept to avoid allocations
+    std::vector<uint8_t> m_Compressed;
+
+    // !\brief Decompressed block, kept to avoid allocations
+    std::vector<uint8_t> m_Raw;
+};
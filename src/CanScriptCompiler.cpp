@@ -0,0 +1,1317 @@
+#include "pch.hpp"
+
+std::string CanScriptValue::ToString() const
+{
+    return is_float ? std::format("{}", f) : std::format("{}", i);
+}
+
+bool CanScriptValue::ApplyBinary(CanScriptOpcode op, const CanScriptValue& lhs, const CanScriptValue& rhs, CanScriptValue& result)
+{
+    const bool is_float = lhs.is_float || rhs.is_float;
+    const uint64_t a = static_cast<uint64_t>(lhs.AsInt());  /* Integer arithmetic wraps around instead of being undefined */
+    const uint64_t b = static_cast<uint64_t>(rhs.AsInt());
+    switch(op)
+    {
+        case CSO_ADD:
+            result = is_float ? CanScriptValue(lhs.AsDouble() + rhs.AsDouble()) : CanScriptValue(static_cast<int64_t>(a + b));
+            break;
+        case CSO_SUB:
+            result = is_float ? CanScriptValue(lhs.AsDouble() - rhs.AsDouble()) : CanScriptValue(static_cast<int64_t>(a - b));
+            break;
+        case CSO_MUL:
+            result = is_float ? CanScriptValue(lhs.AsDouble() * rhs.AsDouble()) : CanScriptValue(static_cast<int64_t>(a * b));
+            break;
+        case CSO_DIV:
+        {
+            if(is_float)
+            {
+                if(rhs.AsDouble() == 0.0)
+                    return false;
+                result = CanScriptValue(lhs.AsDouble() / rhs.AsDouble());
+            }
+            else
+            {
+                if(rhs.i == 0)
+                    return false;
+                result = rhs.i == -1 ? CanScriptValue(static_cast<int64_t>(0 - a)) : CanScriptValue(lhs.i / rhs.i);
+            }
+            break;
+        }
+        case CSO_MOD:
+        {
+            if(is_float)
+            {
+                if(rhs.AsDouble() == 0.0)
+                    return false;
+                result = CanScriptValue(std::fmod(lhs.AsDouble(), rhs.AsDouble()));
+            }
+            else
+            {
+                if(rhs.i == 0)
+                    return false;
+                result = rhs.i == -1 ? CanScriptValue(static_cast<int64_t>(0)) : CanScriptValue(lhs.i % rhs.i);
+            }
+            break;
+        }
+        case CSO_BIT_AND: result = CanScriptValue(static_cast<int64_t>(a & b)); break;
+        case CSO_BIT_OR: result = CanScriptValue(static_cast<int64_t>(a | b)); break;
+        case CSO_BIT_XOR: result = CanScriptValue(static_cast<int64_t>(a ^ b)); break;
+        case CSO_SHL: result = CanScriptValue(static_cast<int64_t>(a << (b & 63))); break;
+        case CSO_SHR: result = CanScriptValue(static_cast<int64_t>(a >> (b & 63))); break;
+        case CSO_EQ: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() == rhs.AsDouble() : lhs.i == rhs.i)); break;
+        case CSO_NE: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() != rhs.AsDouble() : lhs.i != rhs.i)); break;
+        case CSO_LT: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() < rhs.AsDouble() : lhs.i < rhs.i)); break;
+        case CSO_LE: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() <= rhs.AsDouble() : lhs.i <= rhs.i)); break;
+        case CSO_GT: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() > rhs.AsDouble() : lhs.i > rhs.i)); break;
+        case CSO_GE: result = CanScriptValue(static_cast<int64_t>(is_float ? lhs.AsDouble() >= rhs.AsDouble() : lhs.i >= rhs.i)); break;
+        case CSO_LOGICAL_AND: result = CanScriptValue(static_cast<int64_t>(lhs.IsTrue() && rhs.IsTrue())); break;
+        case CSO_LOGICAL_OR: result = CanScriptValue(static_cast<int64_t>(lhs.IsTrue() || rhs.IsTrue())); break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool CanScriptValue::ApplyUnary(CanScriptOpcode op, const CanScriptValue& value, CanScriptValue& result)
+{
+    switch(op)
+    {
+        case CSO_NEG:
+            result = value.is_float ? CanScriptValue(-value.f) : CanScriptValue(static_cast<int64_t>(0 - static_cast<uint64_t>(value.i)));
+            break;
+        case CSO_NOT:
+            result = CanScriptValue(static_cast<int64_t>(!value.IsTrue()));
+            break;
+        case CSO_BIT_NOT:
+            result = CanScriptValue(~value.AsInt());
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+uint8_t CanScriptWaitCondition::OnFrame(uint64_t candidates, uint64_t& latched, const uint8_t* data, uint16_t size) const
+{
+    for(uint64_t pending = candidates & ~latched; pending; pending &= pending - 1)
+    {
+        size_t i = std::countr_zero(pending);
+        if(predicates[i].Match(data, size))
+            latched |= 1ULL << i;
+    }
+
+    for(size_t i = 0; i != alternatives.size(); i++)
+    {
+        if((latched & alternatives[i]) == alternatives[i])
+            return static_cast<uint8_t>(i + 1);
+    }
+    return 0;
+}
+
+class CanScriptBinaryOperator
+{
+public:
+    std::string_view text;
+    CanScriptOpcode opcode;
+    uint8_t precedence;
+};
+
+static constexpr CanScriptBinaryOperator BINARY_OPERATORS[] =
+{
+    { "||", CSO_LOGICAL_OR, 1 },
+    { "&&", CSO_LOGICAL_AND, 2 },
+    { "|", CSO_BIT_OR, 3 },
+    { "^", CSO_BIT_XOR, 4 },
+    { "&", CSO_BIT_AND, 5 },
+    { "==", CSO_EQ, 6 }, { "!=", CSO_NE, 6 },
+    { "<", CSO_LT, 7 }, { "<=", CSO_LE, 7 }, { ">", CSO_GT, 7 }, { ">=", CSO_GE, 7 },
+    { "<<", CSO_SHL, 8 }, { ">>", CSO_SHR, 8 },
+    { "+", CSO_ADD, 9 }, { "-", CSO_SUB, 9 },
+    { "*", CSO_MUL, 10 }, { "/", CSO_DIV, 10 }, { "%", CSO_MOD, 10 },
+};
+
+/* Longer operators first, so "<<" isn't tokenized as two "<" */
+static constexpr std::string_view OPERATOR_TOKENS[] =
+{
+    "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "+", "-", "*", "/", "%", "&", "|", "^", "<", ">", "!", "~"
+};
+
+enum CanScriptTokenType : uint8_t
+{
+    CSTT_NUMBER, CSTT_IDENTIFIER, CSTT_SIGNAL, CSTT_OPERATOR, CSTT_LEFT_PAREN, CSTT_RIGHT_PAREN, CSTT_END
+};
+
+class CanScriptToken
+{
+public:
+    CanScriptTokenType type = CSTT_END;
+    std::string text;
+    CanScriptValue value;
+};
+
+class CanScriptBlock
+{
+public:
+    enum Type : uint8_t { If, Else, While, Loop };
+
+    Type type = If;
+
+    // !\brief Source line where the block has been opened
+    uint32_t line = 0;
+
+    // !\brief Start of the loop condition
+    uint32_t head = 0;
+
+    // !\brief Jump which has to be patched to the end of the block
+    uint32_t exit_jump = 0;
+
+    // !\brief Hidden counter variable of Loop
+    uint32_t counter = 0;
+
+    // !\brief Break jumps to patch
+    std::vector<uint32_t> breaks;
+
+    // !\brief Continue jumps to patch
+    std::vector<uint32_t> continues;
+};
+
+class CanScriptCompilerState
+{
+public:
+    CanScriptCompilerState(const CanScriptSymbols& symbols, CanScriptProgram& program, std::vector<std::string>& errors) :
+        m_Symbols(symbols), m_Program(program), m_Errors(errors)
+    {
+        m_Statements["SetFrameField"] = &CanScriptCompilerState::CompileSetFrameField;
+        m_Statements["SetSignal"] = &CanScriptCompilerState::CompileSetSignal;
+        m_Statements["SetFrameFieldRaw"] = &CanScriptCompilerState::CompileSetFrameFieldRaw;
+        m_Statements["SendFrame"] = &CanScriptCompilerState::CompileSendFrame;
+        m_Statements["WaitForFrame"] = &CanScriptCompilerState::CompileWaitForFrame;
+        m_Statements["WaitFor"] = &CanScriptCompilerState::CompileWaitFor;
+        m_Statements["Sleep"] = &CanScriptCompilerState::CompileSleep;
+        m_Statements["SleepUs"] = &CanScriptCompilerState::CompileSleepUs;
+        m_Statements["Print"] = &CanScriptCompilerState::CompilePrint;
+        m_Statements["Trace"] = &CanScriptCompilerState::CompileTrace;
+        m_Statements["Label"] = &CanScriptCompilerState::CompileLabel;
+        m_Statements["Goto"] = &CanScriptCompilerState::CompileGoto;
+        m_Statements["If"] = &CanScriptCompilerState::CompileIf;
+        m_Statements["Else"] = &CanScriptCompilerState::CompileElse;
+        m_Statements["EndIf"] = &CanScriptCompilerState::CompileEndIf;
+        m_Statements["While"] = &CanScriptCompilerState::CompileWhile;
+        m_Statements["EndWhile"] = &CanScriptCompilerState::CompileEndWhile;
+        m_Statements["Loop"] = &CanScriptCompilerState::CompileLoop;
+        m_Statements["EndLoop"] = &CanScriptCompilerState::CompileEndLoop;
+        m_Statements["Break"] = &CanScriptCompilerState::CompileBreak;
+        m_Statements["Continue"] = &CanScriptCompilerState::CompileContinue;
+        m_Statements["Exit"] = &CanScriptCompilerState::CompileExit;
+    }
+
+    bool Compile(const std::string& script)
+    {
+        std::istringstream ss(script);
+        std::string line;
+        bool ret = true;
+        while(std::getline(ss, line, '\n'))
+        {
+            m_Line++;
+            m_Depth = 0;
+            if(!CompileLine(line))
+                ret = false;
+        }
+
+        for(auto& i : m_Blocks)
+            ret = Error(i.line, "Block isn't closed");
+
+        for(auto& [index, name, line_number] : m_Gotos)
+        {
+            auto it = m_Labels.find(name);
+            if(it == m_Labels.end())
+                ret = Error(line_number, std::format("Unknown label: {}", name));
+            else
+                m_Program.code[index].operand = it->second;
+        }
+
+        Emit(CSO_HALT);
+        m_Program.max_stack = m_MaxDepth;
+        return ret;
+    }
+
+private:
+    using StatementHandler = bool (CanScriptCompilerState::*)(std::string_view);
+
+    bool Error(uint32_t line, const std::string& message)
+    {
+        m_Errors.push_back(std::format("Line {}: {}", line, message));
+        return false;
+    }
+
+    bool Error(const std::string& message)
+    {
+        return Error(m_Line, message);
+    }
+
+    uint32_t Emit(CanScriptOpcode opcode, uint32_t operand = 0)
+    {
+        m_Program.code.push_back({ opcode, operand });
+        m_Program.lines.push_back(m_Line);
+        return static_cast<uint32_t>(m_Program.code.size() - 1);
+    }
+
+    uint32_t Here() const
+    {
+        return static_cast<uint32_t>(m_Program.code.size());
+    }
+
+    void Push()
+    {
+        m_Depth++;
+        m_MaxDepth = std::max(m_MaxDepth, m_Depth);
+    }
+
+    void Pop()
+    {
+        if(m_Depth)
+            m_Depth--;
+    }
+
+    void EmitConstant(const CanScriptValue& value)
+    {
+        uint32_t index = 0;
+        for(; index != m_Program.constants.size(); index++)
+        {
+            const CanScriptValue& c = m_Program.constants[index];
+            if(c.is_float == value.is_float && (c.is_float ? c.f == value.f : c.i == value.i))
+                break;
+        }
+
+        if(index == m_Program.constants.size())
+            m_Program.constants.push_back(value);
+        Emit(CSO_PUSH_CONST, index);
+        Push();
+    }
+
+    bool IsConstant(size_t index) const
+    {
+        return index >= m_ExpressionStart && index < m_Program.code.size() && m_Program.code[index].opcode == CSO_PUSH_CONST;
+    }
+
+    void RemoveLast()
+    {
+        m_Program.code.pop_back();
+        m_Program.lines.pop_back();
+        Pop();
+    }
+
+    bool EmitBinary(CanScriptOpcode opcode)
+    {
+        size_t size = m_Program.code.size();
+        if(size >= 2 && IsConstant(size - 1) && IsConstant(size - 2))  /* Fold constant expressions */
+        {
+            CanScriptValue lhs = m_Program.constants[m_Program.code[size - 2].operand];
+            CanScriptValue rhs = m_Program.constants[m_Program.code[size - 1].operand];
+            CanScriptValue result;
+            if(!CanScriptValue::ApplyBinary(opcode, lhs, rhs, result))
+                return Error("Division by zero");
+
+            RemoveLast();
+            RemoveLast();
+            EmitConstant(result);
+            return true;
+        }
+
+        Emit(opcode);
+        Pop();
+        return true;
+    }
+
+    void EmitUnary(CanScriptOpcode opcode)
+    {
+        size_t size = m_Program.code.size();
+        CanScriptValue result;
+        if(size >= 1 && IsConstant(size - 1) && CanScriptValue::ApplyUnary(opcode, m_Program.constants[m_Program.code[size - 1].operand], result))
+        {
+            RemoveLast();
+            EmitConstant(result);
+            return;
+        }
+        Emit(opcode);
+    }
+
+    static bool IsIdentifierChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static bool IsIdentifier(std::string_view str)
+    {
+        return !str.empty() && !std::isdigit(static_cast<unsigned char>(str[0])) && std::all_of(str.begin(), str.end(), IsIdentifierChar);
+    }
+
+    // !\brief Read a name, which can be quoted if it contains whitespace
+    bool ReadName(std::string_view& input, std::string& name)
+    {
+        if(input.starts_with('"'))
+        {
+            size_t end = input.find('"', 1);
+            if(end == std::string_view::npos)
+                return Error("Missing closing quote");
+            name = input.substr(1, end - 1);
+            input.remove_prefix(end + 1);
+        }
+        else
+        {
+            size_t end = input.find_first_of(" \t");
+            name = input.substr(0, end);
+            input.remove_prefix(end == std::string_view::npos ? input.size() : end);
+        }
+        Trim(input);
+
+        if(name.empty())
+            return Error("Missing name");
+        return true;
+    }
+
+    static void Trim(std::string_view& str)
+    {
+        while(!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+            str.remove_prefix(1);
+        while(!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+            str.remove_suffix(1);
+    }
+
+    bool ParseNumber(std::string_view text, CanScriptValue& value)
+    {
+        std::from_chars_result result;
+        if(text.starts_with("0x") || text.starts_with("0X") || text.starts_with("0b") || text.starts_with("0B"))
+        {
+            int base = std::tolower(text[1]) == 'x' ? 16 : 2;
+            uint64_t number = 0;
+            result = std::from_chars(text.data() + 2, text.data() + text.size(), number, base);
+            value = CanScriptValue(static_cast<int64_t>(number));
+        }
+        else if(text.find_first_of(".eE") != std::string_view::npos)
+        {
+            double number = 0.0;
+            result = std::from_chars(text.data(), text.data() + text.size(), number);
+            value = CanScriptValue(number);
+        }
+        else
+        {
+            uint64_t number = 0;
+            result = std::from_chars(text.data(), text.data() + text.size(), number);
+            value = CanScriptValue(static_cast<int64_t>(number));
+        }
+
+        if(result.ec != std::errc() || result.ptr != text.data() + text.size())
+            return Error(std::format("Invalid number: {}", text));
+        return true;
+    }
+
+    bool Tokenize(std::string_view input)
+    {
+        m_Tokens.clear();
+        m_TokenPos = 0;
+        size_t pos = 0;
+        while(pos < input.size())
+        {
+            char c = input[pos];
+            if(std::isspace(static_cast<unsigned char>(c)))
+            {
+                pos++;
+                continue;
+            }
+
+            CanScriptToken token;
+            if(std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && pos + 1 < input.size() && std::isdigit(static_cast<unsigned char>(input[pos + 1]))))
+            {
+                size_t start = pos;
+                bool is_hex = input.substr(pos).starts_with("0x") || input.substr(pos).starts_with("0X");
+                while(pos < input.size() && (IsIdentifierChar(input[pos]) || input[pos] == '.' ||
+                    (!is_hex && (input[pos] == '+' || input[pos] == '-') && std::tolower(input[pos - 1]) == 'e')))
+                    pos++;
+
+                token.type = CSTT_NUMBER;
+                token.text = input.substr(start, pos - start);
+                if(!ParseNumber(token.text, token.value))
+                    return false;
+            }
+            else if(IsIdentifierChar(c))
+            {
+                size_t start = pos;
+                while(pos < input.size() && IsIdentifierChar(input[pos]))
+                    pos++;
+                token.type = CSTT_IDENTIFIER;
+                token.text = input.substr(start, pos - start);
+            }
+            else if(c == '$')
+            {
+                pos++;
+                token.type = CSTT_SIGNAL;
+                if(pos < input.size() && input[pos] == '{')  /* ${Signal name with spaces} */
+                {
+                    size_t end = input.find('}', pos);
+                    if(end == std::string_view::npos)
+                        return Error("Missing closing '}' for signal name");
+                    token.text = input.substr(pos + 1, end - pos - 1);
+                    pos = end + 1;
+                }
+                else
+                {
+                    size_t start = pos;
+                    while(pos < input.size() && IsIdentifierChar(input[pos]))
+                        pos++;
+                    token.text = input.substr(start, pos - start);
+                }
+
+                if(token.text.empty())
+                    return Error("Missing signal name after '$'");
+            }
+            else if(c == '(' || c == ')')
+            {
+                token.type = c == '(' ? CSTT_LEFT_PAREN : CSTT_RIGHT_PAREN;
+                token.text = c;
+                pos++;
+            }
+            else
+            {
+                auto op = std::find_if(std::begin(OPERATOR_TOKENS), std::end(OPERATOR_TOKENS), [&](std::string_view o) { return input.substr(pos).starts_with(o); });
+                if(op == std::end(OPERATOR_TOKENS))
+                    return Error(std::format("Unexpected character: {}", c));
+                token.type = CSTT_OPERATOR;
+                token.text = *op;
+                pos += op->size();
+            }
+            m_Tokens.push_back(std::move(token));
+        }
+        m_Tokens.push_back(CanScriptToken{});
+        return true;
+    }
+
+    const CanScriptToken& Peek() const
+    {
+        return m_Tokens[m_TokenPos];
+    }
+
+    const CanScriptToken& Next()
+    {
+        const CanScriptToken& token = m_Tokens[m_TokenPos];
+        if(token.type != CSTT_END)
+            m_TokenPos++;
+        return token;
+    }
+
+    bool CompileExpression(std::string_view input)
+    {
+        if(!Tokenize(input))
+            return false;
+
+        if(Peek().type == CSTT_END)
+            return Error("Missing expression");
+
+        m_ExpressionStart = m_Program.code.size();
+        if(!ParseBinary(1))
+            return false;
+
+        if(Peek().type != CSTT_END)
+            return Error(std::format("Unexpected '{}' in expression", Peek().text));
+        return true;
+    }
+
+    bool ParseBinary(uint8_t min_precedence)
+    {
+        if(!ParseUnary())
+            return false;
+
+        while(Peek().type == CSTT_OPERATOR)
+        {
+            auto op = std::find_if(std::begin(BINARY_OPERATORS), std::end(BINARY_OPERATORS), [this](const CanScriptBinaryOperator& o) { return o.text == Peek().text; });
+            if(op == std::end(BINARY_OPERATORS) || op->precedence < min_precedence)
+                break;
+
+            Next();
+            if(!ParseBinary(op->precedence + 1) || !EmitBinary(op->opcode))
+                return false;
+        }
+        return true;
+    }
+
+    bool ParseUnary()
+    {
+        const CanScriptToken& token = Peek();
+        if(token.type == CSTT_OPERATOR && (token.text == "-" || token.text == "+" || token.text == "!" || token.text == "~"))
+        {
+            char op = token.text[0];
+            Next();
+            if(!ParseUnary())
+                return false;
+
+            if(op != '+')
+                EmitUnary(op == '-' ? CSO_NEG : op == '!' ? CSO_NOT : CSO_BIT_NOT);
+            return true;
+        }
+        return ParsePrimary();
+    }
+
+    bool ParsePrimary()
+    {
+        const CanScriptToken& token = Next();
+        switch(token.type)
+        {
+            case CSTT_NUMBER:
+            {
+                EmitConstant(token.value);
+                return true;
+            }
+            case CSTT_IDENTIFIER:
+            {
+                auto it = m_Variables.find(token.text);
+                if(it == m_Variables.end())
+                    return Error(std::format("Unknown variable: {}", token.text));
+                Emit(CSO_LOAD_VAR, it->second);
+                Push();
+                return true;
+            }
+            case CSTT_SIGNAL:
+            {
+                uint32_t signal = 0;
+                if(!ResolveSignal(token.text, signal))
+                    return false;
+                Emit(CSO_LOAD_SIGNAL, signal);
+                Push();
+                return true;
+            }
+            case CSTT_LEFT_PAREN:
+            {
+                if(!ParseBinary(1))
+                    return false;
+                if(Next().type != CSTT_RIGHT_PAREN)
+                    return Error("Missing ')'");
+                return true;
+            }
+            case CSTT_END:
+                return Error("Unexpected end of expression");
+            default:
+                return Error(std::format("Unexpected '{}' in expression", token.text));
+        }
+    }
+
+    uint32_t AddFrame(uint32_t frame_id, uint8_t size, const std::string& name)
+    {
+        auto it = m_FrameIndex.find(frame_id);
+        if(it != m_FrameIndex.end())
+            return it->second;
+
+        CanScriptFrame frame;
+        frame.frame_id = frame_id;
+        frame.size = std::min<uint8_t>(size, 8);
+        frame.name = name;
+        m_Program.frames.push_back(std::move(frame));
+        uint32_t index = static_cast<uint32_t>(m_Program.frames.size() - 1);
+        m_FrameIndex[frame_id] = index;
+        return index;
+    }
+
+    // !\brief Find frame by its name or by the name of one of its signals
+    bool ResolveFrame(const std::string& name, uint32_t& index)
+    {
+        auto frame = m_Symbols.frames.find(name);
+        if(frame != m_Symbols.frames.end())
+        {
+            index = AddFrame(frame->second.first, frame->second.second, name);
+            return true;
+        }
+
+        auto signal = m_Symbols.signals.find(name);
+        if(signal != m_Symbols.signals.end())
+        {
+            index = AddFrameOfSignal(signal->second.frame_id);
+            return true;
+        }
+        return Error(std::format("Unknown frame: {}", name));
+    }
+
+    uint32_t AddFrameOfSignal(uint32_t frame_id)
+    {
+        for(auto& [name, frame] : m_Symbols.frames)
+        {
+            if(frame.first == frame_id)
+                return AddFrame(frame_id, frame.second, name);
+        }
+        return AddFrame(frame_id, 8, std::format("{:X}", frame_id));
+    }
+
+    bool ResolveSignal(const std::string& name, uint32_t& index)
+    {
+        auto it = m_SignalIndex.find(name);
+        if(it != m_SignalIndex.end())
+        {
+            index = it->second;
+            return true;
+        }
+
+        auto symbol = m_Symbols.signals.find(name);
+        if(symbol == m_Symbols.signals.end())
+            return Error(std::format("Unknown signal: {}", name));
+
+        CanScriptSignal signal;
+        signal.frame = AddFrameOfSignal(symbol->second.frame_id);
+        signal.offset = symbol->second.offset;
+        signal.size = symbol->second.size;
+        signal.type = symbol->second.type;
+        signal.name = name;
+        m_Program.signals.push_back(std::move(signal));
+        index = static_cast<uint32_t>(m_Program.signals.size() - 1);
+        m_SignalIndex[name] = index;
+        return true;
+    }
+
+    uint32_t DeclareVariable(const std::string& name)
+    {
+        auto it = m_Variables.find(name);
+        if(it != m_Variables.end())
+            return it->second;
+
+        m_Program.variables.push_back(name);
+        uint32_t slot = static_cast<uint32_t>(m_Program.variables.size() - 1);
+        m_Variables[name] = slot;
+        return slot;
+    }
+
+    bool CompileLine(std::string_view line)
+    {
+        size_t comment = std::min(line.find('#'), line.find("//"));
+        if(comment != std::string_view::npos)
+            line = line.substr(0, comment);
+        Trim(line);
+        if(line.empty())
+            return true;
+
+        if(line.ends_with(':') && IsIdentifier(line.substr(0, line.size() - 1)))  /* label: */
+            return CompileLabel(line.substr(0, line.size() - 1));
+
+        size_t end = line.find_first_of(" \t");
+        std::string command(line.substr(0, end));
+        std::string_view rest = end == std::string_view::npos ? std::string_view() : line.substr(end);
+        Trim(rest);
+
+        auto it = m_Statements.find(command);
+        if(it != m_Statements.end())
+            return (this->*(it->second))(rest);
+
+        if(IsIdentifier(command))
+        {
+            if(rest.starts_with('=') && !rest.starts_with("=="))
+                return CompileAssignment(command, CSO_HALT, rest.substr(1));
+
+            for(auto& op : BINARY_OPERATORS)  /* Compound assignment, e.g. x += 1 */
+            {
+                if(op.opcode < CSO_EQ && rest.starts_with(op.text) && rest.substr(op.text.size()).starts_with('='))
+                    return CompileAssignment(command, op.opcode, rest.substr(op.text.size() + 1));
+            }
+        }
+        return Error(std::format("Unknown script function name: {}", command));
+    }
+
+    bool CompileAssignment(const std::string& name, CanScriptOpcode op, std::string_view expression)
+    {
+        Trim(expression);
+        if(op == CSO_HALT && expression.starts_with("WaitFor") && expression.size() > 7 && std::isspace(static_cast<unsigned char>(expression[7])))
+        {
+            if(!CompileWaitCondition(expression.substr(7)))  /* x = WaitFor ... stores the index of the satisfied alternative */
+                return false;
+
+            Emit(CSO_STORE_VAR, DeclareVariable(name));
+            Pop();
+            return true;
+        }
+
+        if(op != CSO_HALT)
+        {
+            auto it = m_Variables.find(name);
+            if(it == m_Variables.end())
+                return Error(std::format("Unknown variable: {}", name));
+            Emit(CSO_LOAD_VAR, it->second);
+            Push();
+        }
+
+        if(!CompileExpression(expression))
+            return false;
+
+        if(op != CSO_HALT && !EmitBinary(op))
+            return false;
+
+        Emit(CSO_STORE_VAR, DeclareVariable(name));
+        Pop();
+        return true;
+    }
+
+    bool CompileSetFrameField(std::string_view args)
+    {
+        std::string name;
+        uint32_t signal = 0;
+        if(!ReadName(args, name) || !ResolveSignal(name, signal))
+            return false;
+
+        std::string_view value = args;
+        if(value.starts_with("0x") || value.starts_with("0X"))
+            value.remove_prefix(2);
+
+        uint64_t number = 0;
+        auto result = std::from_chars(value.data(), value.data() + value.size(), number, 16);
+        if(value.empty() || result.ec != std::errc() || result.ptr != value.data() + value.size())
+            return Error(std::format("Invalid SetFrameField value: {}, it has to be hex. Use SetSignal for expressions", args));
+
+        EmitConstant(CanScriptValue(static_cast<int64_t>(number)));
+        Emit(CSO_SET_SIGNAL, signal);
+        Pop();
+        return true;
+    }
+
+    bool CompileSetSignal(std::string_view args)
+    {
+        std::string name;
+        uint32_t signal = 0;
+        if(!ReadName(args, name) || !ResolveSignal(name, signal) || !CompileExpression(args))
+            return false;
+
+        Emit(CSO_SET_SIGNAL, signal);
+        Pop();
+        return true;
+    }
+
+    bool CompileSetFrameFieldRaw(std::string_view args)
+    {
+        std::string name;
+        CanScriptRawData raw;
+        if(!ReadName(args, name) || !ResolveFrame(name, raw.frame))
+            return false;
+
+        std::string hex(args.starts_with("0x") || args.starts_with("0X") ? args.substr(2) : args);
+        if(hex.empty() || hex.length() > raw.data.size() * 2)
+            return Error(std::format("Invalid frame value: {}, max supported bytes for a single frame is 8", args));
+
+        if(hex.length() & 1)  /* Increase it's length if it's odd */
+            hex += hex.back();
+
+        for(size_t i = 0; i != hex.length() / 2; i++)
+        {
+            auto result = std::from_chars(hex.data() + i * 2, hex.data() + i * 2 + 2, raw.data[i], 16);
+            if(result.ec != std::errc() || result.ptr != hex.data() + i * 2 + 2)
+                return Error(std::format("Invalid frame value: {}", args));
+        }
+
+        m_Program.raw_data.push_back(raw);
+        Emit(CSO_SET_FRAME_RAW, static_cast<uint32_t>(m_Program.raw_data.size() - 1));
+        return true;
+    }
+
+    bool CompileSendFrame(std::string_view args)
+    {
+        std::string name;
+        uint32_t frame = 0;
+        if(!ReadName(args, name) || !ResolveFrame(name, frame))
+            return false;
+
+        if(!args.empty())
+            return Error(std::format("Unexpected parameter: {}", args));
+
+        Emit(CSO_SEND_FRAME, frame);
+        return true;
+    }
+
+    bool CompileWaitForFrame(std::string_view args)
+    {
+        std::string name;
+        CanScriptPredicate predicate;  /* Any data, it's compared with the frame buffer when the frame is received */
+        if(!ReadName(args, name) || !ResolveFrame(name, predicate.frame) || !CompileExpression(args))
+            return false;
+
+        predicate.frame_id = m_Program.frames[predicate.frame].frame_id;
+
+        CanScriptWaitCondition condition;
+        condition.predicates.push_back(predicate);
+        condition.alternatives.push_back(1);
+        condition.by_id.push_back({ predicate.frame_id, 1 });
+        condition.text = name;
+        m_Program.wait_conditions.push_back(std::move(condition));
+
+        Emit(CSO_WAIT_FRAME, static_cast<uint32_t>(m_Program.wait_conditions.size() - 1));
+        Pop();
+        return true;
+    }
+
+    bool CompileWaitFor(std::string_view args)
+    {
+        if(!CompileWaitCondition(args))
+            return false;
+
+        Emit(CSO_POP);
+        Pop();
+        return true;
+    }
+
+    // !\brief Read a word until whitespace, quoted parts can contain whitespace
+    static std::string_view ReadWord(std::string_view& input)
+    {
+        Trim(input);
+        size_t pos = 0;
+        bool is_quoted = false;
+        for(; pos != input.size(); pos++)
+        {
+            if(input[pos] == '"')
+                is_quoted = !is_quoted;
+            else if(!is_quoted && std::isspace(static_cast<unsigned char>(input[pos])))
+                break;
+        }
+
+        std::string_view word = input.substr(0, pos);
+        input.remove_prefix(pos);
+        Trim(input);
+        return word;
+    }
+
+    static bool IsKeyword(std::string_view word, std::string_view keyword)
+    {
+        return word.size() == keyword.size() && std::equal(word.begin(), word.end(), keyword.begin(),
+            [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    }
+
+    bool ParseByte(std::string_view text, uint8_t& value)
+    {
+        CanScriptValue number;
+        if(!ParseNumber(text, number))
+            return false;
+        if(number.is_float || number.i < 0 || number.i > 0xFF)
+            return Error(std::format("Invalid byte value: {}", text));
+        value = static_cast<uint8_t>(number.i);
+        return true;
+    }
+
+    bool ParseHexBytes(std::string_view text, std::array<uint8_t, 8>& data, uint8_t& len)
+    {
+        if(text.starts_with("0x") || text.starts_with("0X"))
+            text.remove_prefix(2);
+        if(text.empty() || text.size() > data.size() * 2 || (text.size() & 1))
+            return Error(std::format("Invalid hex data: {}, it has to be 1-8 bytes", text));
+
+        len = static_cast<uint8_t>(text.size() / 2);
+        for(size_t i = 0; i != len; i++)
+        {
+            auto result = std::from_chars(text.data() + i * 2, text.data() + i * 2 + 2, data[i], 16);
+            if(result.ec != std::errc() || result.ptr != text.data() + i * 2 + 2)
+                return Error(std::format("Invalid hex data: {}", text));
+        }
+        return true;
+    }
+
+    // !\brief Parse frame predicate: Name, 0x123, Name[2]==0x05, Name[2]&0x0F==5 or Name/FFFF=0322
+    bool ParsePredicate(std::string_view word, CanScriptPredicate& predicate)
+    {
+        size_t name_end = word.starts_with('"') ? word.find('"', 1) + 1 : word.find_first_of("[/");
+        if(name_end == 0)
+            return Error("Missing closing quote");
+        name_end = std::min(name_end, word.size());
+
+        std::string name(word.substr(0, name_end));
+        std::string_view match = word.substr(name_end);
+        if(name.starts_with('"'))
+            name = name.substr(1, name.size() - 2);
+
+        if(name.starts_with("0x") || name.starts_with("0X"))
+        {
+            uint32_t frame_id = 0;
+            auto result = std::from_chars(name.data() + 2, name.data() + name.size(), frame_id, 16);
+            if(result.ec != std::errc() || result.ptr != name.data() + name.size())
+                return Error(std::format("Invalid frame ID: {}", name));
+            predicate.frame = AddFrameOfSignal(frame_id);
+        }
+        else if(name.empty() || !ResolveFrame(name, predicate.frame))
+        {
+            return name.empty() ? Error("Missing frame name") : false;
+        }
+        predicate.frame_id = m_Program.frames[predicate.frame].frame_id;
+
+        if(match.starts_with('/'))  /* /MASK=VALUE, both in hex */
+        {
+            size_t eq = match.find('=');
+            if(eq == std::string_view::npos)
+                return Error(std::format("Missing '=' in data match: {}", match));
+
+            uint8_t mask_len = 0;
+            if(!ParseHexBytes(match.substr(1, eq - 1), predicate.mask, mask_len) || !ParseHexBytes(match.substr(eq + 1), predicate.value, predicate.len))
+                return false;
+            if(mask_len != predicate.len)
+                return Error(std::format("Mask and value have different length: {}", match));
+        }
+        else
+        {
+            while(match.starts_with('['))  /* [n]==value or [n]&mask==value, can be repeated */
+            {
+                size_t close = match.find(']');
+                size_t eq = match.find('=', close);
+                if(close == std::string_view::npos || eq == std::string_view::npos)
+                    return Error(std::format("Invalid data match: {}", match));
+
+                uint8_t index = 0;
+                uint8_t mask = 0xFF;
+                uint8_t value = 0;
+                std::string_view mask_str = match.substr(close + 1, eq - close - 1);
+                std::string_view value_str = match.substr(eq + 1);
+                if(value_str.starts_with('='))
+                    value_str.remove_prefix(1);
+                size_t value_end = std::min(value_str.find('['), value_str.size());
+                if(!ParseByte(match.substr(1, close - 1), index) || (!mask_str.empty() && (!mask_str.starts_with('&') || !ParseByte(mask_str.substr(1), mask))) ||
+                    !ParseByte(value_str.substr(0, value_end), value))
+                    return false;
+                if(index >= predicate.mask.size())
+                    return Error(std::format("Invalid byte index: {}", index));
+
+                predicate.mask[index] = mask;
+                predicate.value[index] = value & mask;
+                predicate.len = std::max<uint8_t>(predicate.len, index + 1);
+                match = value_str.substr(value_end);
+            }
+
+            if(!match.empty())
+                return Error(std::format("Invalid data match: {}", match));
+        }
+
+        for(uint8_t i = 0; i != predicate.len; i++)
+            predicate.value[i] &= predicate.mask[i];
+        return true;
+    }
+
+    // !\brief Compile WaitFor operands, AND binds tighter than OR: A and B or C = (A and B) or C
+    bool CompileWaitCondition(std::string_view args)
+    {
+        CanScriptWaitCondition condition;
+        condition.text = args;
+        std::string_view timeout;
+        uint64_t alternative = 0;
+        while(true)
+        {
+            std::string_view word = ReadWord(args);
+            if(word.empty())
+                return Error("Missing frame in WaitFor");
+
+            CanScriptPredicate predicate;
+            if(!ParsePredicate(word, predicate))
+                return false;
+
+            auto it = std::find_if(condition.predicates.begin(), condition.predicates.end(), [&predicate](const CanScriptPredicate& p)
+                { return p.frame_id == predicate.frame_id && p.len == predicate.len && p.mask == predicate.mask && p.value == predicate.value; });
+            size_t index = std::distance(condition.predicates.begin(), it);
+            if(it == condition.predicates.end())
+            {
+                if(condition.predicates.size() == CAN_SCRIPT_MAX_PREDICATES)
+                    return Error(std::format("Too many frames in WaitFor, max is {}", CAN_SCRIPT_MAX_PREDICATES));
+                condition.predicates.push_back(predicate);
+            }
+            alternative |= 1ULL << index;
+
+            std::string_view connective = ReadWord(args);
+            if(connective == "&&" || IsKeyword(connective, "and"))
+                continue;
+
+            condition.alternatives.push_back(alternative);
+            alternative = 0;
+            if(connective == "||" || IsKeyword(connective, "or"))
+                continue;
+
+            if(IsKeyword(connective, "timeout"))
+            {
+                timeout = args;
+                break;
+            }
+
+            if(!connective.empty())
+                return Error(std::format("Unexpected '{}' in WaitFor, expected and, or or Timeout", connective));
+            break;
+        }
+
+        if(condition.alternatives.size() > std::numeric_limits<uint8_t>::max())
+            return Error("Too many alternatives in WaitFor");
+
+        for(size_t i = 0; i != condition.predicates.size(); i++)
+        {
+            uint32_t frame_id = condition.predicates[i].frame_id;
+            auto it = std::find_if(condition.by_id.begin(), condition.by_id.end(), [frame_id](auto& p) { return p.first == frame_id; });
+            if(it == condition.by_id.end())
+                condition.by_id.push_back({ frame_id, 1ULL << i });
+            else
+                it->second |= 1ULL << i;
+        }
+
+        if(timeout.empty())
+            EmitConstant(CanScriptValue(static_cast<int64_t>(-1)));  /* No timeout */
+        else if(!CompileExpression(timeout))
+            return false;
+
+        m_Program.wait_conditions.push_back(std::move(condition));
+        Emit(CSO_WAIT_CONDITION, static_cast<uint32_t>(m_Program.wait_conditions.size() - 1));  /* Pops the timeout, pushes the result */
+        return true;
+    }
+
+    bool CompileSleep(std::string_view args)
+    {
+        if(!CompileExpression(args))
+            return false;
+
+        EmitConstant(CanScriptValue(static_cast<int64_t>(1000)));
+        if(!EmitBinary(CSO_MUL))
+            return false;
+        Emit(CSO_SLEEP);
+        Pop();
+        return true;
+    }
+
+    bool CompileSleepUs(std::string_view args)
+    {
+        if(!CompileExpression(args))
+            return false;
+        Emit(CSO_SLEEP);
+        Pop();
+        return true;
+    }
+
+    bool CompilePrint(std::string_view args)
+    {
+        if(!CompileExpression(args))
+            return false;
+        Emit(CSO_PRINT);
+        Pop();
+        return true;
+    }
+
+    bool CompileTrace(std::string_view args)
+    {
+        if(boost::algorithm::iequals(args, "on") || args == "1")
+            Emit(CSO_TRACE, 1);
+        else if(boost::algorithm::iequals(args, "off") || args == "0")
+            Emit(CSO_TRACE, 0);
+        else
+            return Error(std::format("Invalid Trace parameter: {}, On or Off is expected", args));
+        return true;
+    }
+
+    bool CompileLabel(std::string_view args)
+    {
+        std::string name(args);
+        if(!IsIdentifier(name))
+            return Error(std::format("Invalid label name: {}", name));
+        if(m_Labels.contains(name))
+            return Error(std::format("Label is already defined: {}", name));
+        m_Labels[name] = Here();
+        return true;
+    }
+
+    bool CompileGoto(std::string_view args)
+    {
+        if(!IsIdentifier(args))
+            return Error(std::format("Invalid label name: {}", args));
+        m_Gotos.push_back({ Emit(CSO_JUMP), std::string(args), m_Line });
+        return true;
+    }
+
+    bool CompileIf(std::string_view args)
+    {
+        if(!CompileExpression(args))
+            return false;
+
+        CanScriptBlock block;
+        block.type = CanScriptBlock::If;
+        block.line = m_Line;
+        block.exit_jump = Emit(CSO_JUMP_IF_FALSE);
+        Pop();
+        m_Blocks.push_back(std::move(block));
+        return true;
+    }
+
+    bool CompileElse(std::string_view)
+    {
+        if(m_Blocks.empty() || m_Blocks.back().type != CanScriptBlock::If)
+            return Error("Else without If");
+
+        CanScriptBlock& block = m_Blocks.back();
+        uint32_t jump = Emit(CSO_JUMP);
+        m_Program.code[block.exit_jump].operand = Here();
+        block.exit_jump = jump;
+        block.type = CanScriptBlock::Else;
+        return true;
+    }
+
+    bool CompileEndIf(std::string_view)
+    {
+        if(m_Blocks.empty() || (m_Blocks.back().type != CanScriptBlock::If && m_Blocks.back().type != CanScriptBlock::Else))
+            return Error("EndIf without If");
+
+        m_Program.code[m_Blocks.back().exit_jump].operand = Here();
+        m_Blocks.pop_back();
+        return true;
+    }
+
+    bool CompileWhile(std::string_view args)
+    {
+        CanScriptBlock block;
+        block.type = CanScriptBlock::While;
+        block.line = m_Line;
+        block.head = Here();
+        if(!CompileExpression(args))
+            return false;
+
+        block.exit_jump = Emit(CSO_JUMP_IF_FALSE);
+        Pop();
+        m_Blocks.push_back(std::move(block));
+        return true;
+    }
+
+    void CloseLoop(uint32_t continue_target)
+    {
+        CanScriptBlock& block = m_Blocks.back();
+        for(auto& i : block.continues)
+            m_Program.code[i].operand = continue_target;
+
+        Emit(CSO_JUMP, block.head);
+        m_Program.code[block.exit_jump].operand = Here();
+        for(auto& i : block.breaks)
+            m_Program.code[i].operand = Here();
+        m_Blocks.pop_back();
+    }
+
+    bool CompileEndWhile(std::string_view)
+    {
+        if(m_Blocks.empty() || m_Blocks.back().type != CanScriptBlock::While)
+            return Error("EndWhile without While");
+
+        CloseLoop(m_Blocks.back().head);
+        return true;
+    }
+
+    bool CompileLoop(std::string_view args)
+    {
+        if(!CompileExpression(args))
+            return false;
+
+        CanScriptBlock block;
+        block.type = CanScriptBlock::Loop;
+        block.line = m_Line;
+        block.counter = DeclareVariable(std::format("#loop{}", m_Line));  /* Can't collide with user variables */
+        Emit(CSO_STORE_VAR, block.counter);
+        Pop();
+
+        block.head = Here();
+        Emit(CSO_LOAD_VAR, block.counter);
+        Push();
+        m_ExpressionStart = m_Program.code.size();
+        EmitConstant(CanScriptValue(static_cast<int64_t>(0)));
+        EmitBinary(CSO_GT);
+        block.exit_jump = Emit(CSO_JUMP_IF_FALSE);
+        Pop();
+        m_Blocks.push_back(std::move(block));
+        return true;
+    }
+
+    bool CompileEndLoop(std::string_view)
+    {
+        if(m_Blocks.empty() || m_Blocks.back().type != CanScriptBlock::Loop)
+            return Error("EndLoop without Loop");
+
+        uint32_t continue_target = Here();
+        uint32_t counter = m_Blocks.back().counter;
+        Emit(CSO_LOAD_VAR, counter);
+        Push();
+        m_ExpressionStart = m_Program.code.size();
+        EmitConstant(CanScriptValue(static_cast<int64_t>(1)));
+        EmitBinary(CSO_SUB);
+        Emit(CSO_STORE_VAR, counter);
+        Pop();
+        CloseLoop(continue_target);
+        return true;
+    }
+
+    CanScriptBlock* FindLoop()
+    {
+        for(auto it = m_Blocks.rbegin(); it != m_Blocks.rend(); ++it)
+        {
+            if(it->type == CanScriptBlock::While || it->type == CanScriptBlock::Loop)
+                return &*it;
+        }
+        return nullptr;
+    }
+
+    bool CompileBreak(std::string_view)
+    {
+        CanScriptBlock* loop = FindLoop();
+        if(!loop)
+            return Error("Break outside of loop");
+        loop->breaks.push_back(Emit(CSO_JUMP));
+        return true;
+    }
+
+    bool CompileContinue(std::string_view)
+    {
+        CanScriptBlock* loop = FindLoop();
+        if(!loop)
+            return Error("Continue outside of loop");
+        loop->continues.push_back(Emit(CSO_JUMP));
+        return true;
+    }
+
+    bool CompileExit(std::string_view)
+    {
+        Emit(CSO_HALT);
+        return true;
+    }
+
+    // !\brief Available frames and signals
+    const CanScriptSymbols& m_Symbols;
+
+    // !\brief Program being compiled
+    CanScriptProgram& m_Program;
+
+    // !\brief Compile errors
+    std::vector<std::string>& m_Errors;
+
+    // !\brief Statement handlers [name] = handler
+    std::unordered_map<std::string, StatementHandler> m_Statements;
+
+    // !\brief Current line
+    uint32_t m_Line = 0;
+
+    // !\brief Tokens of current expression
+    std::vector<CanScriptToken> m_Tokens;
+
+    // !\brief Position in m_Tokens
+    size_t m_TokenPos = 0;
+
+    // !\brief First instruction of current expression, constant folding doesn't go below this
+    size_t m_ExpressionStart = 0;
+
+    // !\brief Current and maximum stack depth
+    size_t m_Depth = 0;
+    size_t m_MaxDepth = 0;
+
+    // !\brief Variables [name] = slot
+    std::unordered_map<std::string, uint32_t> m_Variables;
+
+    // !\brief Frames [frame_id] = index
+    std::unordered_map<uint32_t, uint32_t> m_FrameIndex;
+
+    // !\brief Signals [name] = index
+    std::unordered_map<std::string, uint32_t> m_SignalIndex;
+
+    // !\brief Labels [name] = instruction index
+    std::unordered_map<std::string, uint32_t> m_Labels;
+
+    // !\brief Jumps to labels which have to be resolved at the end (instruction, label, line)
+    std::vector<std::tuple<uint32_t, std::string, uint32_t>> m_Gotos;
+
+    // !\brief Open blocks
+    std::vector<CanScriptBlock> m_Blocks;
+};
+
+bool CanScriptCompiler::Compile(const std::string& script, const CanScriptSymbols& symbols, CanScriptProgram& program, std::vector<std::string>& errors)
+{
+    program = CanScriptProgram{};
+    CanScriptCompilerState state(symbols, program, errors);
+    return state.Compile(script);
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum CanScriptOpcode : uint8_t
+{
+    CSO_PUSH_CONST,     /* Push constants[operand] */
+    CSO_LOAD_VAR,       /* Push variables[operand] */
+    CSO_STORE_VAR,      /* Pop into variables[operand] */
+    CSO_LOAD_SIGNAL,    /* Push value of signals[operand] from the frame buffer */
+    CSO_ADD, CSO_SUB, CSO_MUL, CSO_DIV, CSO_MOD,
+    CSO_BIT_AND, CSO_BIT_OR, CSO_BIT_XOR, CSO_SHL, CSO_SHR,
+    CSO_EQ, CSO_NE, CSO_LT, CSO_LE, CSO_GT, CSO_GE,
+    CSO_LOGICAL_AND, CSO_LOGICAL_OR,
+    CSO_NEG, CSO_NOT, CSO_BIT_NOT,
+    CSO_JUMP,           /* Jump to operand */
+    CSO_JUMP_IF_FALSE,  /* Pop, jump to operand if it's zero */
+    CSO_SET_SIGNAL,     /* Pop into signals[operand] in the frame buffer */
+    CSO_SET_FRAME_RAW,  /* Copy raw_data[operand] to the frame buffer */
+    CSO_SEND_FRAME,     /* Send frames[operand] */
+    CSO_WAIT_FRAME,     /* Pop timeout in ms, wait for the frame of wait_conditions[operand] and compare it with the frame buffer */
+    CSO_WAIT_CONDITION, /* Pop timeout in ms (negative = no timeout), wait for wait_conditions[operand], push matching alternative (1..n) or 0 on timeout */
+    CSO_POP,            /* Drop top of the stack */
+    CSO_SLEEP,          /* Pop time in us, sleep relative to the last wake-up */
+    CSO_PRINT,          /* Pop and print */
+    CSO_TRACE,          /* Enable (operand = 1) or disable (operand = 0) logging of operations */
+    CSO_HALT
+};
+
+class CanScriptInstruction
+{
+public:
+    // !\brief Operation
+    CanScriptOpcode opcode;
+
+    // !\brief Operand (index to a program table or jump target)
+    uint32_t operand = 0;
+};
+
+class CanScriptValue
+{
+public:
+    CanScriptValue() = default;
+    CanScriptValue(int64_t value) : i(value) {}
+    CanScriptValue(double value) : f(value), is_float(true) {}
+
+    // !\brief Return value as integer, floats are truncated
+    int64_t AsInt() const { return is_float ? static_cast<int64_t>(f) : i; }
+
+    // !\brief Return value as floating point
+    double AsDouble() const { return is_float ? f : static_cast<double>(i); }
+
+    // !\brief Is value non-zero?
+    bool IsTrue() const { return is_float ? f != 0.0 : i != 0; }
+
+    // !\brief Value in human readable format
+    std::string ToString() const;
+
+    // !\brief Apply binary operator, the result is float if any of the operands is float (except bitwise operators)
+    // !\param op [in] Operator
+    // !\param lhs [in] Left operand
+    // !\param rhs [in] Right operand
+    // !\param result [out] Result
+    // !\return False on division by zero
+    static bool ApplyBinary(CanScriptOpcode op, const CanScriptValue& lhs, const CanScriptValue& rhs, CanScriptValue& result);
+
+    // !\brief Apply unary operator
+    // !\param op [in] Operator
+    // !\param value [in] Operand
+    // !\param result [out] Result
+    static bool ApplyUnary(CanScriptOpcode op, const CanScriptValue& value, CanScriptValue& result);
+
+    int64_t i = 0;
+    double f = 0.0;
+    bool is_float = false;
+};
+
+enum CanScriptSignalType : uint8_t
+{
+    CSST_UNSIGNED, CSST_SIGNED, CSST_FLOAT, CSST_DOUBLE
+};
+
+class CanScriptSignalSymbol
+{
+public:
+    // !\brief CAN Frame ID which contains the signal
+    uint32_t frame_id = 0;
+
+    // !\brief Bit offset in frame
+    uint8_t offset = 0;
+
+    // !\brief Bit length
+    uint8_t size = 0;
+
+    // !\brief Value type
+    CanScriptSignalType type = CSST_UNSIGNED;
+};
+
+class CanScriptSymbols
+{
+public:
+    // !\brief Frames [name] = (frame_id, size in bytes)
+    std::unordered_map<std::string, std::pair<uint32_t, uint8_t>> frames;
+
+    // !\brief Signals [name] = signal
+    std::unordered_map<std::string, CanScriptSignalSymbol> signals;
+};
+
+class CanScriptFrame
+{
+public:
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Data length
+    uint8_t size = 8;
+
+    // !\brief Name used in script
+    std::string name;
+};
+
+class CanScriptSignal
+{
+public:
+    // !\brief Index to CanScriptProgram::frames
+    uint32_t frame = 0;
+
+    // !\brief Bit offset in frame
+    uint8_t offset = 0;
+
+    // !\brief Bit length
+    uint8_t size = 0;
+
+    // !\brief Value type
+    CanScriptSignalType type = CSST_UNSIGNED;
+
+    // !\brief Name used in script
+    std::string name;
+};
+
+class CanScriptRawData
+{
+public:
+    // !\brief Index to CanScriptProgram::frames
+    uint32_t frame = 0;
+
+    // !\brief Frame data
+    std::array<uint8_t, 8> data = {};
+};
+
+/* Predicates are tracked in a 64 bit mask */
+constexpr size_t CAN_SCRIPT_MAX_PREDICATES = 64;
+
+class CanScriptPredicate
+{
+public:
+    // !\brief Does the frame data match?
+    bool Match(const uint8_t* data, uint16_t size) const
+    {
+        if(size < len)
+            return false;
+        for(uint8_t i = 0; i != len; i++)
+        {
+            if((data[i] & mask[i]) != value[i])
+                return false;
+        }
+        return true;
+    }
+
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Index to CanScriptProgram::frames
+    uint32_t frame = 0;
+
+    // !\brief Number of bytes compared
+    uint8_t len = 0;
+
+    // !\brief Data mask
+    std::array<uint8_t, 8> mask = {};
+
+    // !\brief Expected data after masking
+    std::array<uint8_t, 8> value = {};
+};
+
+class CanScriptWaitCondition
+{
+public:
+    // !\brief Handle a received frame
+    // !\param candidates [in] Predicates on the frame's ID, a bit mask from by_id
+    // !\param latched [in/out] Predicates which have been satisfied so far
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length
+    // !\return Index of the satisfied alternative + 1, 0 if none of them is satisfied yet
+    uint8_t OnFrame(uint64_t candidates, uint64_t& latched, const uint8_t* data, uint16_t size) const;
+
+    // !\brief Predicates
+    std::vector<CanScriptPredicate> predicates;
+
+    // !\brief Alternatives (OR), each of them is a mask of predicates which all have to be satisfied (AND)
+    std::vector<uint64_t> alternatives;
+
+    // !\brief Predicates by CAN Frame ID [frame_id] = predicate mask, used for building the RX dispatch index
+    std::vector<std::pair<uint32_t, uint64_t>> by_id;
+
+    // !\brief Source text, for logging
+    std::string text;
+};
+
+class CanScriptProgram
+{
+public:
+    // !\brief Instructions
+    std::vector<CanScriptInstruction> code;
+
+    // !\brief Source line of each instruction
+    std::vector<uint32_t> lines;
+
+    // !\brief Constant pool
+    std::vector<CanScriptValue> constants;
+
+    // !\brief Variable names, index is the variable slot
+    std::vector<std::string> variables;
+
+    // !\brief Frames referenced by the script
+    std::vector<CanScriptFrame> frames;
+
+    // !\brief Signals referenced by the script
+    std::vector<CanScriptSignal> signals;
+
+    // !\brief Raw frame data used by SetFrameFieldRaw
+    std::vector<CanScriptRawData> raw_data;
+
+    // !\brief Conditions used by WaitFor and WaitForFrame
+    std::vector<CanScriptWaitCondition> wait_conditions;
+
+    // !\brief Maximum stack depth needed by expressions
+    size_t max_stack = 0;
+};
+
+class CanScriptCompiler
+{
+public:
+    // !\brief Compile script to bytecode
+    // !\param script [in] Script source
+    // !\param symbols [in] Frames and signals which can be referenced by the script
+    // !\param program [out] Compiled program
+    // !\param errors [out] Compile errors with line numbers
+    // !\return True if the script has been compiled without error
+    static bool Compile(const std::string& script, const CanScriptSymbols& symbols, CanScriptProgram& program, std::vector<std::string>& errors);
+};
@@ -1,16 +1,28 @@
 #include "pch.hpp"
 
+CanScriptContext::CanScriptContext(CanScriptProgram&& program_) :
+    program(std::move(program_))
+{
+    stack.reserve(program.max_stack);
+    variables.resize(program.variables.size());
+    frame_data.resize(program.frames.size());
+    is_frame_set.resize(program.frames.size());
+    wake_time = std::chrono::steady_clock::now();
+}
+
+CanScriptTask::CanScriptTask(uint32_t id_, CanScriptProgram&& program) :
+    id(id_), ctx(std::move(program))
+{
+    start_time = ctx.wake_time;
+}
+
 CanScriptHandler::CanScriptHandler(ICanResultPanel& result_panel) :
     m_Result(result_panel)
 {
-    m_operands["SetFrameField"] = std::bind(&CanScriptHandler::SetFrameField, this, 3, std::placeholders::_2);
-    m_operands["SetFrameFieldRaw"] = std::bind(&CanScriptHandler::SetFrameFieldRaw, this, 3, std::placeholders::_2);
-    m_operands["SendFrame"] = std::bind(&CanScriptHandler::SendFrame, this, 2, std::placeholders::_2);
-    m_operands["WaitForFrame"] = std::bind(&CanScriptHandler::WaitForFrame, this, 3, std::placeholders::_2);
-    m_operands["Sleep"] = std::bind(&CanScriptHandler::Sleep, this, 2, std::placeholders::_2);
-
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
     can_handler->RegisterObserver(this);
+
+    m_Scheduler = std::make_unique<std::jthread>(std::bind_front(&CanScriptHandler::SchedulerThread, this));
 }
 
 CanScriptHandler::~CanScriptHandler()
@@ -19,465 +31,574 @@ CanScriptHandler::~CanScriptHandler()
     if(can_handler.get())
         can_handler->UnregisterObserver(this);
 
-    AbortRunningScript();
+    m_Scheduler.reset();  /* Requests stop and joins */
 }
 
-void CanScriptHandler::ExecuteScript(std::string script)
+void CanScriptHandler::BuildSymbols(CanScriptSymbols& symbols)
 {
-    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
-    std::istringstream ss(script);
-    std::string line;
-    size_t line_cnt = 0;
-    while(std::getline(ss, line, '\n') && !m_IsAborted)
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    for(auto& [frame_id, name] : can_handler->m_frame_name_mapping)
     {
-        line_cnt++;
-
-        boost::algorithm::trim_right(line);
-        std::vector<std::string> params;
-        boost::split(params, line, boost::is_any_of(" "));
-
-        if(params[0].starts_with("#"))  /* Skip comments */
-            continue;
-
-        if(params[0].length() == 0)
-        {
-            LOG(LogLevel::Verbose, "Skipping empty line at line: {}", line_cnt);
-            continue;
-        }
+        uint8_t size = 8;
+        if(can_handler->m_frame_size_mapping.contains(frame_id))
+            size = can_handler->m_frame_size_mapping[frame_id];
+        symbols.frames[name] = { frame_id, size };
+    }
 
-        bool is_executed = false;
-        for(auto& [name, func] : m_operands)
+    for(auto& [frame_id, maps] : can_handler->GetMapping())
+    {
+        for(auto& [offset, m] : maps)
         {
-            if(!memcmp(params[0].c_str(), name.c_str(), params[0].length()))
+            CanScriptSignalSymbol signal;
+            signal.frame_id = frame_id;
+            signal.offset = offset;
+            signal.size = m->m_Size;
+            switch(m->m_Type)
             {
-                func(std::placeholders::_1, params);
-                is_executed = true;
-                break;
+                case CBT_I8:
+                case CBT_I16:
+                case CBT_I32:
+                case CBT_I64:
+                    signal.type = CSST_SIGNED;
+                    break;
+                case CBT_FLOAT:
+                    signal.type = CSST_FLOAT;
+                    break;
+                case CBT_DOUBLE:
+                    signal.type = CSST_DOUBLE;
+                    break;
+                default:
+                    signal.type = CSST_UNSIGNED;
+                    break;
             }
+            symbols.signals.try_emplace(m->m_Name, signal);  /* First mapping wins if the same name is used in more frames */
         }
+    }
+}
+
+uint32_t CanScriptHandler::RunScript(std::string script)
+{
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    CanScriptSymbols symbols;
+    BuildSymbols(symbols);
 
-        if(!is_executed)
+    CanScriptProgram program;
+    std::vector<std::string> errors;
+    if(!CanScriptCompiler::Compile(script, symbols, program, errors))
+    {
+        for(auto& i : errors)
         {
-            LOG(LogLevel::Warning, "Unknown script function name: {}", params[0]);
-            m_Result.AddToLog(std::format("Unknown script function name: {}\n", params[0]));
+            LOG(LogLevel::Error, "CAN script error: {}", i);
+            m_Result.AddToLog(std::format("{}\n", i));
         }
+        m_Result.AddToLog(std::format("Script compilation failed with {} error(s)\n", errors.size()));
+        return 0;
     }
 
     std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
     int64_t dif = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    LOG(LogLevel::Verbose, "CAN script compiled to {} instructions, {} variables, {} frames in {:.6f} ms",
+        program.code.size(), program.variables.size(), program.frames.size(), (double)dif / 1000000.0);
 
-    m_Result.AddToLog(std::format("Script finished {}. Execution took {:.6f} ms\n", m_IsAborted ? "by abort" : "successfully", (double)dif / 1000000.0));
-    m_IsAborted = false;
+    uint32_t id = 0;
+    {
+        std::unique_lock lk(cv_m);
+        id = m_NextId++;
+        m_Result.AddToLog(std::format("Script #{} started\n", id));
+        m_Tasks.push_back(std::make_unique<CanScriptTask>(id, std::move(program)));
+        m_TaskCount = m_Tasks.size();
+        m_IsNotified = true;
+    }
+    cv.notify_all();
+    return id;
 }
 
-void CanScriptHandler::AbortRunningScript()
+bool CanScriptHandler::IsScriptRunning() const
 {
-    m_IsAborted = true;
-    m_WaitingFrame = std::numeric_limits<uint32_t>::max();
-    m_WaitingFrameReceived = true;
-    cv.notify_all();
-
-    raw_frame_blocks.clear();
-    m_FrameIDValues.clear();
-
-    if(m_FutureHandle.valid())
-        if(m_FutureHandle.wait_for(std::chrono::milliseconds(10)) == std::future_status::ready)
-            m_FutureHandle.get();
-    //LOG(LogLevel::Normal, "Running script aborted");
+    return m_TaskCount != 0;
 }
 
-void CanScriptHandler::RunScript(std::string script)
+size_t CanScriptHandler::GetRunningScriptCount() const
 {
-    if(m_FutureHandle.valid())
-        if(m_FutureHandle.wait_for(std::chrono::nanoseconds(1)) != std::future_status::ready)
-            m_FutureHandle.get();
-
-    m_FutureHandle = std::async(&CanScriptHandler::ExecuteScript, this, script);
+    return m_TaskCount;
 }
 
-bool CanScriptHandler::IsScriptRunning() const
+std::vector<uint32_t> CanScriptHandler::GetRunningScriptIds()
 {
-    bool ret = false;
-    if(m_FutureHandle.valid())
-        if(m_FutureHandle.wait_for(std::chrono::nanoseconds(1)) != std::future_status::ready)
-            ret = true;
-    return ret;
+    std::vector<uint32_t> ids;
+    std::scoped_lock lk(cv_m);
+    ids.reserve(m_Tasks.size());
+    for(auto& task : m_Tasks)
+        ids.push_back(task->id);
+    return ids;
 }
 
-void CanScriptHandler::OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size)
+void CanScriptHandler::AbortScript(uint32_t id)
 {
-    if(m_WaitingFrame == frame_id && m_WaitingFrame != std::numeric_limits<uint32_t>::max() && !m_WaitingFrameReceived)
     {
         std::unique_lock lk(cv_m);
-        m_WaitingFrameReceived = true;
-        m_WaitingFrameData.assign(data, data + size);
-        cv.notify_all();
+        for(auto& task : m_Tasks)
+        {
+            if(task->id == id)
+                task->is_aborted = true;
+        }
+        m_IsNotified = true;
     }
+    cv.notify_all();
 }
 
-void CanScriptHandler::OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size)
-{
-
-}
-
-template <typename T> void CanScriptHandler::HandleBitWriting(uint32_t frame_id, uint8_t& pos, uint8_t offset, uint8_t size, uint8_t* byte_array, std::string& new_data)
+void CanScriptHandler::AbortRunningScript()
 {
-    T raw_data;
-    try
-    {
-        raw_data = static_cast<T>(std::stoll(new_data, nullptr, 16));
-        set_bitfield(raw_data, offset, size, byte_array, 64);
-    }
-    catch(const std::exception& e)
     {
-        LOG(LogLevel::Error, "Invalid input for pos {}. Exception: {}", pos, e.what());
+        std::unique_lock lk(cv_m);
+        for(auto& task : m_Tasks)
+            task->is_aborted = true;
+        m_IsNotified = true;
     }
-
-    //DBG("%s - %d, %x ......... %d\n", m.second->m_Name.c_str(), m.first, raw_data, m.second->m_Size);
-    pos++;
+    cv.notify_all();
 }
 
-void CanScriptHandler::ApplyEditingOnFrameId(uint32_t frame_id, const std::string field_name, std::string new_data)
+void CanScriptHandler::SchedulerThread(std::stop_token token)
 {
-    uint8_t cnt = 0;
-    uint8_t byte_array[8] = {};
-    
-    if(m_FrameIDValues.contains(frame_id))
-        memcpy(byte_array, (uint64_t*)&m_FrameIDValues[frame_id], sizeof(uint64_t));
-
-    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    CanMapping& m_mapping = can_handler->GetMapping();
-    if(m_mapping.contains(frame_id))
+    std::vector<CanScriptTask*> due;
+    while(!token.stop_requested())
     {
-        LOG(LogLevel::Normal, "MapSize: {}, NewDataSize: {}", m_mapping[frame_id].size(), new_data.size());
-        for(auto& [offset, m] : m_mapping[frame_id])
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
         {
-            if(m->m_Name == field_name)
+            std::unique_lock lk(cv_m);
+            m_IsNotified = false;
+            due.clear();
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            for(auto& task : m_Tasks)
             {
-                switch(m->m_Type)
+                CanScriptContext& ctx = task->ctx;
+                bool is_waiting = task->state == CSS_WAITING_FRAME;
+                bool is_due = task->is_aborted || task->state == CSS_RUNNING || (is_waiting && task->wait.result) ||
+                    ((task->state == CSS_SLEEPING || (is_waiting && !ctx.is_infinite_wait)) && ctx.deadline <= now);
+                if(is_due)
+                {
+                    if(is_waiting)
+                        RemoveWait(*task);  /* Result can't change after this point */
+                    due.push_back(task.get());
+                }
+                else if(!is_waiting || !ctx.is_infinite_wait)
                 {
-                    case CBT_BOOL:
-                    case CBT_UI8:
-                    {
-                        HandleBitWriting<uint8_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_I8:
-                    {
-                        HandleBitWriting<int8_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_UI16:
-                    {
-                        HandleBitWriting<uint16_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_I16:
-                    {
-                        HandleBitWriting<int16_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_UI32:
-                    {
-                        HandleBitWriting<uint32_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_I32:
-                    {
-                        HandleBitWriting<int32_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_UI64:
-                    {
-                        HandleBitWriting<uint64_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
-                    case CBT_I64:
-                    {
-                        HandleBitWriting<int64_t>(frame_id, cnt, offset, m->m_Size, byte_array, new_data);
-                        break;
-                    }
+                    next = std::min(next, ctx.deadline);
                 }
             }
+
+            if(due.empty() && next - now > CAN_SCRIPT_SPIN_THRESHOLD)
+            {
+                auto is_notified = [this]() { return m_IsNotified.load(); };
+                if(next == std::chrono::steady_clock::time_point::max())
+                    cv.wait(lk, token, is_notified);
+                else
+                    cv.wait_until(lk, token, next - CAN_SCRIPT_SPIN_THRESHOLD, is_notified);
+                continue;
+            }
         }
 
-        uint32_t reversed_1 = boost::endian::endian_reverse(*(uint32_t*)byte_array);
-        uint32_t reversed_2 = boost::endian::endian_reverse(*(uint32_t*)&byte_array[4]);
-        m_FrameIDValues[frame_id] = ((uint64_t)(uint64_t)reversed_1 << 32 | (uint64_t)reversed_2);
+        if(due.empty())  /* Last part of the sleep is busy-waited for microsecond precision */
+        {
+            while(std::chrono::steady_clock::now() < next && !m_IsNotified && !token.stop_requested())
+                std::this_thread::yield();
+            continue;
+        }
 
-        can_handler->AssignNewBufferToTxEntry(frame_id, byte_array, sizeof(byte_array));
+        for(CanScriptTask* task : due)
+            RunTask(*task);
+
+        std::unique_lock lk(cv_m);
+        std::erase_if(m_Tasks, [](const std::unique_ptr<CanScriptTask>& task) { return task->state == CSS_FINISHED || task->state == CSS_FAILED; });
+        m_TaskCount = m_Tasks.size();
+    }
 
-        MyFrame* frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
-        if(frame && frame->can_panel)
-            frame->can_panel->sender->UpdateGridForTxFrame(frame_id, byte_array);
+    std::unique_lock lk(cv_m);
+    for(auto& task : m_Tasks)
+    {
+        if(task->state == CSS_WAITING_FRAME)
+            RemoveWait(*task);
     }
-    DBG("ok");
 }
 
-CanScriptReturn CanScriptHandler::SetFrameField(std::any required_params, OperandParams& params)
+void CanScriptHandler::RunTask(CanScriptTask& task)
 {
-    if(!CheckParams(params.size(), std::any_cast<int>(required_params)))
-        return;
-
-    const std::string& field_name = params[1];
-    const std::string& frame_value = params[2];
-
-    try
+    CanScriptContext& ctx = task.ctx;
+    if(task.state == CSS_SLEEPING)
     {
-        //m_FrameValues[field_name] = strtoull(frame_value.c_str(), NULL, 16);
+        ctx.wake_time = ctx.deadline;  /* Next sleep is relative to the planned wake-up, not to the actual one */
     }
-    catch(const std::exception& e)
+    else if(task.state == CSS_WAITING_FRAME)
     {
-        LOG(LogLevel::Error, "Invalid SetFrameField script parameter, strtoull exception: {} (Input: {})", e.what(), frame_value);
-        return;
+        CompleteWait(task);
+        ctx.wake_time = std::chrono::steady_clock::now();
     }
 
-    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    CanMapping& mapping = can_handler->GetMapping();
+    if(task.is_aborted)
+    {
+        task.state = CSS_FINISHED;
+        FinishTask(task);
+        return;
+    }
 
-    uint32_t frame_id = 0;
-    for(auto& i : mapping)
+    task.state = Execute(ctx);
+    switch(task.state)
     {
-        for(auto& x : i.second)
+        case CSS_WAITING_FRAME:
         {
-            if(x.second->m_Name == field_name)
-            {
-                frame_id = i.first;
-                break;
-            }
+            std::unique_lock lk(cv_m);
+            AddWait(task);
+            break;
         }
-
-        if(frame_id != 0)
+        case CSS_FINISHED:
+        case CSS_FAILED:
+            FinishTask(task);
+            break;
+        default:
             break;
     }
+}
 
-    if(!frame_id)
+void CanScriptHandler::FinishTask(CanScriptTask& task)
+{
+    CanScriptContext& ctx = task.ctx;
+    if(!ctx.is_trace)  /* TX list hasn't been updated while tracing was disabled */
     {
-        LOG(LogLevel::Error, "FrameID {} isn't found", frame_id);
-        return;
+        for(uint32_t i = 0; i != ctx.frame_data.size(); i++)
+        {
+            if(ctx.is_frame_set[i])
+                UpdateTxEntry(ctx, i);
+        }
     }
 
-    ApplyEditingOnFrameId(frame_id, field_name, frame_value);
-
-    uint64_t data_to_send = m_FrameIDValues[frame_id];
-    uint8_t size_in_bytes = 8;
-    if(can_handler->m_frame_size_mapping.contains(frame_id))
-        size_in_bytes = can_handler->m_frame_size_mapping[frame_id];
-
-    uint8_t array_to_send[8];
-    memcpy(array_to_send, (uint8_t*)&data_to_send, sizeof(array_to_send));
-    std::reverse(std::begin(array_to_send), std::end(array_to_send));
-
-    std::string hex;
-    utils::ConvertHexBufferToString((const char*)array_to_send, size_in_bytes, hex);
-    m_Result.AddToLog(std::format("SetDataFrame {} (FrameID: {:X}, Size: {}, Data: {})\n", field_name, frame_id, size_in_bytes, hex));
+    int64_t dif = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - task.start_time).count();
+    const char* result = task.is_aborted ? "by abort" : task.state == CSS_FAILED ? "with error" : "successfully";
+    m_Result.AddToLog(std::format("Script #{} finished {}. Execution took {:.6f} ms\n", task.id, result, (double)dif / 1000000.0));
 }
 
-CanScriptReturn CanScriptHandler::SetFrameFieldRaw(std::any required_params, OperandParams& params)
+CanScriptState CanScriptHandler::Execute(CanScriptContext& ctx)
 {
-	/* TODO: finish this */
-    if(!CheckParams(params.size(), std::any_cast<int>(required_params)))
-        return;
-
-    const std::string& field_name = params[1];
-    std::string frame_value = params[2].starts_with("0x") ? params[2].substr(2) : params[2];
-
-    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    CanMapping& mapping = can_handler->GetMapping();
-
-    uint32_t frame_id = 0;
-    for(auto& i : mapping)
+    const std::vector<CanScriptInstruction>& code = ctx.program.code;
+    std::vector<CanScriptValue>& stack = ctx.stack;
+    size_t executed = 0;
+    while(true)
     {
-        for(auto& x : i.second)
+        if(++executed == CAN_SCRIPT_INSTRUCTION_SLICE)
+            return CSS_RUNNING;
+
+        const CanScriptInstruction& ins = code[ctx.pc++];
+        switch(ins.opcode)
         {
-            if(x.second->m_Name == field_name)
+            case CSO_PUSH_CONST:
+                stack.push_back(ctx.program.constants[ins.operand]);
+                break;
+            case CSO_LOAD_VAR:
+                stack.push_back(ctx.variables[ins.operand]);
+                break;
+            case CSO_STORE_VAR:
+                ctx.variables[ins.operand] = stack.back();
+                stack.pop_back();
+                break;
+            case CSO_LOAD_SIGNAL:
             {
-                frame_id = i.first;
+                const CanScriptSignal& signal = ctx.program.signals[ins.operand];
+                stack.push_back(ReadSignal(signal, ctx.frame_data[signal.frame].data()));
+                break;
+            }
+            case CSO_NEG:
+            case CSO_NOT:
+            case CSO_BIT_NOT:
+                CanScriptValue::ApplyUnary(ins.opcode, stack.back(), stack.back());
+                break;
+            case CSO_JUMP:
+                ctx.pc = ins.operand;
+                break;
+            case CSO_JUMP_IF_FALSE:
+            {
+                if(!stack.back().IsTrue())
+                    ctx.pc = ins.operand;
+                stack.pop_back();
+                break;
+            }
+            case CSO_SET_SIGNAL:
+            {
+                const CanScriptSignal& signal = ctx.program.signals[ins.operand];
+                WriteSignal(signal, stack.back(), ctx.frame_data[signal.frame].data());
+                ctx.is_frame_set[signal.frame] = true;
+                if(ctx.is_trace)
+                {
+                    const CanScriptFrame& frame = ctx.program.frames[signal.frame];
+                    std::string hex;
+                    utils::ConvertHexBufferToString((const char*)ctx.frame_data[signal.frame].data(), frame.size, hex);
+                    m_Result.AddToLog(std::format("SetDataFrame {} = {} (FrameID: {:X}, Size: {}, Data: {})\n", signal.name, stack.back().ToString(), frame.frame_id, frame.size, hex));
+                    UpdateTxEntry(ctx, signal.frame);
+                }
+                stack.pop_back();
+                break;
+            }
+            case CSO_SET_FRAME_RAW:
+            {
+                const CanScriptRawData& raw = ctx.program.raw_data[ins.operand];
+                ctx.frame_data[raw.frame] = raw.data;
+                ctx.is_frame_set[raw.frame] = true;
+                if(ctx.is_trace)
+                {
+                    const CanScriptFrame& frame = ctx.program.frames[raw.frame];
+                    std::string hex;
+                    utils::ConvertHexBufferToString((const char*)raw.data.data(), raw.data.size(), hex);
+                    m_Result.AddToLog(std::format("SetDataFrameRaw {} (FrameID: {:X}, Size: {}, Data: {})\n", frame.name, frame.frame_id, raw.data.size(), hex));
+                    UpdateTxEntry(ctx, raw.frame);
+                }
+                break;
+            }
+            case CSO_SEND_FRAME:
+                SendFrame(ctx, ins.operand);
+                break;
+            case CSO_WAIT_FRAME:
+            case CSO_WAIT_CONDITION:
+            {
+                int64_t timeout_ms = stack.back().AsInt();
+                stack.pop_back();
+                ctx.waiting_condition = ins.operand;
+                ctx.is_legacy_wait = ins.opcode == CSO_WAIT_FRAME;
+                ctx.is_infinite_wait = timeout_ms < 0 && !ctx.is_legacy_wait;
+                ctx.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max<int64_t>(0, timeout_ms));
+                return CSS_WAITING_FRAME;
+            }
+            case CSO_POP:
+                stack.pop_back();
+                break;
+            case CSO_SLEEP:
+            {
+                double sleep_us = std::max(0.0, stack.back().AsDouble());
+                stack.pop_back();
+                ctx.deadline = ctx.wake_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(sleep_us));
+                if(ctx.is_trace)
+                    m_Result.AddToLog(std::format("Wait {} us\n", sleep_us));
+                return CSS_SLEEPING;
+            }
+            case CSO_PRINT:
+                m_Result.AddToLog(std::format("{}\n", stack.back().ToString()));
+                stack.pop_back();
+                break;
+            case CSO_TRACE:
+                ctx.is_trace = ins.operand != 0;
+                break;
+            case CSO_HALT:
+                return CSS_FINISHED;
+            default:  /* Binary operators */
+            {
+                CanScriptValue rhs = stack.back();
+                stack.pop_back();
+                if(!CanScriptValue::ApplyBinary(ins.opcode, stack.back(), rhs, stack.back()))
+                {
+                    LOG(LogLevel::Error, "CAN script error at line {}: division by zero", ctx.program.lines[ctx.pc - 1]);
+                    m_Result.AddToLog(std::format("Line {}: division by zero\n", ctx.program.lines[ctx.pc - 1]));
+                    return CSS_FAILED;
+                }
                 break;
             }
         }
-
-        if(frame_id != 0)
-            break;
     }
+}
 
-    if(!frame_id)
+void CanScriptHandler::AddWait(CanScriptTask& task)
+{
+    CanScriptContext& ctx = task.ctx;
+    const CanScriptWaitCondition& condition = ctx.program.wait_conditions[ctx.waiting_condition];
+    if(ctx.is_legacy_wait)
     {
-        LOG(LogLevel::Error, "FrameID {} isn't found", frame_id);
-        return;
+        const CanScriptFrame& frame = ctx.program.frames[condition.predicates[0].frame];
+        m_Result.AddToLog(std::format("WaitForFrame START {}, timeout: {} ms (FrameID: {:X})\n", frame.name,
+            std::chrono::duration_cast<std::chrono::milliseconds>(ctx.deadline - std::chrono::steady_clock::now()).count(), frame.frame_id));
     }
-
-    if(frame_value.length() > 16)
+    else if(ctx.is_trace)
     {
-        LOG(LogLevel::Error, "Frame value is too long! Max supported bytes for a single frame is 8, but current are: {}", frame_value.length());
-        return;
+        m_Result.AddToLog(std::format("WaitFor START {}\n", condition.text));
     }
 
-    uint8_t array_to_send[8];
-    std::string hex_str;
-
-    if((frame_value.length() & 1))  /* Increase it's length if it's odd */
-        frame_value += frame_value.back();
-
-    utils::ConvertHexStringToBuffer(frame_value, std::span{ array_to_send });
-
-    raw_frame_blocks[frame_id] = std::vector<uint8_t>(array_to_send, array_to_send + sizeof(array_to_send));
+    task.wait = CanScriptActiveWait{};
+    task.wait.condition = &condition;
+    for(auto& [frame_id, mask] : condition.by_id)
+        m_WaitIndex[frame_id].push_back({ &task.wait, mask });
+    m_ActiveWaits++;
+}
 
-    std::string hex;
-    utils::ConvertHexBufferToString((const char*)array_to_send, sizeof(array_to_send), hex);
-    m_Result.AddToLog(std::format("SetDataFrameRaw {} (FrameID: {:X}, Size: {}, Data: {})\n", field_name, frame_id, sizeof(array_to_send), hex));
+void CanScriptHandler::RemoveWait(CanScriptTask& task)
+{
+    for(auto& [frame_id, mask] : task.wait.condition->by_id)
+    {
+        auto it = m_WaitIndex.find(frame_id);
+        std::erase_if(it->second, [&task](auto& p) { return p.first == &task.wait; });
+        if(it->second.empty())
+            m_WaitIndex.erase(it);
+    }
+    m_ActiveWaits--;
 }
 
-CanScriptReturn CanScriptHandler::SendFrame(std::any required_params, OperandParams& params)
+void CanScriptHandler::CompleteWait(CanScriptTask& task)
 {
-    if(!CheckParams(params.size(), std::any_cast<int>(required_params)))
+    CanScriptContext& ctx = task.ctx;
+    const CanScriptActiveWait& wait = task.wait;
+    if(ctx.is_legacy_wait)
+    {
+        LogWaitForFrameResult(task);
         return;
+    }
 
-    const std::string& frame_name = params[1];
-
-    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    uint32_t frame_id = can_handler->FindFrameIdOnMapByName(frame_name);
-    if(frame_id != 0)
+    ctx.stack.push_back(CanScriptValue(static_cast<int64_t>(wait.result)));
+    if(ctx.is_trace)
     {
-        CanMapping& m_mapping = can_handler->GetMapping();
-
-        if(m_FrameIDValues.contains(frame_id))
+        if(wait.result)
         {
-            uint64_t data_to_send = m_FrameIDValues[frame_id];
-            uint8_t size_in_bytes = 8;
-            if(can_handler->m_frame_size_mapping.contains(frame_id))
-                size_in_bytes = can_handler->m_frame_size_mapping[frame_id];
-
-            CanSerialPort::Get()->AddToTxQueue(frame_id, size_in_bytes, (uint8_t*)&data_to_send);
-
             std::string hex;
-            utils::ConvertHexBufferToString((const char*)&data_to_send, size_in_bytes, hex);
-            m_Result.AddToLog(std::format("SendFrame {} (FrameID: {:X}, Size: {}, Data: {})\n", frame_name, frame_id, size_in_bytes, hex));
+            utils::ConvertHexBufferToString((const char*)wait.data.data(), wait.size, hex);
+            m_Result.AddToLog(std::format("WaitFor OK, alternative {} (Last frame data: {})\n", wait.result, hex));
         }
-        else if(raw_frame_blocks.contains(frame_id))
+        else
         {
-            std::vector<uint8_t> to_send = raw_frame_blocks[frame_id];
-            CanSerialPort::Get()->AddToTxQueue(frame_id, 8, to_send.data());
-
-            uint8_t* sent_data = to_send.data();
-            std::string hex;
-            utils::ConvertHexBufferToString((const char*)sent_data, 8, hex);
-            m_Result.AddToLog(std::format("SendFrame {} (FrameID: {:X}, Size: {}, Data: {})\n", frame_name, frame_id, 8, hex));
+            m_Result.AddToLog(std::format("WaitFor FAILED with {} {}\n", task.is_aborted ? "ABORT" : "timeout", wait.condition->text));
         }
+    }
+}
+
+void CanScriptHandler::LogWaitForFrameResult(CanScriptTask& task)
+{
+    CanScriptContext& ctx = task.ctx;
+    const CanScriptActiveWait& wait = task.wait;
+    uint32_t frame_index = ctx.program.wait_conditions[ctx.waiting_condition].predicates[0].frame;
+    const CanScriptFrame& frame = ctx.program.frames[frame_index];
+    if(wait.result && !task.is_aborted)
+    {
+        const std::array<uint8_t, 8>& expected = ctx.frame_data[frame_index];
+        if(!ctx.is_frame_set[frame_index] || (wait.size >= frame.size && std::equal(expected.begin(), expected.begin() + frame.size, wait.data.begin())))
+            m_Result.AddToLog(std::format("WaitForFrame OK {} (FrameID: {:X})\n", frame.name, frame.frame_id));
         else
         {
-            m_Result.AddToLog("SetFrameField or SetFrameFieldRaw wasn't callbed before SendFrame\n");
-            return;
+            std::string recv;
+            utils::ConvertHexBufferToString((const char*)wait.data.data(), wait.size, recv);
+            std::string expected_str;
+            utils::ConvertHexBufferToString((const char*)expected.data(), frame.size, expected_str);
+
+            m_Result.AddToLog(std::format("WaitForFrame INVALID DATA Recv: {}, Expected: {} (FrameName: {}, FrameID: {:X})\n", recv, expected_str, frame.name, frame.frame_id));
         }
     }
+    else if(task.is_aborted)
+    {
+        m_Result.AddToLog(std::format("WaitForFrame FAILED with ABORT {} (FrameID: {:X})\n", frame.name, frame.frame_id));
+    }
     else
     {
-        m_Result.AddToLog(std::format("SendFrame {} failed (FrameID: {:X})\n", frame_name, frame_id));
+        m_Result.AddToLog(std::format("WaitForFrame FAILED with timeout {} (FrameID: {:X})\n", frame.name, frame.frame_id));
     }
 }
 
-CanScriptReturn CanScriptHandler::WaitForFrame(std::any required_params, OperandParams& params)
+void CanScriptHandler::SendFrame(CanScriptContext& ctx, uint32_t frame_index)
 {
-    if(!CheckParams(params.size(), std::any_cast<int>(required_params)))
-        return;
-
-    const std::string& field_name = params[1];
-    uint32_t wait_ms = 0;
-    try
+    const CanScriptFrame& frame = ctx.program.frames[frame_index];
+    if(!ctx.is_frame_set[frame_index])
     {
-        wait_ms = std::stoi(params[2]);
+        m_Result.AddToLog(std::format("SetFrameField or SetFrameFieldRaw wasn't called before SendFrame {}\n", frame.name));
+        return;
     }
-    catch(const std::exception& e)
+
+    uint8_t* data = ctx.frame_data[frame_index].data();
+    CanSerialPort::Get()->AddToTxQueue(frame.frame_id, frame.size, data);
+    if(ctx.is_trace)
     {
-        LOG(LogLevel::Error, "Invalid WaitForFrame script parameter, stoi exception: {} (Input: {})", e.what(), params[2]);
-        return;
+        std::string hex;
+        utils::ConvertHexBufferToString((const char*)data, frame.size, hex);
+        m_Result.AddToLog(std::format("SendFrame {} (FrameID: {:X}, Size: {}, Data: {})\n", frame.name, frame.frame_id, frame.size, hex));
     }
+}
+
+void CanScriptHandler::UpdateTxEntry(CanScriptContext& ctx, uint32_t frame_index)
+{
+    const CanScriptFrame& frame = ctx.program.frames[frame_index];
+    uint8_t* data = ctx.frame_data[frame_index].data();
 
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    CanMapping& mapping = can_handler->GetMapping();
+    can_handler->AssignNewBufferToTxEntry(frame.frame_id, data, frame.size);
 
-    uint32_t frame_id = 0;
-    for(auto& i : mapping)
+    MyFrame* main_frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
+    if(main_frame && main_frame->can_panel)
+        main_frame->can_panel->sender->UpdateGridForTxFrame(frame.frame_id, data);
+}
+
+CanScriptValue CanScriptHandler::ReadSignal(const CanScriptSignal& signal, const uint8_t* data)
+{
+    uint64_t raw = get_bitfield(data, 8, signal.offset, signal.size);
+    switch(signal.type)
     {
-        for(auto& x : i.second)
+        case CSST_SIGNED:
         {
-            if(x.second->m_Name == field_name)
-            {
-                frame_id = i.first;
-                break;
-            }
+            if(signal.size < 64 && (raw & (1ULL << (signal.size - 1))))  /* Sign extension */
+                raw |= ~0ULL << signal.size;
+            return CanScriptValue(static_cast<int64_t>(raw));
         }
-
-        if(frame_id != 0)
-            break;
+        case CSST_FLOAT:
+            return CanScriptValue(static_cast<double>(std::bit_cast<float>(static_cast<uint32_t>(raw))));
+        case CSST_DOUBLE:
+            return CanScriptValue(std::bit_cast<double>(raw));
+        default:
+            return CanScriptValue(static_cast<int64_t>(raw));
     }
+}
 
-    if(!frame_id)
+void CanScriptHandler::WriteSignal(const CanScriptSignal& signal, const CanScriptValue& value, uint8_t* data)
+{
+    uint64_t raw = 0;
+    switch(signal.type)
     {
-        LOG(LogLevel::Error, "FrameID {} isn't found", frame_id);
-        return;
+        case CSST_FLOAT:
+            raw = std::bit_cast<uint32_t>(static_cast<float>(value.AsDouble()));
+            break;
+        case CSST_DOUBLE:
+            raw = std::bit_cast<uint64_t>(value.AsDouble());
+            break;
+        default:
+            raw = static_cast<uint64_t>(value.AsInt());
+            break;
     }
 
-    m_Result.AddToLog(std::format("WaitForFrame START {}, timeout: {} (FrameID: {:X})\n", field_name, wait_ms, frame_id));
+    if(signal.size < 64)
+        raw &= (1ULL << signal.size) - 1;
+    set_bitfield(raw, signal.offset, signal.size, data, 8);
+}
+
+void CanScriptHandler::OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size)
+{
+    if(!m_ActiveWaits.load(std::memory_order_acquire))
+        return;
 
-    m_WaitingFrame = frame_id;
-    m_WaitingFrameReceived = false;
     std::unique_lock lk(cv_m);
-    auto now = std::chrono::system_clock::now();
-    bool ret = cv.wait_until(lk, now + std::chrono::milliseconds(wait_ms), [this]() { return m_WaitingFrameReceived || m_IsAborted.load(); });
-    if(ret)
+    auto it = m_WaitIndex.find(frame_id);
+    if(it == m_WaitIndex.end())
+        return;
+
+    bool is_satisfied = false;
+    for(auto& [wait, candidates] : it->second)
     {
-        if(m_WaitingFrameReceived && !m_IsAborted)
-        {
-            if(raw_frame_blocks[frame_id] == m_WaitingFrameData)
-                m_Result.AddToLog(std::format("WaitForFrame OK {} (FrameID: {:X})\n", field_name, frame_id));
-            else
-            {
-                std::string recv;
-                utils::ConvertHexBufferToString((const char*)m_WaitingFrameData.data(), m_WaitingFrameData.size(), recv);
-                std::string expected;
-                utils::ConvertHexBufferToString((const char*)raw_frame_blocks[frame_id].data(), raw_frame_blocks[frame_id].size(), expected);
+        if(wait->result)
+            continue;
 
-                m_Result.AddToLog(std::format("WaitForFrame INVALID DATA Recv: {}, Expected: {} (FrameName: {}, FrameID: {:X})\n", recv, expected, field_name, frame_id));
-            }
-        }
-        else
+        wait->result = wait->condition->OnFrame(candidates, wait->latched, data, size);
+        if(wait->result)
         {
-            m_Result.AddToLog(std::format("WaitForFrame FAILED with ABORT {} (FrameID: {:X})\n", field_name, frame_id));
+            wait->size = std::min<uint16_t>(size, static_cast<uint16_t>(wait->data.size()));
+            std::copy(data, data + wait->size, wait->data.begin());
+            is_satisfied = true;
         }
     }
-    else
+
+    if(is_satisfied)
     {
-        m_Result.AddToLog(std::format("WaitForFrame FAILED with timeout {} (FrameID: {:X})\n", field_name, frame_id));
+        m_IsNotified = true;
+        cv.notify_all();
     }
-    m_WaitingFrame = std::numeric_limits<uint32_t>::max();
-    m_WaitingFrameReceived = false;
-    raw_frame_blocks.erase(frame_id);
 }
 
-CanScriptReturn CanScriptHandler::Sleep(std::any required_params, OperandParams& params)
+void CanScriptHandler::OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size)
 {
-    if(!CheckParams(params.size(), std::any_cast<int>(required_params)))
-        return;
 
-    uint32_t sleep_ms = 0;
-    try
-    {
-        sleep_ms = std::stoi(params[1]);
-    }
-    catch(const std::exception& e)
-    {
-        LOG(LogLevel::Error, "Invalid Sleep script parameter, stoi exception: {} (Input: {})", e.what(), params[1]);
-        return;
-    }
-
-    m_Result.AddToLog(std::format("Wait {} ms... ", sleep_ms));
-
-    std::unique_lock lk(cv_m);
-    auto now = std::chrono::system_clock::now();
-    bool ret = cv.wait_until(lk, now + std::chrono::milliseconds(sleep_ms), [this]() {return m_IsAborted.load(); });
-    if(ret)  /* This is in reverse */
-        m_Result.AddToLog("Aborted\n");
-    else
-        m_Result.AddToLog("OK\n");
-}
\ No newline at end of file
+}
@@ -2,12 +2,106 @@
 
 #include "ICanResultPanel.hpp"
 #include "ICanObserver.hpp"
+#include "CanScriptCompiler.hpp"
 #include "Logger.hpp"
 
 #include <map>
 
-using CanScriptReturn = void;
-using OperandParams = std::vector<std::string>;
+/* Last part of each sleep is busy-waited, because the OS scheduler can't wake up a thread with microsecond precision */
+constexpr auto CAN_SCRIPT_SPIN_THRESHOLD = std::chrono::microseconds(2000);
+
+/* Scripts yield to the others after this many instructions, so a script without sleep can't block the rest */
+constexpr size_t CAN_SCRIPT_INSTRUCTION_SLICE = 4096;
+
+enum CanScriptState : uint8_t
+{
+    CSS_RUNNING, CSS_SLEEPING, CSS_WAITING_FRAME, CSS_FINISHED, CSS_FAILED
+};
+
+class CanScriptContext
+{
+public:
+    CanScriptContext(CanScriptProgram&& program_);
+
+    // !\brief Compiled program
+    CanScriptProgram program;
+
+    // !\brief Program counter
+    uint32_t pc = 0;
+
+    // !\brief Expression stack
+    std::vector<CanScriptValue> stack;
+
+    // !\brief Variable slots
+    std::vector<CanScriptValue> variables;
+
+    // !\brief Data of frames referenced by the program, index is the same as CanScriptProgram::frames
+    std::vector<std::array<uint8_t, 8>> frame_data;
+
+    // !\brief Has the frame data been set?
+    std::vector<bool> is_frame_set;
+
+    // !\brief Time base for Sleep, sleeps are relative to the last wake-up so loops don't drift
+    std::chrono::steady_clock::time_point wake_time;
+
+    // !\brief Deadline of sleep or frame wait
+    std::chrono::steady_clock::time_point deadline;
+
+    // !\brief Index of CanScriptProgram::wait_conditions being waited for
+    uint32_t waiting_condition = 0;
+
+    // !\brief Is the wait issued by WaitForFrame? It compares the data with the frame buffer instead of pushing a result
+    bool is_legacy_wait = false;
+
+    // !\brief Is the wait without timeout?
+    bool is_infinite_wait = false;
+
+    // !\brief Are operations logged?
+    bool is_trace = true;
+};
+
+class CanScriptActiveWait
+{
+public:
+    // !\brief Condition being waited for
+    const CanScriptWaitCondition* condition = nullptr;
+
+    // !\brief Predicates which have been satisfied so far
+    uint64_t latched = 0;
+
+    // !\brief Satisfied alternative + 1, 0 while waiting
+    uint8_t result = 0;
+
+    // !\brief Data of the frame which completed the condition
+    std::array<uint8_t, 8> data = {};
+
+    // !\brief Length of data
+    uint16_t size = 0;
+};
+
+class CanScriptTask
+{
+public:
+    CanScriptTask(uint32_t id_, CanScriptProgram&& program);
+
+    // !\brief Script ID, tasks are resumed in ID order when more of them are due
+    uint32_t id;
+
+    // !\brief Execution context
+    CanScriptContext ctx;
+
+    // !\brief State after the last time slice
+    CanScriptState state = CSS_RUNNING;
+
+    // !\brief Frame wait of the task, registered in the RX index while state is CSS_WAITING_FRAME
+    CanScriptActiveWait wait;
+
+    // !\brief Is the task aborted?
+    std::atomic<bool> is_aborted{};
+
+    // !\brief Start time of the script
+    std::chrono::steady_clock::time_point start_time;
+};
 
 class CanScriptHandler : public ICanObserver
 {
@@ -15,78 +109,101 @@ public:
     CanScriptHandler(ICanResultPanel& result_panel);
     ~CanScriptHandler();
 
-    // !\brief Execute script
+    // !\brief Compile script and start it next to the already running ones
     // !\param script Script to execute
-    void RunScript(std::string script);
+    // !\return ID of the started script, 0 if the script couldn't be compiled
+    uint32_t RunScript(std::string script);
 
-    // !\brief Is script running
+    // !\brief Is any script running
     // !\return true if script is running, otherwise false
     bool IsScriptRunning() const;
 
-    // !\brief Abort running script
+    // !\brief Get number of running scripts
+    size_t GetRunningScriptCount() const;
+
+    // !\brief Get IDs of running scripts
+    // !\return IDs in start order
+    std::vector<uint32_t> GetRunningScriptIds();
+
+    // !\brief Abort a running script
+    // !\param id [in] ID returned by RunScript
+    void AbortScript(uint32_t id);
+
+    // !\brief Abort all running scripts
     void AbortRunningScript();
 
 private:
-    // !\brief Check if params count is correct
-    // !\param actual Actual params count
-    // !\param required Required params count
-    bool __forceinline CheckParams(uint8_t actual, uint8_t required)
-    {
-        if(actual != required)
-        {
-            LOG(LogLevel::Error, "Invalid param count. {} should be instead of {}", required, actual);
-            return false;
-        }
-        return true;
-    }
-
-    // !\brief Execute script
-    // !\param script Script to execute
-    void ExecuteScript(std::string script);
+    // !\brief Collect frames and signals from CAN mapping for the compiler
+    void BuildSymbols(CanScriptSymbols& symbols);
 
-    template <typename T> void HandleBitWriting(uint32_t frame_id, uint8_t& pos, uint8_t offset, uint8_t size, uint8_t* byte_array, std::string& new_data);
-    void ApplyEditingOnFrameId(uint32_t frame_id, const std::string field_name, std::string new_data);
+    // !\brief Scheduler thread, runs every script as a cooperative task
+    void SchedulerThread(std::stop_token token);
 
-    CanScriptReturn SetFrameField(std::any required_params, OperandParams& params);
-    CanScriptReturn SetFrameFieldRaw(std::any required_params, OperandParams& params);
-    CanScriptReturn SendFrame(std::any required_params, OperandParams& params);
-    CanScriptReturn WaitForFrame(std::any required_params, OperandParams& params);
-    CanScriptReturn Sleep(std::any required_params, OperandParams& params);
+    // !\brief Resume task until it sleeps, waits, finishes or its time slice is over
+    void RunTask(CanScriptTask& task);
 
-    void OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size) override;
-    void OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size) override;
+    // !\brief Log result of the task and update TX list if it's needed
+    void FinishTask(CanScriptTask& task);
+
+    // !\brief Run instructions until the script sleeps, waits, finishes or its time slice is over
+    // !\param ctx [in/out] Script context
+    // !\return State of the script
+    CanScriptState Execute(CanScriptContext& ctx);
 
-    // !\brief Bound operands
-    std::map<std::string, std::function<CanScriptReturn(std::any, OperandParams&)>> m_operands;
+    // !\brief Register wait of the task in the RX index, cv_m has to be locked
+    void AddWait(CanScriptTask& task);
 
-    // !\brief Frame values set by SetFrameField
-    std::map<uint32_t, uint64_t> m_FrameIDValues;
+    // !\brief Remove wait of the task from the RX index, cv_m has to be locked
+    void RemoveWait(CanScriptTask& task);
+
+    // !\brief Handle result of a finished wait
+    void CompleteWait(CanScriptTask& task);
+
+    // !\brief Log result of WaitForFrame, the received data is compared with the frame buffer
+    void LogWaitForFrameResult(CanScriptTask& task);
+
+    // !\brief Send frame from the context
+    void SendFrame(CanScriptContext& ctx, uint32_t frame);
+
+    // !\brief Update TX entry and TX grid with the frame data set by the script
+    void UpdateTxEntry(CanScriptContext& ctx, uint32_t frame);
+
+    // !\brief Read signal value from the frame data
+    static CanScriptValue ReadSignal(const CanScriptSignal& signal, const uint8_t* data);
+
+    // !\brief Write signal value to the frame data
+    static void WriteSignal(const CanScriptSignal& signal, const CanScriptValue& value, uint8_t* data);
+
+    void OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size) override;
+    void OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size) override;
 
     // !\brief Result panel
     ICanResultPanel& m_Result;
 
-    // !\brief Is running script aborted?
-    std::atomic<bool> m_IsAborted{};
+    // !\brief Running tasks in ID order, guarded by cv_m. Only the scheduler thread removes tasks and touches their contexts
+    std::vector<std::unique_ptr<CanScriptTask>> m_Tasks;
 
-    // !\brief Conditon variable for waiting
-    std::condition_variable cv;
+    // !\brief Number of tasks in m_Tasks
+    std::atomic<size_t> m_TaskCount{};
 
-    // !\brief Mutex for condition variable
-    std::mutex cv_m;
+    // !\brief ID of the next script
+    uint32_t m_NextId = 1;
 
-    // !\brief Waiting Frame ID
-    uint32_t m_WaitingFrame = std::numeric_limits<uint32_t>::max();
+    // !\brief Is there anything new for the scheduler? (new task, abort, satisfied wait)
+    std::atomic<bool> m_IsNotified{};
 
-    // !\brief Is the frame received which we are waiting for?
-    bool m_WaitingFrameReceived = false;
+    // !\brief Conditon variable for waking up the scheduler
+    std::condition_variable_any cv;
 
-    // !\brief Data received for the waiting frame
-    std::vector<uint8_t> m_WaitingFrameData;
+    // !\brief Mutex for condition variable
+    std::mutex cv_m;
 
-    // !\brief Future for executing CAN script
-    std::future<void> m_FutureHandle;
+    // !\brief Active waits by CAN Frame ID [frame_id] = (wait, mask of predicates on this ID), guarded by cv_m
+    std::unordered_map<uint32_t, std::vector<std::pair<CanScriptActiveWait*, uint64_t>>> m_WaitIndex;
 
-    // !\brief RAW frame values set by SetFrameFieldRaw
-    std::map<uint16_t, std::vector<uint8_t>> raw_frame_blocks;
+    // !\brief Number of active waits, RX path returns without locking when it's zero
+    std::atomic<size_t> m_ActiveWaits{};
 
-};
\ No newline at end of file
+    // !\brief Scheduler thread
+    std::unique_ptr<std::jthread> m_Scheduler;
+};
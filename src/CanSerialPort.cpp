@@ -1,25 +1,35 @@
 #include "pch.hpp"
 
-constexpr size_t TX_QUEUE_MAX_SIZE = 100;
 constexpr size_t RX_CIRCBUFF_SIZE = 1024;  /* Bytes */
 constexpr size_t CAN_SERIAL_TX_BUFFER_SIZE = 64;
 constexpr auto CAN_SERIAL_PORT_TIMEOUT = 5000ms;
 constexpr auto CAN_SERIAL_PORT_EXCEPTION_TIMEOUT = 1000ms;
 constexpr auto SEND_DELAY_BETWEEN_FRAMES = 100us;
 
-CanSerialPort::CanSerialPort() : m_CircBuff(RX_CIRCBUFF_SIZE)
+CanSerialPort::CanSerialPort() : m_CircBuff(RX_CIRCBUFF_SIZE),
+    m_StressGenerator([this](uint32_t frame_id, const uint8_t* data, uint8_t size) { return AddToTxQueue(frame_id, size, data); })
 {
 
 }
 
 CanSerialPort::~CanSerialPort()
 {
-
+    m_StressGenerator.Stop();
+    DestroyWorkerThread();  /* Worker thread uses m_Device */
 }
 
 void CanSerialPort::Init()
 {
-    if(is_enabled)
+    if(is_enabled && m_DeviceType == CanDeviceType::SIMULATOR)
+    {
+        m_Device = std::make_unique<CanDeviceSimulator>(ECU_SIMULATOR_CONFIG_FILENAME);
+        if(!m_worker)
+        {
+            m_worker = std::make_unique<std::jthread>(std::bind_front(&CanSerialPort::DeviceWorkerThread, this));
+            utils::SetThreadName(*m_worker, "CanSerialPort");
+        }
+    }
+    else if(is_enabled)
     {
         auto recv_f = std::bind(&CanSerialPort::OnDataReceived, this, std::placeholders::_1, std::placeholders::_2);
         auto send_f = std::bind(&CanSerialPort::OnDataSent, this, std::placeholders::_1);
@@ -40,29 +50,46 @@ void CanSerialPort::SetDevice(std::unique_ptr<ICanDevice>&& device)
     m_Device = std::move(device);
 }
 
-void CanSerialPort::AddToTxQueue(uint32_t frame_id, uint8_t data_len, uint8_t* data)
+bool CanSerialPort::AddToTxQueue(uint32_t frame_id, uint8_t data_len, const uint8_t* data, bool can_block)
 {
     if(!data || !data_len)
-        return;
-    std::unique_lock lock(m_mutex);
-    m_TxQueue.push(std::make_unique<CanData>(frame_id, data_len, data));
+        return false;
+    /* Not under m_mutex, because the Block overflow policy waits here for SendPendingCanFrames */
+    if(!m_TxQueue.Push(frame_id, data_len, data, can_block))
+        return false;
 
-    if(m_TxQueue.size() > TX_QUEUE_MAX_SIZE)
-    {
-        //LOG(LogLevel::Error, "Queue overflow");
-        m_TxQueue.pop();
-    }
+    std::unique_lock lock(m_mutex);
     NotifiyMainThread();
+    return true;
 }
 
 void CanSerialPort::AddToRxQueue(uint32_t frame_id, uint8_t data_len, uint8_t* data)
 {
+    if(m_Gateway.IsEnabled())
+    {
+        /* Forwarded before the frame is passed to the entry handler, so recording and scripts don't add latency */
+        uint32_t forward_id = frame_id;
+        uint8_t forward_data[MAX_CAN_FRAME_DATA_LEN];
+        uint8_t forward_len = std::min<uint8_t>(data_len, sizeof(forward_data));
+        memcpy(forward_data, data, forward_len);
+        /* This thread drains the TX queue too, so it can't wait for free space */
+        if(m_Gateway.Process(forward_id, forward_data, forward_len, std::chrono::steady_clock::now()))
+            AddToTxQueue(forward_id, forward_len, forward_data, false);
+    }
+
     //std::unique_lock lock(m_mutex);
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
     if(can_handler)
         can_handler->OnFrameReceived(frame_id, data_len, data);
 }
 
+void CanSerialPort::OnErrorFrame()
+{
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    if(can_handler)
+        can_handler->OnErrorFrame();
+}
+
 void CanSerialPort::OnDataReceived(const char* data, unsigned int len)
 {
     std::scoped_lock guard(m_RxMutex);
@@ -73,32 +100,49 @@ void CanSerialPort::OnDataReceived(const char* data, unsigned int len)
 void CanSerialPort::OnDataSent(CallbackAsyncSerial& serial_port)
 {
     m_Device->ProcessReceivedFrames(m_RxMutex);
-    SendPendingCanFrames(serial_port);
+    SendPendingCanFrames(&serial_port);
+}
+
+void CanSerialPort::DeviceWorkerThread(std::stop_token token)
+{
+    m_is_ok = true;
+    while(!token.stop_requested())
+    {
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait_for(lock, token, CAN_SERIAL_PORT_TIMEOUT, [this]() { return is_notification_pending != 0; });
+        }
+
+        is_notification_pending = false;
+        SendPendingCanFrames(nullptr);
+    }
+    m_is_ok = false;
 }
 
-void CanSerialPort::SendPendingCanFrames(CallbackAsyncSerial& serial_port)
+void CanSerialPort::SendPendingCanFrames(CallbackAsyncSerial* serial_port)
 {
-    //DBG("txssize: %lld\n", m_TxQueue.size());
-    while(!m_TxQueue.empty())
+    CanData frame;
+    uint64_t sequence;
+    while(m_TxQueue.Front(frame, sequence))
     {
-        std::shared_ptr<CanData> data_ptr = m_TxQueue.front();
         bool is_remove = false;
 
         {
             std::scoped_lock lock(m_mutex);
             char data[CAN_SERIAL_TX_BUFFER_SIZE];
-            size_t size = m_Device->PrepareSendDataFormat(data_ptr, data, sizeof(data), is_remove);
+            size_t size = m_Device->PrepareSendDataFormat(frame, data, sizeof(data), is_remove);
 
-            if(size)
-                serial_port.write((const char*)&data, size);
+            if(size && serial_port)
+                serial_port->write((const char*)&data, size);
         }
 
         std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-        can_handler->OnFrameSent(data_ptr->frame_id, data_ptr->data_len, data_ptr->data);
+        can_handler->OnFrameSent(frame.frame_id, frame.data_len, frame.data);
 
         if(is_remove)
-            m_TxQueue.pop();
+            m_TxQueue.Pop(sequence);
 
-        std::this_thread::sleep_for(SEND_DELAY_BETWEEN_FRAMES);  /* This delay is needed because UART timeout won't happen if everything is sent at once */
+        if(serial_port)
+            std::this_thread::sleep_for(SEND_DELAY_BETWEEN_FRAMES);  /* This delay is needed because UART timeout won't happen if everything is sent at once */
     }
 }
\ No newline at end of file
@@ -5,34 +5,16 @@
 #include <semaphore>
 #include <boost/circular_buffer.hpp>
 #include <ICanDevice.hpp>
-
-constexpr size_t MAX_CAN_FRAME_DATA_LEN = 8;
+#include "CanGateway.hpp"
+#include "CanTxQueue.hpp"
+#include "CanStressGenerator.hpp"
 
 enum class CanDeviceType
 {
     STM32,
-    LAWICEL
-};
-
-#pragma pack(push, 1)
-class CanData
-{
-public:
-    CanData(uint32_t frame_id_, uint8_t data_len, uint8_t* data_)
-        : frame_id(frame_id_), data_len(data_len)
-    {
-        memset(data, 0, sizeof(data));
-        if(data_len > sizeof(data))
-            data_len = sizeof(data);
-
-        if(data_)
-            memcpy(data, data_, data_len);
-    }
-    uint32_t frame_id;
-    uint8_t data_len;
-    uint8_t data[MAX_CAN_FRAME_DATA_LEN];
+    LAWICEL,
+    SIMULATOR
 };
-#pragma pack(pop)
 
 /* TODO: create asbtraction for this & SerialPort because it's the same - but no time currently */
 class CallbackAsyncSerial;
@@ -57,13 +39,28 @@ public:
     void SetDevice(std::unique_ptr<ICanDevice>&& device);
 
     // !\brief Add CAN frame to TX queue
-    void AddToTxQueue(uint32_t frame_id, uint8_t data_len, uint8_t* data);
+    // !\param can_block [in] May wait for free space with the Block overflow policy? Has to be false under CanEntryHandler::m and on the consumer thread
+    // !\return False if the frame was dropped
+    bool AddToTxQueue(uint32_t frame_id, uint8_t data_len, const uint8_t* data, bool can_block = true);
 
     // !\brief Add CAN frame to RX queue
     void AddToRxQueue(uint32_t frame_id, uint8_t data_len, uint8_t* data);
 
+    // !\brief Report error or corrupted frame received from CAN device
+    void OnErrorFrame();
+
     // !\brief Send pending CAN Frames from the internal buffer
-    void SendPendingCanFrames(CallbackAsyncSerial& serial_port);
+    // !\param serial_port [in] Pointer to serial port, nullptr if the CAN device isn't a serial device
+    void SendPendingCanFrames(CallbackAsyncSerial* serial_port);
+
+    // !\brief Get gateway which forwards received frames back to the TX queue
+    CanGateway& GetGateway() { return m_Gateway; }
+
+    // !\brief Get TX queue for its settings and counters
+    CanTxQueue& GetTxQueue() { return m_TxQueue; }
+
+    // !\brief Get stress generator which feeds the TX queue
+    CanStressGenerator& GetStressGenerator() { return m_StressGenerator; }
 
 private:
     // !\brief Called when data was received via serial port (called by boost::asio::read_some)
@@ -74,6 +71,9 @@ private:
     // !\brief On data sent
     void OnDataSent(CallbackAsyncSerial& serial_port);
 
+    // !\brief Worker thread for CAN devices which don't use serial port
+    void DeviceWorkerThread(std::stop_token token);
+
     // !\brief Mutex for received data processing
     std::mutex m_RxMutex;
 
@@ -81,11 +81,17 @@ private:
     boost::circular_buffer<char> m_CircBuff;
 
     // !\brief CAN Tx Queue
-    std::queue<std::shared_ptr<CanData>> m_TxQueue;
+    CanTxQueue m_TxQueue;
 
     // !\brief CAN Device
     std::unique_ptr<ICanDevice> m_Device = nullptr;
 
     // !\brief CAN Device type
     CanDeviceType m_DeviceType = CanDeviceType::STM32;
+
+    // !\brief Gateway, runs in the RX dispatch path
+    CanGateway m_Gateway;
+
+    // !\brief Stress generator, it has to be destroyed before the TX queue
+    CanStressGenerator m_StressGenerator;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "pch.hpp"
+
+static constexpr std::array<std::string_view, CBT_INVALID + 1> s_CanBitfieldTypeNames
+{
+    "bool", "uint8_t", "int8_t", "uint16_t", "int16_t", "uint32_t", "int32_t", "uint64_t", "int64_t", "float", "double", "invalid"
+};
+
+bool CanSignalDecoder::LoadMapping(const std::filesystem::path& path)
+{
+    bool ret = true;
+    m_Frames.clear();
+    m_SignalCount = 0;
+    boost::property_tree::ptree pt;
+    try
+    {
+        read_xml(path.generic_string(), pt);
+        for(const boost::property_tree::ptree::value_type& v : pt.get_child("CanFrameMapping")) /* loop over each Frame */
+        {
+            std::string frame_id_str = v.second.get_child("ID").get_value<std::string>();
+            CanFrameDefinition frame;
+            try
+            {
+                frame.frame_id = std::stoul(frame_id_str, nullptr, 16);
+            }
+            catch(const std::exception& e)
+            {
+                LOG(LogLevel::Error, "Invalid FrameID format, stoul exception: {} (FrameID: {})", e.what(), frame_id_str);
+                continue;
+            }
+
+            frame.name = v.second.get_child("Name").get_value<std::string>();
+            frame.size = static_cast<uint8_t>(v.second.get_child("Size").get_value<uint16_t>());
+            for(const boost::property_tree::ptree::value_type& m : v.second) /* loop over each nested child */
+            {
+                if(m.first != "Mapping")
+                    continue;
+
+                CanSignalDefinition signal;
+                signal.name = m.second.get_value<std::string>();
+                signal.offset = static_cast<uint8_t>(m.second.get<uint16_t>("<xmlattr>.offset"));
+                signal.size = static_cast<uint8_t>(m.second.get<uint16_t>("<xmlattr>.len"));
+                signal.type = GetTypeFromString(m.second.get<std::string>("<xmlattr>.type"));
+                if(signal.type == CBT_INVALID || signal.size == 0 || signal.size > 64)
+                {
+                    LOG(LogLevel::Warning, "Invalid signal in frame mapping. FrameID: {:X}, Name: {}", frame.frame_id, signal.name);
+                    continue;
+                }
+
+                auto it = std::ranges::find(frame.signals, signal.offset, &CanSignalDefinition::offset);
+                if(it != frame.signals.end())
+                {
+                    LOG(LogLevel::Warning, "Duplicate offset for FrameID: {:X}, Name: {}, Offset: {} - skipping this one", frame.frame_id, signal.name, signal.offset);
+                    continue;
+                }
+                frame.signals.push_back(std::move(signal));
+            }
+            std::ranges::sort(frame.signals, {}, &CanSignalDefinition::offset);
+            m_Frames[frame.frame_id] = std::move(frame);
+        }
+    }
+    catch(const boost::property_tree::xml_parser_error& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}, {}", e.filename(), e.what());
+        ret = false;
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}", e.what());
+        ret = false;
+    }
+
+    for(auto& [frame_id, frame] : m_Frames)  /* Indexes are assigned after loading, so they're stable regardless of the file order */
+    {
+        for(auto& signal : frame.signals)
+            signal.index = m_SignalCount++;
+    }
+    return ret;
+}
+
+const CanFrameDefinition* CanSignalDecoder::FindFrame(uint32_t frame_id) const
+{
+    auto it = m_Frames.find(frame_id);
+    return it != m_Frames.end() ? &it->second : nullptr;
+}
+
+bool CanSignalDecoder::Decode(const CanSignalDefinition& signal, const uint8_t* data, uint8_t size, double& value)
+{
+    if(signal.offset + signal.size > size * 8)
+        return false;
+
+    uint64_t raw = get_bitfield(data, size, signal.offset, signal.size);
+    switch(signal.type)
+    {
+        case CBT_I8:
+        case CBT_I16:
+        case CBT_I32:
+        case CBT_I64:
+        {
+            if(signal.size < 64 && (raw & (1ULL << (signal.size - 1))))  /* Sign extension */
+                raw |= ~0ULL << signal.size;
+            value = static_cast<double>(static_cast<int64_t>(raw));
+            break;
+        }
+        case CBT_FLOAT:
+            value = static_cast<double>(std::bit_cast<float>(static_cast<uint32_t>(raw)));
+            break;
+        case CBT_DOUBLE:
+            value = std::bit_cast<double>(raw);
+            break;
+        default:
+            value = static_cast<double>(raw);
+            break;
+    }
+    return true;
+}
+
+CanBitfieldType CanSignalDecoder::GetTypeFromString(std::string_view input)
+{
+    for(uint8_t i = 0; i != CBT_INVALID; i++)
+    {
+        if(s_CanBitfieldTypeNames[i] == input)
+            return static_cast<CanBitfieldType>(i);
+    }
+    return CBT_INVALID;
+}
+
+std::string_view CanSignalDecoder::GetStringFromType(CanBitfieldType type)
+{
+    return s_CanBitfieldTypeNames[std::min<size_t>(type, CBT_INVALID)];
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <inttypes.h>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum CanBitfieldType : uint8_t
+{
+    CBT_BOOL, CBT_UI8, CBT_I8, CBT_UI16, CBT_I16, CBT_UI32, CBT_I32, CBT_UI64, CBT_I64, CBT_FLOAT, CBT_DOUBLE, CBT_INVALID
+};
+
+class CanSignalDefinition
+{
+public:
+    // !\brief Signal name
+    std::string name;
+
+    // !\brief Signal type
+    CanBitfieldType type = CBT_UI8;
+
+    // !\brief Bit offset in the frame
+    uint8_t offset = 0;
+
+    // !\brief Bit length
+    uint8_t size = 0;
+
+    // !\brief Index of the signal in the whole mapping, in Frame ID and offset order
+    uint32_t index = 0;
+};
+
+class CanFrameDefinition
+{
+public:
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Frame name
+    std::string name;
+
+    // !\brief Data length
+    uint8_t size = 0;
+
+    // !\brief Signals in offset order
+    std::vector<CanSignalDefinition> signals;
+};
+
+/* Frame mapping without the GUI customizations, usable without wxWidgets */
+class CanSignalDecoder
+{
+public:
+    // !\brief Load frame mapping (FrameMapping.xml)
+    // !\param path [in] Path to XML file
+    // !\return False if the file can't be parsed, invalid entries are skipped with a warning
+    bool LoadMapping(const std::filesystem::path& path);
+
+    // !\brief Find frame definition
+    // !\param frame_id [in] CAN Frame ID
+    // !\return Frame definition or nullptr if the frame isn't mapped
+    const CanFrameDefinition* FindFrame(uint32_t frame_id) const;
+
+    // !\brief Get frame definitions by Frame ID
+    const std::map<uint32_t, CanFrameDefinition>& GetFrames() const { return m_Frames; }
+
+    // !\brief Get number of signals in the mapping
+    uint32_t GetSignalCount() const { return m_SignalCount; }
+
+    // !\brief Decode signal, signed types are sign extended from their bit length
+    // !\param signal [in] Signal
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length
+    // !\param value [out] Decoded value
+    // !\return False if the signal doesn't fit into the frame data
+    static bool Decode(const CanSignalDefinition& signal, const uint8_t* data, uint8_t size, double& value);
+
+    // !\brief Convert type name from the mapping (eg. "uint8_t") to type
+    static CanBitfieldType GetTypeFromString(std::string_view input);
+
+    // !\brief Convert type to type name used in the mapping
+    static std::string_view GetStringFromType(CanBitfieldType type);
+
+private:
+    // !\brief Frame definitions [frame_id] = frame
+    std::map<uint32_t, CanFrameDefinition> m_Frames;
+
+    // !\brief Number of signals
+    uint32_t m_SignalCount = 0;
+};
@@ -0,0 +1,240 @@
+#include "pch.hpp"
+
+CanSignalSeries::CanSignalSeries(const std::string& name, size_t capacity) :
+    m_Name(name), m_Points(std::max<size_t>(capacity, 1))
+{
+    m_Levels.resize(CAN_SIGNAL_SERIES_LEVELS);
+    for(auto& level : m_Levels)
+        level.buckets.resize(std::max(m_Points.size() / CAN_SIGNAL_SERIES_BUCKET_SIZE, CAN_SIGNAL_SERIES_MIN_LEVEL_SIZE));
+}
+
+void CanSignalSeries::Add(int64_t time, double value)
+{
+    m_Points[m_Count % m_Points.size()] = CanSignalPoint{ time, value };
+    m_Count++;
+
+    if(!m_Levels.empty())
+        Merge(0, CanSignalBucket{ time, time, time, time, value, value });
+}
+
+void CanSignalSeries::Merge(size_t level_index, const CanSignalBucket& bucket)
+{
+    CanSignalSeriesLevel& level = m_Levels[level_index];
+    CanSignalBucket& open = level.open;
+    if(!level.open_count)
+    {
+        open = bucket;
+    }
+    else
+    {
+        open.last_time = bucket.last_time;
+        if(bucket.min < open.min)
+        {
+            open.min = bucket.min;
+            open.min_time = bucket.min_time;
+        }
+        if(bucket.max > open.max)
+        {
+            open.max = bucket.max;
+            open.max_time = bucket.max_time;
+        }
+    }
+
+    if(++level.open_count < CAN_SIGNAL_SERIES_BUCKET_SIZE)
+        return;
+
+    level.buckets[level.count % level.buckets.size()] = open;
+    level.count++;
+    level.open_count = 0;
+    if(level_index + 1 < m_Levels.size())
+        Merge(level_index + 1, open);
+}
+
+uint64_t CanSignalSeries::FindPoint(int64_t time, bool is_end) const
+{
+    uint64_t first = m_Count > m_Points.size() ? m_Count - m_Points.size() : 0;
+    uint64_t last = m_Count;
+    while(first < last)
+    {
+        uint64_t mid = first + (last - first) / 2;
+        int64_t t = GetPoint(mid).time;
+        if(is_end ? t <= time : t < time)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    return first;
+}
+
+uint64_t CanSignalSeries::FindBucket(const CanSignalSeriesLevel& level, int64_t time, bool is_end) const
+{
+    uint64_t first = level.count > level.buckets.size() ? level.count - level.buckets.size() : 0;
+    uint64_t last = level.count;
+    while(first < last)
+    {
+        uint64_t mid = first + (last - first) / 2;
+        const CanSignalBucket& bucket = level.buckets[mid % level.buckets.size()];
+        if(is_end ? bucket.first_time <= time : bucket.last_time < time)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    return first;
+}
+
+void CanSignalSeries::AppendBuckets(const CanSignalSeriesLevel& level, int64_t from, int64_t to, std::vector<CanSignalPoint>& points) const
+{
+    uint64_t end = FindBucket(level, to, true);
+    for(uint64_t n = FindBucket(level, from, false); n < end; n++)
+    {
+        /* Min and max in time order, so spikes stay visible */
+        const CanSignalBucket& bucket = level.buckets[n % level.buckets.size()];
+        if(bucket.min_time == bucket.max_time)
+        {
+            points.push_back(CanSignalPoint{ bucket.min_time, bucket.min });
+        }
+        else if(bucket.min_time < bucket.max_time)
+        {
+            points.push_back(CanSignalPoint{ bucket.min_time, bucket.min });
+            points.push_back(CanSignalPoint{ bucket.max_time, bucket.max });
+        }
+        else
+        {
+            points.push_back(CanSignalPoint{ bucket.max_time, bucket.max });
+            points.push_back(CanSignalPoint{ bucket.min_time, bucket.min });
+        }
+    }
+}
+
+void CanSignalSeries::Query(int64_t from, int64_t to, size_t max_points, std::vector<CanSignalPoint>& out) const
+{
+    out.clear();
+    max_points = std::max<size_t>(max_points, 3);
+    if(!m_Count || from > to)
+        return;
+
+    size_t limit = max_points * CAN_SIGNAL_SERIES_OVERSAMPLING;
+    std::vector<CanSignalPoint> points;
+
+    uint64_t raw_begin = FindPoint(from, false);
+    uint64_t raw_end = FindPoint(to, true);
+    bool is_raw_covered = m_Count <= m_Points.size() || GetPoint(m_Count - m_Points.size()).time <= from;
+    if(m_Levels.empty() || !m_Levels[0].count || (raw_end - raw_begin <= limit && is_raw_covered))
+    {
+        points.reserve(raw_end - raw_begin);
+        for(uint64_t n = raw_begin; n != raw_end; n++)
+            points.push_back(GetPoint(n));
+        Lttb(points, max_points, out);
+        return;
+    }
+
+    /* Finest level with few enough buckets in the window, or the coarsest one which has data */
+    size_t level_index = 0;
+    for(size_t i = 0; i != m_Levels.size() && m_Levels[i].count; i++)
+    {
+        const CanSignalSeriesLevel& level = m_Levels[i];
+        level_index = i;
+        bool is_covered = level.count <= level.buckets.size() || level.buckets[level.count % level.buckets.size()].first_time <= from;
+        if((FindBucket(level, to, true) - FindBucket(level, from, false)) * 2 <= limit && is_covered)
+            break;
+    }
+
+    /* Newest part which isn't in a closed bucket of the level yet is taken from the finer levels, less than CAN_SIGNAL_SERIES_BUCKET_SIZE items each */
+    int64_t next = from;
+    for(size_t i = level_index + 1; i-- > 0;)
+    {
+        const CanSignalSeriesLevel& level = m_Levels[i];
+        if(!level.count)
+            continue;
+        AppendBuckets(level, next, to, points);
+        next = std::max(next, level.buckets[(level.count - 1) % level.buckets.size()].last_time + 1);
+    }
+    for(uint64_t n = FindPoint(next, false); n < raw_end; n++)
+        points.push_back(GetPoint(n));
+    Lttb(points, max_points, out);
+}
+
+bool CanSignalSeries::GetTimeRange(int64_t& first, int64_t& last) const
+{
+    if(!m_Count)
+        return false;
+
+    first = GetPoint(m_Count > m_Points.size() ? m_Count - m_Points.size() : 0).time;
+    if(!m_Levels.empty() && m_Levels.back().count)  /* Coarse levels keep data for longer */
+    {
+        const CanSignalSeriesLevel& level = m_Levels.back();
+        uint64_t oldest = level.count > level.buckets.size() ? level.count - level.buckets.size() : 0;
+        first = std::min(first, level.buckets[oldest % level.buckets.size()].first_time);
+    }
+    last = GetPoint(m_Count - 1).time;
+    return true;
+}
+
+size_t CanSignalSeries::GetSize() const
+{
+    return static_cast<size_t>(std::min<uint64_t>(m_Count, m_Points.size()));
+}
+
+void CanSignalSeries::Clear()
+{
+    m_Count = 0;
+    for(auto& level : m_Levels)
+    {
+        level.count = 0;
+        level.open_count = 0;
+    }
+}
+
+void CanSignalSeries::Lttb(const std::vector<CanSignalPoint>& in, size_t threshold, std::vector<CanSignalPoint>& out)
+{
+    out.clear();
+    threshold = std::max<size_t>(threshold, 3);
+    if(in.size() <= threshold)
+    {
+        out = in;
+        return;
+    }
+
+    out.reserve(threshold);
+    out.push_back(in.front());
+
+    /* First and last points are kept, the rest is split into threshold - 2 buckets */
+    double bucket_size = static_cast<double>(in.size() - 2) / static_cast<double>(threshold - 2);
+    size_t selected = 0;
+    for(size_t i = 0; i != threshold - 2; i++)
+    {
+        size_t begin = static_cast<size_t>(i * bucket_size) + 1;
+        size_t end = std::min(static_cast<size_t>((i + 1) * bucket_size) + 1, in.size() - 1);
+
+        /* Average of the next bucket is the third point of the triangle */
+        size_t next_begin = end;
+        size_t next_end = std::min(static_cast<size_t>((i + 2) * bucket_size) + 1, in.size());
+        double avg_time = 0.0, avg_value = 0.0;
+        for(size_t n = next_begin; n != next_end; n++)
+        {
+            avg_time += static_cast<double>(in[n].time - in[selected].time);
+            avg_value += in[n].value;
+        }
+        size_t next_count = next_end - next_begin;
+        avg_time /= static_cast<double>(next_count);
+        avg_value /= static_cast<double>(next_count);
+
+        /* Doubled area is |(B - A) x (C - A)|, A is the selected point, B is the candidate and C is the average,
+           times are relative to A, so large timestamps don't lose precision */
+        double max_area = -1.0;
+        size_t max_index = begin;
+        for(size_t n = begin; n != end; n++)
+        {
+            double area = std::abs(static_cast<double>(in[n].time - in[selected].time) * (avg_value - in[selected].value) -
+                avg_time * (in[n].value - in[selected].value));
+            if(area > max_area)
+            {
+                max_area = area;
+                max_index = n;
+            }
+        }
+        out.push_back(in[max_index]);
+        selected = max_index;
+    }
+    out.push_back(in.back());
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <inttypes.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+/* Number of points or buckets merged into one bucket of the next level */
+constexpr size_t CAN_SIGNAL_SERIES_BUCKET_SIZE = 16;
+
+/* Number of pyramid levels, every level keeps capacity / CAN_SIGNAL_SERIES_BUCKET_SIZE buckets, so it reaches back 16 times further than the previous one */
+constexpr size_t CAN_SIGNAL_SERIES_LEVELS = 4;
+
+/* Minimum number of buckets of a level */
+constexpr size_t CAN_SIGNAL_SERIES_MIN_LEVEL_SIZE = 64;
+
+/* Query reads at most this many times more points than requested, the rest is done by LTTB */
+constexpr size_t CAN_SIGNAL_SERIES_OVERSAMPLING = 4;
+
+class CanSignalPoint
+{
+public:
+    // !\brief Time in microseconds
+    int64_t time = 0;
+
+    // !\brief Value
+    double value = 0.0;
+};
+
+class CanSignalBucket
+{
+public:
+    // !\brief Time of the first point
+    int64_t first_time = 0;
+
+    // !\brief Time of the last point
+    int64_t last_time = 0;
+
+    // !\brief Time of the minimum
+    int64_t min_time = 0;
+
+    // !\brief Time of the maximum
+    int64_t max_time = 0;
+
+    // !\brief Minimum value
+    double min = std::numeric_limits<double>::max();
+
+    // !\brief Maximum value
+    double max = std::numeric_limits<double>::lowest();
+};
+
+class CanSignalSeriesLevel
+{
+public:
+    // !\brief Buckets, ring of closed buckets
+    std::vector<CanSignalBucket> buckets;
+
+    // !\brief Number of closed buckets since the beginning, the oldest one is at max(count - capacity, 0)
+    uint64_t count = 0;
+
+    // !\brief Bucket which is being filled
+    CanSignalBucket open;
+
+    // !\brief Number of merged items of the open bucket
+    size_t open_count = 0;
+};
+
+/* Ring buffer of (time, value) points of a signal with a min/max pyramid, so any time window can be drawn from a fixed number of points */
+class CanSignalSeries
+{
+public:
+    // !\param name [in] Signal name
+    // !\param capacity [in] Maximum number of raw points, the oldest one is dropped above it, but the levels keep the min/max of older ones
+    CanSignalSeries(const std::string& name, size_t capacity);
+
+    // !\brief Get signal name
+    const std::string& GetName() const { return m_Name; }
+
+    // !\brief Add point, amortized O(1)
+    // !\param time [in] Time in microseconds, has to be monotonic
+    // !\param value [in] Value
+    void Add(int64_t time, double value);
+
+    // !\brief Get points of a time window
+    // !\details The finest level which has at most max_points * CAN_SIGNAL_SERIES_OVERSAMPLING points in the window is read,
+    // !         buckets are converted to their min and max points, then the result is reduced with LTTB, so the cost doesn't depend on the window length
+    // !\param from [in] Start of the window in microseconds
+    // !\param to [in] End of the window in microseconds
+    // !\param max_points [in] Maximum number of returned points, at least 3
+    // !\param out [out] Points in time order
+    void Query(int64_t from, int64_t to, size_t max_points, std::vector<CanSignalPoint>& out) const;
+
+    // !\brief Get time range of the stored points
+    // !\return False if the series is empty
+    bool GetTimeRange(int64_t& first, int64_t& last) const;
+
+    // !\brief Get number of raw points in the ring
+    size_t GetSize() const;
+
+    // !\brief Get number of pyramid levels including the raw points
+    size_t GetLevelCount() const { return m_Levels.size() + 1; }
+
+    // !\brief Drop every point
+    void Clear();
+
+    // !\brief Largest-Triangle-Three-Buckets downsampling, keeps the visual shape of the series
+    // !\param in [in] Points in time order
+    // !\param threshold [in] Number of output points, at least 3, the input is copied if it's not larger
+    // !\param out [out] Points in time order
+    static void Lttb(const std::vector<CanSignalPoint>& in, size_t threshold, std::vector<CanSignalPoint>& out);
+
+private:
+    // !\brief Merge bucket into the open bucket of a level and close it when it's full
+    // !\param level [in] Level index in m_Levels
+    // !\param bucket [in] Bucket of the finer level
+    void Merge(size_t level, const CanSignalBucket& bucket);
+
+    // !\brief Append min and max points of buckets in a time window
+    void AppendBuckets(const CanSignalSeriesLevel& level, int64_t from, int64_t to, std::vector<CanSignalPoint>& points) const;
+
+    // !\brief Get raw point by logical index
+    const CanSignalPoint& GetPoint(uint64_t index) const { return m_Points[index % m_Points.size()]; }
+
+    // !\brief Find first raw point at or after the given time
+    uint64_t FindPoint(int64_t time, bool is_end) const;
+
+    // !\brief Find first bucket of a level at or after the given time
+    uint64_t FindBucket(const CanSignalSeriesLevel& level, int64_t time, bool is_end) const;
+
+    // !\brief Signal name
+    std::string m_Name;
+
+    // !\brief Raw points, ring
+    std::vector<CanSignalPoint> m_Points;
+
+    // !\brief Number of raw points since the beginning
+    uint64_t m_Count = 0;
+
+    // !\brief Pyramid levels, level 0 has CAN_SIGNAL_SERIES_BUCKET_SIZE points per bucket
+    std::vector<CanSignalSeriesLevel> m_Levels;
+};
@@ -0,0 +1,327 @@
+#include "pch.hpp"
+
+CanStressGenerator::CanStressGenerator(CanStressSendFunction&& send) :
+    m_Send(std::move(send))
+{
+
+}
+
+CanStressGenerator::~CanStressGenerator()
+{
+    Stop();
+}
+
+bool CanStressGenerator::Start(const CanStressConfig& config, std::vector<CanData>&& seeds)
+{
+    Stop();
+    if(!Reset(config, std::move(seeds), std::chrono::steady_clock::now()))
+        return false;
+
+    m_Worker = std::make_unique<std::jthread>(std::bind_front(&CanStressGenerator::WorkerThread, this));
+    utils::SetThreadName(*m_Worker, "CanStressGenerator");
+
+    CanStressStats stats = GetStats();
+    LOG(LogLevel::Notification, "Stress generator started, seed: {}", stats.seed);
+    return true;
+}
+
+void CanStressGenerator::Stop()
+{
+    m_Worker.reset(nullptr);
+    m_IsRunning = false;
+}
+
+CanStressStats CanStressGenerator::GetStats()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Stats;
+}
+
+CanStressConfig CanStressGenerator::GetConfig()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Config;
+}
+
+bool CanStressGenerator::Reset(const CanStressConfig& config, std::vector<CanData>&& seeds, std::chrono::steady_clock::time_point now)
+{
+    std::erase_if(seeds, [](const CanData& frame) { return frame.data_len == 0 || frame.data_len > MAX_CAN_FRAME_DATA_LEN; });
+    if(config.id_min > config.id_max)
+    {
+        LOG(LogLevel::Error, "Invalid stress generator ID range: {:X} - {:X}", config.id_min, config.id_max);
+        return false;
+    }
+    if(config.dlc_min == 0 || config.dlc_min > config.dlc_max || config.dlc_max > MAX_CAN_FRAME_DATA_LEN)
+    {
+        LOG(LogLevel::Error, "Invalid stress generator data length range: {} - {}, it has to be between 1 and {}", config.dlc_min, config.dlc_max, MAX_CAN_FRAME_DATA_LEN);
+        return false;
+    }
+    if(config.burst_size ? config.burst_period.count() <= 0 : (config.bus_load > 0.0 ? config.bus_load > 100.0 || !config.bitrate : config.rate <= 0.0))
+    {
+        LOG(LogLevel::Error, "Invalid stress generator rate, rate: {}, bus load: {}, bitrate: {}, burst period: {}", config.rate, config.bus_load, config.bitrate, config.burst_period.count());
+        return false;
+    }
+    if(config.payload_mode == CSPM_MUTATE && seeds.empty())
+    {
+        LOG(LogLevel::Error, "Stress generator has no seed frames to mutate, record some frames first");
+        return false;
+    }
+
+    std::scoped_lock lock(m_Mutex);
+    m_Config = config;
+    m_Seeds = std::move(seeds);
+    m_Stats = CanStressStats();
+    m_Stats.seed = config.seed;
+    if(!m_Stats.seed)
+    {
+        std::random_device rd;
+        m_Stats.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    m_Stats.start = now;
+    m_Random.seed(m_Stats.seed);
+    m_NextTime = now;
+    m_NextId = config.id_min;
+    m_NextDlc = config.dlc_min;
+    m_Counter = 0;
+    m_NextSeed = 0;
+    m_IsRunning = true;
+    return true;
+}
+
+bool CanStressGenerator::Poll(std::chrono::steady_clock::time_point now)
+{
+    std::scoped_lock lock(m_Mutex);
+    if(!m_IsRunning)
+        return false;
+
+    if(m_Config.duration.count() && now - m_Stats.start >= m_Config.duration)
+    {
+        m_IsRunning = false;
+        return false;
+    }
+
+    /* Sending the missed frames at once would distort the rate, eg. after the thread wasn't scheduled for a while */
+    if(now - m_NextTime > CAN_STRESS_MAX_LAG)
+    {
+        m_NextTime = now;
+        m_Stats.overruns++;
+    }
+
+    while(m_NextTime <= now && m_IsRunning)
+    {
+        if(m_Config.burst_size)
+        {
+            for(uint32_t i = 0; i != m_Config.burst_size && m_IsRunning; i++)
+                SendFrame();
+            m_NextTime += m_Config.burst_period;
+        }
+        else
+        {
+            /* Gap is calculated from the length of the generated frame, so the bus load is exact even with different lengths */
+            uint32_t bits = SendFrame();
+            double seconds = m_Config.bus_load > 0.0 ? bits / (m_Config.bitrate * m_Config.bus_load / 100.0) : 1.0 / m_Config.rate;
+            m_NextTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        }
+    }
+    return m_IsRunning;
+}
+
+std::chrono::steady_clock::time_point CanStressGenerator::GetNextFrameTime()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_NextTime;
+}
+
+uint32_t CanStressGenerator::SendFrame()
+{
+    CanData frame;
+    Generate(frame);
+    m_Stats.generated++;
+
+    uint32_t bits = GetFrameBits(frame.frame_id, frame.data, frame.data_len);
+    if(m_Send(frame.frame_id, frame.data, frame.data_len))
+    {
+        m_Stats.sent++;
+        m_Stats.bits += bits;
+    }
+    else
+    {
+        m_Stats.dropped++;
+    }
+
+    if(m_Config.count && m_Stats.generated >= m_Config.count)
+        m_IsRunning = false;
+    return bits;
+}
+
+void CanStressGenerator::Generate(CanData& frame)
+{
+    if(m_Config.payload_mode == CSPM_MUTATE)
+    {
+        frame = m_Seeds[m_NextSeed];
+        m_NextSeed = (m_NextSeed + 1) % m_Seeds.size();
+        for(uint32_t i = 0; i != m_Config.mutations; i++)
+            Mutate(frame);
+        return;
+    }
+
+    switch(m_Config.id_mode)
+    {
+        case CSIM_FIXED:
+            frame.frame_id = m_Config.id_min;
+            break;
+        case CSIM_INCREMENT:
+            frame.frame_id = m_NextId;
+            m_NextId = m_NextId >= m_Config.id_max ? m_Config.id_min : m_NextId + 1;
+            break;
+        case CSIM_RANDOM:
+            frame.frame_id = std::uniform_int_distribution<uint32_t>(m_Config.id_min, m_Config.id_max)(m_Random);
+            break;
+    }
+
+    switch(m_Config.dlc_mode)
+    {
+        case CSDM_FIXED:
+            frame.data_len = m_Config.dlc_max;
+            break;
+        case CSDM_SWEEP:
+            frame.data_len = m_NextDlc;
+            m_NextDlc = m_NextDlc >= m_Config.dlc_max ? m_Config.dlc_min : m_NextDlc + 1;
+            break;
+        case CSDM_RANDOM:
+            frame.data_len = static_cast<uint8_t>(std::uniform_int_distribution<uint32_t>(m_Config.dlc_min, m_Config.dlc_max)(m_Random));
+            break;
+    }
+
+    switch(m_Config.payload_mode)
+    {
+        case CSPM_FIXED:
+            memcpy(frame.data, m_Config.payload, sizeof(frame.data));
+            break;
+        case CSPM_INCREMENT:
+            for(size_t i = 0; i != sizeof(frame.data); i++)
+                frame.data[i] = static_cast<uint8_t>(m_Counter >> (i * 8));
+            m_Counter++;
+            break;
+        case CSPM_RANDOM:
+        {
+            uint64_t value = m_Random();
+            memcpy(frame.data, &value, sizeof(frame.data));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void CanStressGenerator::Mutate(CanData& frame)
+{
+    static constexpr uint8_t BOUNDARY_VALUES[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+
+    uint8_t& byte = frame.data[m_Random() % frame.data_len];
+    switch(m_Random() % 6)
+    {
+        case 0:  /* Bit flip */
+            byte ^= static_cast<uint8_t>(1 << (m_Random() % 8));
+            break;
+        case 1:  /* Random byte */
+            byte = static_cast<uint8_t>(m_Random());
+            break;
+        case 2:  /* Boundary value */
+            byte = BOUNDARY_VALUES[m_Random() % std::size(BOUNDARY_VALUES)];
+            break;
+        case 3:
+            byte++;
+            break;
+        case 4:
+            byte--;
+            break;
+        case 5:  /* Length change, bytes after the original length are zero */
+            frame.data_len = static_cast<uint8_t>(1 + m_Random() % MAX_CAN_FRAME_DATA_LEN);
+            break;
+    }
+}
+
+uint32_t CanStressGenerator::GetFrameBits(uint32_t frame_id, const uint8_t* data, uint8_t size)
+{
+    size = std::min<uint8_t>(size, MAX_CAN_FRAME_DATA_LEN);
+
+    /* Bits from SOF to the end of CRC, these are stuffed, 0 is dominant */
+    uint8_t bits[128];
+    uint32_t count = 0;
+    auto push = [&bits, &count](uint32_t value, int len)
+    {
+        for(int i = len - 1; i >= 0; i--)
+            bits[count++] = (value >> i) & 1;
+    };
+
+    push(0, 1);  /* SOF */
+    if(frame_id < CAN_TX_QUEUE_STD_IDS)
+    {
+        push(frame_id, 11);
+        push(0, 3);  /* RTR, IDE, r0 */
+    }
+    else
+    {
+        push(frame_id >> 18, 11);
+        push(3, 2);  /* SRR, IDE */
+        push(frame_id & 0x3FFFF, 18);
+        push(0, 3);  /* RTR, r1, r0 */
+    }
+    push(size, 4);
+    for(uint8_t i = 0; i != size; i++)
+        push(data[i], 8);
+
+    uint16_t crc = 0;
+    for(uint32_t i = 0; i != count; i++)
+    {
+        bool crc_next = bits[i] ^ ((crc >> 14) & 1);
+        crc = (crc << 1) & 0x7FFF;
+        if(crc_next)
+            crc ^= 0x4599;
+    }
+    push(crc, 15);
+
+    /* A complement bit is inserted after 5 equal bits, it's the first bit of the next run */
+    uint32_t stuff_bits = 0;
+    uint32_t run = 0;
+    uint8_t previous = 2;
+    for(uint32_t i = 0; i != count; i++)
+    {
+        if(bits[i] == previous)
+        {
+            run++;
+        }
+        else
+        {
+            previous = bits[i];
+            run = 1;
+        }
+
+        if(run == 5)
+        {
+            stuff_bits++;
+            previous ^= 1;
+            run = 1;
+        }
+    }
+    return count + stuff_bits + CAN_STRESS_FRAME_TAIL_BITS;
+}
+
+void CanStressGenerator::WorkerThread(std::stop_token token)
+{
+    while(!token.stop_requested())
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(!Poll(now))
+            break;
+
+        std::unique_lock lock(m_Mutex);
+        m_Cv.wait_until(lock, token, std::min(m_NextTime, now + CAN_STRESS_MAX_SLEEP), []() { return false; });
+    }
+
+    CanStressStats stats = GetStats();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - stats.start).count();
+    LOG(LogLevel::Notification, "Stress generator stopped after {:.1f} s, generated: {}, sent: {}, dropped: {}, overruns: {}, average rate: {:.0f} frames/s, seed: {}",
+        elapsed, stats.generated, stats.sent, stats.dropped, stats.overruns, elapsed > 0.0 ? static_cast<double>(stats.sent) / elapsed : 0.0, stats.seed);
+}
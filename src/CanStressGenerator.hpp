@@ -0,0 +1,230 @@
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "CanTxQueue.hpp"
+
+/* If the generator falls behind more than this, frames are skipped instead of sending them as a burst */
+constexpr std::chrono::milliseconds CAN_STRESS_MAX_LAG{ 20 };
+
+/* Longest sleep of the worker thread */
+constexpr std::chrono::milliseconds CAN_STRESS_MAX_SLEEP{ 10 };
+
+/* Bits after the CRC: CRC delimiter, ACK slot & delimiter, EOF and intermission, they're not stuffed */
+constexpr uint32_t CAN_STRESS_FRAME_TAIL_BITS = 1 + 2 + 7 + 3;
+
+enum CanStressIdMode : uint8_t
+{
+    CSIM_FIXED,      /* Always id_min */
+    CSIM_INCREMENT,  /* id_min..id_max, then starts over */
+    CSIM_RANDOM      /* Random between id_min and id_max */
+};
+
+enum CanStressDlcMode : uint8_t
+{
+    CSDM_FIXED,      /* Always dlc_max */
+    CSDM_SWEEP,      /* dlc_min..dlc_max, then starts over */
+    CSDM_RANDOM      /* Random between dlc_min and dlc_max */
+};
+
+enum CanStressPayloadMode : uint8_t
+{
+    CSPM_FIXED,      /* Always payload */
+    CSPM_INCREMENT,  /* Little endian counter, increased for every frame */
+    CSPM_RANDOM,     /* Random bytes */
+    CSPM_MUTATE      /* Seed frames (eg. recording) with random mutations, ID and DLC are taken from the seed */
+};
+
+class CanStressConfig
+{
+public:
+    // !\brief How Frame IDs are generated
+    CanStressIdMode id_mode = CSIM_FIXED;
+
+    // !\brief Lowest Frame ID, IDs from 0x800 are sent as extended frames
+    uint32_t id_min = 0x100;
+
+    // !\brief Highest Frame ID
+    uint32_t id_max = 0x100;
+
+    // !\brief How data lengths are generated
+    CanStressDlcMode dlc_mode = CSDM_FIXED;
+
+    // !\brief Lowest data length, at least 1, because the TX queue doesn't accept frames without data
+    uint8_t dlc_min = 1;
+
+    // !\brief Highest data length, used by CSDM_FIXED
+    uint8_t dlc_max = MAX_CAN_FRAME_DATA_LEN;
+
+    // !\brief How data is generated
+    CanStressPayloadMode payload_mode = CSPM_RANDOM;
+
+    // !\brief Data of CSPM_FIXED
+    uint8_t payload[MAX_CAN_FRAME_DATA_LEN] = {};
+
+    // !\brief Number of mutations per frame with CSPM_MUTATE
+    uint32_t mutations = 1;
+
+    // !\brief Frames per second, used if bus_load is 0
+    double rate = 1000.0;
+
+    // !\brief Target bus load in percent, the gap after every frame is calculated from its length in bits, 0 = use rate
+    double bus_load = 0.0;
+
+    // !\brief Bitrate of the bus in bit/s, used by bus_load and bus load reporting
+    uint32_t bitrate = 500000;
+
+    // !\brief Number of frames queued at once every burst_period, 0 = continuous sending with rate or bus_load
+    uint32_t burst_size = 0;
+
+    // !\brief Period of bursts
+    std::chrono::milliseconds burst_period{ 100 };
+
+    // !\brief Stop after this many frames, 0 = unlimited
+    uint64_t count = 0;
+
+    // !\brief Stop after this time, 0 = unlimited
+    std::chrono::milliseconds duration{ 0 };
+
+    // !\brief Seed of the random generator, 0 = random seed, the used seed is reported, so a failure can be reproduced
+    uint64_t seed = 0;
+};
+
+class CanStressStats
+{
+public:
+    // !\brief Number of generated frames
+    uint64_t generated = 0;
+
+    // !\brief Number of frames accepted by the send function
+    uint64_t sent = 0;
+
+    // !\brief Number of frames rejected by the send function (TX queue is full)
+    uint64_t dropped = 0;
+
+    // !\brief Number of times when the generator fell behind more than CAN_STRESS_MAX_LAG and skipped frames
+    uint64_t overruns = 0;
+
+    // !\brief Sum of bits of accepted frames including stuff bits
+    uint64_t bits = 0;
+
+    // !\brief Used seed
+    uint64_t seed = 0;
+
+    // !\brief Start time
+    std::chrono::steady_clock::time_point start;
+};
+
+using CanStressSendFunction = std::function<bool(uint32_t frame_id, const uint8_t* data, uint8_t size)>;
+
+/* Generates frames with precise rate or bus load for stress testing and fuzzing */
+class CanStressGenerator
+{
+public:
+    // !\param send [in] Function which queues a frame, returns false if the frame was dropped
+    CanStressGenerator(CanStressSendFunction&& send);
+    ~CanStressGenerator();
+
+    // !\brief Start generating in a worker thread, the previous run is stopped
+    // !\param config [in] Configuration
+    // !\param seeds [in] Seed frames of CSPM_MUTATE
+    // !\return False if the configuration is invalid
+    bool Start(const CanStressConfig& config, std::vector<CanData>&& seeds);
+
+    // !\brief Stop the worker thread
+    void Stop();
+
+    // !\brief Is generating running?
+    bool IsRunning() const { return m_IsRunning; }
+
+    // !\brief Get counters of the current or the last run
+    CanStressStats GetStats();
+
+    // !\brief Get configuration of the current or the last run
+    CanStressConfig GetConfig();
+
+    // !\brief Reset generator state without starting the worker thread, used by Start and unit tests
+    // !\param config [in] Configuration
+    // !\param seeds [in] Seed frames of CSPM_MUTATE
+    // !\param now [in] Start time
+    // !\return False if the configuration is invalid
+    bool Reset(const CanStressConfig& config, std::vector<CanData>&& seeds, std::chrono::steady_clock::time_point now);
+
+    // !\brief Send every frame which is due
+    // !\param now [in] Current time
+    // !\return False if generating has finished
+    bool Poll(std::chrono::steady_clock::time_point now);
+
+    // !\brief Get time when the next frame is due
+    std::chrono::steady_clock::time_point GetNextFrameTime();
+
+    // !\brief Get length of a data frame on the bus, including stuff bits and interframe space
+    // !\param frame_id [in] CAN Frame ID, IDs from 0x800 are extended
+    // !\param data [in] Frame data
+    // !\param size [in] Data length
+    static uint32_t GetFrameBits(uint32_t frame_id, const uint8_t* data, uint8_t size);
+
+private:
+    // !\brief Worker thread
+    void WorkerThread(std::stop_token token);
+
+    // !\brief Generate next frame
+    void Generate(CanData& frame);
+
+    // !\brief Apply a random mutation: bit flip, random byte, boundary value, increment, decrement or length change
+    void Mutate(CanData& frame);
+
+    // !\brief Generate and send one frame, m_Mutex has to be locked
+    // !\return Length of the frame in bits
+    uint32_t SendFrame();
+
+    // !\brief Send function
+    CanStressSendFunction m_Send;
+
+    // !\brief Configuration
+    CanStressConfig m_Config;
+
+    // !\brief Seed frames of CSPM_MUTATE
+    std::vector<CanData> m_Seeds;
+
+    // !\brief Counters
+    CanStressStats m_Stats;
+
+    // !\brief Random generator
+    std::mt19937_64 m_Random;
+
+    // !\brief Time when the next frame or burst is due
+    std::chrono::steady_clock::time_point m_NextTime;
+
+    // !\brief Next Frame ID of CSIM_INCREMENT
+    uint32_t m_NextId = 0;
+
+    // !\brief Next data length of CSDM_SWEEP
+    uint8_t m_NextDlc = 0;
+
+    // !\brief Counter of CSPM_INCREMENT
+    uint64_t m_Counter = 0;
+
+    // !\brief Next seed frame of CSPM_MUTATE
+    size_t m_NextSeed = 0;
+
+    // !\brief Is generating running?
+    std::atomic<bool> m_IsRunning = false;
+
+    // !\brief Mutex for generator state
+    std::mutex m_Mutex;
+
+    // !\brief Conditional variable for worker thread, so stopping doesn't wait for the sleep
+    std::condition_variable_any m_Cv;
+
+    // !\brief Worker thread
+    std::unique_ptr<std::jthread> m_Worker;
+};
@@ -0,0 +1,303 @@
+#include "pch.hpp"
+
+/* Default size of the pre-trigger ring, about 10 seconds of a busy 500 kbit/s bus */
+constexpr size_t CAN_CAPTURE_DEFAULT_RING_SIZE = 40000;
+
+/* ReadDataByIdentifier positive response SID */
+constexpr uint8_t CAN_CAPTURE_DID_RESPONSE_SID = 0x62;
+
+bool CanCaptureTrigger::Match(const uint8_t* data, uint8_t size) const
+{
+    if(size < len)
+        return false;
+    for(uint8_t i = 0; i != len; i++)
+    {
+        if((data[i] & mask[i]) != value[i])
+            return false;
+    }
+    return true;
+}
+
+/* Parse hex number, unlike std::stoul the whole string has to be a number */
+static uint32_t ParseHex(const std::string& str)
+{
+    size_t pos = 0;
+    uint32_t ret = static_cast<uint32_t>(std::stoul(str, &pos, 16));
+    if(pos != str.length())
+        throw std::invalid_argument("not a hex number");
+    return ret;
+}
+
+CanTriggerCapture::CanTriggerCapture() :
+    m_Ring(CAN_CAPTURE_DEFAULT_RING_SIZE)
+{
+
+}
+
+bool CanTriggerCapture::SetTriggersFromString(const std::string& str)
+{
+    std::vector<std::string> entries;
+    boost::split(entries, str.substr(0, str.find('#')), boost::is_any_of(","));
+
+    bool ret = true;
+    m_Triggers.clear();
+    for(auto& entry : entries)
+    {
+        boost::algorithm::trim(entry);
+        if(entry.empty())
+            continue;
+
+        std::vector<std::string> params;
+        boost::split(params, entry, boost::is_any_of(":"));
+        try
+        {
+            CanCaptureTrigger trigger;
+            if(boost::iequals(params[0], "Error") && params.size() == 1)
+            {
+                trigger.type = CCT_ERROR_FRAME;
+            }
+            else if(boost::iequals(params[0], "Missing") && params.size() == 3)
+            {
+                trigger.type = CCT_MISSING_FRAME;
+                trigger.frame_id = ParseHex(params[1]);
+                trigger.timeout = std::chrono::milliseconds(std::stoul(params[2]));
+            }
+            else if(boost::iequals(params[0], "Did") && params.size() == 3)
+            {
+                trigger.type = CCT_DID_RESPONSE;
+                trigger.frame_id = ParseHex(params[1]);
+                trigger.did = static_cast<uint16_t>(ParseHex(params[2]));
+            }
+            else if(params.size() == 1)
+            {
+                trigger.type = CCT_FRAME;
+                size_t slash = entry.find('/');
+                trigger.frame_id = ParseHex(entry.substr(0, slash));
+                if(slash != std::string::npos)
+                {
+                    size_t equal = entry.find('=', slash);
+                    std::string mask = equal == std::string::npos ? std::string() : entry.substr(slash + 1, equal - slash - 1);
+                    std::string value = equal == std::string::npos ? std::string() : entry.substr(equal + 1);
+                    if(mask.empty() || mask.length() != value.length() || mask.length() % 2 || mask.length() > trigger.mask.size() * 2)
+                    {
+                        LOG(LogLevel::Error, "Invalid capture trigger data: {}, expected ID/MASK=VALUE with the same length", entry);
+                        ret = false;
+                        continue;
+                    }
+
+                    trigger.len = static_cast<uint8_t>(mask.length() / 2);
+                    for(uint8_t i = 0; i != trigger.len; i++)
+                    {
+                        trigger.mask[i] = static_cast<uint8_t>(ParseHex(mask.substr(i * 2, 2)));
+                        trigger.value[i] = static_cast<uint8_t>(ParseHex(value.substr(i * 2, 2))) & trigger.mask[i];
+                    }
+                }
+            }
+            else
+            {
+                LOG(LogLevel::Error, "Invalid capture trigger format: {}, expected ID/MASK=VALUE, Error, Missing:ID:TIMEOUT_MS or Did:RESPONSE_ID:DID", entry);
+                ret = false;
+                continue;
+            }
+            m_Triggers.push_back(trigger);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid capture trigger format, exception: {} ({})", e.what(), entry);
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+std::string CanTriggerCapture::GetTriggersAsString() const
+{
+    std::string ret;
+    for(auto& trigger : m_Triggers)
+    {
+        if(!ret.empty())
+            ret += ", ";
+        ret += TriggerToString(trigger);
+    }
+    return ret;
+}
+
+std::string CanTriggerCapture::TriggerToString(const CanCaptureTrigger& trigger)
+{
+    switch(trigger.type)
+    {
+        case CCT_ERROR_FRAME:
+            return "Error";
+        case CCT_MISSING_FRAME:
+            return std::format("Missing:{:X}:{}", trigger.frame_id, trigger.timeout.count());
+        case CCT_DID_RESPONSE:
+            return std::format("Did:{:X}:{:04X}", trigger.frame_id, trigger.did);
+        default:
+            break;
+    }
+
+    std::string ret = std::format("{:X}", trigger.frame_id);
+    if(trigger.len)
+    {
+        std::string mask, value;
+        for(uint8_t i = 0; i != trigger.len; i++)
+        {
+            mask += std::format("{:02X}", trigger.mask[i]);
+            value += std::format("{:02X}", trigger.value[i]);
+        }
+        ret += "/" + mask + "=" + value;
+    }
+    return ret;
+}
+
+void CanTriggerCapture::SetRingSize(size_t frames)
+{
+    m_Ring.set_capacity(std::max<size_t>(frames, 1));
+}
+
+void CanTriggerCapture::SetWindow(std::chrono::milliseconds pre_trigger, std::chrono::milliseconds post_trigger)
+{
+    m_PreTrigger = pre_trigger;
+    m_PostTrigger = post_trigger;
+}
+
+void CanTriggerCapture::Arm(bool is_armed, std::chrono::steady_clock::time_point now)
+{
+    if(m_IsRunning)  /* Don't lose the frames collected so far */
+        Complete();
+
+    m_IsArmed = is_armed;
+    m_Ring.clear();
+    if(is_armed)
+    {
+        m_EventCount = 0;
+        m_DroppedEvents = 0;
+        for(auto& trigger : m_Triggers)
+        {
+            trigger.last_seen = now;
+            trigger.is_missing = false;
+        }
+    }
+}
+
+void CanTriggerCapture::OnFrame(uint8_t direction, uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now)
+{
+    if(!m_IsArmed)
+        return;
+
+    CanCaptureFrame frame;
+    frame.time = now;
+    frame.frame_id = frame_id;
+    frame.direction = direction;
+    frame.size = std::min<uint8_t>(size, static_cast<uint8_t>(frame.data.size()));
+    std::copy(data, data + frame.size, frame.data.begin());
+
+    if(m_IsRunning)
+    {
+        if(now - m_Running.trigger_time > m_PostTrigger || m_Running.frames.size() - m_Running.pre_trigger_count >= m_Ring.capacity())
+            Complete();
+        else
+            m_Running.frames.push_back(frame);
+    }
+    m_Ring.push_back(frame);
+
+    for(auto& trigger : m_Triggers)
+    {
+        if(trigger.frame_id != frame_id)
+            continue;
+
+        if(trigger.type == CCT_FRAME && trigger.Match(frame.data.data(), frame.size))
+        {
+            Fire(trigger, now);
+        }
+        else if(trigger.type == CCT_MISSING_FRAME)
+        {
+            trigger.last_seen = now;
+            trigger.is_missing = false;
+        }
+    }
+}
+
+void CanTriggerCapture::OnErrorFrame(std::chrono::steady_clock::time_point now)
+{
+    if(!m_IsArmed)
+        return;
+
+    for(auto& trigger : m_Triggers)
+    {
+        if(trigger.type == CCT_ERROR_FRAME)
+            Fire(trigger, now);
+    }
+}
+
+void CanTriggerCapture::OnIsoTpData(uint32_t frame_id, const uint8_t* data, uint16_t size, std::chrono::steady_clock::time_point now)
+{
+    if(!m_IsArmed || size < 3 || data[0] != CAN_CAPTURE_DID_RESPONSE_SID)
+        return;
+
+    uint16_t did = static_cast<uint16_t>((data[1] << 8) | data[2]);
+    for(auto& trigger : m_Triggers)
+    {
+        if(trigger.type == CCT_DID_RESPONSE && trigger.frame_id == frame_id && trigger.did == did)
+            Fire(trigger, now);
+    }
+}
+
+void CanTriggerCapture::Poll(std::chrono::steady_clock::time_point now)
+{
+    if(!m_IsArmed)
+        return;
+
+    if(m_IsRunning && now - m_Running.trigger_time > m_PostTrigger)
+        Complete();
+
+    for(auto& trigger : m_Triggers)
+    {
+        if(trigger.type == CCT_MISSING_FRAME && !trigger.is_missing && now - trigger.last_seen > trigger.timeout)
+        {
+            trigger.is_missing = true;
+            Fire(trigger, now);
+        }
+    }
+}
+
+bool CanTriggerCapture::TakeEvents(std::vector<CanCaptureEvent>& events)
+{
+    if(m_Completed.empty())
+        return false;
+
+    std::move(m_Completed.begin(), m_Completed.end(), std::back_inserter(events));
+    m_Completed.clear();
+    return true;
+}
+
+void CanTriggerCapture::Fire(const CanCaptureTrigger& trigger, std::chrono::steady_clock::time_point now)
+{
+    if(m_IsRunning)  /* Triggers in the post-trigger window belong to the running event */
+        return;
+
+    m_Running = CanCaptureEvent();
+    m_Running.number = ++m_EventCount;
+    m_Running.trigger = TriggerToString(trigger);
+    m_Running.trigger_time = now;
+
+    /* Ring is in time order, skip frames which are older than the pre-trigger window */
+    auto first = std::find_if(m_Ring.begin(), m_Ring.end(), [this, now](const CanCaptureFrame& frame) { return now - frame.time <= m_PreTrigger; });
+    m_Running.frames.assign(first, m_Ring.end());
+    m_Running.pre_trigger_count = m_Running.frames.size();
+    m_IsRunning = true;
+
+    if(m_PostTrigger.count() == 0)
+        Complete();
+}
+
+void CanTriggerCapture::Complete()
+{
+    m_IsRunning = false;
+    if(m_Completed.size() >= CAN_CAPTURE_MAX_PENDING_EVENTS)
+    {
+        m_Completed.erase(m_Completed.begin());
+        m_DroppedEvents++;
+    }
+    m_Completed.push_back(std::move(m_Running));
+}
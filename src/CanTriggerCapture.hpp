@@ -0,0 +1,208 @@
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+
+/* Completed events waiting to be saved, the oldest one is dropped when the writer can't keep up */
+constexpr size_t CAN_CAPTURE_MAX_PENDING_EVENTS = 16;
+
+enum CanCaptureTriggerType : uint8_t
+{
+    CCT_FRAME,          /* Frame with given ID and masked data */
+    CCT_ERROR_FRAME,    /* Error or corrupted frame reported by the CAN device */
+    CCT_MISSING_FRAME,  /* Periodic frame hasn't been seen for the given timeout */
+    CCT_DID_RESPONSE    /* Positive response to ReadDataByIdentifier with given DID */
+};
+
+class CanCaptureTrigger
+{
+public:
+    // !\brief Does the frame data match?
+    bool Match(const uint8_t* data, uint8_t size) const;
+
+    // !\brief Trigger type
+    CanCaptureTriggerType type = CCT_FRAME;
+
+    // !\brief CAN Frame ID (CCT_FRAME, CCT_MISSING_FRAME), ISO-TP response ID (CCT_DID_RESPONSE)
+    uint32_t frame_id = 0;
+
+    // !\brief Number of bytes compared
+    uint8_t len = 0;
+
+    // !\brief Data mask
+    std::array<uint8_t, 8> mask = {};
+
+    // !\brief Expected data after masking
+    std::array<uint8_t, 8> value = {};
+
+    // !\brief Timeout of CCT_MISSING_FRAME
+    std::chrono::milliseconds timeout{};
+
+    // !\brief DID of CCT_DID_RESPONSE
+    uint16_t did = 0;
+
+    // !\brief Last time when the frame of CCT_MISSING_FRAME has been seen
+    std::chrono::steady_clock::time_point last_seen;
+
+    // !\brief Has CCT_MISSING_FRAME fired for the current gap? It's re-armed when the frame appears again
+    bool is_missing = false;
+};
+
+class CanCaptureFrame
+{
+public:
+    // !\brief Time of the frame
+    std::chrono::steady_clock::time_point time;
+
+    // !\brief CAN Frame ID
+    uint32_t frame_id = 0;
+
+    // !\brief Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    uint8_t direction = 0;
+
+    // !\brief Data length
+    uint8_t size = 0;
+
+    // !\brief Frame data
+    std::array<uint8_t, 8> data = {};
+};
+
+class CanCaptureEvent
+{
+public:
+    // !\brief Sequence number of the event since arming
+    uint32_t number = 0;
+
+    // !\brief Trigger in settings format, for the saved file
+    std::string trigger;
+
+    // !\brief Time of the trigger
+    std::chrono::steady_clock::time_point trigger_time;
+
+    // !\brief Frames of the pre and post-trigger window in time order
+    std::vector<CanCaptureFrame> frames;
+
+    // !\brief Number of pre-trigger frames in frames, a frame which fired the trigger is the last one of them
+    size_t pre_trigger_count = 0;
+};
+
+class CanTriggerCapture
+{
+public:
+    CanTriggerCapture();
+
+    // !\brief Set triggers from settings string, entries separated by comma:
+    // !       ID or ID/MASK=VALUE (hex) - Frame, eg. "7E8/00FFFF=006220"
+    // !       Error - Error frame
+    // !       Missing:ID:TIMEOUT_MS - Periodic frame is missing
+    // !       Did:RESPONSE_ID:DID - DID response received over ISO-TP
+    // !\param str [in] Triggers
+    // !\return False if any of the triggers is invalid, the valid ones are set
+    bool SetTriggersFromString(const std::string& str);
+
+    // !\brief Get triggers as settings string
+    std::string GetTriggersAsString() const;
+
+    // !\brief Set size of the pre-trigger ring, it's also the limit of post-trigger frames
+    // !\param frames [in] Maximum number of frames
+    void SetRingSize(size_t frames);
+
+    // !\brief Get size of the pre-trigger ring
+    size_t GetRingSize() const { return m_Ring.capacity(); }
+
+    // !\brief Set time window before and after the trigger
+    void SetWindow(std::chrono::milliseconds pre_trigger, std::chrono::milliseconds post_trigger);
+
+    // !\brief Get time window before the trigger
+    std::chrono::milliseconds GetPreTrigger() const { return m_PreTrigger; }
+
+    // !\brief Get time window after the trigger
+    std::chrono::milliseconds GetPostTrigger() const { return m_PostTrigger; }
+
+    // !\brief Arm or disarm triggers, arming clears the ring and restarts timeouts of missing frames
+    // !\param is_armed [in] Arm?
+    // !\param now [in] Current time
+    void Arm(bool is_armed, std::chrono::steady_clock::time_point now);
+
+    // !\brief Are triggers armed?
+    bool IsArmed() const { return m_IsArmed; }
+
+    // !\brief Handle frame on the bus
+    // !\param direction [in] Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    // !\param frame_id [in] CAN Frame ID
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length
+    // !\param now [in] Time of the frame
+    void OnFrame(uint8_t direction, uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Handle error frame
+    // !\param now [in] Time of the error
+    void OnErrorFrame(std::chrono::steady_clock::time_point now);
+
+    // !\brief Handle received ISO-TP data
+    // !\param frame_id [in] CAN Frame ID of the response
+    // !\param data [in] Received data
+    // !\param size [in] Data size
+    // !\param now [in] Time of reception
+    void OnIsoTpData(uint32_t frame_id, const uint8_t* data, uint16_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Check timeouts of missing frames and end of post-trigger window, has to be called periodically
+    // !\param now [in] Current time
+    void Poll(std::chrono::steady_clock::time_point now);
+
+    // !\brief Take completed events
+    // !\param events [out] Completed events, appended
+    // !\return False if there wasn't any
+    bool TakeEvents(std::vector<CanCaptureEvent>& events);
+
+    // !\brief Get number of events since arming
+    uint32_t GetEventCount() const { return m_EventCount; }
+
+    // !\brief Get number of events dropped because they weren't taken in time
+    uint32_t GetDroppedEventCount() const { return m_DroppedEvents; }
+
+private:
+    // !\brief Start event with the pre-trigger frames of the ring, ignored while an event is collecting post-trigger frames
+    void Fire(const CanCaptureTrigger& trigger, std::chrono::steady_clock::time_point now);
+
+    // !\brief Move running event to completed ones
+    void Complete();
+
+    // !\brief Convert trigger to settings format
+    static std::string TriggerToString(const CanCaptureTrigger& trigger);
+
+    // !\brief Triggers
+    std::vector<CanCaptureTrigger> m_Triggers;
+
+    // !\brief Pre-trigger ring
+    boost::circular_buffer<CanCaptureFrame> m_Ring;
+
+    // !\brief Time window before the trigger
+    std::chrono::milliseconds m_PreTrigger{ 2000 };
+
+    // !\brief Time window after the trigger
+    std::chrono::milliseconds m_PostTrigger{ 2000 };
+
+    // !\brief Are triggers armed?
+    bool m_IsArmed = false;
+
+    // !\brief Is an event collecting post-trigger frames?
+    bool m_IsRunning = false;
+
+    // !\brief Event collecting post-trigger frames
+    CanCaptureEvent m_Running;
+
+    // !\brief Completed events
+    std::vector<CanCaptureEvent> m_Completed;
+
+    // !\brief Number of events since arming
+    uint32_t m_EventCount = 0;
+
+    // !\brief Number of dropped events
+    uint32_t m_DroppedEvents = 0;
+};
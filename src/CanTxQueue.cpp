@@ -0,0 +1,381 @@
+#include "pch.hpp"
+
+CanTxQueue::CanTxQueue(size_t capacity) :
+    m_Slots(std::max<size_t>(capacity, 1))
+{
+    Reset();
+}
+
+void CanTxQueue::Reset()
+{
+    m_Heap.clear();
+    m_Heap.reserve(m_Slots.size());
+    m_FreeSlots.clear();
+    m_FreeSlots.reserve(m_Slots.size());
+    for(size_t i = m_Slots.size(); i != 0; i--)
+        m_FreeSlots.push_back(static_cast<uint32_t>(i - 1));
+    for(auto& [frame_id, slot] : m_CoalescedSlots)
+        slot = static_cast<uint32_t>(m_Slots.size());
+    m_InFlight = UINT64_MAX;
+}
+
+void CanTxQueue::SetCapacity(size_t capacity)
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_Slots.assign(std::max<size_t>(capacity, 1), CanData());
+        Reset();
+    }
+    m_SpaceCv.notify_all();
+}
+
+size_t CanTxQueue::GetCapacity()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Slots.size();
+}
+
+void CanTxQueue::SetOverflowPolicy(CanTxOverflowPolicy policy, std::chrono::milliseconds block_timeout)
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Policy = policy;
+    m_BlockTimeout = block_timeout;
+}
+
+bool CanTxQueue::SetOverflowPolicyFromString(const std::string& str)
+{
+    std::string policy = boost::algorithm::trim_copy(str.substr(0, str.find('#')));
+    if(boost::iequals(policy, "DropOldest"))
+    {
+        SetOverflowPolicy(CTOP_DROP_OLDEST);
+    }
+    else if(boost::iequals(policy, "DropNewest"))
+    {
+        SetOverflowPolicy(CTOP_DROP_NEWEST);
+    }
+    else if(boost::istarts_with(policy, "Block"))
+    {
+        std::chrono::milliseconds timeout = CAN_TX_QUEUE_DEFAULT_BLOCK_TIMEOUT;
+        if(policy.length() > 5)
+        {
+            size_t pos = 0;
+            try
+            {
+                if(policy[5] != ':')
+                    throw std::invalid_argument("expected colon");
+                timeout = std::chrono::milliseconds(std::stoul(policy.substr(6), &pos, 10));
+                if(pos != policy.length() - 6)
+                    throw std::invalid_argument("not a number");
+            }
+            catch(const std::exception& e)
+            {
+                LOG(LogLevel::Error, "Invalid TX queue block timeout, exception: {} ({})", e.what(), policy);
+                return false;
+            }
+        }
+        SetOverflowPolicy(CTOP_BLOCK, timeout);
+    }
+    else
+    {
+        LOG(LogLevel::Error, "Invalid TX queue overflow policy: {}, expected DropOldest, DropNewest or Block:TIMEOUT_MS", policy);
+        return false;
+    }
+    return true;
+}
+
+std::string CanTxQueue::GetOverflowPolicyAsString()
+{
+    std::scoped_lock lock(m_Mutex);
+    switch(m_Policy)
+    {
+        case CTOP_DROP_NEWEST:
+            return "DropNewest";
+        case CTOP_BLOCK:
+            return std::format("Block:{}", m_BlockTimeout.count());
+        default:
+            return "DropOldest";
+    }
+}
+
+void CanTxQueue::SetOrder(CanTxQueueOrder order)
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Order = order;
+    for(auto& entry : m_Heap)
+        entry.key = m_Order == CTOO_ARBITRATION ? GetArbitrationKey(m_Slots[entry.slot].frame_id) : 0;
+    std::make_heap(m_Heap.begin(), m_Heap.end(), IsSentLater);
+}
+
+bool CanTxQueue::SetOrderFromString(const std::string& str)
+{
+    std::string order = boost::algorithm::trim_copy(str.substr(0, str.find('#')));
+    if(boost::iequals(order, "Fifo"))
+    {
+        SetOrder(CTOO_FIFO);
+    }
+    else if(boost::iequals(order, "Arbitration"))
+    {
+        SetOrder(CTOO_ARBITRATION);
+    }
+    else
+    {
+        LOG(LogLevel::Error, "Invalid TX queue order: {}, expected Fifo or Arbitration", order);
+        return false;
+    }
+    return true;
+}
+
+std::string CanTxQueue::GetOrderAsString()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Order == CTOO_ARBITRATION ? "Arbitration" : "Fifo";
+}
+
+bool CanTxQueue::SetCoalescedIdsFromString(const std::string& str)
+{
+    std::vector<std::string> entries;
+    boost::split(entries, str.substr(0, str.find('#')), boost::is_any_of(","));
+
+    bool ret = true;
+    std::vector<uint32_t> frame_ids;
+    for(auto& entry : entries)
+    {
+        boost::algorithm::trim(entry);
+        if(entry.empty())
+            continue;
+
+        size_t pos = 0;
+        try
+        {
+            uint32_t frame_id = static_cast<uint32_t>(std::stoul(entry, &pos, 16));
+            if(pos != entry.length())
+                throw std::invalid_argument("not a hex number");
+            frame_ids.push_back(frame_id);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid coalesced TX frame ID, exception: {} ({})", e.what(), entry);
+            ret = false;
+        }
+    }
+
+    std::scoped_lock lock(m_Mutex);
+    m_CoalescedSlots.clear();
+    for(auto& frame_id : frame_ids)
+        m_CoalescedSlots.emplace(frame_id, static_cast<uint32_t>(m_Slots.size()));
+
+    /* Newest queued frame of an ID receives the new data, except the one which is being sent */
+    std::unordered_map<uint32_t, uint64_t> newest_sequences;
+    for(auto& entry : m_Heap)
+    {
+        uint32_t frame_id = m_Slots[entry.slot].frame_id;
+        auto it = m_CoalescedSlots.find(frame_id);
+        if(it == m_CoalescedSlots.end() || entry.sequence == m_InFlight)
+            continue;
+        auto [newest, is_inserted] = newest_sequences.emplace(frame_id, entry.sequence);
+        if(is_inserted || entry.sequence > newest->second)
+        {
+            it->second = entry.slot;
+            newest->second = entry.sequence;
+        }
+    }
+    return ret;
+}
+
+std::string CanTxQueue::GetCoalescedIdsAsString()
+{
+    std::scoped_lock lock(m_Mutex);
+    std::vector<uint32_t> frame_ids;
+    for(auto& [frame_id, slot] : m_CoalescedSlots)
+        frame_ids.push_back(frame_id);
+    std::sort(frame_ids.begin(), frame_ids.end());
+
+    std::string ret;
+    for(auto& frame_id : frame_ids)
+    {
+        if(!ret.empty())
+            ret += ", ";
+        ret += std::format("{:X}", frame_id);
+    }
+    return ret;
+}
+
+uint64_t CanTxQueue::GetArbitrationKey(uint32_t frame_id)
+{
+    /* Bits in order of transmission: 11 bit base ID, SRR/RTR, IDE, 18 bit ID extension. Dominant (0) bit wins */
+    if(frame_id < CAN_TX_QUEUE_STD_IDS)
+        return static_cast<uint64_t>(frame_id) << 20;
+    return (static_cast<uint64_t>(frame_id >> 18) << 20) | (3ULL << 18) | (frame_id & 0x3FFFF);
+}
+
+bool CanTxQueue::IsSentLater(const CanTxQueueEntry& a, const CanTxQueueEntry& b)
+{
+    if(a.key != b.key)
+        return a.key > b.key;
+    return a.sequence > b.sequence;
+}
+
+void CanTxQueue::RemoveEntry(size_t index)
+{
+    uint32_t slot = m_Heap[index].slot;
+    if(index == 0)
+    {
+        std::pop_heap(m_Heap.begin(), m_Heap.end(), IsSentLater);
+        m_Heap.pop_back();
+    }
+    else
+    {
+        /* Only on overflow or when a frame arrived before the sent one, the queue is short */
+        m_Heap[index] = m_Heap.back();
+        m_Heap.pop_back();
+        std::make_heap(m_Heap.begin(), m_Heap.end(), IsSentLater);
+    }
+
+    auto it = m_CoalescedSlots.find(m_Slots[slot].frame_id);
+    if(it != m_CoalescedSlots.end() && it->second == slot)
+        it->second = static_cast<uint32_t>(m_Slots.size());
+    m_FreeSlots.push_back(slot);
+}
+
+bool CanTxQueue::Coalesce(uint32_t frame_id, uint8_t data_len, const uint8_t* data)
+{
+    auto it = m_CoalescedSlots.find(frame_id);
+    if(it == m_CoalescedSlots.end() || it->second == m_Slots.size())
+        return false;
+
+    /* Latest value wins, the frame keeps its place in the queue */
+    CanData& slot = m_Slots[it->second];
+    slot.data_len = data_len;
+    memset(slot.data, 0, sizeof(slot.data));
+    if(data)
+        memcpy(slot.data, data, data_len);
+    m_Counters.pushed++;
+    m_Counters.coalesced++;
+    return true;
+}
+
+bool CanTxQueue::Push(uint32_t frame_id, uint8_t data_len, const uint8_t* data, bool can_block)
+{
+    std::unique_lock lock(m_Mutex);
+    uint8_t len = std::min<uint8_t>(data_len, MAX_CAN_FRAME_DATA_LEN);
+    if(Coalesce(frame_id, len, data))
+        return true;
+
+    if(m_FreeSlots.empty())
+    {
+        switch(m_Policy)
+        {
+            case CTOP_DROP_OLDEST:
+            {
+                size_t oldest = 0;
+                for(size_t i = 1; i != m_Heap.size(); i++)
+                {
+                    if(m_Heap[i].sequence < m_Heap[oldest].sequence)
+                        oldest = i;
+                }
+                RemoveEntry(oldest);
+                m_Counters.dropped_oldest++;
+                break;
+            }
+            case CTOP_BLOCK:
+            {
+                /* The consumer would wait for itself */
+                if(can_block && std::this_thread::get_id() != m_Consumer &&
+                    m_SpaceCv.wait_for(lock, m_BlockTimeout, [this]() { return !m_FreeSlots.empty(); }))
+                {
+                    /* Same ID may have been queued by another producer meanwhile */
+                    if(Coalesce(frame_id, len, data))
+                        return true;
+                    break;
+                }
+                m_Counters.dropped_newest++;
+                return false;
+            }
+            default:
+            {
+                m_Counters.dropped_newest++;
+                return false;
+            }
+        }
+    }
+
+    uint32_t slot_index = m_FreeSlots.back();
+    m_FreeSlots.pop_back();
+
+    CanData& slot = m_Slots[slot_index];
+    slot.frame_id = frame_id;
+    slot.data_len = len;
+    memset(slot.data, 0, sizeof(slot.data));
+    if(data)
+        memcpy(slot.data, data, len);
+
+    auto coalesced = m_CoalescedSlots.find(frame_id);
+    if(coalesced != m_CoalescedSlots.end())
+        coalesced->second = slot_index;
+
+    m_Heap.push_back(CanTxQueueEntry{ m_Order == CTOO_ARBITRATION ? GetArbitrationKey(frame_id) : 0, m_NextSequence++, slot_index });
+    std::push_heap(m_Heap.begin(), m_Heap.end(), IsSentLater);
+
+    m_Counters.pushed++;
+    m_Counters.high_watermark = std::max<size_t>(m_Counters.high_watermark, m_Heap.size());
+    return true;
+}
+
+bool CanTxQueue::Front(CanData& frame, uint64_t& sequence)
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Consumer = std::this_thread::get_id();
+    if(m_Heap.empty())
+        return false;
+
+    const CanTxQueueEntry& entry = m_Heap.front();
+    frame = m_Slots[entry.slot];
+    sequence = entry.sequence;
+
+    /* Data of the sent frame can't be replaced anymore, the next frame of the ID is queued again */
+    m_InFlight = entry.sequence;
+    auto it = m_CoalescedSlots.find(frame.frame_id);
+    if(it != m_CoalescedSlots.end() && it->second == entry.slot)
+        it->second = static_cast<uint32_t>(m_Slots.size());
+    return true;
+}
+
+void CanTxQueue::Pop(uint64_t sequence)
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+        m_InFlight = UINT64_MAX;
+        auto it = std::find_if(m_Heap.begin(), m_Heap.end(), [sequence](const CanTxQueueEntry& entry) { return entry.sequence == sequence; });
+        if(it == m_Heap.end())
+            return;
+        RemoveEntry(it - m_Heap.begin());
+    }
+    m_SpaceCv.notify_one();
+}
+
+void CanTxQueue::Clear()
+{
+    {
+        std::scoped_lock lock(m_Mutex);
+        Reset();
+    }
+    m_SpaceCv.notify_all();
+}
+
+size_t CanTxQueue::GetSize()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Heap.size();
+}
+
+CanTxQueueCounters CanTxQueue::GetCounters()
+{
+    std::scoped_lock lock(m_Mutex);
+    return m_Counters;
+}
+
+void CanTxQueue::ResetCounters()
+{
+    std::scoped_lock lock(m_Mutex);
+    m_Counters = CanTxQueueCounters();
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+constexpr size_t MAX_CAN_FRAME_DATA_LEN = 8;
+
+/* Default number of frames in the TX queue */
+constexpr size_t CAN_TX_QUEUE_DEFAULT_SIZE = 100;
+
+/* Frame IDs below this are standard (11 bit) IDs */
+constexpr uint32_t CAN_TX_QUEUE_STD_IDS = 0x800;
+
+/* Default time a producer waits for free space with CTOP_BLOCK */
+constexpr std::chrono::milliseconds CAN_TX_QUEUE_DEFAULT_BLOCK_TIMEOUT{ 10 };
+
+#pragma pack(push, 1)
+class CanData
+{
+public:
+    CanData() = default;
+
+    CanData(uint32_t frame_id_, uint8_t data_len, const uint8_t* data_)
+        : frame_id(frame_id_), data_len(data_len)
+    {
+        memset(data, 0, sizeof(data));
+        if(data_len > sizeof(data))
+            data_len = sizeof(data);
+
+        if(data_)
+            memcpy(data, data_, data_len);
+    }
+    uint32_t frame_id = 0;
+    uint8_t data_len = 0;
+    uint8_t data[MAX_CAN_FRAME_DATA_LEN] = {};
+};
+#pragma pack(pop)
+
+enum CanTxOverflowPolicy : uint8_t
+{
+    CTOP_DROP_OLDEST,  /* Oldest frame in the queue is overwritten */
+    CTOP_DROP_NEWEST,  /* New frame is dropped */
+    CTOP_BLOCK         /* Producer waits for free space, the new frame is dropped after the timeout */
+};
+
+enum CanTxQueueOrder : uint8_t
+{
+    CTOO_FIFO,        /* Frames are sent in order of queueing */
+    CTOO_ARBITRATION  /* Lower arbitration ID is sent first like CAN controller mailboxes, FIFO within the same ID */
+};
+
+class CanTxQueueEntry
+{
+public:
+    // !\brief Sorting key, 0 with CTOO_FIFO
+    uint64_t key = 0;
+
+    // !\brief Sequence number, increased for every queued frame
+    uint64_t sequence = 0;
+
+    // !\brief Slot index
+    uint32_t slot = 0;
+};
+
+class CanTxQueueCounters
+{
+public:
+    // !\brief Number of frames added to the queue
+    uint64_t pushed = 0;
+
+    // !\brief Number of queued frames overwritten by CTOP_DROP_OLDEST
+    uint64_t dropped_oldest = 0;
+
+    // !\brief Number of new frames dropped by CTOP_DROP_NEWEST or CTOP_BLOCK timeout
+    uint64_t dropped_newest = 0;
+
+    // !\brief Number of frames which replaced the data of a queued frame with the same ID
+    uint64_t coalesced = 0;
+
+    // !\brief Maximum number of frames in the queue
+    size_t high_watermark = 0;
+
+    // !\brief Total number of lost frames
+    uint64_t GetDropped() const { return dropped_oldest + dropped_newest; }
+};
+
+/* Fixed capacity queue of frames, any thread can add frames but only one thread may consume them. Slots are allocated once, so queueing doesn't allocate */
+class CanTxQueue
+{
+public:
+    CanTxQueue(size_t capacity = CAN_TX_QUEUE_DEFAULT_SIZE);
+
+    // !\brief Set capacity, queued frames are dropped
+    // !\param capacity [in] Number of frames, at least 1
+    void SetCapacity(size_t capacity);
+
+    // !\brief Get capacity
+    size_t GetCapacity();
+
+    // !\brief Set what happens when the queue is full
+    // !\param policy [in] Overflow policy
+    // !\param block_timeout [in] Maximum waiting time of CTOP_BLOCK
+    void SetOverflowPolicy(CanTxOverflowPolicy policy, std::chrono::milliseconds block_timeout = CAN_TX_QUEUE_DEFAULT_BLOCK_TIMEOUT);
+
+    // !\brief Set overflow policy from settings string: DropOldest, DropNewest, Block or Block:TIMEOUT_MS
+    // !\return False if the string is invalid, the policy isn't changed then
+    bool SetOverflowPolicyFromString(const std::string& str);
+
+    // !\brief Get overflow policy as settings string
+    std::string GetOverflowPolicyAsString();
+
+    // !\brief Set order of sending
+    void SetOrder(CanTxQueueOrder order);
+
+    // !\brief Set order from settings string: Fifo or Arbitration
+    // !\return False if the string is invalid, the order isn't changed then
+    bool SetOrderFromString(const std::string& str);
+
+    // !\brief Get order as settings string
+    std::string GetOrderAsString();
+
+    // !\brief Set IDs which are coalesced, a new frame of these replaces the data of the queued one instead of being queued again
+    // !\param str [in] Frame IDs in hex, separated by comma
+    // !\return False if any of the IDs is invalid, the valid ones are set
+    bool SetCoalescedIdsFromString(const std::string& str);
+
+    // !\brief Get coalesced IDs as settings string
+    std::string GetCoalescedIdsAsString();
+
+    // !\brief Get sorting key of a Frame ID, standard IDs win against extended ones with the same base ID like on the bus
+    static uint64_t GetArbitrationKey(uint32_t frame_id);
+
+    // !\brief Add frame to the queue
+    // !\details The consumer thread never blocks itself with CTOP_BLOCK, the frame is dropped immediately if the queue is full
+    // !\param frame_id [in] CAN Frame ID
+    // !\param data_len [in] Data length, longer data is truncated to MAX_CAN_FRAME_DATA_LEN
+    // !\param data [in] Data
+    // !\param can_block [in] May wait for free space with CTOP_BLOCK? False if the caller holds a lock the consumer needs
+    // !\return False if the new frame was dropped
+    bool Push(uint32_t frame_id, uint8_t data_len, const uint8_t* data, bool can_block = true);
+
+    // !\brief Copy the next frame without removing it, called by the consumer
+    // !\param frame [out] Frame
+    // !\param sequence [out] Sequence number of the frame for Pop
+    // !\return False if the queue is empty
+    bool Front(CanData& frame, uint64_t& sequence);
+
+    // !\brief Remove the frame returned by Front, called by the consumer
+    // !\param sequence [in] Sequence number returned by Front, nothing happens if that frame has been dropped meanwhile
+    void Pop(uint64_t sequence);
+
+    // !\brief Drop every queued frame
+    void Clear();
+
+    // !\brief Get number of queued frames
+    size_t GetSize();
+
+    // !\brief Get counters
+    CanTxQueueCounters GetCounters();
+
+    // !\brief Reset counters
+    void ResetCounters();
+
+private:
+    // !\brief Is entry a sent later than entry b? Comparator of the std heap functions
+    static bool IsSentLater(const CanTxQueueEntry& a, const CanTxQueueEntry& b);
+
+    // !\brief Replace data of the queued frame of a coalesced ID
+    // !\return False if the ID isn't coalesced or it has no queued frame
+    bool Coalesce(uint32_t frame_id, uint8_t data_len, const uint8_t* data);
+
+    // !\brief Remove entry from the heap and free its slot
+    // !\param index [in] Index in m_Heap
+    void RemoveEntry(size_t index);
+
+    // !\brief Drop every queued frame and rebuild free slot list
+    void Reset();
+
+    // !\brief Frame slots
+    std::vector<CanData> m_Slots;
+
+    // !\brief Indexes of free slots
+    std::vector<uint32_t> m_FreeSlots;
+
+    // !\brief Queued frames, heap ordered by key and sequence
+    std::vector<CanTxQueueEntry> m_Heap;
+
+    // !\brief Sequence number of the next frame
+    uint64_t m_NextSequence = 0;
+
+    // !\brief Sequence number of the frame returned by Front
+    uint64_t m_InFlight = UINT64_MAX;
+
+    // !\brief Queued slot of coalesced IDs [frame_id] = slot index, m_Slots.size() if there is no queued frame. Keys are inserted only by SetCoalescedIdsFromString, so Push doesn't allocate
+    std::unordered_map<uint32_t, uint32_t> m_CoalescedSlots;
+
+    // !\brief Order of sending
+    CanTxQueueOrder m_Order = CTOO_FIFO;
+
+    // !\brief Overflow policy
+    CanTxOverflowPolicy m_Policy = CTOP_DROP_OLDEST;
+
+    // !\brief Maximum waiting time of CTOP_BLOCK
+    std::chrono::milliseconds m_BlockTimeout = CAN_TX_QUEUE_DEFAULT_BLOCK_TIMEOUT;
+
+    // !\brief Thread which called Front last time
+    std::thread::id m_Consumer;
+
+    // !\brief Counters
+    CanTxQueueCounters m_Counters;
+
+    // !\brief Mutex for the queue
+    std::mutex m_Mutex;
+
+    // !\brief Signaled when a frame is removed
+    std::condition_variable m_SpaceCv;
+};
@@ -0,0 +1,673 @@
+#include "pch.hpp"
+
+constexpr uint8_t DID_DISCOVERY_MAX_RETRIES = 3;
+constexpr auto DID_DISCOVERY_N_CR_TIMEOUT = 1000ms;
+constexpr auto DID_DISCOVERY_BUSY_BACKOFF = 500ms;  /* Multiplied by the number of retries */
+constexpr auto DID_DISCOVERY_SAVE_PERIOD = 1000ms;
+
+DidDiscovery::DidDiscovery(CanEntryHandler* can_handler, UdsSessionManager& session_manager) :
+    m_can_handler(can_handler), m_SessionManager(session_manager)
+{
+    if(m_can_handler)
+        m_can_handler->RegisterObserver(this);
+}
+
+DidDiscovery::~DidDiscovery()
+{
+    Stop();
+    if(m_can_handler)
+        m_can_handler->UnregisterObserver(this);
+}
+
+bool DidDiscovery::ParseTargets(const std::string& input, std::vector<DidDiscoveryTarget>& targets)
+{
+    std::vector<std::string> target_strings;
+    boost::split(target_strings, input, boost::is_any_of(","));
+    for(auto& target_str : target_strings)
+    {
+        boost::algorithm::trim(target_str);
+        if(target_str.empty())
+            continue;
+
+        std::vector<std::string> params;
+        boost::split(params, target_str, boost::is_any_of(":"));
+        if(params.size() < 2)
+        {
+            LOG(LogLevel::Error, "Invalid DID discovery target: {}, ECU and response ID is required", target_str);
+            return false;
+        }
+
+        DidDiscoveryTarget target;
+        try
+        {
+            target.ecu_id = std::stoul(params[0], nullptr, 16);
+            target.response_id = std::stoul(params[1], nullptr, 16);
+            for(size_t i = 2; i < params.size(); i++)
+            {
+                boost::algorithm::trim(params[i]);
+                if(boost::algorithm::iequals(params[i], "strict"))
+                {
+                    target.is_strict = true;
+                    continue;
+                }
+
+                size_t separator = params[i].find('-');
+                if(separator == std::string::npos)
+                    throw std::invalid_argument("invalid DID range");
+                target.first_did = static_cast<uint16_t>(std::stoul(params[i].substr(0, separator), nullptr, 16));
+                target.last_did = static_cast<uint16_t>(std::stoul(params[i].substr(separator + 1), nullptr, 16));
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid DID discovery target: {}, exception: {}", target_str, e.what());
+            return false;
+        }
+
+        if(target.first_did > target.last_did)
+        {
+            LOG(LogLevel::Error, "Invalid DID range for discovery: {:X}-{:X}", target.first_did, target.last_did);
+            return false;
+        }
+        target.next_did = target.first_did;
+        targets.push_back(std::move(target));
+    }
+    return !targets.empty();
+}
+
+bool DidDiscovery::Start(const std::vector<DidDiscoveryTarget>& targets)
+{
+    if(!m_can_handler || targets.empty() || IsRunning())
+        return false;
+
+    Stop();
+
+    std::map<uint32_t, DidDiscoveryTarget> saved_targets;
+    LoadProgress(saved_targets);
+
+    /* Channels are opened without holding m, because CAN RX path locks CanEntryHandler::m first, then m */
+    std::map<uint32_t, std::unique_ptr<TargetState>> new_targets;
+    for(auto& i : targets)
+    {
+        if(new_targets.contains(i.response_id))
+        {
+            LOG(LogLevel::Error, "Response ID {:X} is used by more DID discovery targets", i.response_id);
+            continue;
+        }
+
+        if(i.response_id != m_can_handler->GetIsoTpResponseFrameId() && !m_can_handler->OpenIsoTpChannel(i.ecu_id, i.response_id))
+        {
+            LOG(LogLevel::Error, "Failed to open ISO-TP channel for ECU {:X} (response ID: {:X})", i.ecu_id, i.response_id);
+            continue;
+        }
+
+        std::unique_ptr<TargetState> state = std::make_unique<TargetState>();
+        state->target = i;
+        state->target.next_did = i.first_did;
+        state->target.found.clear();
+
+        auto saved = saved_targets.find(i.ecu_id);
+        if(saved != saved_targets.end() && saved->second.response_id == i.response_id &&
+            saved->second.first_did == i.first_did && saved->second.last_did == i.last_did)
+        {
+            state->target.next_did = saved->second.next_did;
+            state->target.found = std::move(saved->second.found);
+            LOG(LogLevel::Normal, "Resuming DID discovery for ECU {:X} from DID {:X}, {} DIDs found earlier", i.ecu_id, state->target.next_did, state->target.found.size());
+        }
+        new_targets[i.response_id] = std::move(state);
+    }
+
+    {
+        std::scoped_lock lock(m);
+        m_Targets = std::move(new_targets);
+    }
+
+    for(auto& [response_id, state] : m_Targets)
+    {
+        state->is_running = true;
+        state->worker = std::make_unique<std::jthread>(std::bind_front(&DidDiscovery::WorkerThread, this), state.get());
+        utils::SetThreadName(*state->worker, "DidDiscovery");
+    }
+    return !m_Targets.empty();
+}
+
+void DidDiscovery::Stop()
+{
+    for(auto& [response_id, state] : m_Targets)
+        state->worker.reset(nullptr);  /* Request stop and join */
+
+    std::vector<uint32_t> response_ids;
+    {
+        std::scoped_lock lock(m);
+        for(auto& [response_id, state] : m_Targets)
+            response_ids.push_back(response_id);
+    }
+
+    /* Closed without holding m, see Start */
+    for(auto response_id : response_ids)
+    {
+        if(m_can_handler && response_id != m_can_handler->GetIsoTpResponseFrameId())
+            m_can_handler->CloseIsoTpChannel(response_id);
+    }
+}
+
+bool DidDiscovery::IsRunning() const
+{
+    std::scoped_lock lock(m);
+    return std::any_of(m_Targets.cbegin(), m_Targets.cend(), [](const auto& item) { return item.second->is_running.load(); });
+}
+
+std::string DidDiscovery::GetProgressAsString() const
+{
+    std::scoped_lock lock(m);
+    std::string ret;
+    for(auto& [response_id, state] : m_Targets)
+    {
+        const DidDiscoveryTarget& t = state->target;
+        double progress = 100.0 * (t.next_did - t.first_did) / (static_cast<double>(t.last_did) - t.first_did + 1);
+        if(!ret.empty())
+            ret += ", ";
+        ret += std::format("ECU {:X}: {:.1f}%, {} DIDs, {} requests, {} timeouts", t.ecu_id, progress, t.found.size(), t.requests, t.timeouts);
+    }
+    return ret;
+}
+
+void DidDiscovery::OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size)
+{
+    std::scoped_lock lock(m);
+    auto it = m_Targets.find(frame_id);
+    if(it == m_Targets.end())
+        return;
+
+    {
+        std::scoped_lock response_lock(it->second->response_mutex);
+        it->second->response_frame_cnt++;
+    }
+    it->second->response_cv.notify_all();
+}
+
+void DidDiscovery::OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size)
+{
+    std::scoped_lock lock(m);
+    auto it = m_Targets.find(frame_id);
+    if(it == m_Targets.end())
+        return;
+
+    {
+        std::scoped_lock response_lock(it->second->response_mutex);
+        it->second->response.assign(data, data + size);
+        it->second->response_cnt++;
+    }
+    it->second->response_cv.notify_all();
+}
+
+void DidDiscovery::WorkerThread(std::stop_token token, TargetState* state)
+{
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    const uint32_t ecu_id = state->target.ecu_id;
+    const uint32_t last_did = state->target.last_did;
+    bool is_finished = false;
+
+    OpenExtendedSession(*state, token);
+    while(!token.stop_requested())
+    {
+        uint32_t next_did = 0;
+        {
+            std::scoped_lock lock(m);
+            next_did = state->target.next_did;
+        }
+
+        if(next_did > last_did)
+        {
+            is_finished = true;
+            break;
+        }
+
+        size_t count = std::min<size_t>(state->batch_size, last_did - next_did + 1);
+        if(!ScanRange(*state, next_did, count, token))
+            break;
+
+        bool is_save_due = false;
+        {
+            std::scoped_lock lock(m);
+            state->target.next_did = next_did + static_cast<uint32_t>(count);
+            is_save_due = std::chrono::steady_clock::now() - m_LastSave > DID_DISCOVERY_SAVE_PERIOD;
+        }
+
+        if(is_save_due)
+            SaveProgress();
+    }
+    SaveProgress();
+
+    if(is_finished)
+    {
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        std::string path = std::format("DidList_{:X}.xml", ecu_id);
+        ExportDidList(state->target, path);
+        LOG(LogLevel::Notification, "DID discovery finished for ECU {:X} in {:.3f}s, {} supported DIDs, {} requests. Saved to {}",
+            ecu_id, std::chrono::duration<double>(t2 - t1).count(), state->target.found.size(), state->target.requests, path);
+    }
+    state->is_running = false;
+}
+
+bool DidDiscovery::ScanRange(TargetState& state, uint32_t first, size_t count, std::stop_token& token)
+{
+    const uint32_t ecu_id = state.target.ecu_id;
+    uint8_t session_retries = 0;
+    uint8_t busy_retries = 0;
+
+    std::vector<std::pair<uint32_t, size_t>> pending = { { first, count } };
+    auto split = [&pending](uint32_t start, size_t cnt)
+    {
+        pending.push_back({ start + static_cast<uint32_t>(cnt / 2), cnt - cnt / 2 });
+        pending.push_back({ start, cnt / 2 });  /* Lower half is scanned first */
+    };
+
+    auto record = [this, &state](uint16_t did, DidDiscoveryResult&& result)
+    {
+        LOG(LogLevel::Verbose, "DID discovery: ECU {:X} supports DID {:X}, length: {}, NRC: {:X}", state.target.ecu_id, did, result.len, result.nrc);
+        std::scoped_lock lock(m);
+        state.target.found[did] = std::move(result);
+    };
+
+    while(!pending.empty())
+    {
+        if(token.stop_requested())
+            return false;
+
+        auto [start, cnt] = pending.back();
+        pending.pop_back();
+
+        std::vector<uint8_t> request = { 0x22 };
+        for(uint32_t did = start; did != start + cnt; did++)
+        {
+            request.push_back(static_cast<uint8_t>(did >> 8));
+            request.push_back(static_cast<uint8_t>(did & 0xFF));
+        }
+
+        bool ret = false;
+        for(uint8_t retry = 0; retry != DID_DISCOVERY_MAX_RETRIES && !ret && !token.stop_requested(); retry++)
+            ret = SendRequest(state, request, token);
+
+        if(!ret)
+        {
+            if(token.stop_requested())
+                return false;
+
+            if(cnt > 1)  /* ECU might not be able to handle the response */
+                split(start, cnt);
+            else
+                LOG(LogLevel::Warning, "DID discovery: no response for DID {:X} from ECU {:X}, skipping it", start, ecu_id);
+            continue;
+        }
+
+        std::vector<uint8_t> response;
+        {
+            std::scoped_lock lock(state.response_mutex);
+            response = state.response;
+        }
+
+        if(response.size() >= 3 && response[0] == 0x62)
+        {
+            busy_retries = 0;
+            std::vector<size_t> offsets;
+            switch(SplitPositiveResponse(response, start, cnt, offsets))
+            {
+                case DDS_OK:
+                {
+                    for(size_t i = 0; i != cnt; i++)
+                    {
+                        size_t data_start = offsets[i] + 2;
+                        size_t data_end = i + 1 != cnt ? offsets[i + 1] : response.size();
+                        record(static_cast<uint16_t>(start + i), { data_end - data_start, 0, std::vector<uint8_t>(response.begin() + data_start, response.begin() + data_end) });
+                    }
+                    break;
+                }
+                case DDS_MISSING:  /* Unsupported DIDs are isolated by bisection */
+                {
+                    if(cnt > 1)
+                        split(start, cnt);
+                    break;
+                }
+                case DDS_AMBIGUOUS:  /* Every DID is supported, but the data lengths are unknown */
+                {
+                    for(uint32_t did = start + static_cast<uint32_t>(cnt); did-- != start;)
+                        pending.push_back({ did, 1 });
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if(response.size() < 3 || response[0] != 0x7F || response[1] != 0x22)
+        {
+            std::string hex;
+            utils::ConvertHexBufferToString((const char*)response.data(), response.size(), hex);
+            LOG(LogLevel::Warning, "DID discovery: unexpected response from ECU {:X}: {}", ecu_id, hex);
+            continue;
+        }
+
+        uint8_t nrc = response[2];
+        switch(nrc)
+        {
+            case 0x31:  /* requestOutOfRange - none of the DIDs is supported */
+            {
+                if(cnt > 1 && state.target.is_strict)
+                    split(start, cnt);
+                break;
+            }
+            case 0x13:  /* incorrectMessageLengthOrInvalidFormat - too many DIDs */
+            case 0x14:  /* responseTooLong */
+            {
+                if(cnt > 1)
+                {
+                    state.batch_size = std::max<size_t>(1, cnt / 2);
+                    split(start, cnt);
+                }
+                else if(nrc == 0x14)
+                {
+                    record(static_cast<uint16_t>(start), { 0, nrc, {} });
+                }
+                break;
+            }
+            case 0x7F:  /* serviceNotSupportedInActiveSession - session has been lost */
+            {
+                if(session_retries++ < DID_DISCOVERY_MAX_RETRIES)
+                {
+                    OpenExtendedSession(state, token);
+                    pending.push_back({ start, cnt });
+                }
+                break;
+            }
+            case 0x11:  /* serviceNotSupported */
+            {
+                LOG(LogLevel::Error, "DID discovery: ECU {:X} doesn't support ReadDataByIdentifier", ecu_id);
+                return false;
+            }
+            case 0x33:  /* securityAccessDenied - DID exists, but it can't be read without unlocking */
+            {
+                if(cnt > 1)
+                    split(start, cnt);
+                else
+                    record(static_cast<uint16_t>(start), { 0, nrc, {} });
+                break;
+            }
+            default:  /* Whole request is rejected (e.g. busyRepeatRequest, conditionsNotCorrect), it says nothing about the DIDs */
+            {
+                if(busy_retries++ == DID_DISCOVERY_MAX_RETRIES)
+                {
+                    LOG(LogLevel::Error, "DID discovery: ECU {:X} keeps rejecting requests with NRC {:X}, stopping the scan at DID {:X}", ecu_id, nrc, start);
+                    return false;
+                }
+
+                LOG(LogLevel::Verbose, "DID discovery: ECU {:X} rejected request with NRC {:X}, retrying", ecu_id, nrc);
+                {
+                    std::unique_lock lock(state.response_mutex);
+                    state.response_cv.wait_for(lock, token, DID_DISCOVERY_BUSY_BACKOFF * busy_retries, []() { return false; });
+                }
+                pending.push_back({ start, cnt });
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+DidDiscoverySplit DidDiscovery::SplitPositiveResponse(const std::vector<uint8_t>& response, uint32_t first, size_t count, std::vector<size_t>& offsets)
+{
+    offsets.clear();
+    if(count == 1)  /* Data may contain the ID too, but it can belong only to this DID */
+    {
+        if(response.size() < 3 || response[1] != static_cast<uint8_t>(first >> 8) || response[2] != static_cast<uint8_t>(first & 0xFF))
+            return DDS_MISSING;
+        offsets.push_back(1);
+        return DDS_OK;
+    }
+
+    /* Data lengths are unknown, so the response is split at the DIDs. It's unambiguous only if every DID occurs exactly once,
+       otherwise a DID could be omitted (unsupported) and its ID could be part of the data of another one */
+    bool is_ambiguous = false;
+    for(uint32_t did = first; did != first + count; did++)
+    {
+        size_t offset = 0;
+        size_t occurrences = 0;
+        for(size_t pos = 1; pos + 2 <= response.size(); pos++)
+        {
+            if(response[pos] == static_cast<uint8_t>(did >> 8) && response[pos + 1] == static_cast<uint8_t>(did & 0xFF))
+            {
+                offset = pos;
+                occurrences++;
+            }
+        }
+
+        if(!occurrences)
+            return DDS_MISSING;
+        if(occurrences != 1 || (offsets.empty() ? offset != 1 : offset < offsets.back() + 2))
+            is_ambiguous = true;
+        offsets.push_back(offset);
+    }
+    return is_ambiguous ? DDS_AMBIGUOUS : DDS_OK;
+}
+
+bool DidDiscovery::SendRequest(TargetState& state, const std::vector<uint8_t>& request, std::stop_token& token)
+{
+    uint32_t response_cnt = 0;
+    uint32_t response_frame_cnt = 0;
+    {
+        std::scoped_lock lock(state.response_mutex);
+        response_cnt = state.response_cnt;
+        response_frame_cnt = state.response_frame_cnt;
+    }
+
+    const uint32_t ecu_id = state.target.ecu_id;
+    const uint32_t response_id = state.target.response_id;
+    const uint8_t sid = request[0];
+    const UdsTiming timing = m_SessionManager.GetTiming(ecu_id);
+    const auto start = std::chrono::steady_clock::now();
+    if(response_id == m_can_handler->GetIsoTpResponseFrameId())
+        m_can_handler->SendIsoTpFrame(ecu_id, const_cast<uint8_t*>(request.data()), static_cast<uint16_t>(request.size()));
+    else
+        m_can_handler->SendIsoTpFrameOnChannel(response_id, const_cast<uint8_t*>(request.data()), static_cast<uint16_t>(request.size()));
+    m_SessionManager.OnRequestSent(ecu_id);
+
+    {
+        std::scoped_lock lock(m);
+        state.target.requests++;
+    }
+
+    std::chrono::milliseconds timeout = timing.p2 + UDS_P2_CLIENT_MARGIN;
+    while(!token.stop_requested())
+    {
+        std::unique_lock lock(state.response_mutex);
+        bool ret = state.response_cv.wait_for(lock, token, timeout, [&]()
+            {
+                return state.response_cnt != response_cnt || state.response_frame_cnt != response_frame_cnt;
+            });
+
+        if(!ret)
+            break;
+
+        if(state.response_cnt != response_cnt)
+        {
+            response_cnt = state.response_cnt;
+            response_frame_cnt = state.response_frame_cnt;
+            if(state.response.size() >= 3 && state.response[0] == 0x7F && state.response[2] == 0x78)  /* responsePending */
+            {
+                /* Pending response of another service doesn't extend the timeout of this request */
+                if(state.response[1] == sid)
+                {
+                    m_SessionManager.OnResponsePending(ecu_id);
+                    timeout = timing.p2_star + UDS_P2_CLIENT_MARGIN;
+                }
+                continue;
+            }
+
+            /* Session and timings reported by the ECU are tracked for the next requests */
+            m_SessionManager.OnResponseReceived(ecu_id, state.response.data(), state.response.size());
+            m_SessionManager.OnResponseTime(ecu_id, std::chrono::steady_clock::now() - start);
+            return true;
+        }
+
+        response_frame_cnt = state.response_frame_cnt;  /* Multi-frame response is in progress */
+        timeout = DID_DISCOVERY_N_CR_TIMEOUT;
+    }
+
+    if(!token.stop_requested())
+    {
+        m_SessionManager.OnResponseTimeout(ecu_id);
+        std::scoped_lock lock(m);
+        state.target.timeouts++;
+    }
+    return false;
+}
+
+void DidDiscovery::OpenExtendedSession(TargetState& state, std::stop_token& token)
+{
+    bool ret = SendRequest(state, { 0x10, 0x03 }, token);
+    std::scoped_lock lock(state.response_mutex);
+    if(ret && !state.response.empty() && state.response[0] == 0x50)
+        LOG(LogLevel::Verbose, "DID discovery: extended session opened on ECU {:X}", state.target.ecu_id);
+    else
+        LOG(LogLevel::Warning, "DID discovery: failed to open extended session on ECU {:X}, scanning in the active session", state.target.ecu_id);
+}
+
+void DidDiscovery::LoadProgress(std::map<uint32_t, DidDiscoveryTarget>& targets)
+{
+    if(!std::filesystem::exists(DID_DISCOVERY_PROGRESS_FILENAME))
+        return;
+
+    boost::property_tree::ptree pt;
+    try
+    {
+        read_xml(DID_DISCOVERY_PROGRESS_FILENAME, pt);
+        for(const boost::property_tree::ptree::value_type& v : pt.get_child("DidDiscovery"))
+        {
+            if(v.first != "Ecu")
+                continue;
+
+            DidDiscoveryTarget target;
+            target.ecu_id = std::stoul(v.second.get<std::string>("<xmlattr>.id"), nullptr, 16);
+            target.response_id = std::stoul(v.second.get<std::string>("<xmlattr>.response"), nullptr, 16);
+            target.first_did = static_cast<uint16_t>(std::stoul(v.second.get<std::string>("<xmlattr>.first"), nullptr, 16));
+            target.last_did = static_cast<uint16_t>(std::stoul(v.second.get<std::string>("<xmlattr>.last"), nullptr, 16));
+            target.next_did = std::stoul(v.second.get<std::string>("<xmlattr>.next"), nullptr, 16);
+            for(const boost::property_tree::ptree::value_type& did_node : v.second)
+            {
+                if(did_node.first != "Did")
+                    continue;
+
+                uint16_t did = static_cast<uint16_t>(std::stoul(did_node.second.get<std::string>("<xmlattr>.id"), nullptr, 16));
+                DidDiscoveryResult result;
+                result.nrc = static_cast<uint8_t>(std::stoul(did_node.second.get<std::string>("<xmlattr>.nrc", "0"), nullptr, 16));
+                std::string hex = did_node.second.get_value<std::string>();
+                boost::algorithm::unhex(hex, std::back_inserter(result.data));
+                result.len = result.data.size();
+                target.found[did] = std::move(result);
+            }
+            targets[target.ecu_id] = std::move(target);
+        }
+    }
+    catch(const boost::property_tree::xml_parser_error& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}, {}", e.filename(), e.what());
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}", e.what());
+    }
+}
+
+bool DidDiscovery::SaveProgress()
+{
+    /* Snapshot is taken while holding the file lock, so an older snapshot can't overwrite a newer one */
+    std::scoped_lock save_lock(m_SaveMutex);
+    std::vector<DidDiscoveryTarget> targets;
+    {
+        std::scoped_lock lock(m);
+        for(auto& [response_id, state] : m_Targets)
+            targets.push_back(state->target);
+        m_LastSave = std::chrono::steady_clock::now();
+    }
+
+    /* Progress of ECUs which aren't scanned now is kept */
+    boost::property_tree::ptree pt;
+    if(std::filesystem::exists(DID_DISCOVERY_PROGRESS_FILENAME))
+    {
+        try
+        {
+            read_xml(DID_DISCOVERY_PROGRESS_FILENAME, pt, boost::property_tree::xml_parser::trim_whitespace);
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Warning, "DID discovery progress is invalid, it's overwritten: {}", e.what());
+            pt.clear();
+        }
+    }
+
+    boost::property_tree::ptree& root_node = pt.get_child_optional("DidDiscovery") ? pt.get_child("DidDiscovery") : pt.add_child("DidDiscovery", boost::property_tree::ptree{});
+    for(auto it = root_node.begin(); it != root_node.end();)
+    {
+        uint32_t ecu_id = std::strtoul(it->second.get<std::string>("<xmlattr>.id", "").c_str(), nullptr, 16);
+        bool is_scanned = it->first == "Ecu" && std::any_of(targets.begin(), targets.end(), [ecu_id](const DidDiscoveryTarget& t) { return t.ecu_id == ecu_id; });
+        it = is_scanned ? root_node.erase(it) : std::next(it);
+    }
+
+    bool ret = true;
+    for(const DidDiscoveryTarget& t : targets)
+    {
+        auto& ecu_node = root_node.add_child("Ecu", boost::property_tree::ptree{});
+        ecu_node.put("<xmlattr>.id", std::format("{:X}", t.ecu_id));
+        ecu_node.put("<xmlattr>.response", std::format("{:X}", t.response_id));
+        ecu_node.put("<xmlattr>.first", std::format("{:X}", t.first_did));
+        ecu_node.put("<xmlattr>.last", std::format("{:X}", t.last_did));
+        ecu_node.put("<xmlattr>.next", std::format("{:X}", t.next_did));
+        for(auto& [did, result] : t.found)
+        {
+            std::string hex;
+            boost::algorithm::hex(result.data.begin(), result.data.end(), std::back_inserter(hex));
+            auto& did_node = ecu_node.add("Did", hex);
+            did_node.put("<xmlattr>.id", std::format("{:X}", did));
+            did_node.put("<xmlattr>.nrc", std::format("{:X}", result.nrc));
+        }
+    }
+
+    try
+    {
+        boost::property_tree::write_xml(DID_DISCOVERY_PROGRESS_FILENAME, pt, std::locale(),
+            boost::property_tree::xml_writer_make_settings<boost::property_tree::ptree::key_type>('\t', 1));
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Exception thrown: {}", e.what());
+        ret = false;
+    }
+    return ret;
+}
+
+bool DidDiscovery::ExportDidList(const DidDiscoveryTarget& target, const std::filesystem::path& path)
+{
+    DidMap dids;
+    for(auto& [did, result] : target.found)
+    {
+        DidEntryType type = DET_BYTEARRAY;
+        switch(result.len)
+        {
+            case 1: type = DET_UI8; break;
+            case 2: type = DET_UI16; break;
+            case 4: type = DET_UI32; break;
+            case 8: type = DET_UI64; break;
+            default:
+            {
+                if(!result.data.empty() && std::all_of(result.data.begin(), result.data.end(), [](uint8_t c) { return std::isprint(c) || c == 0; }))
+                    type = DET_STRING;
+                break;
+            }
+        }
+
+        std::string name = result.nrc ? std::format("DID_{:04X} (NRC {:X})", did, result.nrc) : std::format("DID_{:04X}", did);
+        dids[did] = std::make_unique<DidEntry>(did, type, name, "", "", result.len);
+    }
+
+    XmlDidLoader loader;
+    return loader.Save(path, dids);
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ICanObserver.hpp"
+
+constexpr const char* DID_DISCOVERY_PROGRESS_FILENAME = "DidDiscovery.xml";
+
+/* Number of DIDs in one ReadDataByIdentifier request at the beginning, it's halved if the ECU rejects the length */
+constexpr size_t DID_DISCOVERY_DEFAULT_BATCH_SIZE = 32;
+
+enum DidDiscoverySplit : uint8_t
+{
+    DDS_OK,        /* Every DID is found in the response */
+    DDS_MISSING,   /* A DID isn't in the response, it isn't supported */
+    DDS_AMBIGUOUS  /* Every DID is there, but an ID occurs in the data of another DID too */
+};
+
+class DidDiscoveryResult
+{
+public:
+    // !\brief Data length
+    size_t len = 0;
+
+    // !\brief Negative response code if the DID exists but can't be read, 0 otherwise
+    uint8_t nrc = 0;
+
+    // !\brief Data read during the scan
+    std::vector<uint8_t> data;
+};
+
+class DidDiscoveryTarget
+{
+public:
+    // !\brief CAN ID of requests
+    uint32_t ecu_id = 0;
+
+    // !\brief CAN ID of responses
+    uint32_t response_id = 0;
+
+    // !\brief First DID to scan
+    uint16_t first_did = 0x0000;
+
+    // !\brief Last DID to scan
+    uint16_t last_did = 0xFFFF;
+
+    // !\brief Bisect batches rejected with NRC 0x31 too, for ECUs which reject the whole request if a DID isn't supported
+    bool is_strict = false;
+
+    // !\brief Next DID to scan, last_did + 1 when the scan is finished
+    uint32_t next_did = 0;
+
+    // !\brief Supported DIDs found so far
+    std::map<uint16_t, DidDiscoveryResult> found;
+
+    // !\brief Number of requests sent
+    size_t requests = 0;
+
+    // !\brief Number of requests without response
+    size_t timeouts = 0;
+};
+
+class CanEntryHandler;
+class UdsSessionManager;
+class DidDiscovery : public ICanObserver
+{
+public:
+    // !\param can_handler [in] CAN entry handler
+    // !\param session_manager [in] Session manager, P2/P2* timings of the targets are taken from it
+    DidDiscovery(CanEntryHandler* can_handler, UdsSessionManager& session_manager);
+    ~DidDiscovery();
+
+    // !\brief Parse targets from string
+    // !\param input [in] Comma separated list in ECU_ID:RESPONSE_ID[:FIRST-LAST][:strict] format, IDs are in hex
+    // !\param targets [out] Parsed targets
+    // !\return False if input contains an invalid target
+    static bool ParseTargets(const std::string& input, std::vector<DidDiscoveryTarget>& targets);
+
+    // !\brief Start scanning targets concurrently, progress of an earlier scan with the same range is resumed
+    // !\param targets [in] Targets to scan, each of them needs a different response ID
+    bool Start(const std::vector<DidDiscoveryTarget>& targets);
+
+    // !\brief Stop scanning, progress is saved
+    void Stop();
+
+    // !\brief Is scanning in progress?
+    bool IsRunning() const;
+
+    // !\brief Get progress of each target in human readable format
+    std::string GetProgressAsString() const;
+
+    // !\brief Save supported DIDs of a target in DidList format
+    // !\param target [in] Target
+    // !\param path [in] Path to XML file
+    static bool ExportDidList(const DidDiscoveryTarget& target, const std::filesystem::path& path);
+
+    void OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size) override;
+    void OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size) override;
+
+private:
+    class TargetState
+    {
+    public:
+        // !\brief Target and its progress, guarded by DidDiscovery::m
+        DidDiscoveryTarget target;
+
+        // !\brief Current number of DIDs per request
+        size_t batch_size = DID_DISCOVERY_DEFAULT_BATCH_SIZE;
+
+        // !\brief Mutex for response
+        std::mutex response_mutex;
+
+        // !\brief Conditional variable for response
+        std::condition_variable_any response_cv;
+
+        // !\brief Last response
+        std::vector<uint8_t> response;
+
+        // !\brief Number of responses received
+        uint32_t response_cnt = 0;
+
+        // !\brief Number of frames received on response ID
+        uint32_t response_frame_cnt = 0;
+
+        // !\brief Is scan of this target running?
+        std::atomic<bool> is_running = false;
+
+        // !\brief Worker thread
+        std::unique_ptr<std::jthread> worker;
+    };
+
+    // !\brief Worker thread, one is running for each target
+    void WorkerThread(std::stop_token token, TargetState* state);
+
+    // !\brief Scan given DID range, bisect it until supported DIDs are isolated
+    // !\return False if the scan of this target has to be aborted
+    bool ScanRange(TargetState& state, uint32_t first, size_t count, std::stop_token& token);
+
+    // !\brief Split a positive ReadDataByIdentifier response at the DIDs
+    // !\param response [in] Positive response
+    // !\param first [in] First requested DID
+    // !\param count [in] Number of requested DIDs
+    // !\param offsets [out] Offset of each DID in the response
+    static DidDiscoverySplit SplitPositiveResponse(const std::vector<uint8_t>& response, uint32_t first, size_t count, std::vector<size_t>& offsets);
+
+    // !\brief Send UDS request and wait for the final response
+    // !\return False on timeout
+    bool SendRequest(TargetState& state, const std::vector<uint8_t>& request, std::stop_token& token);
+
+    // !\brief Open extended diagnostic session
+    void OpenExtendedSession(TargetState& state, std::stop_token& token);
+
+    // !\brief Load progress of an earlier scan
+    void LoadProgress(std::map<uint32_t, DidDiscoveryTarget>& targets);
+
+    // !\brief Save progress of each target, saved progress of other ECUs is kept
+    bool SaveProgress();
+
+    // !\brief Pointer to CAN entry handler
+    CanEntryHandler* m_can_handler = nullptr;
+
+    // !\brief Session manager for P2/P2* timings
+    UdsSessionManager& m_SessionManager;
+
+    // !\brief Targets [response_id] = state
+    std::map<uint32_t, std::unique_ptr<TargetState>> m_Targets;
+
+    // !\brief Mutex for targets, it's locked in CAN RX callbacks, so file I/O isn't done while holding it
+    mutable std::mutex m;
+
+    // !\brief Mutex for progress file
+    std::mutex m_SaveMutex;
+
+    // !\brief Time of last progress saving, guarded by m
+    std::chrono::steady_clock::time_point m_LastSave;
+};
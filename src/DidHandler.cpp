@@ -2,10 +2,25 @@
 
 constexpr const char* DID_LIST_FILENAME = "DidList.xml";
 
+constexpr char DID_CACHE_MAGIC[4] = { 'D', 'I', 'D', 'C' };
+constexpr uint16_t DID_CACHE_VERSION = 1;
+constexpr size_t DID_CACHE_HEADER_SIZE = sizeof(DID_CACHE_MAGIC) + sizeof(uint16_t) * 2;  /* Magic, version, reserved */
+constexpr size_t DID_CACHE_RECORD_OVERHEAD = sizeof(uint16_t) * 3 + sizeof(int64_t) + sizeof(uint16_t);  /* DID, NRC, value length, timestamp, CRC */
+
+/* Journal is compacted when it has this many times more records than what is kept */
+constexpr size_t DID_CACHE_COMPACTION_RATIO = 2;
+constexpr size_t DID_CACHE_MIN_RECORDS_FOR_COMPACTION = 10000;
+
 constexpr uint8_t MAX_EXTENDED_SESSION_RETRIES = 5;
-constexpr auto UDS_TIMEOUT_FOR_RESPONSE = 12000ms;
 
-constexpr auto MAIN_THREAD_SLEEP = 350ms;
+/* ISO 15765-2 N_Cr: maximum time between consecutive frames of a multi-frame response */
+constexpr auto ISOTP_N_CR_TIMEOUT = 1000ms;
+
+constexpr size_t DEFAULT_MAX_DIDS_PER_REQUEST = 16;
+
+/* Learned DID limit is doubled after this many fully answered batches, so a limit learned from a transient rejection recovers */
+constexpr size_t DID_BATCH_LIMIT_RECOVERY = 8;
+constexpr size_t ISOTP_MAX_RESPONSE_LEN = 4095;
 
 DidHandler::DidHandler(IDidLoader& loader, IDidLoader& cache_loader, CanEntryHandler* can_handler) :
     m_loader(loader), m_cache_loader(cache_loader), m_can_handler(can_handler), m_Semaphore(0)
@@ -17,8 +32,10 @@ DidHandler::~DidHandler()
 {
     m_PendingDidReads.clear();
     m_PendingDidWrites.clear();
-    m_IsoTpBufLen = 0xFFFF;
+    m_IsAborted = true;
     m_CanMessageCv.notify_all();
+    if(m_worker)
+        m_worker->request_stop();
     m_Semaphore.release();
     m_worker.reset(nullptr);
     m_can_handler->UnregisterObserver(this);
@@ -27,17 +44,55 @@ DidHandler::~DidHandler()
 void DidHandler::Init()
 {
     m_loader.Load(DID_LIST_FILENAME, m_DidList);
-    m_cache_loader.Load(DID_CACHE_FILENAME, m_DidList);
+    m_cache_loader.Load(DID_BINARY_CACHE_FILENAME, m_DidList);
     m_worker = std::make_unique<std::jthread>(std::bind_front(&DidHandler::WorkerThread, this));
     if(m_worker)
         utils::SetThreadName(*m_worker, "DidHandler");
     m_can_handler->RegisterObserver(this);
 }
 
-bool DidHandler::SaveChache() const
+bool DidHandler::SaveChache()
+{
+    std::filesystem::path cache_path = DID_BINARY_CACHE_FILENAME;
+
+    /* Only the changed values are copied under the lock, the journal is written without it, so CAN reception isn't blocked by file I/O */
+    DidMap unsaved;
+    {
+        std::unique_lock lock(m);
+        for(auto did : m_UnsavedDids)
+        {
+            auto did_it = m_DidList.find(did);
+            if(did_it == m_DidList.end() || unsaved.contains(did))
+                continue;
+
+            const DidEntry& entry = *did_it->second;
+            auto copy = std::make_unique<DidEntry>(entry.id, entry.type, entry.name, entry.min, entry.max, entry.len);
+            copy->value_str = entry.value_str;
+            copy->nrc = entry.nrc;
+            copy->last_update = entry.last_update;
+            unsaved.emplace(did, std::move(copy));
+        }
+        m_UnsavedDids.clear();
+    }
+
+    if(unsaved.empty())
+        return true;
+
+    bool ret = m_cache_loader.Save(cache_path, unsaved);
+    if(!ret)
+    {
+        std::unique_lock lock(m);
+        for(auto& [did, entry] : unsaved)
+            m_UnsavedDids.push_back(did);
+    }
+    return ret;
+}
+
+bool DidHandler::ExportCacheToXml(const std::filesystem::path& path)
 {
-    std::filesystem::path cache_path = DID_CACHE_FILENAME;
-    bool ret = m_cache_loader.Save(cache_path, m_DidList);
+    XmlDidCacheLoader xml_loader;
+    std::unique_lock lock(m);
+    bool ret = xml_loader.Save(path, m_DidList);
     return ret;
 }
 
@@ -51,6 +106,30 @@ void DidHandler::WriteDid(uint16_t did, uint8_t* data_to_write, uint16_t size)
     m_PendingDidWrites[did] = std::string(data_to_write, data_to_write + size);
 }
 
+void DidHandler::SchedulePeriodicDids(const std::vector<uint16_t>& dids, UdsPeriodicRate rate)
+{
+    std::vector<uint16_t> periodic_dids;
+    for(auto did : dids)
+    {
+        if(did >= PERIODIC_DID_FIRST && did <= PERIODIC_DID_LAST)
+            periodic_dids.push_back(did);
+        else
+            LOG(LogLevel::Warning, "DID {:X} can't be read periodically, only {:X}-{:X} are allowed", did, PERIODIC_DID_FIRST, PERIODIC_DID_LAST);
+    }
+
+    if(periodic_dids.empty())
+        return;
+
+    std::unique_lock lock(m);
+    m_PendingPeriodicRequests.emplace_back(rate, std::move(periodic_dids));
+}
+
+void DidHandler::StopPeriodicDids()
+{
+    std::unique_lock lock(m);
+    m_PendingPeriodicRequests.emplace_back(UDS_PERIODIC_STOP, std::vector<uint16_t>{});  /* Without any DID, it stops all of them */
+}
+
 void DidHandler::NotifyDidUpdate()
 {
     m_Semaphore.release();
@@ -62,27 +141,56 @@ void DidHandler::AbortDidUpdate()
         std::unique_lock lock{ m };
         m_PendingDidReads.clear();
         m_PendingDidWrites.clear();
+        m_PendingPeriodicRequests.clear();
     }
 
     m_IsAborted = true;
-    m_IsoTpBufLen = 0xFFFF;
+    m_CanMessageCv.notify_all();
 
     LOG(LogLevel::Normal, "In progress DID updating has been aborted");
 }
 
 void DidHandler::OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size)
 {
+    if(m_PeriodicResponseId != 0 && frame_id == m_PeriodicResponseId && size >= 2)
+    {
+        ProcessPeriodicResponse(data, size);
+        return;
+    }
 
+    if(frame_id == m_can_handler->GetIsoTpResponseFrameId())  /* ECU has started answering, P2 doesn't apply for the rest of a multi-frame response */
+    {
+        {
+            std::scoped_lock lock(m_CanMessageMutex);
+            m_ResponseFrameCnt++;
+        }
+        m_CanMessageCv.notify_all();
+    }
 }
 
 void DidHandler::OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size)
 {
-    memcpy(m_IsoTpBuffer, data, size);
-    m_IsoTpBufLen = static_cast<uint16_t>(size);
+    if(frame_id != m_can_handler->GetIsoTpResponseFrameId())  /* Response on an other ISO-TP channel */
+        return;
+
+    m_SessionManager.OnResponseReceived(m_can_handler->GetDefaultEcuId(), data, size);
+
+    if(size >= 2 && data[0] == 0x6A)  /* Periodic DID sent over ISO-TP, it isn't a response for the pending request */
+    {
+        ProcessPeriodicResponse(data + 1, size - 1);
+        return;
+    }
+
+    {
+        std::scoped_lock lock(m_CanMessageMutex);
+        memcpy(m_IsoTpBuffer, data, size);
+        m_IsoTpBufLen = static_cast<uint16_t>(size);
+        m_ResponseCnt++;
+    }
     m_CanMessageCv.notify_all();
 
     std::string hex;
-    utils::ConvertHexBufferToString((const char*)m_IsoTpBuffer, m_IsoTpBufLen.load(), hex);
+    utils::ConvertHexBufferToString((const char*)data, size, hex);
     LOG(LogLevel::Debug, "OnIsoTpFrameReceived: {} | \"{}\"", size, hex);
 }
 
@@ -169,8 +277,10 @@ bool XmlDidLoader::Save(const std::filesystem::path& path, const DidMap& m) cons
     for(auto& i : m)
     {
         auto& frame_node = root_node.add_child("DidEntry", boost::property_tree::ptree{});
-        frame_node.add("ID", std::format("{:X}", i.second->id));
+        frame_node.add("DID", std::format("{:X}", i.second->id));
+        frame_node.add("Type", std::string(GetStringFromType(i.second->type)));
         frame_node.add("Name", i.second->name);
+        frame_node.add("Length", i.second->len);
         frame_node.add("Min", i.second->min);
         frame_node.add("Max", i.second->max);
     }
@@ -284,6 +394,283 @@ bool XmlDidCacheLoader::Save(const std::filesystem::path& path, const DidMap& m)
     return ret;
 }
 
+BinaryDidCacheLoader::~BinaryDidCacheLoader()
+{
+    m_Compactor.reset(nullptr);
+}
+
+static int64_t DidCacheTimestampFromPtime(const boost::posix_time::ptime& time)
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    return (time - epoch).total_microseconds();
+}
+
+static boost::posix_time::ptime DidCacheTimestampToPtime(int64_t timestamp)
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    return epoch + boost::posix_time::microseconds(timestamp);
+}
+
+bool BinaryDidCacheLoader::ParseRecord(const uint8_t* data, size_t size, size_t& pos, DidCacheRecord& record)
+{
+    if(pos + DID_CACHE_RECORD_OVERHEAD > size)
+        return false;
+
+    const uint8_t* p = data + pos;
+    uint16_t value_len = 0;
+    memcpy(&record.did, p, sizeof(uint16_t));
+    memcpy(&record.nrc, p + 2, sizeof(uint16_t));
+    memcpy(&record.timestamp, p + 4, sizeof(int64_t));
+    memcpy(&value_len, p + 12, sizeof(uint16_t));
+
+    size_t record_size = DID_CACHE_RECORD_OVERHEAD + value_len;
+    if(pos + record_size > size)
+        return false;
+
+    uint16_t crc = 0;
+    memcpy(&crc, p + record_size - sizeof(uint16_t), sizeof(uint16_t));
+    if(crc != utils::crc16_modbus((void*)p, record_size - sizeof(uint16_t)))  /* Torn write at the end of journal */
+        return false;
+
+    record.value = std::string_view(reinterpret_cast<const char*>(p + 14), value_len);
+    record.raw = std::string_view(reinterpret_cast<const char*>(p), record_size);
+    pos += record_size;
+    return true;
+}
+
+void BinaryDidCacheLoader::AppendRecord(std::string& out, uint16_t did, uint16_t nrc, const boost::posix_time::ptime& timestamp, const std::string& value)
+{
+    uint8_t header[14];
+    int64_t time = DidCacheTimestampFromPtime(timestamp);
+    uint16_t value_len = static_cast<uint16_t>(std::min<size_t>(value.length(), std::numeric_limits<uint16_t>::max()));
+    memcpy(header, &did, sizeof(uint16_t));
+    memcpy(header + 2, &nrc, sizeof(uint16_t));
+    memcpy(header + 4, &time, sizeof(int64_t));
+    memcpy(header + 12, &value_len, sizeof(uint16_t));
+
+    size_t start = out.length();
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+    out.append(value.data(), value_len);
+    uint16_t crc = utils::crc16_modbus(out.data() + start, out.length() - start);
+    out.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+}
+
+bool BinaryDidCacheLoader::Load(const std::filesystem::path& path, DidMap& m)
+{
+    if(!std::filesystem::exists(path))
+    {
+        std::filesystem::path xml_path = path;
+        xml_path.replace_extension(".xml");
+        if(std::filesystem::exists(xml_path))
+        {
+            LOG(LogLevel::Normal, "Migrating DID cache from {} to {}", xml_path.generic_string(), path.generic_string());
+            XmlDidCacheLoader xml_loader;
+            if(xml_loader.Load(xml_path, m))
+                return Save(path, m);
+        }
+
+        LOG(LogLevel::Normal, "DID cache is missing ({}), skip loading", path.generic_string());
+        return false;
+    }
+
+    std::scoped_lock lock(m_Mutex);
+    m_IsValid = false;
+    size_t valid_size = 0;
+    size_t file_size = 0;
+    try
+    {
+        boost::interprocess::file_mapping file(path.generic_string().c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+        const uint8_t* data = static_cast<const uint8_t*>(region.get_address());
+        file_size = region.get_size();
+        if(file_size < DID_CACHE_HEADER_SIZE || memcmp(data, DID_CACHE_MAGIC, sizeof(DID_CACHE_MAGIC)) != 0)
+        {
+            LOG(LogLevel::Error, "Invalid DID cache header: {}", path.generic_string());
+            return false;
+        }
+
+        m_RecordCnt = 0;
+        m_Persisted.clear();
+        size_t pos = DID_CACHE_HEADER_SIZE;
+        DidCacheRecord record;
+        while(ParseRecord(data, file_size, pos, record))
+        {
+            DidHistoryEntry entry{ DidCacheTimestampToPtime(record.timestamp), std::string(record.value), record.nrc };
+            auto did_it = m.find(record.did);
+            if(did_it != m.end())
+            {
+                did_it->second->value_str = entry.value;
+                did_it->second->nrc = entry.nrc;
+                did_it->second->last_update = entry.timestamp;
+                did_it->second->history.push_back(entry);
+            }
+            m_Persisted[record.did] = std::move(entry);
+            m_RecordCnt++;
+        }
+        valid_size = pos;
+    }
+    catch(const boost::interprocess::interprocess_exception& e)
+    {
+        LOG(LogLevel::Error, "Failed to map DID cache {}: {}", path.generic_string(), e.what());
+        return false;
+    }
+
+    if(valid_size != file_size)
+    {
+        /* Drop the torn tail, otherwise records appended later would be unreachable */
+        LOG(LogLevel::Warning, "DID cache {} is corrupted from offset {}, truncating it", path.generic_string(), valid_size);
+        std::error_code ec;
+        std::filesystem::resize_file(path, valid_size, ec);
+    }
+
+    m_IsValid = true;
+    LOG(LogLevel::Verbose, "DID cache loaded, {} records, {} DIDs", m_RecordCnt, m_Persisted.size());
+    return true;
+}
+
+bool BinaryDidCacheLoader::Save(const std::filesystem::path& path, const DidMap& m) const
+{
+    std::scoped_lock lock(m_Mutex);
+    /* Records appended to a file without a valid header could never be loaded, so it's rewritten with every DID */
+    std::error_code ec;
+    uintmax_t good_size = std::filesystem::file_size(path, ec);
+    bool is_rewrite = !m_IsValid || ec || good_size < DID_CACHE_HEADER_SIZE;
+    std::string journal;
+    if(is_rewrite)
+    {
+        journal.append(DID_CACHE_MAGIC, sizeof(DID_CACHE_MAGIC));
+        uint16_t header[2] = { DID_CACHE_VERSION, 0 };
+        journal.append(reinterpret_cast<const char*>(header), sizeof(header));
+        good_size = 0;
+    }
+
+    /* m_Persisted is updated only after the records are flushed, so failed ones are written again at the next save */
+    std::map<uint16_t, DidHistoryEntry> written;
+    for(auto& [did, entry] : m)
+    {
+        if(entry->last_update.is_not_a_date_time())
+            continue;
+
+        auto it = m_Persisted.find(did);
+        if(!is_rewrite && it != m_Persisted.end() && it->second.value == entry->value_str && it->second.nrc == entry->nrc)
+            continue;
+
+        AppendRecord(journal, did, entry->nrc, entry->last_update, entry->value_str);
+        written[did] = { entry->last_update, entry->value_str, entry->nrc };
+    }
+
+    if(journal.empty())
+        return true;
+
+    std::ofstream out(path, std::ofstream::binary | (is_rewrite ? std::ofstream::trunc : std::ofstream::app));
+    out.write(journal.data(), journal.size());
+    out.flush();
+    if(!out)
+    {
+        LOG(LogLevel::Error, "Failed to write DID cache: {}", path.generic_string());
+        out.close();
+        /* A torn record would hide every record appended after it from Load */
+        std::filesystem::resize_file(path, good_size, ec);
+        if(is_rewrite)
+            m_IsValid = false;
+        return false;
+    }
+    out.close();
+
+    if(is_rewrite)
+    {
+        m_Persisted.clear();
+        m_RecordCnt = 0;
+        m_IsValid = true;
+    }
+    m_RecordCnt += written.size();
+    for(auto& [did, entry] : written)
+        m_Persisted[did] = std::move(entry);
+
+    size_t records_to_keep = std::max(m_Persisted.size() * DID_HISTORY_SIZE, DID_CACHE_MIN_RECORDS_FOR_COMPACTION);
+    if(m_RecordCnt > records_to_keep * DID_CACHE_COMPACTION_RATIO && !m_IsCompacting)
+    {
+        m_IsCompacting = true;
+        m_Compactor = std::make_unique<std::jthread>(&BinaryDidCacheLoader::Compact, this, path);
+    }
+    return true;
+}
+
+void BinaryDidCacheLoader::Compact(std::filesystem::path path) const
+{
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+    try
+    {
+        size_t compacted_size = 0;
+        {
+            std::scoped_lock lock(m_Mutex);
+            compacted_size = std::filesystem::file_size(path);
+        }
+
+        /* Records appended meanwhile are copied over at the end under lock */
+        std::string out;
+        size_t parsed_cnt = 0;
+        size_t kept_cnt = 0;
+        {
+            boost::interprocess::file_mapping file(path.generic_string().c_str(), boost::interprocess::read_only);
+            boost::interprocess::mapped_region region(file, boost::interprocess::read_only, 0, compacted_size);
+            const uint8_t* data = static_cast<const uint8_t*>(region.get_address());
+
+            std::map<uint16_t, std::deque<std::string_view>> records;
+            size_t pos = DID_CACHE_HEADER_SIZE;
+            DidCacheRecord record;
+            while(ParseRecord(data, compacted_size, pos, record))
+            {
+                auto& did_records = records[record.did];
+                did_records.push_back(record.raw);
+                if(did_records.size() > DID_HISTORY_SIZE)
+                    did_records.pop_front();
+                parsed_cnt++;
+            }
+
+            out.append(reinterpret_cast<const char*>(data), DID_CACHE_HEADER_SIZE);
+            for(auto& [did, did_records] : records)
+            {
+                for(auto& raw : did_records)
+                    out.append(raw);
+                kept_cnt += did_records.size();
+            }
+        }
+
+        std::ofstream tmp(tmp_path, std::ofstream::binary | std::ofstream::trunc);
+        tmp.write(out.data(), out.size());
+
+        std::scoped_lock lock(m_Mutex);
+        size_t current_size = std::filesystem::file_size(path);
+        if(current_size > compacted_size)
+        {
+            std::string tail(current_size - compacted_size, '\0');
+            std::ifstream in(path, std::ifstream::binary);
+            in.seekg(compacted_size);
+            in.read(tail.data(), tail.size());
+            tmp.write(tail.data(), tail.size());
+        }
+        tmp.close();
+        if(!tmp)
+            throw std::runtime_error("failed to write " + tmp_path.generic_string());
+
+        std::filesystem::rename(tmp_path, path);
+        m_RecordCnt = m_RecordCnt - parsed_cnt + kept_cnt;
+
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+        LOG(LogLevel::Verbose, "DID cache compacted in {:.3f} ms, records: {} -> {}", std::chrono::duration<double, std::milli>(t2 - t1).count(), parsed_cnt, kept_cnt);
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "DID cache compaction failed: {}", e.what());
+        std::error_code ec;
+        std::filesystem::remove(tmp_path, ec);
+    }
+    m_IsCompacting = false;
+}
+
 DidEntryType XmlDidLoader::GetTypeFromString(const std::string_view& input)
 {
     auto ret = std::find_if(m_DidEntryTypeMap.cbegin(), m_DidEntryTypeMap.cend(), [&input](const auto& item) { return item.second == input; });
@@ -300,88 +687,205 @@ const std::string_view XmlDidLoader::GetStringFromType(DidEntryType type)
     return m_DidEntryTypeMap[DidEntryType::DET_INVALID];
 }
 
-bool DidHandler::SendUdsFrameAndWaitForResponse(std::vector<uint8_t> frame)
+bool DidHandler::SendUdsRequest(const std::vector<uint8_t>& request, std::stop_token& token)
 {
-    if(!m_can_handler)
+    if(!m_can_handler || request.empty())
         return false;
 
-    m_IsoTpBufLen = 0;
-    m_can_handler->SendIsoTpFrame(m_can_handler->GetDefaultEcuId(), frame.data(), frame.size());
-    LOG(LogLevel::Verbose, "DidHandler::SendUdsFrameAndWaitForResponse");
+    const uint32_t ecu_id = m_can_handler->GetDefaultEcuId();
+    const UdsTiming timing = m_SessionManager.GetTiming(ecu_id);
+    const uint8_t sid = request[0];
 
-    bool ret = WaitForResponse();
-    return ret;
+    uint32_t response_cnt = 0;
+    uint32_t response_frame_cnt = 0;
+    {
+        std::scoped_lock lock(m_CanMessageMutex);
+        response_cnt = m_ResponseCnt;
+        response_frame_cnt = m_ResponseFrameCnt;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    m_can_handler->SendIsoTpFrame(ecu_id, const_cast<uint8_t*>(request.data()), static_cast<uint16_t>(request.size()));
+    m_SessionManager.OnRequestSent(ecu_id);
+
+    std::chrono::milliseconds timeout = timing.p2 + UDS_P2_CLIENT_MARGIN;
+    while(!token.stop_requested() && !m_IsAborted)
+    {
+        {
+            std::unique_lock lock(m_CanMessageMutex);
+            bool is_received = m_CanMessageCv.wait_for(lock, token, timeout,
+                [this, response_cnt, response_frame_cnt]() { return m_ResponseCnt != response_cnt || m_ResponseFrameCnt != response_frame_cnt || m_IsAborted; });
+            if(token.stop_requested() || m_IsAborted)
+                return false;
+
+            if(!is_received)
+            {
+                LOG(LogLevel::Warning, "No response from ECU {:X} for service {:X} within {} ms", ecu_id, sid, timeout.count());
+                m_SessionManager.OnResponseTimeout(ecu_id);
+                return false;
+            }
+
+            if(m_ResponseCnt == response_cnt)  /* Multi-frame response is in progress */
+            {
+                response_frame_cnt = m_ResponseFrameCnt;
+                timeout = std::max(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(ISOTP_N_CR_TIMEOUT));
+                continue;
+            }
+
+            response_cnt = m_ResponseCnt;
+            response_frame_cnt = m_ResponseFrameCnt;
+            m_Response.assign(m_IsoTpBuffer, m_IsoTpBuffer + m_IsoTpBufLen);
+        }
+
+        if(m_Response.size() >= 3 && m_Response[0] == 0x7F && m_Response[1] == sid && m_Response[2] == 0x78)  /* Response pending */
+        {
+            LOG(LogLevel::Verbose, "Response pending for service {:X}, waiting {} ms", sid, timing.p2_star.count());
+            m_SessionManager.OnResponsePending(ecu_id);
+            timeout = timing.p2_star + UDS_P2_CLIENT_MARGIN;
+            continue;
+        }
+
+        m_SessionManager.OnResponseTime(ecu_id, std::chrono::steady_clock::now() - start);
+        return true;
+    }
+    return false;
 }
 
-bool DidHandler::WaitForResponse()
+size_t DidHandler::GetDidDataLength(const DidEntry& entry)
 {
-    std::unique_lock lk(m_CanMessageMutex);
-    auto now = std::chrono::system_clock::now();
-    bool ret = m_CanMessageCv.wait_until(lk, now + UDS_TIMEOUT_FOR_RESPONSE, [this]() {return m_IsoTpBufLen != 0; });
-    if(ret)
+    switch(entry.type)
     {
-        if(m_IsoTpBufLen == 0xFFFF)
-            return false;
+        case DET_UI8:
+            return sizeof(uint8_t);
+        case DET_UI16:
+            return sizeof(uint16_t);
+        case DET_UI32:
+            return sizeof(uint32_t);
+        case DET_UI64:
+            return sizeof(uint64_t);
+        case DET_STRING:
+        case DET_BYTEARRAY:
+            return entry.len;
+        default:
+            break;
+    }
+    return 0;
+}
+
+std::vector<uint16_t> DidHandler::CollectDidBatch(size_t limit)
+{
+    std::vector<uint16_t> batch;
+    size_t response_len = 1;  /* SID */
+
+    std::unique_lock lock(m);
+    for(auto it = m_PendingDidReads.begin(); it != m_PendingDidReads.end() && batch.size() < limit;)
+    {
+        auto did_it = m_DidList.find(*it);
+        if(did_it == m_DidList.end())
+        {
+            LOG(LogLevel::Warning, "DID {:X} isn't found on DID list, removing it from read queue", *it);
+            it = m_PendingDidReads.erase(it);
+            continue;
+        }
+
+        if(std::find(batch.begin(), batch.end(), *it) != batch.end())
+            break;
+
+        /* Response can be split only if the length of each DID is known, unknown ones are read alone */
+        size_t data_len = GetDidDataLength(*did_it->second);
+        if(data_len == 0)
+        {
+            if(batch.empty())
+                batch.push_back(*it);
+            break;
+        }
 
-        std::string hex;
-        utils::ConvertHexBufferToString((const char*)m_IsoTpBuffer, m_IsoTpBufLen.load(), hex);
-        LOG(LogLevel::Verbose, "DidHandler::Finished waiting. Response len: {} | \"{}\"", m_IsoTpBufLen.load(), hex);
+        if(response_len + 2 + data_len > ISOTP_MAX_RESPONSE_LEN)
+            break;
+
+        response_len += 2 + data_len;
+        batch.push_back(*it);
+        ++it;
     }
-    else
+    return batch;
+}
+
+void DidHandler::RemoveFromReadQueue(const std::vector<uint16_t>& dids)
+{
+    std::unique_lock lock(m);
+    for(auto did : dids)
     {
-        LOG(LogLevel::Verbose, "DidHandler::Timeout");
+        auto it = std::find(m_PendingDidReads.begin(), m_PendingDidReads.end(), did);
+        if(it != m_PendingDidReads.end())
+            m_PendingDidReads.erase(it);
     }
+}
+
+bool DidHandler::OpenExtendedSession(std::stop_token& token)
+{
+    const uint32_t ecu_id = m_can_handler->GetDefaultEcuId();
+    if(m_SessionManager.IsSessionActive(ecu_id, UDS_SESSION_EXTENDED))
+        return true;
+
+    bool ret = SendUdsRequest({ 0x10, UDS_SESSION_EXTENDED }, token);
+    if(ret)
+        ret = m_Response[0] == 0x50;
+    if(!ret)
+        LOG(LogLevel::Warning, "Failed to open extended session on ECU {:X}", ecu_id);
     return ret;
 }
 
-void DidHandler::ProcessReadDidResponse(std::unique_ptr<DidEntry>& entry)
+void DidHandler::SendTesterPresent(uint32_t ecu_id)
+{
+    uint8_t data[2] = { 0x3E, 0x80 };  /* Suppress positive response */
+    m_can_handler->SendIsoTpFrame(ecu_id, data, sizeof(data));
+    m_SessionManager.OnRequestSent(ecu_id);
+    LOG(LogLevel::Debug, "TesterPresent sent to ECU {:X}", ecu_id);
+}
+
+void DidHandler::ProcessReadDidResponse(std::unique_ptr<DidEntry>& entry, const uint8_t* data, size_t len)
 {
     std::unique_lock lock(m);
     entry->nrc = 0x0;
-    entry->last_update = boost::posix_time::second_clock::local_time();
+    entry->last_update = boost::posix_time::microsec_clock::local_time();
 
     switch(entry->type)
     {
         case DET_UI8:
         {
-            uint8_t val = m_IsoTpBuffer[3];
+            uint8_t val = data[0];
             entry->value_str = std::format("{:X}", val);
             break;
         }
         case DET_UI16:
         {
-            uint16_t val = m_IsoTpBuffer[3] || m_IsoTpBuffer[4] << 8;
+            uint16_t val = data[0] | data[1] << 8;
             entry->value_str = std::format("{:X}", val);
             break;
         }
         case DET_UI32:
         {
-            uint32_t val = m_IsoTpBuffer[3] || m_IsoTpBuffer[4] << 8 || m_IsoTpBuffer[5] << 16 || m_IsoTpBuffer[6] << 24;
+            uint32_t val = data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
             entry->value_str = std::format("{:X}", val);
             break;
         }
         case DET_UI64:
         {
-            /*
-            uint64_t val = m_IsoTpBuffer[3] || m_IsoTpBuffer[4] << 8 || m_IsoTpBuffer[5] << 16 || m_IsoTpBuffer[6] << 24 || m_IsoTpBuffer[7] << 32 || m_IsoTpBuffer[8] << 40 || m_IsoTpBuffer[9] << 48 || m_IsoTpBuffer[10] << 56;
+            uint64_t val = 0;
+            for(size_t i = 0; i != sizeof(uint64_t); ++i)
+                val |= static_cast<uint64_t>(data[i]) << (i * 8);
             entry->value_str = std::format("{:X}", val);
-            */
             break;
         }
         case DET_STRING:
         {
-            std::string hex;
-            std::string response = std::string(m_IsoTpBuffer + 3, m_IsoTpBuffer + (m_IsoTpBufLen - 3));
-
-            entry->value_str = response;
+            entry->value_str = std::string(data, data + len);
             break;
         }
         case DET_BYTEARRAY:
         {
             std::string hex;
-            std::string response = std::string(m_IsoTpBuffer + 3, m_IsoTpBuffer + (m_IsoTpBufLen - 3));
-            utils::ConvertHexBufferToString(response.data(), response.length(), hex);
-
+            utils::ConvertHexBufferToString((const char*)data, len, hex);
             entry->value_str = hex;
             break;
         }
@@ -391,147 +895,189 @@ void DidHandler::ProcessReadDidResponse(std::unique_ptr<DidEntry>& entry)
         }
     }
 
-    m_PendingDidReads.pop_front();
+    entry->UpdateHistory();
     m_UpdatedDids.push_back(entry->id);
+    m_UnsavedDids.push_back(entry->id);
 
     LOG(LogLevel::Verbose, "Received response for DID: {:X} | \"{}\"", entry->id, entry->value_str);
 }
 
-void DidHandler::ProcessRejectedNrc(std::unique_ptr<DidEntry>& entry)
+size_t DidHandler::ProcessMultiDidResponse(const std::vector<uint16_t>& batch, std::vector<uint16_t>& unparsed)
 {
-    LOG(LogLevel::Warning, "Rejected");
+    const size_t len = m_Response.size();
+    std::vector<bool> is_received(batch.size());
+    size_t received_cnt = 0;
+    size_t pos = 1;  /* Skip SID */
+    while(pos + 2 <= len)
+    {
+        uint16_t did = m_Response[pos] << 8 | m_Response[pos + 1];
+        auto batch_it = std::find(batch.begin(), batch.end(), did);
+        if(batch_it == batch.end())
+        {
+            LOG(LogLevel::Warning, "Unexpected DID {:X} in response at offset {}, dropping the rest", did, pos);
+            break;
+        }
+
+        auto& entry = m_DidList[did];
+        size_t data_len = GetDidDataLength(*entry);
+        if(data_len == 0)  /* Only requested alone, the rest of the response belongs to this DID */
+            data_len = len - pos - 2;
+
+        if(pos + 2 + data_len > len)
+        {
+            LOG(LogLevel::Warning, "Truncated response for DID {:X}, expected {} bytes, got {}", did, data_len, len - pos - 2);
+            break;
+        }
+
+        ProcessReadDidResponse(entry, &m_Response[pos + 2], data_len);
+        is_received[std::distance(batch.begin(), batch_it)] = true;
+        received_cnt++;
+        pos += 2 + data_len;
+    }
+
+    for(size_t i = 0; i != batch.size(); ++i)
+    {
+        if(is_received[i])
+            continue;
+
+        if(pos == len)  /* ECU omits the unsupported DIDs from a multi-DID response */
+            ProcessRejectedNrc(m_DidList[batch[i]], 0x31);
+        else
+            unparsed.push_back(batch[i]);
+    }
+    return received_cnt;
+}
+
+void DidHandler::ProcessRejectedNrc(std::unique_ptr<DidEntry>& entry, uint8_t nrc)
+{
+    LOG(LogLevel::Warning, "DID {:X} rejected with NRC {:X}", entry->id, nrc);
     std::unique_lock lock(m);
-    entry->nrc = 0x10;
-    entry->last_update = boost::posix_time::second_clock::local_time();
-    m_PendingDidReads.pop_front();
+    entry->nrc = nrc;
+    entry->last_update = boost::posix_time::microsec_clock::local_time();
+    entry->UpdateHistory();
+    m_UpdatedDids.push_back(entry->id);
+    m_UnsavedDids.push_back(entry->id);
 }
 
 void DidHandler::HandleDidReading(std::stop_token& token)
 {
-    uint8_t extended_session_retry_count = 0;
-    while(m_PendingDidReads.size() > 0 && !token.stop_requested() && !m_IsAborted)
+    uint8_t retry_count = 0;
+    const uint32_t ecu_id = m_can_handler->GetDefaultEcuId();
+    DidBatchLimit& limit = m_MaxDidsPerRequest.try_emplace(ecu_id, DidBatchLimit{ DEFAULT_MAX_DIDS_PER_REQUEST }).first->second;
+    size_t& max_dids = limit.max_dids;
+    size_t batch_limit = max_dids;
+    size_t bisect_left = 0;  /* DIDs left from a batch rejected with NRC 0x31, which are requested again in smaller batches */
+    size_t single_left = 0;  /* DIDs left from a batch with unexpected response, which are requested again one by one */
+    bool is_session_reopened = false;
+    while(!token.stop_requested() && !m_IsAborted)
     {
         {
-            m.lock();
-            uint16_t curr_did = m_PendingDidReads.front();
-            m.unlock();
+            std::unique_lock lock(m);
+            if(m_PendingDidReads.empty())
+                break;
+        }
 
-            auto& did_it = m_DidList[curr_did];
+        std::vector<uint16_t> batch = CollectDidBatch(batch_limit);
+        if(batch.empty())
+            continue;
 
-            //m_PendingDids.pop_front();
+        bool is_ok = OpenExtendedSession(token);
+        if(is_ok)
+        {
+            std::vector<uint8_t> request = { 0x22 };
+            for(auto did : batch)
+            {
+                request.push_back(did >> 8 & 0xFF);
+                request.push_back(did & 0xFF);
+            }
+            is_ok = SendUdsRequest(request, token);
+        }
 
-            bool is_ok = SendUdsFrameAndWaitForResponse({ 0x10, 0x03 });
-            if(is_ok)
+        if(!is_ok)
+        {
+            if(++retry_count > MAX_EXTENDED_SESSION_RETRIES)
             {
-                extended_session_retry_count = 0;
-                m_IsoTpBufLen = 0;
-                uint8_t data[3] = { 0x22 };
-                data[1] = did_it->id >> 8 & 0xFF;
-                data[2] = did_it->id & 0xFF;
-                is_ok = SendUdsFrameAndWaitForResponse(std::vector<uint8_t>(data, data + 3));
-                if(is_ok)
-                {
-                    {
-                        std::unique_lock lock{ m };
-                        m_CanMessageCv.wait_for(lock, token, 50ms, []() { return 0 == 1; });
-                    }
+                LOG(LogLevel::Error, "No response from ECU after {} retries, abort questioning.", MAX_EXTENDED_SESSION_RETRIES);
+                std::unique_lock lock(m);
+                m_PendingDidReads.clear();
+                break;
+            }
+            continue;
+        }
+        retry_count = 0;
 
-                    if(m_IsoTpBuffer[0] == 0x62)
-                    {
-                        ProcessReadDidResponse(did_it);
-                    }
-                    else if(m_IsoTpBuffer[0] == 0x7F)
-                    {
-                        LOG(LogLevel::Warning, "7F received for DID ({:X} {:X}): {:X}", m_IsoTpBuffer[1], m_IsoTpBuffer[2], did_it->id);
-                        if(m_IsoTpBuffer[1] == 0x22 && m_IsoTpBuffer[2] == 0x78)  /* Response pending */
-                        {
-                            while(!token.stop_requested() && !m_IsAborted)
-                            {
-                                m_IsoTpBufLen = 0;
-                                bool is_recv_ok = WaitForResponse();
-
-                                if(!is_recv_ok)
-                                {
-                                    LOG(LogLevel::Warning, "Pending response timeout");
-                                    break;
-                                }
-
-                                if(m_IsoTpBuffer[0] == 0x62)
-                                {
-                                    ProcessReadDidResponse(did_it);
-                                    break;
-                                }
-                                else if(m_IsoTpBuffer[1] == 0x22 && m_IsoTpBuffer[2] == 0x78)
-                                {
-                                    LOG(LogLevel::Warning, "Pending response NRC 78");
-                                    did_it->nrc = 0x78;
-                                }
-                                else if(m_IsoTpBuffer[2] == 0x10)
-                                {
-                                    ProcessRejectedNrc(did_it);
-                                    break;
-                                }
-                                else if(m_IsoTpBuffer[2] == 0x22 && (m_IsoTpBuffer[2] >= 0x11 && m_IsoTpBuffer[2] <= 0x93))
-                                {
-                                    LOG(LogLevel::Warning, "Pending response general NRC: {}", m_IsoTpBuffer[2]);
-                                    did_it->nrc = m_IsoTpBuffer[2];
-                                    did_it->last_update = boost::posix_time::second_clock::local_time();
-                                    break;
-                                }
-                                else
-                                {
-                                    LOG(LogLevel::Warning, "Pending response else case: {}", m_IsoTpBuffer[1]);
-                                }
-                                m_UpdatedDids.push_back(curr_did);
-                            }
-
-                            LOG(LogLevel::Warning, "Pending response base");
-                        }
-                        else
-                        {
-                            if(m_IsoTpBuffer[2] == 0x10)  /* Rejected */
-                            {
-                                ProcessRejectedNrc(did_it);
-                            }
-                            else if(m_IsoTpBuffer[2] == 0x22 && (m_IsoTpBuffer[2] >= 0x11 && m_IsoTpBuffer[2] <= 0x93))
-                            {
-                                LOG(LogLevel::Warning, "Pending response general NRC: {}", m_IsoTpBuffer[2]);
-                                did_it->nrc = m_IsoTpBuffer[2];
-                                did_it->last_update = boost::posix_time::second_clock::local_time();
-                                break;
-                            }
-                            else
-                            {
-                                LOG(LogLevel::Warning, "Unimplemented NRC received, rejecting this DID");
-                                ProcessRejectedNrc(did_it);
-                                did_it->nrc = m_IsoTpBuffer[2];
-                            }
-                        }
-                        m_UpdatedDids.push_back(curr_did);
-                    }
-                    else if(m_IsoTpBuffer[0] == 0x50)
-                    {
-                        LOG(LogLevel::Verbose, "Ignoring extended session response");
-                    }
-                }
+        if(m_Response[0] == 0x62)
+        {
+            std::vector<uint16_t> unparsed;
+            size_t received_cnt = ProcessMultiDidResponse(batch, unparsed);
+            if(!unparsed.empty() && batch.size() > 1)
+            {
+                /* DIDs after the malformed part stay on the read queue and are requested one by one */
+                std::erase_if(batch, [&unparsed](uint16_t did) { return std::find(unparsed.begin(), unparsed.end(), did) != unparsed.end(); });
+                RemoveFromReadQueue(batch);
+                single_left = unparsed.size();
+                batch_limit = 1;
+                is_session_reopened = false;
+                continue;
             }
-            else
+
+            if(bisect_left == 0 && single_left == 0 && batch.size() == max_dids && received_cnt == batch.size() &&
+                max_dids < DEFAULT_MAX_DIDS_PER_REQUEST && ++limit.full_batches >= DID_BATCH_LIMIT_RECOVERY)
             {
-                if(++extended_session_retry_count > MAX_EXTENDED_SESSION_RETRIES)
-                {
-                    LOG(LogLevel::Error, "No response for extended session after {} retries, abort questioning.", MAX_EXTENDED_SESSION_RETRIES);
-                    extended_session_retry_count = 0;
-                    m_PendingDidReads.clear();
-                    break;
-                }
+                max_dids = std::min(max_dids * 2, DEFAULT_MAX_DIDS_PER_REQUEST);
+                limit.full_batches = 0;
+                LOG(LogLevel::Verbose, "Trying {} DIDs per request on ECU {:X} again", max_dids, ecu_id);
             }
         }
+        else if(m_Response[0] == 0x7F && m_Response.size() >= 3)
+        {
+            uint8_t nrc = m_Response[2];
+            if((nrc == 0x7F || nrc == 0x22) && !is_session_reopened)  /* ECU has dropped the session, reopen it and retry once */
+            {
+                m_SessionManager.Invalidate(ecu_id);
+                is_session_reopened = true;
+                continue;
+            }
+            else if(batch.size() > 1 && (nrc == 0x13 || nrc == 0x14))  /* Incorrect message length or response too long - too many DIDs */
+            {
+                max_dids = std::max<size_t>(batch.size() / 2, 1);
+                limit.full_batches = 0;
+                batch_limit = max_dids;
+                LOG(LogLevel::Notification, "ECU {:X} rejected {} DIDs per request, retrying with {}", ecu_id, batch.size(), max_dids);
+                continue;
+            }
+            else if(batch.size() > 1 && nrc == 0x31)  /* A DID isn't supported, bisect the batch, the learned limit is kept for the next batches */
+            {
+                if(bisect_left == 0)
+                    bisect_left = batch.size();
+                batch_limit = batch.size() / 2;
+                continue;
+            }
 
+            for(auto did : batch)
+                ProcessRejectedNrc(m_DidList[did], nrc);
+        }
+        else if(batch.size() > 1)
         {
-            std::unique_lock lock{ m };
-            m_CanMessageCv.wait_for(lock, token, MAIN_THREAD_SLEEP, []() { return 0 == 1; });
+            LOG(LogLevel::Warning, "Unexpected response for DID read: {:X}, requesting {} DIDs one by one", m_Response[0], batch.size());
+            single_left = batch.size();
+            batch_limit = 1;
+            continue;
         }
+        else
+        {
+            LOG(LogLevel::Warning, "Unexpected response for DID {:X} read: {:X}", batch[0], m_Response[0]);
+        }
+
+        RemoveFromReadQueue(batch);
+        is_session_reopened = false;
+        bisect_left -= std::min(bisect_left, batch.size());
+        single_left -= std::min(single_left, batch.size());
+        if(bisect_left == 0 && single_left == 0)
+            batch_limit = max_dids;
     }
+
+    LOG(LogLevel::Verbose, "DID reading finished, {}", m_SessionManager.GetStatsAsString(ecu_id));
 }
 
 void DidHandler::HandleDidWriting(std::stop_token& token)
@@ -540,79 +1086,34 @@ void DidHandler::HandleDidWriting(std::stop_token& token)
     {
         for(auto& [did, raw_value] : m_PendingDidWrites)
         {
-            bool is_ok = SendUdsFrameAndWaitForResponse({ 0x10, 0x03 });
+            if(token.stop_requested() || m_IsAborted)
+                break;
+
+            bool is_ok = OpenExtendedSession(token);
             if(is_ok)
             {
-                m_IsoTpBufLen = 0;
                 std::vector<uint8_t> data_to_write = {0x2E};
                 data_to_write.push_back(did >> 8 & 0xFF);
                 data_to_write.push_back(did & 0xFF);
                 std::copy(raw_value.begin(), raw_value.end(), std::back_inserter(data_to_write));
 
-                is_ok = SendUdsFrameAndWaitForResponse(data_to_write);
+                is_ok = SendUdsRequest(data_to_write, token);
                 if(is_ok)
                 {
-                    if(m_IsoTpBuffer[0] == 0x6E)
+                    if(m_Response[0] == 0x6E)
                     {
-                        LOG(LogLevel::Warning, "Did write OK");
+                        LOG(LogLevel::Normal, "Did write OK: {:X}", did);
                     }
-                    else if(m_IsoTpBuffer[0] == 0x7F)
+                    else if(m_Response[0] == 0x7F && m_Response.size() >= 3)
                     {
-                        LOG(LogLevel::Warning, "7F received for write DID ({:X} {:X}): {:X}", m_IsoTpBuffer[1], m_IsoTpBuffer[2], did);
-                        if(m_IsoTpBuffer[1] == 0x2E && m_IsoTpBuffer[2] == 0x78)  /* Response pending */
-                        {
-                            while(!token.stop_requested() && !m_IsAborted)
-                            {
-                                m_IsoTpBufLen = 0;
-                                bool is_recv_ok = WaitForResponse();
-
-                                if(!is_recv_ok)
-                                {
-                                    LOG(LogLevel::Warning, "Pending response timeout");
-                                    break;
-                                }
-
-                                if(m_IsoTpBuffer[0] == 0x6E)
-                                {
-                                    LOG(LogLevel::Warning, "Did write OK");
-                                    break;
-                                }
-                                else if(m_IsoTpBuffer[1] == 0x2E && m_IsoTpBuffer[2] == 0x78)
-                                {
-                                    LOG(LogLevel::Warning, "Pending response NRC 78");
-                                }
-                                else if(m_IsoTpBuffer[2] == 0x10)
-                                {
-                                    LOG(LogLevel::Warning, "Did write rejected");
-                                    break;
-                                }
-                                else
-                                {
-                                    LOG(LogLevel::Warning, "Pending write response else case: {}", m_IsoTpBuffer[1]);
-                                }
-                            }
-
-                            LOG(LogLevel::Warning, "Pending response base");
-                        }
-                        else
-                        {
-                            if(m_IsoTpBuffer[2] == 0x10)  /* Rejected */
-                            {
-                                LOG(LogLevel::Warning, "Did write rejected");
-                            }
-                        }
+                        LOG(LogLevel::Warning, "Did write rejected ({:X}), NRC: {:X}", did, m_Response[2]);
                     }
-                    else if(m_IsoTpBuffer[0] == 0x50)
+                    else
                     {
-                        LOG(LogLevel::Verbose, "Ignoring extended session response");
+                        LOG(LogLevel::Warning, "Unexpected response for DID write ({:X}): {:X}", did, m_Response[0]);
                     }
                 }
             }
-
-            {
-                std::unique_lock lock{ m };
-                m_CanMessageCv.wait_for(lock, token, MAIN_THREAD_SLEEP, []() { return 0 == 1; });
-            }
         }
 
         {
@@ -623,12 +1124,112 @@ void DidHandler::HandleDidWriting(std::stop_token& token)
     m_IsAborted = false;
 }
 
+void DidHandler::ProcessPeriodicResponse(const uint8_t* data, size_t size)
+{
+    uint16_t did = PERIODIC_DID_FIRST | data[0];
+    auto did_it = m_DidList.find(did);
+    if(did_it == m_DidList.end())
+    {
+        LOG(LogLevel::Debug, "Periodic DID {:X} isn't found on DID list", did);
+        return;
+    }
+
+    size_t data_len = GetDidDataLength(*did_it->second);
+    if(data_len == 0 || data_len > size - 1)  /* CAN frames can be padded, use the known length if there is any */
+        data_len = size - 1;
+    ProcessReadDidResponse(did_it->second, data + 1, data_len);
+}
+
+void DidHandler::HandlePeriodicScheduling(std::stop_token& token)
+{
+    while(!token.stop_requested() && !m_IsAborted)
+    {
+        std::pair<UdsPeriodicRate, std::vector<uint16_t>> schedule;
+        {
+            std::unique_lock lock(m);
+            if(m_PendingPeriodicRequests.empty())
+                break;
+            schedule = std::move(m_PendingPeriodicRequests.front());
+            m_PendingPeriodicRequests.pop_front();
+        }
+
+        auto& [rate, dids] = schedule;
+        if(!OpenExtendedSession(token))
+            continue;
+
+        std::vector<uint8_t> request = { 0x2A, rate };
+        for(auto did : dids)
+            request.push_back(did & 0xFF);
+
+        if(!SendUdsRequest(request, token))
+            continue;
+
+        if(m_Response[0] == 0x6A)
+        {
+            std::unique_lock lock(m);
+            if(rate == UDS_PERIODIC_STOP && dids.empty())
+                m_PeriodicDids.clear();
+
+            for(auto did : dids)
+            {
+                if(rate == UDS_PERIODIC_STOP)
+                    m_PeriodicDids.erase(did);
+                else
+                    m_PeriodicDids[did] = rate;
+            }
+            LOG(LogLevel::Normal, "Periodic DID schedule updated, rate: {:X}, DIDs: {}, active periodic DIDs: {}", static_cast<uint8_t>(rate), dids.size(), m_PeriodicDids.size());
+        }
+        else if(m_Response[0] == 0x7F && m_Response.size() >= 3)
+        {
+            LOG(LogLevel::Warning, "Periodic DID schedule rejected, NRC: {:X}", m_Response[2]);
+        }
+    }
+}
+
+void DidHandler::ReschedulePeriodicDids()
+{
+    std::map<UdsPeriodicRate, std::vector<uint16_t>> dids_by_rate;
+    std::unique_lock lock(m);
+    for(auto& [did, rate] : m_PeriodicDids)
+        dids_by_rate[rate].push_back(did);
+
+    for(auto& [rate, dids] : dids_by_rate)
+        m_PendingPeriodicRequests.emplace_back(rate, std::move(dids));
+}
+
 void DidHandler::WorkerThread(std::stop_token token)
 {
     while(!token.stop_requested())
     {
-        m_Semaphore.acquire();
+        const uint32_t ecu_id = m_can_handler->GetDefaultEcuId();
+        if(!m_Semaphore.try_acquire_for(m_SessionManager.GetTimeUntilTesterPresent(ecu_id)))
+        {
+            bool is_periodic_active = false;
+            {
+                std::unique_lock lock(m);
+                is_periodic_active = !m_PeriodicDids.empty();
+            }
+
+            if(is_periodic_active)
+                SaveChache();
+
+            if(is_periodic_active && !m_SessionManager.IsSessionActive(ecu_id, UDS_SESSION_EXTENDED))
+            {
+                /* ECU stops periodic transmission when it leaves the session */
+                LOG(LogLevel::Normal, "Session has been lost, scheduling periodic DIDs again");
+                ReschedulePeriodicDids();
+                HandlePeriodicScheduling(token);
+            }
+            else if(m_SessionManager.IsTesterPresentDue(ecu_id))  /* Idle, keep the non-default session alive */
+            {
+                SendTesterPresent(ecu_id);
+            }
+            continue;
+        }
+
         HandleDidReading(token);
         HandleDidWriting(token);
+        HandlePeriodicScheduling(token);
+        SaveChache();  /* Only changed values are appended */
     }
 }
\ No newline at end of file
@@ -2,11 +2,29 @@
 
 #include "IDidLoader.hpp"
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/circular_buffer.hpp>
 #include <semaphore>
 
 #include "ICanObserver.hpp"
+#include "UdsSessionManager.hpp"
 
 constexpr const char* DID_CACHE_FILENAME = "DidCache.xml";
+constexpr const char* DID_BINARY_CACHE_FILENAME = "DidCache.bin";
+
+/* Number of value changes kept in memory and in the binary cache for each DID */
+constexpr size_t DID_HISTORY_SIZE = 256;
+
+/* Periodic DIDs (0x2A) are addressed by the low byte of DIDs from this range */
+constexpr uint16_t PERIODIC_DID_FIRST = 0xF200;
+constexpr uint16_t PERIODIC_DID_LAST = 0xF2FF;
+
+enum UdsPeriodicRate : uint8_t
+{
+    UDS_PERIODIC_SLOW = 0x01,
+    UDS_PERIODIC_MEDIUM = 0x02,
+    UDS_PERIODIC_FAST = 0x03,
+    UDS_PERIODIC_STOP = 0x04,
+};
 
 enum DidEntryType : uint8_t
 {
@@ -15,6 +33,14 @@ enum DidEntryType : uint8_t
 
 using DidValueType = std::variant<uint8_t, uint16_t, uint32_t, uint64_t, std::string, std::vector<uint8_t>>;
 
+class DidHistoryEntry
+{
+public:
+    boost::posix_time::ptime timestamp = boost::posix_time::not_a_date_time;
+    std::string value;
+    uint16_t nrc = 0;
+};
+
 class DidEntry
 {
 public:
@@ -35,6 +61,26 @@ public:
     uint16_t nrc = 0;
 
     boost::posix_time::ptime last_update = boost::posix_time::not_a_date_time;
+
+    // !\brief Previous values of the DID, a new entry is added when the value or the NRC changes
+    boost::circular_buffer<DidHistoryEntry> history{ DID_HISTORY_SIZE };
+
+    // !\brief Add current value to history if it differs from the last one
+    void UpdateHistory()
+    {
+        if(history.empty() || history.back().value != value_str || history.back().nrc != nrc)
+            history.push_back({ last_update, value_str, nrc });
+    }
+};
+
+class DidBatchLimit
+{
+public:
+    // !\brief Maximum number of DIDs in a single 0x22 request
+    size_t max_dids = 0;
+
+    // !\brief Number of fully answered batches since the limit has been changed
+    size_t full_batches = 0;
 };
 
 class XmlDidLoader : public IDidLoader
@@ -73,6 +119,58 @@ private:
 
 };
 
+class BinaryDidCacheLoader : public IDidLoader
+{
+public:
+    virtual ~BinaryDidCacheLoader();
+
+    // !\brief Load DID cache journal, migrate it from the XML cache next to it if it doesn't exist yet
+    bool Load(const std::filesystem::path& path, DidMap& m) override;
+
+    // !\brief Append DIDs whose value has been changed since the last save to the journal
+    // !\details The journal is rewritten with every DID if Load didn't accept it, a failed append is truncated and retried at the next save
+    bool Save(const std::filesystem::path& path, const DidMap& m) const override;
+
+private:
+    struct DidCacheRecord
+    {
+        uint16_t did;
+        uint16_t nrc;
+        int64_t timestamp;  /* Microseconds since 1970.01.01 */
+        std::string_view value;
+        std::string_view raw;  /* Whole record as stored in the journal */
+    };
+
+    // !\brief Parse the record from the given position and step over it
+    // !\return False at the end of journal or if the record is corrupted
+    static bool ParseRecord(const uint8_t* data, size_t size, size_t& pos, DidCacheRecord& record);
+
+    // !\brief Serialize a record to the end of out
+    static void AppendRecord(std::string& out, uint16_t did, uint16_t nrc, const boost::posix_time::ptime& timestamp, const std::string& value);
+
+    // !\brief Rewrite the journal keeping only the last DID_HISTORY_SIZE records of each DID, runs on background thread
+    // !\param path [in] Path to journal
+    void Compact(std::filesystem::path path) const;
+
+    // !\brief Mutex for journal file
+    mutable std::mutex m_Mutex;
+
+    // !\brief Last value of each DID written to the journal
+    mutable std::map<uint16_t, DidHistoryEntry> m_Persisted;
+
+    // !\brief Number of records in journal
+    mutable size_t m_RecordCnt = 0;
+
+    // !\brief Has the journal been accepted by Load or written by Save? Records are appended only then
+    mutable bool m_IsValid = false;
+
+    // !\brief Is compaction in progress?
+    mutable std::atomic<bool> m_IsCompacting = false;
+
+    // !\brief Background compaction thread
+    mutable std::unique_ptr<std::jthread> m_Compactor;
+};
+
 class DidHandler : public ICanObserver
 {
 public:
@@ -82,8 +180,12 @@ public:
     // !\brief Initialize DID handler
     void Init();
 
-    // !\brief Save DID cache
-    bool SaveChache() const;
+    // !\brief Save values of DIDs changed since the last save to DID cache
+    bool SaveChache();
+
+    // !\brief Export DID cache to XML format
+    // !\param path [in] Path to XML file
+    bool ExportCacheToXml(const std::filesystem::path& path);
 
     // !\brief Add DID to read queue which is being read by this handler
     // !\param did [in] DID to add
@@ -95,12 +197,30 @@ public:
     // !\param size [in] Size of data to write
     void WriteDid(uint16_t did, uint8_t* data_to_write, uint16_t size);
 
+    // !\brief Schedule periodic transmission of DIDs on the ECU (ReadDataByPeriodicIdentifier)
+    // !\param dids [in] DIDs to schedule, only DIDs between PERIODIC_DID_FIRST and PERIODIC_DID_LAST are accepted
+    // !\param rate [in] Transmission rate, UDS_PERIODIC_STOP stops the given DIDs
+    void SchedulePeriodicDids(const std::vector<uint16_t>& dids, UdsPeriodicRate rate);
+
+    // !\brief Stop periodic transmission of every DID
+    void StopPeriodicDids();
+
+    // !\brief Set CAN ID where the ECU sends periodic DID frames, 0 if they are sent as ISO-TP frames on the response ID
+    // !\param frame_id [in] Frame ID
+    void SetPeriodicResponseId(uint32_t frame_id) { m_PeriodicResponseId = frame_id; }
+
+    // !\brief Get CAN ID where the ECU sends periodic DID frames
+    uint32_t GetPeriodicResponseId() const { return m_PeriodicResponseId; }
+
     // !\brief Notify that a DID has been updated
     void NotifyDidUpdate();
 
     // !\brief Abort DID reading
     void AbortDidUpdate();
 
+    // !\brief Get session manager
+    UdsSessionManager& GetSessionManager() { return m_SessionManager; }
+
     void OnFrameOnBus(uint32_t frame_id, uint8_t* data, uint16_t size) override;
     void OnIsoTpDataReceived(uint32_t frame_id, uint8_t* data, uint16_t size) override;
      
@@ -114,19 +234,50 @@ public:
     std::vector<uint16_t> m_UpdatedDids;
 
 private:
-    // !\brief Send a UDS frame and wait for a response
-    // !\param frame [in] Frame to send
-    bool SendUdsFrameAndWaitForResponse(std::vector<uint8_t> frame);
-
-    // !\brief Wait for a response from the ECU
-    bool WaitForResponse();
+    // !\brief Send a UDS request and wait for the final response, which is stored in m_Response
+    // !\param request [in] Request to send
+    // !\param token [in] Stop token of the worker thread
+    // !\return True if a final response has been received within P2 (or P2* after NRC 0x78)
+    bool SendUdsRequest(const std::vector<uint8_t>& request, std::stop_token& token);
+
+    // !\brief Open extended diagnostic session unless it's already active
+    // !\param token [in] Stop token of the worker thread
+    bool OpenExtendedSession(std::stop_token& token);
+
+    // !\brief Send TesterPresent with suppressed positive response
+    // !\param ecu_id [in] ECU's request ID
+    void SendTesterPresent(uint32_t ecu_id);
+
+    // !\brief Get the length of DID's data in a positive response
+    // !\param entry [in] DID entry
+    // !\return Length of the data, 0 if it's unknown
+    static size_t GetDidDataLength(const DidEntry& entry);
+
+    // !\brief Collect DIDs from the front of read queue which can be packed into a single 0x22 request
+    // !\param limit [in] Maximum number of DIDs in the request
+    // !\return DIDs to request
+    std::vector<uint16_t> CollectDidBatch(size_t limit);
+
+    // !\brief Remove DIDs from the read queue
+    // !\param dids [in] DIDs to remove
+    void RemoveFromReadQueue(const std::vector<uint16_t>& dids);
+
+    // !\brief Split a positive multi-DID response into DID entries
+    // !\param batch [in] Requested DIDs
+    // !\param unparsed [out] Requested DIDs missing after a malformed part of the response
+    // !\return Number of DIDs found in the response
+    size_t ProcessMultiDidResponse(const std::vector<uint16_t>& batch, std::vector<uint16_t>& unparsed);
 
     // !\brief Process a DID response
     // !\param entry [in] DID entry to process
-    void ProcessReadDidResponse(std::unique_ptr<DidEntry>& entry);
+    // !\param data [in] DID data from the response
+    // !\param len [in] Length of DID data
+    void ProcessReadDidResponse(std::unique_ptr<DidEntry>& entry, const uint8_t* data, size_t len);
 
     // !\brief Process a NRC response 
-    void ProcessRejectedNrc(std::unique_ptr<DidEntry>& entry);
+    // !\param entry [in] DID entry to process
+    // !\param nrc [in] Negative response code
+    void ProcessRejectedNrc(std::unique_ptr<DidEntry>& entry, uint8_t nrc);
 
     // !\brief Handle DID reading
     void HandleDidReading(std::stop_token& token);
@@ -134,6 +285,17 @@ private:
     // !\brief Handle DID writing
     void HandleDidWriting(std::stop_token& token);
 
+    // !\brief Handle pending periodic DID schedule requests
+    void HandlePeriodicScheduling(std::stop_token& token);
+
+    // !\brief Request every scheduled periodic DID again, eg. after the ECU has dropped the session
+    void ReschedulePeriodicDids();
+
+    // !\brief Process a periodic DID response
+    // !\param data [in] Periodic DID (low byte) followed by data
+    // !\param size [in] Size of data
+    void ProcessPeriodicResponse(const uint8_t* data, size_t size);
+
     // !\brief Worker thread
     void WorkerThread(std::stop_token token);
 
@@ -155,6 +317,24 @@ private:
     // !\brief DIDs whose values are being written
     std::map<uint16_t, std::string> m_PendingDidWrites;
 
+    // !\brief Periodic DID schedule requests waiting for being sent
+    std::deque<std::pair<UdsPeriodicRate, std::vector<uint16_t>>> m_PendingPeriodicRequests;
+
+    // !\brief DIDs currently scheduled on the ECU with their rate
+    std::map<uint16_t, UdsPeriodicRate> m_PeriodicDids;
+
+    // !\brief CAN ID of periodic DID frames, 0 = periodic data arrives as ISO-TP frames
+    std::atomic<uint32_t> m_PeriodicResponseId{};
+
+    // !\brief Tracks diagnostic sessions of ECUs
+    UdsSessionManager m_SessionManager;
+
+    // !\brief DIDs whose values have been changed since the last cache save, protected by m
+    std::vector<uint16_t> m_UnsavedDids;
+
+    // !\brief Maximum number of DIDs in a single 0x22 request, learned per ECU
+    std::map<uint32_t, DidBatchLimit> m_MaxDidsPerRequest;
+
     // !\brief Callback to call when a DID has been updated
     std::atomic<bool> m_IsAborted{ false };
 
@@ -162,7 +342,16 @@ private:
     uint8_t m_IsoTpBuffer[4096] = {};
 
     // !\brief Length of IsoTp buffer
-    std::atomic<uint16_t> m_IsoTpBufLen{};
+    uint16_t m_IsoTpBufLen{};
+
+    // !\brief Number of ISO-TP responses received, protected by m_CanMessageMutex
+    uint32_t m_ResponseCnt{};
+
+    // !\brief Number of CAN frames received on ISO-TP response ID, protected by m_CanMessageMutex
+    uint32_t m_ResponseFrameCnt{};
+
+    // !\brief Final response of the last request, used only by worker thread
+    std::vector<uint8_t> m_Response;
 
     // !\brief DID Loader
     IDidLoader& m_loader;
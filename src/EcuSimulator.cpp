@@ -0,0 +1,560 @@
+#include "pch.hpp"
+
+constexpr uint8_t ISOTP_PCI_SINGLE_FRAME = 0x0;
+constexpr uint8_t ISOTP_PCI_FIRST_FRAME = 0x1;
+constexpr uint8_t ISOTP_PCI_CONSECUTIVE_FRAME = 0x2;
+constexpr uint8_t ISOTP_PCI_FLOW_CONTROL = 0x3;
+
+constexpr uint8_t ISOTP_FLOW_STATUS_CTS = 0x0;
+constexpr uint8_t ISOTP_FLOW_STATUS_WAIT = 0x1;
+
+constexpr size_t ISOTP_FRAME_LEN = 8;
+constexpr auto ISOTP_N_BS_TIMEOUT = std::chrono::milliseconds(1000);  /* Waiting for flow control from the tester */
+
+constexpr uint8_t DIAG_SESSION_DEFAULT = 0x01;
+constexpr uint8_t DIAG_SESSION_EXTENDED = 0x03;
+
+constexpr uint8_t PERIODIC_RATE_SLOW = 0x01;
+constexpr uint8_t PERIODIC_RATE_FAST = 0x03;
+constexpr uint8_t PERIODIC_RATE_STOP = 0x04;
+constexpr uint16_t PERIODIC_DID_BASE = 0xF200;
+
+EcuSimulator::EcuSimulator(const EcuSimulatorConfig& config, EcuSimulatorSendFunction send_function) :
+    m_Config(config), m_SendFunction(send_function)
+{
+
+}
+
+void EcuSimulator::OnFrameReceived(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now)
+{
+    if(frame_id != m_Config.request_id || size == 0)
+        return;
+
+    m_Stats.rx_frames++;
+    uint8_t pci = data[0] >> 4;
+    switch(pci)
+    {
+        case ISOTP_PCI_SINGLE_FRAME:
+        {
+            uint8_t len = data[0] & 0xF;
+            if(len == 0 || len > size - 1)
+                break;
+
+            m_TxState = TX_IDLE;  /* New request aborts ongoing response */
+            HandleRequest(std::vector<uint8_t>(data + 1, data + 1 + len), now);
+            break;
+        }
+        case ISOTP_PCI_FIRST_FRAME:
+        {
+            if(size < ISOTP_FRAME_LEN)
+                break;
+
+            m_TxState = TX_IDLE;
+            m_RxExpectedLen = ((data[0] & 0xF) << 8) | data[1];
+            m_RxBuffer.assign(data + 2, data + size);
+            m_RxSequence = 1;
+            m_RxBlockCnt = 0;
+            SendFlowControl();
+            break;
+        }
+        case ISOTP_PCI_CONSECUTIVE_FRAME:
+        {
+            if(m_RxExpectedLen == 0)
+                break;
+
+            if((data[0] & 0xF) != m_RxSequence)  /* Drop the whole message */
+            {
+                m_RxExpectedLen = 0;
+                m_RxBuffer.clear();
+                break;
+            }
+            m_RxSequence = (m_RxSequence + 1) & 0xF;
+
+            size_t len = std::min<size_t>(size - 1, m_RxExpectedLen - m_RxBuffer.size());
+            m_RxBuffer.insert(m_RxBuffer.end(), data + 1, data + 1 + len);
+            if(m_RxBuffer.size() >= m_RxExpectedLen)
+            {
+                m_RxExpectedLen = 0;
+                HandleRequest(m_RxBuffer, now);
+                m_RxBuffer.clear();
+            }
+            else if(m_Config.block_size && ++m_RxBlockCnt >= m_Config.block_size)
+            {
+                m_RxBlockCnt = 0;
+                SendFlowControl();
+            }
+            break;
+        }
+        case ISOTP_PCI_FLOW_CONTROL:
+        {
+            if(m_TxState != TX_WAIT_FLOW_CONTROL || size < 3)
+                break;
+
+            uint8_t flow_status = data[0] & 0xF;
+            if(flow_status == ISOTP_FLOW_STATUS_CTS)
+            {
+                m_TxBlockSize = data[1];
+                m_TxStMin = StMinToDuration(data[2]);
+                m_TxBlockCnt = 0;
+                m_TxNextFrame = now;
+                m_TxState = TX_SENDING;
+                ContinueTransmit(now);
+            }
+            else if(flow_status == ISOTP_FLOW_STATUS_WAIT)
+            {
+                m_TxNextFrame = now + ISOTP_N_BS_TIMEOUT;
+            }
+            else  /* Overflow or invalid flow status */
+            {
+                m_TxState = TX_IDLE;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void EcuSimulator::Poll(std::chrono::steady_clock::time_point now)
+{
+    if(m_Session != DIAG_SESSION_DEFAULT && now - m_LastRequest >= m_Config.s3_timeout)
+    {
+        m_Session = DIAG_SESSION_DEFAULT;
+        m_PeriodicDids.clear();
+        m_IsDownloadActive = false;
+    }
+
+    if(m_TxState == TX_WAIT_FLOW_CONTROL && now >= m_TxNextFrame)  /* N_Bs timeout */
+        m_TxState = TX_IDLE;
+
+    if(m_TxState == TX_SENDING)
+        ContinueTransmit(now);
+
+    while(m_TxState == TX_IDLE && !m_Scheduled.empty() && m_Scheduled.front().time <= now)
+    {
+        StartTransmit(m_Scheduled.front().payload, now);
+        m_Scheduled.pop_front();
+    }
+
+    SendPeriodicData(now);  /* Periodic data via ISO-TP is queued and goes out on the next poll */
+}
+
+std::chrono::steady_clock::time_point EcuSimulator::GetNextEventTime() const
+{
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    if(m_TxState != TX_IDLE)
+        next = std::min(next, m_TxNextFrame);
+    if(!m_Scheduled.empty())
+        next = std::min(next, m_Scheduled.front().time);
+    if(m_Session != DIAG_SESSION_DEFAULT)
+        next = std::min(next, m_LastRequest + m_Config.s3_timeout);
+    for(auto& [pdid, rate] : m_PeriodicDids)
+        next = std::min(next, m_PeriodicNext[rate - 1]);
+    return next;
+}
+
+void EcuSimulator::HandleRequest(const std::vector<uint8_t>& request, std::chrono::steady_clock::time_point now)
+{
+    m_Stats.requests++;
+    m_Stats.rx_bytes += request.size();
+    m_LastRequest = now;
+
+    std::vector<uint8_t> response = ExecuteRequest(request);
+    if(response.empty())
+        return;
+
+    std::chrono::steady_clock::time_point time = now + m_Config.response_latency;
+    if(request[0] != 0x3E)
+    {
+        for(uint8_t i = 0; i != m_Config.pending_count; i++)
+        {
+            m_Scheduled.push_back({ time, NegativeResponse(request[0], UDS_NRC_RESPONSE_PENDING) });
+            time += m_Config.pending_interval;
+        }
+    }
+    m_Scheduled.push_back({ time, std::move(response) });
+}
+
+std::vector<uint8_t> EcuSimulator::ExecuteRequest(const std::vector<uint8_t>& request)
+{
+    if(request.empty())
+        return {};
+
+    switch(request[0])
+    {
+        case 0x10:
+            return HandleSessionControl(request);
+        case 0x22:
+            return HandleReadDataByIdentifier(request);
+        case 0x23:
+            return HandleReadMemoryByAddress(request);
+        case 0x2A:
+            return HandleReadDataByPeriodicIdentifier(request);
+        case 0x2E:
+            return HandleWriteDataByIdentifier(request);
+        case 0x34:
+            return HandleRequestDownload(request);
+        case 0x36:
+            return HandleTransferData(request);
+        case 0x37:
+            return HandleRequestTransferExit(request);
+        case 0x3E:
+            return HandleTesterPresent(request);
+        default:
+            return NegativeResponse(request[0], UDS_NRC_SERVICE_NOT_SUPPORTED);
+    }
+}
+
+std::vector<uint8_t> EcuSimulator::HandleSessionControl(const std::vector<uint8_t>& request)
+{
+    if(request.size() != 2)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    uint8_t session = request[1] & 0x7F;
+    if(session < DIAG_SESSION_DEFAULT || session > DIAG_SESSION_EXTENDED)
+        return NegativeResponse(request[0], UDS_NRC_SUBFUNCTION_NOT_SUPPORTED);
+
+    m_Session = session;
+    if(session == DIAG_SESSION_DEFAULT)
+    {
+        m_PeriodicDids.clear();
+        m_IsDownloadActive = false;
+    }
+
+    if(request[1] & 0x80)  /* suppressPosRspMsgIndicationBit */
+        return {};
+
+    uint16_t p2_star = m_Config.p2_star / 10;  /* Resolution is 10ms */
+    return { 0x50, session, static_cast<uint8_t>(m_Config.p2 >> 8), static_cast<uint8_t>(m_Config.p2 & 0xFF),
+        static_cast<uint8_t>(p2_star >> 8), static_cast<uint8_t>(p2_star & 0xFF) };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleTesterPresent(const std::vector<uint8_t>& request)
+{
+    if(request.size() != 2)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+    if((request[1] & 0x7F) != 0)
+        return NegativeResponse(request[0], UDS_NRC_SUBFUNCTION_NOT_SUPPORTED);
+    if(request[1] & 0x80)
+        return {};
+    return { 0x7E, 0x00 };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleReadDataByIdentifier(const std::vector<uint8_t>& request)
+{
+    if(request.size() < 3 || (request.size() - 1) % 2)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    size_t did_cnt = (request.size() - 1) / 2;
+    if(m_Config.max_dids_per_request && did_cnt > m_Config.max_dids_per_request)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    std::vector<uint8_t> response = { 0x62 };
+    size_t supported_cnt = 0;
+    for(size_t i = 1; i < request.size(); i += 2)
+    {
+        uint16_t did = (request[i] << 8) | request[i + 1];
+        auto it = m_Config.dids.find(did);
+        if(it == m_Config.dids.end())
+            continue;
+
+        if(it->second.nrc)
+        {
+            if(did_cnt == 1)
+                return NegativeResponse(request[0], it->second.nrc);
+            continue;
+        }
+
+        response.push_back(request[i]);
+        response.push_back(request[i + 1]);
+        response.insert(response.end(), it->second.data.begin(), it->second.data.end());
+        supported_cnt++;
+    }
+
+    if(supported_cnt == 0)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+    if(response.size() > ECU_SIMULATOR_MAX_MESSAGE_LEN)
+        return NegativeResponse(request[0], UDS_NRC_RESPONSE_TOO_LONG);
+    return response;
+}
+
+std::vector<uint8_t> EcuSimulator::HandleWriteDataByIdentifier(const std::vector<uint8_t>& request)
+{
+    if(request.size() < 4)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    uint16_t did = (request[1] << 8) | request[2];
+    auto it = m_Config.dids.find(did);
+    if(it == m_Config.dids.end() || !it->second.writable)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+    if(!it->second.data.empty() && it->second.data.size() != request.size() - 3)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    it->second.data.assign(request.begin() + 3, request.end());
+    return { 0x6E, request[1], request[2] };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleReadMemoryByAddress(const std::vector<uint8_t>& request)
+{
+    uint32_t address = 0;
+    uint32_t size = 0;
+    if(!ParseAddressAndSize(request, 1, address, size))
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    EcuSimulatorMemory* memory = FindMemory(address, size);
+    if(size == 0 || size >= ECU_SIMULATOR_MAX_MESSAGE_LEN || !memory)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+
+    std::vector<uint8_t> response = { 0x63 };
+    auto begin = memory->data.begin() + (address - memory->address);
+    response.insert(response.end(), begin, begin + size);
+    return response;
+}
+
+std::vector<uint8_t> EcuSimulator::HandleReadDataByPeriodicIdentifier(const std::vector<uint8_t>& request)
+{
+    if(request.size() < 2)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+
+    uint8_t rate = request[1];
+    if(rate == PERIODIC_RATE_STOP)
+    {
+        if(request.size() == 2)
+            m_PeriodicDids.clear();
+        for(size_t i = 2; i < request.size(); i++)
+            m_PeriodicDids.erase(request[i]);
+        return { 0x6A };
+    }
+
+    if(rate < PERIODIC_RATE_SLOW || rate > PERIODIC_RATE_FAST)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+    if(request.size() < 3)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+    if(m_Session == DIAG_SESSION_DEFAULT)
+        return NegativeResponse(request[0], UDS_NRC_SERVICE_NOT_SUPPORTED_IN_SESSION);
+
+    for(size_t i = 2; i < request.size(); i++)
+    {
+        if(!m_Config.dids.contains(PERIODIC_DID_BASE | request[i]))
+            return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+    }
+
+    for(size_t i = 2; i < request.size(); i++)
+        m_PeriodicDids[request[i]] = rate;
+    m_PeriodicNext[rate - 1] = m_LastRequest + m_Config.response_latency;
+    return { 0x6A };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleRequestDownload(const std::vector<uint8_t>& request)
+{
+    uint32_t address = 0;
+    uint32_t size = 0;
+    if(!ParseAddressAndSize(request, 2, address, size))
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+    if(m_Session == DIAG_SESSION_DEFAULT)
+        return NegativeResponse(request[0], UDS_NRC_SERVICE_NOT_SUPPORTED_IN_SESSION);
+    if(m_IsDownloadActive)
+        return NegativeResponse(request[0], UDS_NRC_UPLOAD_DOWNLOAD_NOT_ACCEPTED);
+    if(size == 0 || !FindMemory(address, size))
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_OUT_OF_RANGE);
+
+    m_IsDownloadActive = true;
+    m_DownloadAddress = address;
+    m_DownloadRemaining = size;
+    m_BlockSequence = 1;
+    return { 0x74, 0x20, static_cast<uint8_t>(m_Config.max_block_len >> 8), static_cast<uint8_t>(m_Config.max_block_len & 0xFF) };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleTransferData(const std::vector<uint8_t>& request)
+{
+    if(request.size() < 2)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+    if(!m_IsDownloadActive)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_SEQUENCE_ERROR);
+    if(request[1] != m_BlockSequence)
+        return NegativeResponse(request[0], UDS_NRC_WRONG_BLOCK_SEQUENCE_COUNTER);
+
+    size_t len = request.size() - 2;
+    if(len + 2 > m_Config.max_block_len)
+        return NegativeResponse(request[0], UDS_NRC_INCORRECT_LENGTH);
+    if(len > m_DownloadRemaining)
+        return NegativeResponse(request[0], UDS_NRC_TRANSFER_DATA_SUSPENDED);
+
+    EcuSimulatorMemory* memory = FindMemory(m_DownloadAddress, static_cast<uint32_t>(len));
+    if(memory)
+        std::copy(request.begin() + 2, request.end(), memory->data.begin() + (m_DownloadAddress - memory->address));
+
+    m_DownloadAddress += static_cast<uint32_t>(len);
+    m_DownloadRemaining -= static_cast<uint32_t>(len);
+    m_BlockSequence++;  /* Wraps around to 0x00 */
+    return { 0x76, request[1] };
+}
+
+std::vector<uint8_t> EcuSimulator::HandleRequestTransferExit(const std::vector<uint8_t>& request)
+{
+    if(!m_IsDownloadActive)
+        return NegativeResponse(request[0], UDS_NRC_REQUEST_SEQUENCE_ERROR);
+
+    m_IsDownloadActive = false;
+    return { 0x77 };
+}
+
+bool EcuSimulator::ParseAddressAndSize(const std::vector<uint8_t>& request, size_t offset, uint32_t& address, uint32_t& size)
+{
+    if(request.size() <= offset)
+        return false;
+
+    uint8_t address_len = request[offset] & 0xF;
+    uint8_t size_len = request[offset] >> 4;
+    if(address_len < 1 || address_len > 4 || size_len < 1 || size_len > 4 || request.size() != offset + 1 + address_len + size_len)
+        return false;
+
+    address = 0;
+    size = 0;
+    size_t pos = offset + 1;
+    for(uint8_t i = 0; i != address_len; i++)
+        address = (address << 8) | request[pos++];
+    for(uint8_t i = 0; i != size_len; i++)
+        size = (size << 8) | request[pos++];
+    return true;
+}
+
+EcuSimulatorMemory* EcuSimulator::FindMemory(uint32_t address, uint32_t size)
+{
+    for(auto& i : m_Config.memory)
+    {
+        if(address >= i.address && static_cast<uint64_t>(address) + size <= static_cast<uint64_t>(i.address) + i.data.size())
+            return &i;
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> EcuSimulator::NegativeResponse(uint8_t sid, uint8_t nrc)
+{
+    return { 0x7F, sid, nrc };
+}
+
+void EcuSimulator::StartTransmit(const std::vector<uint8_t>& payload, std::chrono::steady_clock::time_point now)
+{
+    m_Stats.responses++;
+    m_Stats.tx_bytes += payload.size();
+    if(payload.size() >= 3 && payload[0] == 0x7F && payload[2] != UDS_NRC_RESPONSE_PENDING)
+        m_Stats.negative_responses++;
+
+    uint8_t frame[ISOTP_FRAME_LEN];
+    if(payload.size() <= ISOTP_FRAME_LEN - 1)
+    {
+        frame[0] = static_cast<uint8_t>(payload.size());
+        std::copy(payload.begin(), payload.end(), frame + 1);
+        SendFrame(m_Config.response_id, frame, static_cast<uint8_t>(payload.size() + 1));
+        return;
+    }
+
+    frame[0] = (ISOTP_PCI_FIRST_FRAME << 4) | ((payload.size() >> 8) & 0xF);
+    frame[1] = payload.size() & 0xFF;
+    std::copy(payload.begin(), payload.begin() + 6, frame + 2);
+    SendFrame(m_Config.response_id, frame, ISOTP_FRAME_LEN);
+
+    m_TxBuffer = payload;
+    m_TxOffset = 6;
+    m_TxSequence = 1;
+    m_TxNextFrame = now + ISOTP_N_BS_TIMEOUT;
+    m_TxState = TX_WAIT_FLOW_CONTROL;
+}
+
+void EcuSimulator::ContinueTransmit(std::chrono::steady_clock::time_point now)
+{
+    while(m_TxState == TX_SENDING && now >= m_TxNextFrame)
+    {
+        uint8_t frame[ISOTP_FRAME_LEN];
+        size_t len = std::min<size_t>(ISOTP_FRAME_LEN - 1, m_TxBuffer.size() - m_TxOffset);
+        frame[0] = (ISOTP_PCI_CONSECUTIVE_FRAME << 4) | m_TxSequence;
+        std::copy(m_TxBuffer.begin() + m_TxOffset, m_TxBuffer.begin() + m_TxOffset + len, frame + 1);
+        SendFrame(m_Config.response_id, frame, static_cast<uint8_t>(len + 1));
+
+        m_TxOffset += len;
+        m_TxSequence = (m_TxSequence + 1) & 0xF;
+        if(m_TxOffset >= m_TxBuffer.size())
+        {
+            m_TxState = TX_IDLE;
+            m_TxBuffer.clear();
+        }
+        else if(m_TxBlockSize && ++m_TxBlockCnt >= m_TxBlockSize)
+        {
+            m_TxNextFrame = now + ISOTP_N_BS_TIMEOUT;
+            m_TxState = TX_WAIT_FLOW_CONTROL;
+        }
+        else
+        {
+            m_TxNextFrame = now + m_TxStMin;
+            if(m_TxStMin.count())
+                break;
+        }
+    }
+}
+
+void EcuSimulator::SendPeriodicData(std::chrono::steady_clock::time_point now)
+{
+    for(uint8_t rate = PERIODIC_RATE_SLOW; rate <= PERIODIC_RATE_FAST; rate++)
+    {
+        std::chrono::steady_clock::time_point& next = m_PeriodicNext[rate - 1];
+        if(now < next)
+            continue;
+
+        bool is_sent = false;
+        for(auto& [pdid, pdid_rate] : m_PeriodicDids)
+        {
+            if(pdid_rate != rate)
+                continue;
+
+            const std::vector<uint8_t>& data = m_Config.dids[PERIODIC_DID_BASE | pdid].data;
+            if(m_Config.periodic_id)
+            {
+                uint8_t frame[ISOTP_FRAME_LEN];
+                size_t len = std::min<size_t>(ISOTP_FRAME_LEN - 1, data.size());
+                frame[0] = pdid;
+                std::copy(data.begin(), data.begin() + len, frame + 1);
+                SendFrame(m_Config.periodic_id, frame, static_cast<uint8_t>(len + 1));
+            }
+            else
+            {
+                std::vector<uint8_t> payload = { 0x6A, pdid };
+                payload.insert(payload.end(), data.begin(), data.end());
+                m_Scheduled.push_back({ now, std::move(payload) });
+            }
+            is_sent = true;
+        }
+
+        if(is_sent)
+        {
+            next += m_Config.periodic_rates[rate - 1];
+            if(next < now)  /* Don't try to catch up after a long stall */
+                next = now + m_Config.periodic_rates[rate - 1];
+        }
+    }
+}
+
+void EcuSimulator::SendFrame(uint32_t frame_id, const uint8_t* data, uint8_t size)
+{
+    uint8_t frame[ISOTP_FRAME_LEN];
+    memset(frame, m_Config.padding, sizeof(frame));
+    memcpy(frame, data, std::min<size_t>(size, sizeof(frame)));
+    m_Stats.tx_frames++;
+    if(m_SendFunction)
+        m_SendFunction(frame_id, frame, ISOTP_FRAME_LEN);
+}
+
+void EcuSimulator::SendFlowControl()
+{
+    uint8_t frame[] = { (ISOTP_PCI_FLOW_CONTROL << 4) | ISOTP_FLOW_STATUS_CTS, m_Config.block_size, m_Config.st_min };
+    SendFrame(m_Config.response_id, frame, sizeof(frame));
+}
+
+std::chrono::microseconds EcuSimulator::StMinToDuration(uint8_t st_min)
+{
+    if(st_min <= 0x7F)
+        return std::chrono::milliseconds(st_min);
+    if(st_min >= 0xF1 && st_min <= 0xF9)
+        return std::chrono::microseconds((st_min - 0xF0) * 100);
+    return std::chrono::milliseconds(0x7F);  /* Reserved values shall be interpreted as the maximum */
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <inttypes.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+/* Negative response codes sent by the simulator */
+constexpr uint8_t UDS_NRC_SERVICE_NOT_SUPPORTED = 0x11;
+constexpr uint8_t UDS_NRC_SUBFUNCTION_NOT_SUPPORTED = 0x12;
+constexpr uint8_t UDS_NRC_INCORRECT_LENGTH = 0x13;
+constexpr uint8_t UDS_NRC_RESPONSE_TOO_LONG = 0x14;
+constexpr uint8_t UDS_NRC_REQUEST_SEQUENCE_ERROR = 0x24;
+constexpr uint8_t UDS_NRC_REQUEST_OUT_OF_RANGE = 0x31;
+constexpr uint8_t UDS_NRC_UPLOAD_DOWNLOAD_NOT_ACCEPTED = 0x70;
+constexpr uint8_t UDS_NRC_TRANSFER_DATA_SUSPENDED = 0x71;
+constexpr uint8_t UDS_NRC_WRONG_BLOCK_SEQUENCE_COUNTER = 0x73;
+constexpr uint8_t UDS_NRC_RESPONSE_PENDING = 0x78;
+constexpr uint8_t UDS_NRC_SERVICE_NOT_SUPPORTED_IN_SESSION = 0x7F;
+
+/* Largest UDS message which fits into a classic ISO-TP frame */
+constexpr size_t ECU_SIMULATOR_MAX_MESSAGE_LEN = 4095;
+
+class EcuSimulatorDid
+{
+public:
+    // !\brief Data returned for ReadDataByIdentifier
+    std::vector<uint8_t> data;
+
+    // !\brief Negative response code returned instead of data, 0 = positive response
+    uint8_t nrc = 0;
+
+    // !\brief Can be written with WriteDataByIdentifier?
+    bool writable = true;
+};
+
+class EcuSimulatorMemory
+{
+public:
+    // !\brief Start address of memory region
+    uint32_t address = 0;
+
+    // !\brief Content of memory region
+    std::vector<uint8_t> data;
+};
+
+class EcuSimulatorConfig
+{
+public:
+    // !\brief CAN ID where the tester sends requests
+    uint32_t request_id = 0x8AB;
+
+    // !\brief CAN ID where the simulator sends responses and flow control frames
+    uint32_t response_id = 0x7DA;
+
+    // !\brief CAN ID for ReadDataByPeriodicIdentifier frames, 0 = send them via ISO-TP on response_id
+    uint32_t periodic_id = 0;
+
+    // !\brief Time between the end of the request and the (first) response
+    std::chrono::microseconds response_latency = std::chrono::microseconds(1000);
+
+    // !\brief Number of NRC 0x78 responses sent before each final response
+    uint8_t pending_count = 0;
+
+    // !\brief Time between NRC 0x78 responses
+    std::chrono::microseconds pending_interval = std::chrono::microseconds(20000);
+
+    // !\brief Block size sent in flow control frames, 0 = no further flow control
+    uint8_t block_size = 0;
+
+    // !\brief Separation time sent in flow control frames (ISO-TP STmin encoding)
+    uint8_t st_min = 0;
+
+    // !\brief Byte used for padding CAN frames to 8 bytes
+    uint8_t padding = 0xAA;
+
+    // !\brief Maximum number of DIDs in one ReadDataByIdentifier request, 0 = unlimited
+    size_t max_dids_per_request = 0;
+
+    // !\brief P2 server timing reported in DiagnosticSessionControl response [ms]
+    uint16_t p2 = 50;
+
+    // !\brief P2* server timing reported in DiagnosticSessionControl response [ms]
+    uint16_t p2_star = 5000;
+
+    // !\brief Non-default session falls back to default after this time without request
+    std::chrono::milliseconds s3_timeout = std::chrono::milliseconds(5000);
+
+    // !\brief Periods of ReadDataByPeriodicIdentifier rates (slow, medium, fast)
+    std::chrono::milliseconds periodic_rates[3] = { std::chrono::milliseconds(1000), std::chrono::milliseconds(200), std::chrono::milliseconds(50) };
+
+    // !\brief Maximum length of TransferData requests reported in RequestDownload response
+    uint16_t max_block_len = 0x402;
+
+    // !\brief DID table
+    std::map<uint16_t, EcuSimulatorDid> dids;
+
+    // !\brief Memory regions for ReadMemoryByAddress and RequestDownload
+    std::vector<EcuSimulatorMemory> memory;
+};
+
+class EcuSimulatorStats
+{
+public:
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t negative_responses = 0;
+    uint64_t rx_frames = 0;
+    uint64_t tx_frames = 0;
+    uint64_t rx_bytes = 0;  /* UDS payload */
+    uint64_t tx_bytes = 0;  /* UDS payload */
+};
+
+using EcuSimulatorSendFunction = std::function<void(uint32_t frame_id, const uint8_t* data, uint8_t size)>;
+
+class EcuSimulator
+{
+public:
+    EcuSimulator(const EcuSimulatorConfig& config, EcuSimulatorSendFunction send_function);
+    ~EcuSimulator() = default;
+
+    // !\brief Process CAN frame sent by the tester
+    // !\param frame_id [in] Frame ID
+    // !\param data [in] Frame data
+    // !\param size [in] Frame data length
+    // !\param now [in] Current time
+    void OnFrameReceived(uint32_t frame_id, const uint8_t* data, uint8_t size, std::chrono::steady_clock::time_point now);
+
+    // !\brief Send responses, consecutive frames and periodic data which are due
+    // !\param now [in] Current time
+    void Poll(std::chrono::steady_clock::time_point now);
+
+    // !\brief Get time when Poll has to be called next time
+    std::chrono::steady_clock::time_point GetNextEventTime() const;
+
+    // !\brief Get current diagnostic session
+    uint8_t GetSession() const { return m_Session; }
+
+    // !\brief Get DID table with values written by the tester
+    const std::map<uint16_t, EcuSimulatorDid>& GetDids() const { return m_Config.dids; }
+
+    // !\brief Get memory regions with data downloaded by the tester
+    const std::vector<EcuSimulatorMemory>& GetMemory() const { return m_Config.memory; }
+
+    // !\brief Get statistics
+    const EcuSimulatorStats& GetStats() const { return m_Stats; }
+
+private:
+    class ScheduledResponse
+    {
+    public:
+        std::chrono::steady_clock::time_point time;
+        std::vector<uint8_t> payload;
+    };
+
+    enum TransmitState : uint8_t
+    {
+        TX_IDLE,
+        TX_WAIT_FLOW_CONTROL,
+        TX_SENDING,
+    };
+
+    // !\brief Handle complete UDS request
+    void HandleRequest(const std::vector<uint8_t>& request, std::chrono::steady_clock::time_point now);
+
+    // !\brief Execute UDS request
+    // !\return Response payload, empty if no response has to be sent
+    std::vector<uint8_t> ExecuteRequest(const std::vector<uint8_t>& request);
+
+    std::vector<uint8_t> HandleSessionControl(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleTesterPresent(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleReadDataByIdentifier(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleWriteDataByIdentifier(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleReadMemoryByAddress(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleReadDataByPeriodicIdentifier(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleRequestDownload(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleTransferData(const std::vector<uint8_t>& request);
+    std::vector<uint8_t> HandleRequestTransferExit(const std::vector<uint8_t>& request);
+
+    // !\brief Parse address and size fields described by addressAndLengthFormatIdentifier
+    // !\return False if the format or the request length is invalid
+    static bool ParseAddressAndSize(const std::vector<uint8_t>& request, size_t offset, uint32_t& address, uint32_t& size);
+
+    // !\brief Find memory region containing [address, address + size)
+    EcuSimulatorMemory* FindMemory(uint32_t address, uint32_t size);
+
+    // !\brief Create negative response
+    static std::vector<uint8_t> NegativeResponse(uint8_t sid, uint8_t nrc);
+
+    // !\brief Start ISO-TP transmission of payload
+    void StartTransmit(const std::vector<uint8_t>& payload, std::chrono::steady_clock::time_point now);
+
+    // !\brief Send consecutive frames which are due
+    void ContinueTransmit(std::chrono::steady_clock::time_point now);
+
+    // !\brief Send periodic data which are due
+    void SendPeriodicData(std::chrono::steady_clock::time_point now);
+
+    // !\brief Send CAN frame padded to 8 bytes
+    void SendFrame(uint32_t frame_id, const uint8_t* data, uint8_t size);
+
+    // !\brief Send flow control frame
+    void SendFlowControl();
+
+    // !\brief Convert ISO-TP STmin to duration
+    static std::chrono::microseconds StMinToDuration(uint8_t st_min);
+
+    // !\brief Simulator configuration, DIDs and memory are modified by write services
+    EcuSimulatorConfig m_Config;
+
+    // !\brief Function for sending CAN frames
+    EcuSimulatorSendFunction m_SendFunction;
+
+    // !\brief Active diagnostic session
+    uint8_t m_Session = 1;
+
+    // !\brief Time of last request, used for S3 timeout
+    std::chrono::steady_clock::time_point m_LastRequest;
+
+    // !\brief Responses waiting for their latency
+    std::deque<ScheduledResponse> m_Scheduled;
+
+    // !\brief ISO-TP receive buffer
+    std::vector<uint8_t> m_RxBuffer;
+
+    // !\brief Expected length of segmented request
+    size_t m_RxExpectedLen = 0;
+
+    // !\brief Next expected sequence number
+    uint8_t m_RxSequence = 0;
+
+    // !\brief Consecutive frames received in current block
+    uint8_t m_RxBlockCnt = 0;
+
+    // !\brief ISO-TP transmit buffer
+    std::vector<uint8_t> m_TxBuffer;
+
+    // !\brief Offset of next byte to send
+    size_t m_TxOffset = 0;
+
+    // !\brief Sequence number of next consecutive frame
+    uint8_t m_TxSequence = 0;
+
+    // !\brief Transmit state
+    TransmitState m_TxState = TX_IDLE;
+
+    // !\brief Block size received from the tester, 0 = unlimited
+    uint8_t m_TxBlockSize = 0;
+
+    // !\brief Consecutive frames sent in current block
+    uint8_t m_TxBlockCnt = 0;
+
+    // !\brief Separation time received from the tester
+    std::chrono::microseconds m_TxStMin = std::chrono::microseconds(0);
+
+    // !\brief Time when next consecutive frame can be sent
+    std::chrono::steady_clock::time_point m_TxNextFrame;
+
+    // !\brief Scheduled periodic identifiers and their rate
+    std::map<uint8_t, uint8_t> m_PeriodicDids;
+
+    // !\brief Next transmission time for each periodic rate
+    std::chrono::steady_clock::time_point m_PeriodicNext[3];
+
+    // !\brief Is download active?
+    bool m_IsDownloadActive = false;
+
+    // !\brief Address of next TransferData block
+    uint32_t m_DownloadAddress = 0;
+
+    // !\brief Remaining bytes of download
+    uint32_t m_DownloadRemaining = 0;
+
+    // !\brief Expected block sequence counter
+    uint8_t m_BlockSequence = 1;
+
+    // !\brief Statistics
+    EcuSimulatorStats m_Stats;
+};
@@ -93,6 +93,66 @@ void Settings::LoadFile()
         can_handler->SetRecordingLogLevel(utils::stoi<uint8_t>(pt.get_child("CANSender").find("DefaultRecordingLogLevel")->second.data()));
         can_handler->SetFavouriteLevel(utils::stoi<uint8_t>(pt.get_child("CANSender").find("DefaultFavouriteLevel")->second.data()));
         can_handler->SetDefaultEcuId(static_cast<uint32_t>(std::strtol(pt.get_child("CANSender").find("DefaultEcuId")->second.data().c_str(), nullptr, 16)));
+        {
+            std::string uds_timing;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "UdsTiming", uds_timing);
+            wxGetApp().did_handler->GetSessionManager().SetTimingOverridesFromString(uds_timing);
+
+            std::string periodic_id;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "UdsPeriodicResponseId", periodic_id);
+            wxGetApp().did_handler->SetPeriodicResponseId(static_cast<uint32_t>(std::strtol(periodic_id.c_str(), nullptr, 16)));
+
+            std::string capture_triggers, capture_ring_size, capture_pre_trigger, capture_post_trigger, capture_armed;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "CaptureTriggers", capture_triggers);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "CaptureRingSize", capture_ring_size);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "CapturePreTrigger", capture_pre_trigger);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "CapturePostTrigger", capture_post_trigger);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "CaptureArmed", capture_armed);
+
+            std::scoped_lock lock{ can_handler->m };
+            CanTriggerCapture& capture = can_handler->m_Capture;
+            capture.SetTriggersFromString(capture_triggers);
+            if(!capture_ring_size.empty())
+                capture.SetRingSize(std::strtoul(capture_ring_size.c_str(), nullptr, 10));
+            if(!capture_pre_trigger.empty() && !capture_post_trigger.empty())
+                capture.SetWindow(std::chrono::milliseconds(std::strtoul(capture_pre_trigger.c_str(), nullptr, 10)),
+                    std::chrono::milliseconds(std::strtoul(capture_post_trigger.c_str(), nullptr, 10)));
+            capture.Arm(std::strtoul(capture_armed.c_str(), nullptr, 10) != 0, std::chrono::steady_clock::now());
+        }
+        {
+            std::string gateway_rules, gateway_enabled;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "GatewayRules", gateway_rules);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "GatewayEnabled", gateway_enabled);
+
+            CanGateway& gateway = CanSerialPort::Get()->GetGateway();
+            gateway.SetRulesFromString(gateway_rules);
+            gateway.SetEnabled(std::strtoul(gateway_enabled.c_str(), nullptr, 10) != 0);
+        }
+        {
+            std::string tx_queue_size, tx_queue_overflow, tx_queue_order, tx_queue_coalesced_ids;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "TxQueueSize", tx_queue_size);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "TxQueueOverflow", tx_queue_overflow);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "TxQueueOrder", tx_queue_order);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "TxQueueCoalescedIds", tx_queue_coalesced_ids);
+
+            CanTxQueue& tx_queue = CanSerialPort::Get()->GetTxQueue();
+            if(!tx_queue_size.empty())
+                tx_queue.SetCapacity(std::strtoul(tx_queue_size.c_str(), nullptr, 10));
+            if(!tx_queue_overflow.empty())
+                tx_queue.SetOverflowPolicyFromString(tx_queue_overflow);
+            if(!tx_queue_order.empty())
+                tx_queue.SetOrderFromString(tx_queue_order);
+            tx_queue.SetCoalescedIdsFromString(tx_queue_coalesced_ids);
+        }
+        {
+            std::string signal_series_ids, signal_series_size;
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "SignalSeriesIds", signal_series_ids);
+            utils::ini::ReadValueIfexists(pt.get_child_optional("CANSender"), "SignalSeriesSize", signal_series_size);
+
+            if(!signal_series_size.empty())
+                can_handler->SetSignalSeriesSize(std::strtoul(signal_series_size.c_str(), nullptr, 10));
+            can_handler->SetSignalSeriesIdsFromString(signal_series_ids);
+        }
         can_handler->default_tx_list = std::move(pt.get_child("CANSender").find("DefaultTxList")->second.data());
         can_handler->default_rx_list = pt.get_child("CANSender").find("DefaultRxList")->second.data();
         can_handler->default_mapping = pt.get_child("CANSender").find("DefaultMapping")->second.data();
@@ -288,12 +348,30 @@ void Settings::SaveFile(bool write_default_macros) /* tried boost::ptree ini wri
     out << "[CANSender]\n";
     out << "Enable = " << CanSerialPort::Get()->IsEnabled() << "\n";
     out << "COM = " << CanSerialPort::Get()->GetComPort() << " # Com port for CAN UART where data is received/sent from/to STM32\n";
-    out << "DeviceType = " << static_cast<int>(CanSerialPort::Get()->GetDeviceType()) << " # 0 = STM32, 1 = LAWICEL\n";
+    out << "DeviceType = " << static_cast<int>(CanSerialPort::Get()->GetDeviceType()) << " # 0 = STM32, 1 = LAWICEL, 2 = ECU simulator (EcuSimulator.xml)\n";
     out << "AutoSend = " << can_handler->IsAutoSend() << "\n";
     out << "AutoRecord = " << can_handler->IsAutoRecord() << "\n";
     out << "DefaultRecordingLogLevel = " << static_cast<int>(can_handler->GetRecordingLogLevel()) << "\n";
     out << "DefaultFavouriteLevel = " << static_cast<int>(can_handler->GetFavouriteLevel()) << "\n";
     out << "DefaultEcuId = " << std::format("{:X}", can_handler->GetDefaultEcuId()) << "\n";
+    out << "UdsPeriodicResponseId = " << std::format("{:X}", wxGetApp().did_handler->GetPeriodicResponseId()) << " # CAN ID of periodic DID (0x2A) frames, 0 = they're sent as ISO-TP frames on the response ID\n";
+    out << "UdsTiming = " << wxGetApp().did_handler->GetSessionManager().GetTimingOverridesAsString() << " # Per-ECU P2/P2* override in ms, format: ECU_ID:P2:P2*, separated by comma. Empty = use timings reported by ECU\n";
+    {
+        std::scoped_lock lock{ can_handler->m };
+        out << "CaptureTriggers = " << can_handler->m_Capture.GetTriggersAsString() << " # Triggers of capture, separated by comma: ID/MASK=VALUE, Error, Missing:ID:TIMEOUT_MS, Did:RESPONSE_ID:DID\n";
+        out << "CaptureRingSize = " << can_handler->m_Capture.GetRingSize() << " # Maximum number of frames before and after the trigger\n";
+        out << "CapturePreTrigger = " << can_handler->m_Capture.GetPreTrigger().count() << " # Time window before the trigger in ms\n";
+        out << "CapturePostTrigger = " << can_handler->m_Capture.GetPostTrigger().count() << " # Time window after the trigger in ms\n";
+        out << "CaptureArmed = " << can_handler->m_Capture.IsArmed() << " # Arm triggers at startup\n";
+    }
+    out << "GatewayRules = " << CanSerialPort::Get()->GetGateway().GetRulesAsString() << " # Forwarding of received frames, separated by comma: ID[/MASK]:Drop, ID[/MASK]:NEW_ID[:PATCH][:RATE]\n";
+    out << "GatewayEnabled = " << CanSerialPort::Get()->GetGateway().IsEnabled() << " # Enable gateway at startup\n";
+    out << "TxQueueSize = " << CanSerialPort::Get()->GetTxQueue().GetCapacity() << " # Maximum number of frames waiting for transmission\n";
+    out << "TxQueueOverflow = " << CanSerialPort::Get()->GetTxQueue().GetOverflowPolicyAsString() << " # What happens when TX queue is full: DropOldest, DropNewest, Block:TIMEOUT_MS\n";
+    out << "TxQueueOrder = " << CanSerialPort::Get()->GetTxQueue().GetOrderAsString() << " # Order of sending: Fifo, Arbitration (lower ID first)\n";
+    out << "TxQueueCoalescedIds = " << CanSerialPort::Get()->GetTxQueue().GetCoalescedIdsAsString() << " # Frame IDs in hex, separated by comma, a new frame replaces the data of the queued one\n";
+    out << "SignalSeriesIds = " << can_handler->GetSignalSeriesIdsAsString() << " # Frame IDs in hex, separated by comma, mapped signals of them are recorded for plotting\n";
+    out << "SignalSeriesSize = " << can_handler->GetSignalSeriesSize() << " # Maximum number of points per signal, older ones are kept only as min/max\n";
     out << "DefaultTxList = " << can_handler->default_tx_list.generic_string() << "\n";
     out << "DefaultRxList = " << can_handler->default_rx_list.generic_string() << "\n";
     out << "DefaultMapping = " << can_handler->default_mapping.generic_string() << "\n";
@@ -0,0 +1,189 @@
+#include "pch.hpp"
+
+bool UdsSessionManager::IsSessionActive(uint32_t ecu_id, uint8_t session)
+{
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    CheckExpiry(ecu);
+    return ecu.session == session;
+}
+
+void UdsSessionManager::OnRequestSent(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    CheckExpiry(ecu);
+    ecu.last_request = std::chrono::steady_clock::now();
+}
+
+void UdsSessionManager::OnResponseReceived(uint32_t ecu_id, const uint8_t* data, size_t size)
+{
+    if(size < 2)
+        return;
+
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    switch(data[0])
+    {
+        case 0x50:  /* DiagnosticSessionControl */
+        {
+            if(ecu.session != data[1])
+                LOG(LogLevel::Verbose, "ECU {:X} session changed: {:X} -> {:X}", ecu_id, ecu.session, data[1]);
+            ecu.session = data[1];
+
+            if(size >= 6)  /* P2 in 1 ms, P2* in 10 ms resolution */
+            {
+                ecu.timing.p2 = std::chrono::milliseconds(data[2] << 8 | data[3]);
+                ecu.timing.p2_star = std::chrono::milliseconds((data[4] << 8 | data[5]) * 10);
+                LOG(LogLevel::Verbose, "ECU {:X} timings: P2: {} ms, P2*: {} ms", ecu_id, ecu.timing.p2.count(), ecu.timing.p2_star.count());
+            }
+            break;
+        }
+        case 0x51:  /* ECUReset */
+        {
+            ecu.session = UDS_SESSION_DEFAULT;
+            break;
+        }
+        case 0x7F:
+        {
+            /* Service not supported in active session / conditions not correct: the ECU has most likely dropped the session */
+            if(size >= 3 && (data[2] == 0x7F || data[2] == 0x22))
+                ecu.session = UDS_SESSION_DEFAULT;
+            break;
+        }
+    }
+}
+
+void UdsSessionManager::Invalidate(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    m_Sessions[ecu_id].session = UDS_SESSION_DEFAULT;
+}
+
+bool UdsSessionManager::IsTesterPresentDue(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    CheckExpiry(ecu);
+    return ecu.session != UDS_SESSION_DEFAULT && std::chrono::steady_clock::now() - ecu.last_request >= UDS_TESTER_PRESENT_PERIOD;
+}
+
+std::chrono::steady_clock::duration UdsSessionManager::GetTimeUntilTesterPresent(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    CheckExpiry(ecu);
+    if(ecu.session == UDS_SESSION_DEFAULT)
+        return UDS_TESTER_PRESENT_PERIOD;
+
+    auto elapsed = std::chrono::steady_clock::now() - ecu.last_request;
+    return elapsed >= UDS_TESTER_PRESENT_PERIOD ? std::chrono::steady_clock::duration::zero() : UDS_TESTER_PRESENT_PERIOD - elapsed;
+}
+
+UdsTiming UdsSessionManager::GetTiming(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    auto& ecu = m_Sessions[ecu_id];
+    return ecu.timing_override ? *ecu.timing_override : ecu.timing;
+}
+
+void UdsSessionManager::SetTimingOverridesFromString(const std::string& str)
+{
+    std::vector<std::string> entries;
+    boost::split(entries, str.substr(0, str.find('#')), boost::is_any_of(","));
+
+    std::scoped_lock lock(m);
+    for(auto& [ecu_id, ecu] : m_Sessions)
+        ecu.timing_override.reset();
+
+    for(auto& entry : entries)
+    {
+        boost::algorithm::trim(entry);
+        if(entry.empty())
+            continue;
+
+        std::vector<std::string> params;
+        boost::split(params, entry, boost::is_any_of(":"));
+        if(params.size() != 3)
+        {
+            LOG(LogLevel::Error, "Invalid UDS timing format: {}, expected ECU_ID:P2:P2*", entry);
+            continue;
+        }
+
+        try
+        {
+            uint32_t ecu_id = std::stoi(params[0], nullptr, 16);
+            UdsTiming timing;
+            timing.p2 = std::chrono::milliseconds(std::stoi(params[1]));
+            timing.p2_star = std::chrono::milliseconds(std::stoi(params[2]));
+            m_Sessions[ecu_id].timing_override = timing;
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "Invalid UDS timing format, stoi exception: {} ({})", e.what(), entry);
+        }
+    }
+}
+
+std::string UdsSessionManager::GetTimingOverridesAsString()
+{
+    std::string ret;
+    std::scoped_lock lock(m);
+    for(auto& [ecu_id, ecu] : m_Sessions)
+    {
+        if(!ecu.timing_override)
+            continue;
+        if(!ret.empty())
+            ret += ", ";
+        ret += std::format("{:X}:{}:{}", ecu_id, ecu.timing_override->p2.count(), ecu.timing_override->p2_star.count());
+    }
+    return ret;
+}
+
+void UdsSessionManager::OnResponseTime(uint32_t ecu_id, std::chrono::steady_clock::duration elapsed)
+{
+    auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+    std::scoped_lock lock(m);
+    auto& stats = m_Sessions[ecu_id].stats;
+    stats.count++;
+    stats.total += elapsed_us;
+    stats.min = std::min(stats.min, elapsed_us);
+    stats.max = std::max(stats.max, elapsed_us);
+}
+
+void UdsSessionManager::OnResponsePending(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    m_Sessions[ecu_id].stats.pending++;
+}
+
+void UdsSessionManager::OnResponseTimeout(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    m_Sessions[ecu_id].stats.timeouts++;
+}
+
+UdsResponseStats UdsSessionManager::GetStats(uint32_t ecu_id)
+{
+    std::scoped_lock lock(m);
+    return m_Sessions[ecu_id].stats;
+}
+
+std::string UdsSessionManager::GetStatsAsString(uint32_t ecu_id)
+{
+    UdsResponseStats stats = GetStats(ecu_id);
+    if(stats.count == 0)
+        return std::format("ECU {:X}: no responses, timeouts: {}", ecu_id, stats.timeouts);
+
+    return std::format("ECU {:X}: responses: {}, min: {:.3f} ms, avg: {:.3f} ms, max: {:.3f} ms, response pending: {}, timeouts: {}", ecu_id, stats.count,
+        stats.min.count() / 1000.0, stats.GetAverage().count() / 1000.0, stats.max.count() / 1000.0, stats.pending, stats.timeouts);
+}
+
+void UdsSessionManager::CheckExpiry(UdsEcuSession& ecu)
+{
+    if(ecu.session != UDS_SESSION_DEFAULT && std::chrono::steady_clock::now() - ecu.last_request >= UDS_S3_SERVER_TIMEOUT)
+    {
+        LOG(LogLevel::Verbose, "S3 timer expired, session {:X} is closed", ecu.session);
+        ecu.session = UDS_SESSION_DEFAULT;
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+/* ISO 14229-2: S3 server timer, the ECU falls back to default session without any request during this time */
+constexpr auto UDS_S3_SERVER_TIMEOUT = std::chrono::milliseconds(5000);
+
+/* TesterPresent is sent well before S3 expires */
+constexpr auto UDS_TESTER_PRESENT_PERIOD = std::chrono::milliseconds(2000);
+
+/* Default P2 / P2* server timings until the ECU reports its own in DiagnosticSessionControl response */
+constexpr auto UDS_DEFAULT_P2 = std::chrono::milliseconds(50);
+constexpr auto UDS_DEFAULT_P2_STAR = std::chrono::milliseconds(5000);
+
+/* Added to server timings to cover bus and ISO-TP latency on the tester side */
+constexpr auto UDS_P2_CLIENT_MARGIN = std::chrono::milliseconds(50);
+
+enum UdsSessionType : uint8_t
+{
+    UDS_SESSION_DEFAULT = 0x01,
+    UDS_SESSION_PROGRAMMING = 0x02,
+    UDS_SESSION_EXTENDED = 0x03,
+};
+
+class UdsTiming
+{
+public:
+    // !\brief Maximum time between the request and the first response
+    std::chrono::milliseconds p2 = UDS_DEFAULT_P2;
+
+    // !\brief Maximum time between NRC 0x78 (response pending) and the next response
+    std::chrono::milliseconds p2_star = UDS_DEFAULT_P2_STAR;
+};
+
+class UdsResponseStats
+{
+public:
+    // !\brief Number of final responses
+    size_t count = 0;
+
+    // !\brief Number of requests without any response in time
+    size_t timeouts = 0;
+
+    // !\brief Number of NRC 0x78 (response pending) responses
+    size_t pending = 0;
+
+    // !\brief Fastest response time
+    std::chrono::microseconds min = std::chrono::microseconds::max();
+
+    // !\brief Slowest response time
+    std::chrono::microseconds max = std::chrono::microseconds::zero();
+
+    // !\brief Sum of response times
+    std::chrono::microseconds total = std::chrono::microseconds::zero();
+
+    // !\brief Get average response time
+    std::chrono::microseconds GetAverage() const { return count ? total / static_cast<int64_t>(count) : std::chrono::microseconds::zero(); }
+};
+
+class UdsEcuSession
+{
+public:
+    // !\brief Currently active diagnostic session
+    uint8_t session = UDS_SESSION_DEFAULT;
+
+    // !\brief Time of the last request sent to the ECU, it restarts S3 timer in the ECU
+    std::chrono::steady_clock::time_point last_request;
+
+    // !\brief Timings reported by the ECU
+    UdsTiming timing;
+
+    // !\brief Timings configured by the user, they take precedence over the reported ones
+    std::optional<UdsTiming> timing_override;
+
+    // !\brief Response time statistics
+    UdsResponseStats stats;
+};
+
+class UdsSessionManager
+{
+public:
+    UdsSessionManager() = default;
+    ~UdsSessionManager() = default;
+
+    // !\brief Is the given session active on the ECU?
+    // !\param ecu_id [in] ECU's request ID
+    // !\param session [in] Session type
+    bool IsSessionActive(uint32_t ecu_id, uint8_t session);
+
+    // !\brief Notify the manager that a request has been sent to the ECU
+    // !\param ecu_id [in] ECU's request ID
+    void OnRequestSent(uint32_t ecu_id);
+
+    // !\brief Process a response received from the ECU
+    // !\param ecu_id [in] ECU's request ID
+    // !\param data [in] UDS response
+    // !\param size [in] Size of the response
+    void OnResponseReceived(uint32_t ecu_id, const uint8_t* data, size_t size);
+
+    // !\brief Forget the active session, it has to be reopened before the next request
+    // !\param ecu_id [in] ECU's request ID
+    void Invalidate(uint32_t ecu_id);
+
+    // !\brief Is TesterPresent due for the ECU to keep the non-default session alive?
+    // !\param ecu_id [in] ECU's request ID
+    bool IsTesterPresentDue(uint32_t ecu_id);
+
+    // !\brief Get the time remaining until the next TesterPresent has to be sent
+    // !\param ecu_id [in] ECU's request ID
+    // !\return Remaining time, UDS_TESTER_PRESENT_PERIOD if there is no non-default session
+    std::chrono::steady_clock::duration GetTimeUntilTesterPresent(uint32_t ecu_id);
+
+    // !\brief Get timings to use for the ECU
+    // !\param ecu_id [in] ECU's request ID
+    UdsTiming GetTiming(uint32_t ecu_id);
+
+    // !\brief Set timings from settings string, format: "ECU_ID:P2:P2*" entries separated by comma, eg. "8AB:50:5000, 7E0:25:2000"
+    // !\param str [in] Timing overrides
+    void SetTimingOverridesFromString(const std::string& str);
+
+    // !\brief Get timing overrides as settings string
+    std::string GetTimingOverridesAsString();
+
+    // !\brief Record the time of a final response
+    // !\param ecu_id [in] ECU's request ID
+    // !\param elapsed [in] Time between the request and the final response
+    void OnResponseTime(uint32_t ecu_id, std::chrono::steady_clock::duration elapsed);
+
+    // !\brief Record a NRC 0x78 (response pending)
+    // !\param ecu_id [in] ECU's request ID
+    void OnResponsePending(uint32_t ecu_id);
+
+    // !\brief Record a request without any response in time
+    // !\param ecu_id [in] ECU's request ID
+    void OnResponseTimeout(uint32_t ecu_id);
+
+    // !\brief Get response time statistics of the ECU
+    // !\param ecu_id [in] ECU's request ID
+    UdsResponseStats GetStats(uint32_t ecu_id);
+
+    // !\brief Get response time statistics of the ECU as a human readable string
+    // !\param ecu_id [in] ECU's request ID
+    std::string GetStatsAsString(uint32_t ecu_id);
+
+private:
+    // !\brief Expire the session if S3 timer has elapsed since the last request
+    // !\param ecu [in] ECU session
+    void CheckExpiry(UdsEcuSession& ecu);
+
+    // !\brief Sessions by ECU request ID
+    std::map<uint32_t, UdsEcuSession> m_Sessions;
+
+    // !\brief Mutex for sessions
+    std::mutex m;
+};
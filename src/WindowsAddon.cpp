@@ -26,7 +26,8 @@ bool MyApp::OnInit()
 
     can_entry = std::make_unique<CanEntryHandler>(xml, rx_xml, mapping_xml);
     cmd_executor = std::make_unique<CmdExecutor>();
-    did_handler = std::make_unique<DidHandler>(did_xml_loader, did_xml_chace_loader, can_entry.get());
+    did_handler = std::make_unique<DidHandler>(did_xml_loader, did_cache_loader, can_entry.get());
+    did_discovery = std::make_unique<DidDiscovery>(can_entry.get(), did_handler->GetSessionManager());
     alarm_entry = std::make_unique<AlarmEntryHandler>(alarm_entry_loader);
     time_tracker = std::make_unique<TimeTracker>();
 
@@ -61,6 +62,7 @@ int MyApp::OnExit()
 {
     is_init_finished = false;
     
+    did_discovery.reset(nullptr);  /* Stop scanning while CAN device is still available */
     CanSerialPort::CSingleton::Destroy();
 
     did_handler.reset(nullptr);  /* First this has to be destructed, because it uses CanEntryHandler */
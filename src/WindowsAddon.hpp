@@ -8,6 +8,7 @@
 #include "CanEntryHandler.hpp"
 #include "CmdExecutor.hpp"
 #include "DidHandler.hpp"
+#include "DidDiscovery.hpp"
 #include "Alarms.hpp"
 #include "TimeTracker.hpp"
 
@@ -25,11 +26,12 @@ public:
     XmlCanRxEntryLoader rx_xml;
     XmlCanMappingLoader mapping_xml;
     XmlDidLoader did_xml_loader;
-    XmlDidCacheLoader did_xml_chace_loader;
+    BinaryDidCacheLoader did_cache_loader;
     XmlAlarmEntryLoader alarm_entry_loader;
     std::unique_ptr<CanEntryHandler> can_entry;
     std::unique_ptr<CmdExecutor> cmd_executor;
     std::unique_ptr<DidHandler> did_handler;
+    std::unique_ptr<DidDiscovery> did_discovery;
     std::unique_ptr<AlarmEntryHandler> alarm_entry;
     std::unique_ptr<TimeTracker> time_tracker;
 };
\ No newline at end of file
@@ -20,27 +20,20 @@ CanLogPanel::CanLogPanel(wxWindow* parent)
 
     m_grid = new wxGrid(this, wxID_ANY, wxDefaultPosition, wxSize(800, 600), 0);
 
-    // Grid
-    m_grid->CreateGrid(1, CanLogGridCol::Log_Max);
-    m_grid->EnableEditing(true);
+    // Grid, rows are read from the recording on demand
+    m_Table = new CanLogGridTable();
+    m_Table->SetAttrProvider(new CanLogGridAttrProvider(*m_Table));
+    m_grid->SetTable(m_Table, true, wxGrid::wxGridSelectionModes::wxGridSelectRows);
+    m_grid->EnableEditing(false);
     m_grid->EnableGridLines(true);
     m_grid->EnableDragGridSize(false);
     m_grid->SetMargins(0, 0);
 
-    m_grid->SetColLabelValue(CanLogGridCol::Log_Time, "Time");
-    m_grid->SetColLabelValue(CanLogGridCol::Log_Direction, "Direction");
-    m_grid->SetColLabelValue(CanLogGridCol::Log_Id, "Id");
-    m_grid->SetColLabelValue(CanLogGridCol::Log_DataSize, "Size");
-    m_grid->SetColLabelValue(CanLogGridCol::Log_Data, "Data");
-    m_grid->SetColLabelValue(CanLogGridCol::Log_Comment, "Comment");
-
     // Columns
     m_grid->EnableDragColMove(true);
     m_grid->EnableDragColSize(true);
     m_grid->SetColLabelAlignment(wxALIGN_CENTER, wxALIGN_CENTER);
 
-    m_grid->SetSelectionMode(wxGrid::wxGridSelectionModes::wxGridSelectRows);
-
     // Rows
     m_grid->EnableDragRowSize(true);
     m_grid->SetRowLabelAlignment(wxALIGN_CENTER, wxALIGN_CENTER);
@@ -80,7 +73,7 @@ CanLogPanel::CanLogPanel(wxWindow* parent)
         {
             std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
             can_handler->ToggleRecording(false, false);
-            inserted_until = 0;
+            ClearRecordingsFromGrid();
         });
     h_sizer->Add(m_RecordingStop);
 
@@ -109,6 +102,73 @@ CanLogPanel::CanLogPanel(wxWindow* parent)
     h_sizer->AddSpacer(35);
     h_sizer->Add(m_AutoScrollBtn);
 
+    m_CaptureBtn = new wxButton(this, wxID_ANY, wxT("Toggle capture"), wxDefaultPosition, wxDefaultSize, 0);
+    m_CaptureBtn->SetToolTip("Arm or disarm trigger-based capture, pre and post-trigger frames are saved to Can directory when a trigger fires (triggers are set in settings)");
+    m_CaptureBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            bool is_armed = !can_handler->IsCaptureArmed();
+            can_handler->ToggleCapture(is_armed);
+            m_CaptureBtn->SetBackgroundColour(is_armed ? *wxGREEN : wxNullColour);
+        });
+    if(wxGetApp().can_entry && wxGetApp().can_entry->IsCaptureArmed())
+        m_CaptureBtn->SetBackgroundColour(*wxGREEN);
+    h_sizer->AddSpacer(10);
+    h_sizer->Add(m_CaptureBtn);
+
+    m_GatewayBtn = new wxButton(this, wxID_ANY, wxT("Toggle gateway"), wxDefaultPosition, wxDefaultSize, 0);
+    m_GatewayBtn->SetToolTip("Enable or disable forwarding of received frames by gateway rules (rules are set in settings), counters are logged when it's disabled");
+    m_GatewayBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            CanGateway& gateway = CanSerialPort::Get()->GetGateway();
+            bool is_enabled = !gateway.IsEnabled();
+            if(is_enabled)
+            {
+                gateway.ResetCounters();
+            }
+            else
+            {
+                std::vector<CanGatewayCounters> counters = gateway.GetCounters();
+                for(size_t i = 0; i != counters.size(); i++)
+                    LOG(LogLevel::Notification, "Gateway rule {}: matched: {}, forwarded: {}, dropped: {}, rate limited: {}", i + 1, counters[i].matched, 
+                        counters[i].forwarded, counters[i].dropped, counters[i].rate_limited);
+                LOG(LogLevel::Notification, "Gateway echoes of forwarded frames: {}", gateway.GetEchoCount());
+            }
+            gateway.SetEnabled(is_enabled);
+            m_GatewayBtn->SetBackgroundColour(is_enabled ? *wxGREEN : wxNullColour);
+        });
+    if(CanSerialPort::Get()->GetGateway().IsEnabled())
+        m_GatewayBtn->SetBackgroundColour(*wxGREEN);
+    h_sizer->AddSpacer(10);
+    h_sizer->Add(m_GatewayBtn);
+
+    m_MarkChangesBtn = new wxButton(this, wxID_ANY, wxT("Mark changes"), wxDefaultPosition, wxDefaultSize, 0);
+    m_MarkChangesBtn->SetToolTip("Log received frames and mapped signals which changed since the previous mark, then set a new mark");
+    m_MarkChangesBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            std::chrono::steady_clock::time_point previous_mark;
+            std::vector<CanChangeReport> reports = can_handler->MarkChanges(previous_mark);
+            for(auto& i : reports)
+            {
+                LOG(LogLevel::Notification, "Changed {:X}: bits: {}, toggles: {}, last change: {} ms after mark, signals: {}", i.frame_id, CanChangeDetector::FormatMask(i.changed_mask), 
+                    i.toggle_count, std::chrono::duration_cast<std::chrono::milliseconds>(i.last_change - previous_mark).count(), boost::algorithm::join(i.signals, ", "));
+            }
+            LOG(LogLevel::Notification, "{} frames changed since the previous mark, new mark is set", reports.size());
+        });
+    h_sizer->AddSpacer(10);
+    h_sizer->Add(m_MarkChangesBtn);
+
+    m_PlotDialog = new CanSignalPlotDialog(this);
+    m_PlotSignalsBtn = new wxButton(this, wxID_ANY, wxT("Plot signals"), wxDefaultPosition, wxDefaultSize, 0);
+    m_PlotSignalsBtn->SetToolTip("Plot mapped signals of Frame IDs in SignalSeriesIds setting");
+    m_PlotSignalsBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            m_PlotDialog->ShowDialog();
+        });
+    h_sizer->AddSpacer(10);
+    h_sizer->Add(m_PlotSignalsBtn);
+
     h_sizer->AddSpacer(10);
     h_sizer->Add(new wxStaticText(this, wxID_ANY, "LogLevel:"));
     m_LogLevelCtrl = new wxSpinCtrl(this, ID_CanLogLevelSpinCtrl, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 10, 1);
@@ -131,8 +191,51 @@ CanLogPanel::CanLogPanel(wxWindow* parent)
 #endif
         });
 
+    m_RecordingSaveCompressed = new wxButton(this, wxID_ANY, "Save compressed", wxDefaultPosition, wxDefaultSize);
+    m_RecordingSaveCompressed->SetToolTip("Save recording to file in compressed format, for archiving long recordings");
+    m_RecordingSaveCompressed->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+#ifdef _WIN32
+            const auto now = std::chrono::current_zone()->to_local(std::chrono::system_clock::now());
+
+            if(!std::filesystem::exists("Can"))
+                std::filesystem::create_directory("Can");
+            std::string log_format = std::format("Can/CanLog_{:%Y.%m.%d_%H_%M_%OS}{}", now, CAN_RECORDING_EXTENSION);
+            std::filesystem::path p(log_format);
+
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            can_handler->SaveRecordingToFile(p);
+#endif
+        });
+
+    m_RecordingImport = new wxButton(this, wxID_ANY, "Import log", wxDefaultPosition, wxDefaultSize);
+    m_RecordingImport->SetToolTip("Replace recording with a candump, Vector ASC or compressed log");
+    m_RecordingImport->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            wxFileDialog openFileDialog(this, _("Import CAN log"), "", "", 
+                "CAN logs (*.log;*.asc;*.canrec)|*.log;*.asc;*.canrec|candump logs (*.log)|*.log|Vector ASC logs (*.asc)|*.asc|Compressed recordings (*.canrec)|*.canrec|All files (*.*)|*.*", 
+                wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+            if(openFileDialog.ShowModal() == wxID_CANCEL)
+                return;
+
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            if(can_handler->IsImportRunning())
+            {
+                wxMessageDialog(this, "Wait until the previous import is finished", "Import is running", wxOK | wxICON_WARNING).ShowModal();
+                return;
+            }
+            ClearRecordingsFromGrid();
+            std::filesystem::path p = openFileDialog.GetPath().ToStdString();
+            can_handler->ImportRecording(p);
+        });
+
+    wxBoxSizer* save_sizer = new wxBoxSizer(wxHORIZONTAL);
+    save_sizer->Add(m_RecordingSave);
+    save_sizer->Add(m_RecordingSaveCompressed);
+    save_sizer->Add(m_RecordingImport);
+
     v_sizer->Add(h_sizer);
-    v_sizer->Add(m_RecordingSave);
+    v_sizer->Add(save_sizer);
     v_sizer->Add(static_box);
 
     SetSizerAndFit(v_sizer);
@@ -143,127 +246,101 @@ void CanLogPanel::On10MsTimer()
 {
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
     static std::string last_search_pattern;
-    static uint64_t last_tx_cnt = 0, last_rx_cnt = 0;
+    static uint64_t last_tx_cnt = 0, last_rx_cnt = 0, last_tx_dropped = 0;
 
+    uint64_t tx_dropped = CanSerialPort::Get()->GetTxQueue().GetCounters().GetDropped();
+    wxString tx_dropped_str = tx_dropped ? wxString::Format(", TX dropped: %lld", tx_dropped) : wxString();
     if(search_pattern.empty())
     {
-        if(last_tx_cnt != can_handler->GetTxFrameCount() || last_rx_cnt != can_handler->GetRxFrameCount())
+        if(last_tx_cnt != can_handler->GetTxFrameCount() || last_rx_cnt != can_handler->GetRxFrameCount() || last_tx_dropped != tx_dropped)
         {
-            static_box->GetStaticBox()->SetLabelText(wxString::Format("Log :: TX: %lld, RX: %lld, Total: %lld", can_handler->GetTxFrameCount(), can_handler->GetRxFrameCount(),
-                can_handler->GetTxFrameCount() + can_handler->GetRxFrameCount()));
+            static_box->GetStaticBox()->SetLabelText(wxString::Format("Log :: TX: %lld, RX: %lld, Total: %lld%s", can_handler->GetTxFrameCount(), can_handler->GetRxFrameCount(),
+                can_handler->GetTxFrameCount() + can_handler->GetRxFrameCount(), tx_dropped_str));
         }
     }
     else
     {
-        if(last_tx_cnt != can_handler->GetTxFrameCount() || last_rx_cnt != can_handler->GetRxFrameCount() || last_search_pattern != search_pattern)
+        if(last_tx_cnt != can_handler->GetTxFrameCount() || last_rx_cnt != can_handler->GetRxFrameCount() || last_tx_dropped != tx_dropped || last_search_pattern != search_pattern)
         {
-            static_box->GetStaticBox()->SetLabelText(wxString::Format("Log :: Filter: %s, TX: %lld, RX: %lld, Total: %lld", search_pattern,
-                can_handler->GetTxFrameCount(), can_handler->GetRxFrameCount(), can_handler->GetTxFrameCount() + can_handler->GetRxFrameCount()));
+            static_box->GetStaticBox()->SetLabelText(wxString::Format("Log :: Filter: %s, TX: %lld, RX: %lld, Total: %lld%s", search_pattern,
+                can_handler->GetTxFrameCount(), can_handler->GetRxFrameCount(), can_handler->GetTxFrameCount() + can_handler->GetRxFrameCount(), tx_dropped_str));
         }
     }
 
     last_tx_cnt = can_handler->GetTxFrameCount();
     last_rx_cnt = can_handler->GetRxFrameCount();
+    last_tx_dropped = tx_dropped;
     last_search_pattern = search_pattern;
 
-    if(!can_handler->m_LogEntries.empty())
-    {
-        if(!is_something_inserted)
-            inserted_until = 0;
+    size_t log_size = can_handler->m_LogEntries.size();
+    if(log_size < inserted_until)  /* Recording has been cleared */
+        ClearRecordingsFromGrid();
 
-        auto it = can_handler->m_LogEntries.begin();
-        std::advance(it, inserted_until);
-        if(it == can_handler->m_LogEntries.end())
-        {
-            //DBG("shit happend");
-            return;
-        }
+    uint64_t comment_version = can_handler->GetCommentVersion();
+    if(comment_version != m_CommentVersion)  /* Cached comment matches are stale, filtered rows are rebuilt */
+    {
+        m_CommentVersion = comment_version;
+        if(!m_Filter.IsEmpty())
+            ClearRecordingsFromGrid();
+    }
 
-        if(it != can_handler->m_LogEntries.end())
+    if(m_Filter.IsEmpty())
+    {
+        m_Table->SetLogSize(log_size);
+    }
+    else if(inserted_until == 0 && !m_Filter.GetIdList().empty())
+    {
+        InsertFilteredFromIndex(log_size);
+    }
+    else
+    {
+        CanLogCommentProvider get_comment = [](uint32_t frame_id, uint8_t direction) { return CanLogGridTable::GetComment(frame_id, direction); };
+        for(; inserted_until != log_size; inserted_until++)
         {
-            for(; it != can_handler->m_LogEntries.end(); ++it)
-            {
-                std::string comment;
-                if((*it)->direction == 1)
-                {
-                    auto comment_it = can_handler->rx_entry_comment.find((*it)->frame_id);
-                    if(comment_it != can_handler->rx_entry_comment.end())
-                    {
-                        comment = comment_it->second;
-                    }
-                }
-                else
-                {
-                    for(auto& i : can_handler->entries)
-                    {
-                        if(i->id == (*it)->frame_id)
-                        {
-                            comment = i->comment;
-                            break;
-                        }
-                    }
-                }
-
-                bool insert_row = false;
-                if(search_pattern.empty())
-                {
-                    insert_row = true;
-                }
-                else
-                {
-                    if(boost::icontains(comment, search_pattern))
-                        insert_row = true;
-                }
-
-                if(insert_row)
-                    InsertRow((*it)->last_execution, (*it)->direction, (*it)->frame_id, (*it)->data, comment);
-                inserted_until++;
-            }
-            //inserted_until = std::distance(can_handler->m_LogEntries.begin(), it);
-            is_something_inserted = true;
+            const CanLogEntry& entry = can_handler->m_LogEntries[inserted_until];
+            if(m_Filter.Match(entry.frame_id, entry.direction, entry.data.data(), entry.data.size(), get_comment))
+                m_Table->AddFilteredRow(static_cast<uint32_t>(inserted_until));
         }
     }
+    inserted_until = log_size;
+
+    if(m_Table->SyncRows() && m_AutoScroll)
+        m_grid->MakeCellVisible(m_Table->GetNumberRows() - 1, CanLogGridCol::Log_Time);
 }
 
-void CanLogPanel::InsertRow(std::chrono::steady_clock::time_point& t1, uint8_t direction, uint32_t id, std::vector<uint8_t>& data, std::string& comment)
+void CanLogPanel::ClearRecordingsFromGrid()
 {
-    int num_rows = m_grid->GetNumberRows();
-    if(num_rows <= cnt)
-        m_grid->AppendRows(1);
+    m_Table->Clear();
+    m_Table->SetFiltered(!m_Filter.IsEmpty());
+    m_Filter.InvalidateCache();
+    inserted_until = 0;
+}
 
+void CanLogPanel::InsertFilteredFromIndex(size_t log_size)
+{
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - can_handler->GetStartTime()).count();
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_Time), wxString::Format("%.3lf", static_cast<double>(elapsed) / 1000.0));
-
-    std::string hex;
-    utils::ConvertHexBufferToString(data, hex);
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_Data), hex);
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_Direction), direction == CAN_LOG_DIR_TX ? "TX" : "RX");
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_Id), wxString::Format("%X", id));
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_DataSize), wxString::Format("%lld", data.size()));
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanLogGridCol::Log_Comment), comment);
-
-    if(m_AutoScroll)
-        m_grid->ScrollLines(num_rows);
-
-    for(uint8_t i = 0; i != CanLogGridCol::Log_Max; i++)
+    std::vector<uint32_t> offsets;
     {
-        m_grid->SetReadOnly(cnt, i, true);
-        m_grid->SetCellBackgroundColour(cnt, i, (direction == CAN_LOG_DIR_RX) ? 0xE6E6E6 : 0xFFFFFF);
+        /* Index is modified by the RX path, the frames can be read after unlocking */
+        std::scoped_lock lock{ can_handler->m };
+        for(auto& frame_id : m_Filter.GetIdList())
+        {
+            CanLogOffsets frame_offsets = can_handler->m_LogEntries.GetOffsetsForFrame(frame_id);
+            offsets.insert(offsets.end(), frame_offsets.begin(), frame_offsets.end());
+        }
     }
+    std::sort(offsets.begin(), offsets.end());
 
-    cnt++;
-}
+    CanLogCommentProvider get_comment = [](uint32_t frame_id, uint8_t direction) { return CanLogGridTable::GetComment(frame_id, direction); };
 
-void CanLogPanel::ClearRecordingsFromGrid()
-{
-    int num_rows = m_grid->GetNumberRows();
-    if(num_rows)
-        m_grid->DeleteRows(0, num_rows);
-    cnt = 0;
-
-    is_something_inserted = false;
-    inserted_until = 0;
+    for(auto& offset : offsets)
+    {
+        if(offset >= log_size)  /* Frame has been added after log_size was read, it's handled by the next timer tick */
+            continue;
+        const CanLogEntry& entry = can_handler->m_LogEntries[offset];
+        if(m_Filter.Match(entry.frame_id, entry.direction, entry.data.data(), entry.data.size(), get_comment))
+            m_Table->AddFilteredRow(offset);
+    }
 }
 
 void CanLogPanel::OnKeyDown(wxKeyEvent& evt)
@@ -285,8 +362,17 @@ void CanLogPanel::OnKeyDown(wxKeyEvent& evt)
                         std::string new_search_pattern = d.GetValue().ToStdString();
                         if(new_search_pattern != search_pattern)
                         {
-                            search_pattern = new_search_pattern;
-                            ClearRecordingsFromGrid();
+                            std::string error;
+                            if(!m_Filter.Compile(new_search_pattern, error))
+                            {
+                                wxMessageDialog(this, error, "Invalid filter", wxOK | wxICON_ERROR).ShowModal();
+                                m_Filter.Compile(search_pattern, error);  /* Keep the previous filter */
+                            }
+                            else
+                            {
+                                search_pattern = new_search_pattern;
+                                ClearRecordingsFromGrid();
+                            }
                         }
                     }
                 }
@@ -339,6 +425,144 @@ void CanLogPanel::OnSize(wxSizeEvent& evt)
     evt.Skip(true);
 }
 
+CanLogGridTable::CanLogGridTable()
+{
+
+}
+
+wxString CanLogGridTable::GetValue(int row, int col)
+{
+    const CanLogEntry& entry = GetEntry(row);
+    switch(col)
+    {
+        case CanLogGridCol::Log_Time:
+        {
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(entry.last_execution - can_handler->GetStartTime()).count();
+            return wxString::Format("%.3lf", static_cast<double>(elapsed) / 1000.0);
+        }
+        case CanLogGridCol::Log_Direction:
+            return entry.direction == CAN_LOG_DIR_TX ? "TX" : "RX";
+        case CanLogGridCol::Log_Id:
+            return wxString::Format("%X", static_cast<uint32_t>(entry.frame_id));
+        case CanLogGridCol::Log_DataSize:
+            return wxString::Format("%lld", entry.data.size());
+        case CanLogGridCol::Log_Data:
+        {
+            std::string hex;
+            utils::ConvertHexBufferToString(entry.data, hex);
+            return hex;
+        }
+        case CanLogGridCol::Log_Comment:
+            return GetComment(entry);
+    }
+    return wxEmptyString;
+}
+
+wxString CanLogGridTable::GetColLabelValue(int col)
+{
+    static const char* labels[CanLogGridCol::Log_Max] = { "Time", "Direction", "Id", "Size", "Data", "Comment" };
+    return (col >= 0 && col < CanLogGridCol::Log_Max) ? labels[col] : "";
+}
+
+const CanLogEntry& CanLogGridTable::GetEntry(int row) const
+{
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    return can_handler->m_LogEntries[m_IsFiltered ? m_Filtered[row] : static_cast<size_t>(row)];
+}
+
+std::string CanLogGridTable::GetComment(const CanLogEntry& entry)
+{
+    return GetComment(entry.frame_id, entry.direction);
+}
+
+std::string CanLogGridTable::GetComment(uint32_t frame_id, uint8_t direction)
+{
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    if(direction == CAN_LOG_DIR_RX)
+    {
+        auto comment_it = can_handler->rx_entry_comment.find(frame_id);
+        if(comment_it != can_handler->rx_entry_comment.end())
+            return comment_it->second;
+    }
+    else
+    {
+        for(auto& i : can_handler->entries)
+        {
+            if(i->id == frame_id)
+                return i->comment;
+        }
+    }
+    return {};
+}
+
+void CanLogGridTable::SetLogSize(size_t log_size)
+{
+    m_LogSize = log_size;
+}
+
+void CanLogGridTable::SetFiltered(bool is_filtered)
+{
+    m_IsFiltered = is_filtered;
+}
+
+size_t CanLogGridTable::SyncRows()
+{
+    size_t rows = m_IsFiltered ? m_Filtered.size() : m_LogSize;
+    if(rows <= m_RowCount)
+        return 0;
+
+    size_t new_rows = rows - m_RowCount;
+    m_RowCount = rows;
+    if(GetView())
+    {
+        wxGridTableMessage msg(this, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, static_cast<int>(new_rows));
+        GetView()->ProcessTableMessage(msg);
+    }
+    return new_rows;
+}
+
+void CanLogGridTable::Clear()
+{
+    size_t rows = m_RowCount;
+    m_RowCount = 0;
+    m_LogSize = 0;
+    m_Filtered.clear();
+    if(rows && GetView())
+    {
+        wxGridTableMessage msg(this, wxGRIDTABLE_NOTIFY_ROWS_DELETED, 0, static_cast<int>(rows));
+        GetView()->ProcessTableMessage(msg);
+    }
+}
+
+CanLogGridAttrProvider::CanLogGridAttrProvider(CanLogGridTable& table) :
+    m_Table(table)
+{
+    m_TxAttr = new wxGridCellAttr();
+    m_TxAttr->SetBackgroundColour(0xFFFFFF);
+    m_TxAttr->SetReadOnly(true);
+
+    m_RxAttr = new wxGridCellAttr();
+    m_RxAttr->SetBackgroundColour(0xE6E6E6);
+    m_RxAttr->SetReadOnly(true);
+}
+
+CanLogGridAttrProvider::~CanLogGridAttrProvider()
+{
+    m_TxAttr->DecRef();
+    m_RxAttr->DecRef();
+}
+
+wxGridCellAttr* CanLogGridAttrProvider::GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind) const
+{
+    if(row < 0 || row >= m_Table.GetNumberRows())
+        return wxGridCellAttrProvider::GetAttr(row, col, kind);
+
+    wxGridCellAttr* attr = m_Table.GetEntry(row).direction == CAN_LOG_DIR_RX ? m_RxAttr : m_TxAttr;
+    attr->IncRef();  /* Caller releases it */
+    return attr;
+}
+
 wxBEGIN_EVENT_TABLE(CanLogForFrameDialog, wxDialog)
 EVT_BUTTON(wxID_APPLY, CanLogForFrameDialog::OnApply)
 wxEND_EVENT_TABLE()
@@ -5,6 +5,8 @@
 
 #include <chrono>
 
+#include "../../CanLogFilter.hpp"
+
 enum CanLogGridCol : int
 {
     Log_Time,
@@ -17,13 +19,85 @@ enum CanLogGridCol : int
 };
 
 class CanLogEntry;
+class CanSignalPlotDialog;
+class CanLogGridTable : public wxGridTableBase
+{
+public:
+    CanLogGridTable();
+
+    int GetNumberRows() override { return static_cast<int>(m_RowCount); }
+    int GetNumberCols() override { return CanLogGridCol::Log_Max; }
+    wxString GetValue(int row, int col) override;
+    void SetValue(int row, int col, const wxString& value) override { }  /* Log is read-only */
+    bool IsEmptyCell(int row, int col) override { return false; }
+    wxString GetColLabelValue(int col) override;
+
+    // !\brief Get logged frame of a row
+    const CanLogEntry& GetEntry(int row) const;
+
+    // !\brief Get comment of logged frame from TX or RX list
+    static std::string GetComment(const CanLogEntry& entry);
+
+    // !\brief Get comment of a frame from TX or RX list
+    // !\param frame_id [in] CAN Frame ID
+    // !\param direction [in] Direction (CAN_LOG_DIR_TX or CAN_LOG_DIR_RX)
+    static std::string GetComment(uint32_t frame_id, uint8_t direction);
+
+    // !\brief Show every frame of the log
+    // !\param log_size [in] Number of frames in the log
+    void SetLogSize(size_t log_size);
+
+    // !\brief Show only the added frames
+    void SetFiltered(bool is_filtered);
+
+    // !\brief Add frame to the filtered view
+    // !\param offset [in] Offset of the frame in the log
+    void AddFilteredRow(uint32_t offset) { m_Filtered.push_back(offset); }
+
+    // !\brief Notify the grid about the rows added since the last call
+    // !\return Number of new rows
+    size_t SyncRows();
+
+    // !\brief Remove every row
+    void Clear();
+
+private:
+    // !\brief Number of rows known by the grid
+    size_t m_RowCount = 0;
+
+    // !\brief Number of frames in the log, when it isn't filtered
+    size_t m_LogSize = 0;
+
+    // !\brief Is the view filtered?
+    bool m_IsFiltered = false;
+
+    // !\brief Offsets of frames in filtered view
+    std::vector<uint32_t> m_Filtered;
+};
+
+class CanLogGridAttrProvider : public wxGridCellAttrProvider
+{
+public:
+    CanLogGridAttrProvider(CanLogGridTable& table);
+    ~CanLogGridAttrProvider();
+
+    wxGridCellAttr* GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind) const override;
+
+private:
+    // !\brief Table which rows are styled
+    CanLogGridTable& m_Table;
+
+    // !\brief Shared attributes of TX and RX rows
+    wxGridCellAttr* m_TxAttr = nullptr;
+    wxGridCellAttr* m_RxAttr = nullptr;
+};
+
 class CanLogPanel : public wxPanel
 {
 public:
     CanLogPanel(wxWindow* parent);
 
     void On10MsTimer();
-    void InsertRow(std::chrono::steady_clock::time_point& t1, uint8_t direction, uint32_t id, std::vector<uint8_t>& data, std::string& comment);
     void UpdatePanel();
 
     wxGrid* m_grid = nullptr;
@@ -35,7 +109,9 @@ private:
     void OnSize(wxSizeEvent& evt);
     void ClearRecordingsFromGrid();
 
-    bool is_something_inserted = false;
+    // !\brief Build filtered view from the per-ID index of the log, used when the filter is a list of Frame IDs
+    void InsertFilteredFromIndex(size_t log_size);
+
     std::size_t inserted_until = 0;
     wxStaticBoxSizer* static_box = nullptr;
     wxButton* m_RecordingStart = nullptr;
@@ -43,11 +119,20 @@ private:
     wxButton* m_RecordingStop = nullptr;
     wxButton* m_RecordingClear = nullptr;
     wxButton* m_AutoScrollBtn = nullptr;
+    wxButton* m_CaptureBtn = nullptr;
+    wxButton* m_GatewayBtn = nullptr;
+    wxButton* m_MarkChangesBtn = nullptr;
+    wxButton* m_PlotSignalsBtn = nullptr;
     wxButton* m_RecordingSave = nullptr;
+    wxButton* m_RecordingSaveCompressed = nullptr;
+    wxButton* m_RecordingImport = nullptr;
     wxSpinCtrl* m_LogLevelCtrl = nullptr;
 
-    size_t cnt = 0;
+    CanSignalPlotDialog* m_PlotDialog = nullptr;
+    CanLogGridTable* m_Table = nullptr;
     std::string search_pattern;
+    CanLogFilter m_Filter;
+    uint64_t m_CommentVersion = 0;  /* Comment version of CanEntryHandler the filtered rows were built with */
     bool m_AutoScroll = true;
     wxDECLARE_EVENT_TABLE();
 };
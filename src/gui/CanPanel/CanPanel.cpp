@@ -75,10 +75,11 @@ void CanPanel::SaveMapping()
 
 void CanPanel::On10MsTimer()
 {
+    sender->On10MsTimer();  /* Takes the snapshot of changed entries itself, the lock isn't held while its grids are updated */
+    script->On10MsTimer();
+
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
     std::scoped_lock lock{ can_handler->m };
-
-    sender->On10MsTimer();
     log->On10MsTimer();
 }
 
@@ -36,7 +36,7 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
     m_RunSelectedButton = new wxButton(this, wxID_ANY, wxT("Run selected"), wxDefaultPosition, wxDefaultSize, 0);
     h_sizer_2->Add(m_RunSelectedButton);
 
-    m_Abort = new wxButton(this, wxID_ANY, wxT("Abort"), wxDefaultPosition, wxDefaultSize, 0);
+    m_Abort = new wxButton(this, wxID_ANY, wxT("Abort all"), wxDefaultPosition, wxDefaultSize, 0);
     h_sizer_2->Add(m_Abort);
     m_Abort->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
         {
@@ -45,6 +45,22 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
             m_Script->AbortRunningScript();
         });
 
+    m_RunningScripts = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxSize(100, -1));
+    h_sizer_2->Add(m_RunningScripts);
+    m_AbortSelected = new wxButton(this, wxID_ANY, wxT("Abort"), wxDefaultPosition, wxDefaultSize, 0);
+    m_AbortSelected->Disable();
+    h_sizer_2->Add(m_AbortSelected);
+    m_AbortSelected->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            int sel = m_RunningScripts->GetSelection();
+            if(sel == wxNOT_FOUND || static_cast<size_t>(sel) >= m_RunningIds.size())
+            {
+                LOG(LogLevel::Warning, "No script is selected, nothing to abort");
+                return;
+            }
+            m_Script->AbortScript(m_RunningIds[sel]);
+        });
+
     h_sizer_2->AddSpacer(100);
 
     m_ClearButton = new wxButton(this, wxID_ANY, wxT("Clear"), wxDefaultPosition, wxDefaultSize, 0);
@@ -73,12 +89,6 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
 
     m_RunButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
         {
-            if(m_Script->IsScriptRunning())
-            {
-                wxMessageDialog(this, std::format("Click on abort to abort it, before running another one"), "A script is already running", wxOK).ShowModal();
-                return;
-            }
-
             wxString str = m_Input->GetValue();
             std::string input;
             if(!path.empty())
@@ -93,6 +103,8 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
                 input = str.mb_str();
             }
 
+            if(!m_Script->IsScriptRunning())  /* Scripts run side by side, keep the output of the running ones */
+                m_Output->Clear();
             try
             {
                 boost::algorithm::replace_all(input, "\r", "");  /* Thanks Windows */
@@ -109,8 +121,6 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
 #ifdef _WIN32
                 boost::algorithm::replace_all(input, "\n", "\r\n");  /* LF isn't enough for TextCtrl for some reason... */
 #endif
-                m_Output->Clear();
-                m_Output->SetValue("");
                 m_RunButton->SetForegroundColour(*wxBLACK);
             }
             else
@@ -122,12 +132,6 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
 
     m_RunSelectedButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
         {
-            if(m_Script->IsScriptRunning())
-            {
-                wxMessageDialog(this, std::format("Click on abort to abort it, before running another one"), "A script is already running", wxOK).ShowModal();
-                return;
-            }
-
             std::string input = m_Input->GetStringSelection().ToStdString();;
             if(input.empty())
             {
@@ -135,6 +139,8 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
                 return;
             }
 
+            if(!m_Script->IsScriptRunning())  /* Scripts run side by side, keep the output of the running ones */
+                m_Output->Clear();
             try
             {
                 boost::algorithm::replace_all(input, "\r", "");  /* Thanks Windows */
@@ -151,8 +157,6 @@ CanScriptPanel::CanScriptPanel(wxWindow* parent)
 #ifdef _WIN32
                 boost::algorithm::replace_all(input, "\n", "\r\n");  /* LF isn't enough for TextCtrl for some reason... */
 #endif
-                m_Output->Clear();
-                m_Output->SetValue("");
                 m_RunButton->SetForegroundColour(*wxBLACK);
             }
             else
@@ -174,6 +178,31 @@ void CanScriptPanel::AddToLog(std::string str)
         m_Output->AppendText(str);
 }
 
+void CanScriptPanel::On10MsTimer()
+{
+    std::vector<uint32_t> ids = m_Script->GetRunningScriptIds();
+    if(ids == m_RunningIds)
+        return;
+
+    /* Keep the selected script selected while the others start and finish */
+    uint32_t selected_id = 0;
+    int sel = m_RunningScripts->GetSelection();
+    if(sel != wxNOT_FOUND && static_cast<size_t>(sel) < m_RunningIds.size())
+        selected_id = m_RunningIds[sel];
+
+    m_RunningIds = std::move(ids);
+    m_RunningScripts->Clear();
+    for(size_t i = 0; i != m_RunningIds.size(); i++)
+    {
+        m_RunningScripts->Append(std::format("Script #{}", m_RunningIds[i]));
+        if(m_RunningIds[i] == selected_id)
+            m_RunningScripts->SetSelection(static_cast<int>(i));
+    }
+    if(m_RunningScripts->GetSelection() == wxNOT_FOUND && !m_RunningIds.empty())
+        m_RunningScripts->SetSelection(static_cast<int>(m_RunningIds.size() - 1));
+    m_AbortSelected->Enable(!m_RunningIds.empty());
+}
+
 void CanScriptPanel::OnFileDrop(wxDropFilesEvent& event)
 {
     if(event.GetNumberOfFiles() > 0)
@@ -36,12 +36,17 @@ private:
     wxButton* m_RunButton = nullptr;
     wxButton* m_RunSelectedButton = nullptr;
     wxButton* m_Abort = nullptr;
+    wxChoice* m_RunningScripts = nullptr;
+    wxButton* m_AbortSelected = nullptr;
     wxButton* m_ClearButton = nullptr;
     wxButton* m_ClearOutput = nullptr;
     wxFilePickerCtrl* m_FilePicker = nullptr;
 
     wxString path;
 
+    // !\brief IDs of running scripts listed in m_RunningScripts
+    std::vector<uint32_t> m_RunningIds;
+
     std::unique_ptr<CanScriptHandler> m_Script;
 
     wxDECLARE_EVENT_TABLE();
@@ -103,7 +103,7 @@ void CanGrid::AddRow(std::unique_ptr<CanTxEntry>& e)
     m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_Data), hex);
 
     m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_Period), wxString::Format("%d", e->period));
-    m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_Count), "0");
+    m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_Count), wxString::Format("%lld", e->count.load()));
     m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_LogLevel), wxString::Format("%d", e->log_level));
     m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_FavouriteLevel), wxString::Format("%d", e->favourite_level));
     m_grid->SetCellValue(wxGridCellCoords(cnt, CanSenderGridCol::Sender_Comment), e->comment);
@@ -164,19 +164,12 @@ void CanGrid::RemoveLastRow()
     grid_to_entry.erase(cnt);
 }
 
-void CanGrid::UpdateTxCounter(uint32_t frame_id, size_t count)
+void CanGrid::UpdateTxCounter(uint16_t row, size_t count)
 {
-    for(auto& i : grid_to_entry)
-    {
-        if(i.second->id == frame_id)
-        {
-            int max_rows = m_grid->GetNumberRows();
-            if(i.first < max_rows)
-                m_grid->SetCellValue(wxGridCellCoords(i.first, CanSenderGridCol::Sender_Count), wxString::Format("%lld", count));
-            else
-                DBG("invalid column");
-        }
-    }
+    if(row < m_grid->GetNumberRows())
+        m_grid->SetCellValue(wxGridCellCoords(row, CanSenderGridCol::Sender_Count), wxString::Format("%lld", count));
+    else
+        DBG("invalid column");
 }
 
 CanGridRx::CanGridRx(wxWindow* parent)
@@ -227,13 +220,13 @@ CanGridRx::CanGridRx(wxWindow* parent)
     m_grid->SetCellEditor(cnt, CanSenderGridCol::Sender_FavouriteLevel, new wxGridCellNumberEditor);
 }
 
-void CanGridRx::AddRow(std::unique_ptr<CanRxData>& e)
+int CanGridRx::AddRow(uint32_t frame_id)
 {
     m_grid->AppendRows(1);
     int num_row = m_grid->GetNumberRows() - 1;
     m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Period), "0");
     m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Count), "1");
-    rx_grid_to_entry[num_row] = e.get();
+    rx_id_to_row[frame_id] = num_row;
 
     for(uint8_t i = 0; i != CanSenderGridCol::Sender_Max; i++)
         m_grid->SetCellBackgroundColour(num_row, i, (num_row & 1) ? 0xE6E6E6 : 0xFFFFFF);
@@ -243,26 +236,27 @@ void CanGridRx::AddRow(std::unique_ptr<CanRxData>& e)
     m_grid->SetReadOnly(num_row, CanSenderGridCol::Sender_Data);
     m_grid->SetReadOnly(num_row, CanSenderGridCol::Sender_Period);
     m_grid->SetReadOnly(num_row, CanSenderGridCol::Sender_Count);
+    return num_row;
 }
 
-void CanGridRx::UpdateRow(int num_row, uint32_t frame_id, std::unique_ptr<CanRxData>& e, std::string& comment)
+void CanGridRx::UpdateRow(int num_row, const CanRxSnapshot& e)
 {
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Id), wxString::Format("%X", frame_id));
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_DataSize), wxString::Format("%lld", e->data.size()));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Id), wxString::Format("%X", e.frame_id));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_DataSize), wxString::Format("%lld", e.data.size()));
 
     std::string hex;
-    utils::ConvertHexBufferToString(e->data, hex);
+    utils::ConvertHexBufferToString(e.data, hex);
     m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Data), hex);
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Period), wxString::Format("%d", e->period));
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Count), wxString::Format("%lld", e->count));
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_LogLevel), wxString::Format("%d", e->log_level));
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_FavouriteLevel), wxString::Format("%d", e->favourite_level));
-    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Comment), comment);
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Period), wxString::Format("%d", e.period));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Count), wxString::Format("%lld", e.count));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_LogLevel), wxString::Format("%d", e.log_level));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_FavouriteLevel), wxString::Format("%d", e.favourite_level));
+    m_grid->SetCellValue(wxGridCellCoords(num_row, CanSenderGridCol::Sender_Comment), e.comment);
 }
 
 void CanGridRx::ClearGrid()
 {
-    rx_grid_to_entry.clear();  /* Clear entrie RX grid */
+    rx_id_to_row.clear();  /* Clear entrie RX grid */
     cnt = 0;
     if(m_grid->GetNumberRows())
         m_grid->DeleteRows(0, m_grid->GetNumberRows());
@@ -276,6 +270,7 @@ CanSenderPanel::CanSenderPanel(wxWindow* parent)
     m_BitfieldEditor = new BitEditorDialog(this);
     m_LogForFrame = new CanLogForFrameDialog(this);
     m_UdsRawDialog = new CanUdsRawDialog(this);
+    m_StressDialog = new CanStressDialog(this);
     m_StyleEditDialog = new CanSenderEditDialog(this);
 
     {
@@ -600,6 +595,14 @@ CanSenderPanel::CanSenderPanel(wxWindow* parent)
             });
         h_sizer_2->Add(m_SendIsoTp);
 
+        m_Stress = new wxButton(this, wxID_ANY, "Stress test", wxDefaultPosition, wxDefaultSize);
+        m_Stress->SetToolTip("Generate frames with high rate or bus load, random or incrementing IDs and data, or mutated frames of the recording");
+        m_Stress->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+            {
+                m_StressDialog->ShowDialog();
+            });
+        h_sizer_2->Add(m_Stress);
+
         bSizer1->Add(h_sizer_2);
 
         wxBoxSizer* h_sizer_3 = new wxBoxSizer(wxHORIZONTAL);
@@ -608,10 +611,7 @@ CanSenderPanel::CanSenderPanel(wxWindow* parent)
         m_ClearRx->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
             {
                 std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-                {
-                    std::scoped_lock lock{ can_handler->m };
-                    can_handler->m_rxData.clear();
-                }
+                can_handler->ClearRxEntries();
                 can_grid_rx->ClearGrid();
             });
         h_sizer_3->Add(m_ClearRx);
@@ -625,61 +625,42 @@ CanSenderPanel::CanSenderPanel(wxWindow* parent)
 
 void CanSenderPanel::On10MsTimer()
 {
+    /* Only entries which changed since the last refresh are touched, so the grid work doesn't depend on the bus load */
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    if(search_pattern_rx.empty())
+    can_handler->TakeChangedTxIds(m_ChangedTxIds);
+
+    if(!m_ChangedTxIds.empty())
     {
-        for(auto& entry : can_handler->m_rxData)
+        for(auto& i : can_grid_tx->grid_to_entry)
         {
-            bool found_in_grid = false;
-            for(auto& i : can_grid_rx->rx_grid_to_entry)
-            {
-                if(can_grid_rx->rx_grid_to_entry[i.first] == entry.second.get())
-                {
-                    std::string comment;
-                    auto it = can_handler->rx_entry_comment.find(entry.first);
-                    if(it != can_handler->rx_entry_comment.end())
-                        comment = it->second;
-                    can_grid_rx->UpdateRow(i.first, entry.first, entry.second, comment);
-
-                    found_in_grid = true;
-                    break;
-                }
-            }
-
-            if(!found_in_grid)
-            {
-                can_grid_rx->AddRow(entry.second);
-            }
+            if(m_ChangedTxIds.contains(i.second->id))
+                can_grid_tx->UpdateTxCounter(i.first, i.second->count);
         }
     }
-    else
+
+    /* RX entries are read from the published snapshot without locking the handler */
+    std::shared_ptr<const CanRxSnapshotTable> rx_snapshot = can_handler->GetRxSnapshot();
+    if(rx_snapshot->version == m_RxSnapshotVersion)
+        return;
+
+    if(rx_snapshot->rebuild_version > m_RxSnapshotVersion)  /* Entries were removed */
     {
-        for(auto& entry : can_handler->m_rxData)
-        {
-            std::string comment;
-            auto it = can_handler->rx_entry_comment.find(entry.first);
-            if(it != can_handler->rx_entry_comment.end())
-                comment = it->second;
-            if(boost::icontains(comment, search_pattern_rx))
-            {
-                bool found_in_grid = false;
-                for(auto& i : can_grid_rx->rx_grid_to_entry)
-                {
-                    if(can_grid_rx->rx_grid_to_entry[i.first] == entry.second.get())
-                    {
-                        can_grid_rx->UpdateRow(i.first, entry.first, entry.second, comment);
-                        found_in_grid = true;
-                        break;
-                    }
-                }
+        can_grid_rx->ClearGrid();
+        m_RxSnapshotVersion = 0;
+    }
 
-                if(!found_in_grid)
-                {
-                    can_grid_rx->AddRow(entry.second);
-                }
-            }
-        }
+    for(auto& [frame_id, entry] : rx_snapshot->entries)
+    {
+        if(entry.version <= m_RxSnapshotVersion)
+            continue;
+        if(!search_pattern_rx.empty() && !boost::icontains(entry.comment, search_pattern_rx))
+            continue;
+
+        auto it = can_grid_rx->rx_id_to_row.find(frame_id);
+        int row = it != can_grid_rx->rx_id_to_row.end() ? it->second : can_grid_rx->AddRow(frame_id);
+        can_grid_rx->UpdateRow(row, entry);
     }
+    m_RxSnapshotVersion = rx_snapshot->version;
 }
 
 void CanSenderPanel::RefreshSubpanels()
@@ -723,13 +704,21 @@ void CanSenderPanel::RefreshTx()
 void CanSenderPanel::RefreshRx()
 {
     std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-    std::scoped_lock lock{ can_handler->m };
+    std::vector<std::pair<int, std::string>> comments;  /* Copied, so the lock isn't held while the grid is updated */
+    {
+        std::scoped_lock lock{ can_handler->m };
+        comments.reserve(can_grid_rx->rx_id_to_row.size());
+        for(auto& [frame_id, row] : can_grid_rx->rx_id_to_row)
+        {
+            auto it = can_handler->rx_entry_comment.find(frame_id);
+            comments.emplace_back(row, it != can_handler->rx_entry_comment.end() ? it->second : "");
+        }
+    }
 
-    for(int i = 0; i != can_grid_rx->m_grid->GetNumberRows(); i++)
+    for(auto& [row, comment] : comments)
     {
-        uint32_t frame_id = std::stoi(can_grid_rx->m_grid->GetCellValue(wxGridCellCoords(i, CanSenderGridCol::Sender_Id)).ToStdString(), nullptr, 16);
-        auto it = can_handler->rx_entry_comment.find(frame_id);
-        can_grid_rx->m_grid->SetCellValue(wxGridCellCoords(i, CanSenderGridCol::Sender_Comment), it != can_handler->rx_entry_comment.end() ? it->second : "");
+        if(can_grid_rx->m_grid->GetCellValue(wxGridCellCoords(row, CanSenderGridCol::Sender_Comment)) != comment)
+            can_grid_rx->m_grid->SetCellValue(wxGridCellCoords(row, CanSenderGridCol::Sender_Comment), comment);
     }
 }
 
@@ -794,8 +783,7 @@ void CanSenderPanel::OnCellValueChanged(wxGridEvent& ev)
                 uint32_t frame_id = std::stoi(frame_str.ToStdString(), nullptr, 16);
 
                 std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
-                std::scoped_lock lock{ can_handler->m };
-                can_handler->rx_entry_comment[frame_id] = std::move(new_value.ToStdString());
+                can_handler->SetRxComment(frame_id, new_value.ToStdString());
                 break;
             }
         }
@@ -909,6 +897,7 @@ void CanSenderPanel::OnCellValueChanged(wxGridEvent& ev)
             case CanSenderGridCol::Sender_Comment:
             {
                 can_grid_tx->grid_to_entry[row]->comment = std::move(new_value.ToStdString());
+                wxGetApp().can_entry->OnTxCommentChanged();
                 break;
             }
         }
@@ -990,7 +979,7 @@ void CanSenderPanel::OnCellRightClick(wxGridEvent& ev)
                 wxString frame_str = can_grid_rx->m_grid->GetCellValue(row, CanSenderGridCol::Sender_Id);
                 uint32_t frame_id = std::stoi(frame_str.ToStdString(), nullptr, 16);
 
-                can_handler->m_rxData.erase(frame_id);  /* Remove this entry from CanEntryHandler's map */
+                can_handler->RemoveRxEntry(frame_id);  /* The remaining ones are added back from the next snapshot */
                 can_grid_rx->ClearGrid();
                 break;
             }
@@ -1311,11 +1300,8 @@ void CanSenderPanel::OnKeyDown(wxKeyEvent& evt)
                         else
                             static_box_rx->GetStaticBox()->SetLabelText(wxString::Format("Receive - Search filter: %s", search_pattern_rx));
 
-                        if(can_grid_rx->m_grid->GetNumberRows())
-                            can_grid_rx->m_grid->DeleteRows(0, can_grid_rx->m_grid->GetNumberRows());
-                        can_grid_rx->cnt = 0;
-                        can_grid_rx->rx_grid_to_entry.clear();
-                        RefreshRx();
+                        can_grid_rx->ClearGrid();
+                        m_RxSnapshotVersion = 0;  /* Rows matching the new filter are added from the snapshot at the next refresh */
                     }
                     return;
                 }
@@ -6,13 +6,17 @@
 #include <wx/fontpicker.h>
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 class CanTxEntry;
 class CanRxData;
+class CanRxSnapshot;
 class CanByteEditorDialog;
 class BitEditorDialog;
 class CanLogForFrameDialog;
 class CanUdsRawDialog;
+class CanStressDialog;
 class CanSenderEditDialog;
 class CanMap;
 class IResultPanel;
@@ -38,7 +42,7 @@ public:
     void AddRow(wxString id, wxString dlc, wxString data, wxString period, wxString count, wxString loglevel, wxString comment);
     void AddRow(std::unique_ptr<CanTxEntry>& e);
     void RemoveLastRow();
-    void UpdateTxCounter(uint32_t frame_id, size_t count);
+    void UpdateTxCounter(uint16_t row, size_t count);
     wxGrid* m_grid = nullptr;
 
     std::map<uint16_t, CanTxEntry*> grid_to_entry;  /* Helper map for storing an additional ID to CanTxEntry */
@@ -51,12 +55,12 @@ class CanGridRx
 public:
     CanGridRx(wxWindow* parent);
 
-    void AddRow(std::unique_ptr<CanRxData>& e);
-    void UpdateRow(int num_row, uint32_t frame_id, std::unique_ptr<CanRxData>& e, std::string& comment);
+    int AddRow(uint32_t frame_id);
+    void UpdateRow(int num_row, const CanRxSnapshot& e);
     void ClearGrid();
 
     wxGrid* m_grid = nullptr;
-    std::map<uint16_t, CanRxData*> rx_grid_to_entry;  /* Helper map for storing an additional ID to CanRxData */
+    std::unordered_map<uint32_t, int> rx_id_to_row;  /* [frame_id] = row */
 
     size_t cnt = 0;
 };
@@ -112,6 +116,7 @@ private:
     wxButton* m_Edit = nullptr;
     wxButton* m_SendDataFrame = nullptr;
     wxButton* m_SendIsoTp = nullptr;
+    wxButton* m_Stress = nullptr;
     wxButton* m_ClearRx = nullptr;
 
     std::string m_LastDataInput;
@@ -120,6 +125,7 @@ private:
     BitEditorDialog* m_BitfieldEditor = nullptr;
     CanLogForFrameDialog* m_LogForFrame = nullptr;
     CanUdsRawDialog* m_UdsRawDialog = nullptr;
+    CanStressDialog* m_StressDialog = nullptr;
     CanSenderEditDialog* m_StyleEditDialog = nullptr;
 
     wxString file_path_tx;
@@ -129,6 +135,9 @@ private:
     std::string search_pattern_tx;
     std::string search_pattern_rx;
 
+    std::unordered_set<uint32_t> m_ChangedTxIds;  /* Reused between refreshes to avoid allocations */
+    uint64_t m_RxSnapshotVersion = 0;  /* Version of the last RX snapshot shown in the grid */
+
     wxDECLARE_EVENT_TABLE();
 };
 
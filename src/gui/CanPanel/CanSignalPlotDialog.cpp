@@ -0,0 +1,228 @@
+#include "pch.hpp"
+
+/* Refresh period when following live data, ~60 FPS */
+constexpr int CAN_SIGNAL_PLOT_REFRESH_MS = 16;
+
+/* Shortest and longest time window in microseconds */
+constexpr int64_t CAN_SIGNAL_PLOT_MIN_SPAN = 1000;
+constexpr int64_t CAN_SIGNAL_PLOT_MAX_SPAN = 1000000LL * 3600 * 24 * 7;
+
+wxBEGIN_EVENT_TABLE(CanSignalPlotDialog, wxDialog)
+EVT_CLOSE(CanSignalPlotDialog::OnClose)
+wxEND_EVENT_TABLE()
+
+CanSignalPlotDialog::CanSignalPlotDialog(wxWindow* parent)
+    : wxDialog(parent, wxID_ANY, "CAN Signal Plot", wxDefaultPosition, wxDefaultSize, wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER | wxMAXIMIZE_BOX)
+{
+    sizerTop = new wxBoxSizer(wxVERTICAL);
+
+    wxBoxSizer* h_sizer = new wxBoxSizer(wxHORIZONTAL);
+    h_sizer->Add(new wxStaticText(this, wxID_ANY, "Signal:"), wxSizerFlags().CenterVertical());
+    m_SignalChoice = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxSize(250, -1));
+    m_SignalChoice->SetToolTip("Signals of Frame IDs in SignalSeriesIds setting");
+    m_SignalChoice->Bind(wxEVT_CHOICE, [this](wxCommandEvent& event)
+        {
+            m_Canvas->Refresh();
+        });
+    h_sizer->Add(m_SignalChoice);
+
+    h_sizer->AddSpacer(10);
+    m_FollowCheck = new wxCheckBox(this, wxID_ANY, "Follow");
+    m_FollowCheck->SetToolTip("Keep the newest point on the right side, dragging turns it off");
+    m_FollowCheck->SetValue(true);
+    m_FollowCheck->Bind(wxEVT_CHECKBOX, [this](wxCommandEvent& event)
+        {
+            SetFollowing(m_FollowCheck->GetValue());
+        });
+    h_sizer->Add(m_FollowCheck, wxSizerFlags().CenterVertical());
+    sizerTop->Add(h_sizer, wxSizerFlags().Border());
+
+    m_Canvas = new wxPanel(this, wxID_ANY, wxDefaultPosition, wxSize(800, 400));
+    m_Canvas->SetBackgroundStyle(wxBG_STYLE_PAINT);
+    m_Canvas->SetToolTip("Mouse wheel: zoom, drag: pan");
+    m_Canvas->Bind(wxEVT_PAINT, &CanSignalPlotDialog::OnPaint, this);
+    m_Canvas->Bind(wxEVT_MOUSEWHEEL, &CanSignalPlotDialog::OnMouseWheel, this);
+    m_Canvas->Bind(wxEVT_MOTION, &CanSignalPlotDialog::OnMouseMotion, this);
+    m_Canvas->Bind(wxEVT_SIZE, [this](wxSizeEvent& event)
+        {
+            m_Canvas->Refresh();
+            event.Skip();
+        });
+    m_Canvas->Bind(wxEVT_LEFT_DOWN, [this](wxMouseEvent& event)
+        {
+            m_DragX = event.GetX();
+            m_DragEnd = m_End;
+            m_Canvas->CaptureMouse();
+        });
+    m_Canvas->Bind(wxEVT_LEFT_UP, [this](wxMouseEvent& event)
+        {
+            if(m_Canvas->HasCapture())
+                m_Canvas->ReleaseMouse();
+        });
+    m_Canvas->Bind(wxEVT_MOUSE_CAPTURE_LOST, [this](wxMouseCaptureLostEvent& event) { });
+    sizerTop->Add(m_Canvas, wxSizerFlags(1).Expand().Border());
+
+    sizerTop->Add(CreateStdDialogButtonSizer(wxCLOSE), wxSizerFlags().Right().Border());
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            Close();
+        }, wxID_CLOSE);
+
+    m_Timer = new wxTimer(this);
+    Bind(wxEVT_TIMER, &CanSignalPlotDialog::OnTimer, this, m_Timer->GetId());
+
+    SetAutoLayout(true);
+    SetSizer(sizerTop);
+    sizerTop->Fit(this);
+    sizerTop->SetSizeHints(this);
+    CentreOnScreen();
+}
+
+CanSignalPlotDialog::~CanSignalPlotDialog()
+{
+    m_Timer->Stop();
+    delete m_Timer;
+}
+
+void CanSignalPlotDialog::ShowDialog()
+{
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    std::vector<std::string> names = can_handler->GetSignalSeriesNames();
+
+    wxString selected = m_SignalChoice->GetStringSelection();
+    m_SignalChoice->Clear();
+    for(auto& i : names)
+        m_SignalChoice->Append(i);
+    if(!m_SignalChoice->SetStringSelection(selected) && !names.empty())
+        m_SignalChoice->SetSelection(0);
+
+    if(names.empty())
+        LOG(LogLevel::Warning, "No signals are recorded, add Frame IDs to SignalSeriesIds setting and load their mapping");
+
+    SetFollowing(m_FollowCheck->GetValue());
+    Show();
+    Raise();
+}
+
+void CanSignalPlotDialog::OnClose(wxCloseEvent& event)
+{
+    m_Timer->Stop();
+    Hide();  /* Dialog is reused */
+}
+
+void CanSignalPlotDialog::OnTimer(wxTimerEvent& event)
+{
+    if(IsShown())
+        m_Canvas->Refresh();
+}
+
+void CanSignalPlotDialog::SetFollowing(bool is_following)
+{
+    m_FollowCheck->SetValue(is_following);
+    if(is_following)
+        m_Timer->Start(CAN_SIGNAL_PLOT_REFRESH_MS);
+    else
+        m_Timer->Stop();
+    m_Canvas->Refresh();
+}
+
+void CanSignalPlotDialog::OnPaint(wxPaintEvent& event)
+{
+    wxAutoBufferedPaintDC dc(m_Canvas);
+    dc.SetBackground(*wxWHITE_BRUSH);
+    dc.Clear();
+
+    wxSize size = m_Canvas->GetClientSize();
+    int selection = m_SignalChoice->GetSelection();
+    if(selection == wxNOT_FOUND || size.x < 10 || size.y < 10)
+        return;
+
+    std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+    int64_t first = 0, last = 0;
+    if(!can_handler->GetSignalSeriesTimeRange(static_cast<size_t>(selection), first, last))
+    {
+        dc.DrawText("No data", 10, 10);
+        return;
+    }
+
+    if(m_FollowCheck->GetValue())
+        m_End = last;
+    int64_t from = m_End - m_Span;
+    can_handler->QuerySignalSeries(static_cast<size_t>(selection), from, m_End, static_cast<size_t>(size.x), m_Points);
+    if(m_Points.empty())
+    {
+        dc.DrawText("No data in the window", 10, 10);
+        return;
+    }
+
+    double min = m_Points.front().value, max = m_Points.front().value;
+    for(auto& i : m_Points)
+    {
+        min = std::min(min, i.value);
+        max = std::max(max, i.value);
+    }
+    double range = max - min;
+    if(range == 0.0)
+        range = std::max(std::abs(max), 1.0);
+    double bottom = min - range * 0.05;
+    double top = max + range * 0.05;
+
+    const int margin = 20;
+    int height = size.y - 2 * margin;
+    std::vector<wxPoint>& points = m_ScreenPoints;
+    points.clear();
+    for(auto& i : m_Points)
+    {
+        int x = static_cast<int>(static_cast<double>(i.time - from) * size.x / static_cast<double>(m_Span));
+        int y = margin + static_cast<int>((top - i.value) * height / (top - bottom));
+        points.push_back(wxPoint(x, y));
+    }
+
+    dc.SetPen(*wxLIGHT_GREY_PEN);
+    dc.DrawLine(0, margin, size.x, margin);
+    dc.DrawLine(0, size.y - margin, size.x, size.y - margin);
+
+    dc.SetPen(wxPen(*wxBLUE, 1));
+    if(points.size() == 1)
+        dc.DrawCircle(points.front(), 2);
+    else
+        dc.DrawLines(static_cast<int>(points.size()), points.data());
+
+    dc.SetTextForeground(*wxBLACK);
+    wxString min_str = wxString::Format("%g", min);
+    dc.DrawText(wxString::Format("%g", max), 2, 2);
+    dc.DrawText(min_str, 2, size.y - margin + 2);
+    wxString from_str = wxString::Format("%.3f s", static_cast<double>(from) / 1000000.0);
+    wxString to_str = wxString::Format("%.3f s", static_cast<double>(m_End) / 1000000.0);
+    dc.DrawText(from_str, dc.GetTextExtent(min_str).x + 20, size.y - margin + 2);
+    dc.DrawText(to_str, size.x - dc.GetTextExtent(to_str).x - 2, size.y - margin + 2);
+    dc.DrawText(std::format("{} points", m_Points.size()), size.x - 100, 2);
+}
+
+void CanSignalPlotDialog::OnMouseWheel(wxMouseEvent& event)
+{
+    int width = std::max(m_Canvas->GetClientSize().x, 1);
+    int64_t span = event.GetWheelRotation() > 0 ? m_Span * 4 / 5 : m_Span * 5 / 4;
+    span = std::clamp(span, CAN_SIGNAL_PLOT_MIN_SPAN, CAN_SIGNAL_PLOT_MAX_SPAN);
+    if(!m_FollowCheck->GetValue())
+    {
+        /* Time under the mouse stays in place */
+        double ratio = static_cast<double>(width - event.GetX()) / static_cast<double>(width);
+        m_End += static_cast<int64_t>(ratio * static_cast<double>(span - m_Span));
+    }
+    m_Span = span;
+    m_Canvas->Refresh();
+}
+
+void CanSignalPlotDialog::OnMouseMotion(wxMouseEvent& event)
+{
+    if(!event.Dragging() || !event.LeftIsDown())
+        return;
+
+    if(m_FollowCheck->GetValue())
+        SetFollowing(false);
+
+    int width = std::max(m_Canvas->GetClientSize().x, 1);
+    m_End = m_DragEnd - static_cast<int64_t>(static_cast<double>(event.GetX() - m_DragX) * static_cast<double>(m_Span) / width);
+    m_Canvas->Refresh();
+}
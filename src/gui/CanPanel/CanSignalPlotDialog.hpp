@@ -0,0 +1,61 @@
+#pragma once
+
+#include <wx/wx.h>
+
+#include <vector>
+
+#include "../../CanSignalSeries.hpp"
+
+class CanSignalPlotDialog : public wxDialog
+{
+public:
+    CanSignalPlotDialog(wxWindow* parent);
+    ~CanSignalPlotDialog();
+
+    // !\brief Update list of recorded signals and show the dialog, it isn't modal
+    void ShowDialog();
+
+protected:
+    void OnClose(wxCloseEvent& event);
+    void OnTimer(wxTimerEvent& event);
+
+private:
+    // !\brief Draw the selected signal, only as many points are queried as the canvas is wide
+    void OnPaint(wxPaintEvent& event);
+
+    // !\brief Zoom around the mouse, or around the newest point when following
+    void OnMouseWheel(wxMouseEvent& event);
+
+    // !\brief Pan by dragging
+    void OnMouseMotion(wxMouseEvent& event);
+
+    // !\brief Set following of live data
+    void SetFollowing(bool is_following);
+
+    wxBoxSizer* sizerTop = nullptr;
+    wxChoice* m_SignalChoice = nullptr;
+    wxCheckBox* m_FollowCheck = nullptr;
+    wxPanel* m_Canvas = nullptr;
+    wxTimer* m_Timer = nullptr;
+
+    // !\brief Length of the shown time window in microseconds
+    int64_t m_Span = 10000000;
+
+    // !\brief End of the shown time window in microseconds since start time, it's the newest point when following
+    int64_t m_End = 0;
+
+    // !\brief Time window end at the beginning of dragging
+    int64_t m_DragEnd = 0;
+
+    // !\brief Mouse position at the beginning of dragging
+    int m_DragX = 0;
+
+    // !\brief Points of the last paint, kept to avoid allocation per frame
+    std::vector<CanSignalPoint> m_Points;
+
+    // !\brief Points of the last paint in pixels
+    std::vector<wxPoint> m_ScreenPoints;
+
+    wxDECLARE_EVENT_TABLE();
+    wxDECLARE_NO_COPY_CLASS(CanSignalPlotDialog);
+};
@@ -0,0 +1,239 @@
+#include "pch.hpp"
+
+/* Period of achieved rate and drop reporting */
+constexpr int CAN_STRESS_STATUS_PERIOD_MS = 500;
+
+/* Maximum number of the newest recorded frames used as seeds of mutation */
+constexpr size_t CAN_STRESS_MAX_SEEDS = 10000;
+
+wxBEGIN_EVENT_TABLE(CanStressDialog, wxDialog)
+EVT_CLOSE(CanStressDialog::OnClose)
+wxEND_EVENT_TABLE()
+
+CanStressDialog::CanStressDialog(wxWindow* parent)
+    : wxDialog(parent, wxID_ANY, "CAN Stress Generator", wxDefaultPosition, wxDefaultSize, wxDEFAULT_DIALOG_STYLE | wxRESIZE_BORDER)
+{
+    sizerTop = new wxBoxSizer(wxVERTICAL);
+
+    wxStaticBoxSizer* sizer_frames = new wxStaticBoxSizer(wxVERTICAL, this, "&Frames");
+    wxFlexGridSizer* grid_frames = new wxFlexGridSizer(4, wxSize(5, 5));
+
+    grid_frames->Add(new wxStaticText(this, wxID_ANY, "Frame ID:"), wxSizerFlags().CenterVertical());
+    m_IdMode = new wxChoice(this, wxID_ANY);
+    m_IdMode->Append("Fixed");
+    m_IdMode->Append("Increment");
+    m_IdMode->Append("Random");
+    m_IdMode->SetSelection(CSIM_FIXED);
+    grid_frames->Add(m_IdMode);
+    m_IdMin = new wxTextCtrl(this, wxID_ANY, "100", wxDefaultPosition, wxSize(75, -1));
+    m_IdMin->SetToolTip("Lowest Frame ID in hex, IDs from 800 are sent as extended frames");
+    grid_frames->Add(m_IdMin);
+    m_IdMax = new wxTextCtrl(this, wxID_ANY, "7FF", wxDefaultPosition, wxSize(75, -1));
+    m_IdMax->SetToolTip("Highest Frame ID in hex");
+    grid_frames->Add(m_IdMax);
+
+    grid_frames->Add(new wxStaticText(this, wxID_ANY, "Data length:"), wxSizerFlags().CenterVertical());
+    m_DlcMode = new wxChoice(this, wxID_ANY);
+    m_DlcMode->Append("Fixed");
+    m_DlcMode->Append("Sweep");
+    m_DlcMode->Append("Random");
+    m_DlcMode->SetSelection(CSDM_FIXED);
+    m_DlcMode->SetToolTip("Fixed uses the highest length");
+    grid_frames->Add(m_DlcMode);
+    m_DlcMin = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(75, -1), wxSP_ARROW_KEYS, 1, MAX_CAN_FRAME_DATA_LEN, 1);
+    grid_frames->Add(m_DlcMin);
+    m_DlcMax = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(75, -1), wxSP_ARROW_KEYS, 1, MAX_CAN_FRAME_DATA_LEN, MAX_CAN_FRAME_DATA_LEN);
+    grid_frames->Add(m_DlcMax);
+
+    grid_frames->Add(new wxStaticText(this, wxID_ANY, "Payload:"), wxSizerFlags().CenterVertical());
+    m_PayloadMode = new wxChoice(this, wxID_ANY);
+    m_PayloadMode->Append("Fixed");
+    m_PayloadMode->Append("Increment");
+    m_PayloadMode->Append("Random");
+    m_PayloadMode->Append("Mutate recording");
+    m_PayloadMode->SetSelection(CSPM_RANDOM);
+    m_PayloadMode->SetToolTip("Mutate recording: frames of the recording (log tab) with random bit flips, random bytes, boundary values, +/-1 and length changes, ID and length are taken from the recorded frame");
+    grid_frames->Add(m_PayloadMode);
+    m_Payload = new wxTextCtrl(this, wxID_ANY, "00 00 00 00 00 00 00 00", wxDefaultPosition, wxSize(150, -1));
+    m_Payload->SetToolTip("Data of fixed payload in hex");
+    grid_frames->Add(m_Payload);
+    m_Mutations = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(75, -1), wxSP_ARROW_KEYS, 1, 64, 1);
+    m_Mutations->SetToolTip("Number of mutations per frame");
+    grid_frames->Add(m_Mutations);
+    sizer_frames->Add(grid_frames, wxSizerFlags().Border());
+    sizerTop->Add(sizer_frames, wxSizerFlags().Expand().Border());
+
+    wxStaticBoxSizer* sizer_timing = new wxStaticBoxSizer(wxVERTICAL, this, "&Timing");
+    wxFlexGridSizer* grid_timing = new wxFlexGridSizer(4, wxSize(5, 5));
+    auto add_field = [this, grid_timing](const char* label, const char* value, const char* tooltip) -> wxTextCtrl*
+    {
+        grid_timing->Add(new wxStaticText(this, wxID_ANY, label), wxSizerFlags().CenterVertical());
+        wxTextCtrl* ctrl = new wxTextCtrl(this, wxID_ANY, value, wxDefaultPosition, wxSize(100, -1));
+        ctrl->SetToolTip(tooltip);
+        grid_timing->Add(ctrl);
+        return ctrl;
+    };
+    m_Rate = add_field("Rate:", "1000", "Frames per second, used if bus load is 0");
+    m_BusLoad = add_field("Bus load:", "0", "Target bus load in percent, the gap after every frame is calculated from its length including stuff bits");
+    m_Bitrate = add_field("Bitrate:", "500000", "Bitrate of the bus in bit/s, used for bus load");
+    m_BurstSize = add_field("Burst size:", "0", "Number of frames queued at once every burst period, 0 = continuous sending");
+    m_BurstPeriod = add_field("Burst period:", "100", "Period of bursts in ms");
+    m_Count = add_field("Count:", "0", "Stop after this many frames, 0 = unlimited");
+    m_Duration = add_field("Duration:", "0", "Stop after this time in ms, 0 = unlimited");
+    m_Seed = add_field("Seed:", "0", "Seed of the random generator, 0 = random, the used seed is logged, so a run can be repeated");
+    sizer_timing->Add(grid_timing, wxSizerFlags().Border());
+    sizerTop->Add(sizer_timing, wxSizerFlags().Expand().Border());
+
+    wxStaticBoxSizer* sizer_status = new wxStaticBoxSizer(wxVERTICAL, this, "&Status");
+    wxBoxSizer* h_sizer = new wxBoxSizer(wxHORIZONTAL);
+    m_StartBtn = new wxButton(this, wxID_ANY, "Start", wxDefaultPosition, wxDefaultSize);
+    m_StartBtn->SetToolTip("Start generating frames into the TX queue, TX queue settings (size, overflow policy) apply");
+    m_StartBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            CanStressConfig config;
+            if(!GetConfig(config))
+                return;
+
+            std::vector<CanData> seeds;
+            if(config.payload_mode == CSPM_MUTATE)
+            {
+                /* Log store can be read while frames are added */
+                CanLogStore& log = wxGetApp().can_entry->m_LogEntries;
+                size_t size = log.size();
+                for(size_t n = size > CAN_STRESS_MAX_SEEDS ? size - CAN_STRESS_MAX_SEEDS : 0; n < size; n++)
+                {
+                    const CanLogEntry& entry = log[n];
+                    seeds.push_back(CanData(entry.frame_id, static_cast<uint8_t>(entry.data.size()), entry.data.data()));
+                }
+            }
+
+            m_LastStats = CanStressStats();
+            m_LastTxFrames = wxGetApp().can_entry->GetTxFrameCount();
+            m_LastQueueDropped = CanSerialPort::Get()->GetTxQueue().GetCounters().GetDropped();
+            m_LastUpdate = std::chrono::steady_clock::now();
+            CanSerialPort::Get()->GetStressGenerator().Start(config, std::move(seeds));
+        });
+    h_sizer->Add(m_StartBtn);
+
+    m_StopBtn = new wxButton(this, wxID_ANY, "Stop", wxDefaultPosition, wxDefaultSize);
+    m_StopBtn->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            CanSerialPort::Get()->GetStressGenerator().Stop();
+        });
+    h_sizer->AddSpacer(10);
+    h_sizer->Add(m_StopBtn);
+    sizer_status->Add(h_sizer, wxSizerFlags().Border());
+
+    m_Status = new wxStaticText(this, wxID_ANY, "Stopped\n\n\n");
+    m_Status->SetToolTip("Generated: frames accepted by the TX queue, Device: frames passed to the CAN device. "
+        "If the device rate is lower than the generated one, the device or the serial link is the bottleneck, if overruns grow, the generator thread is");
+    sizer_status->Add(m_Status, wxSizerFlags().Expand().Border());
+    sizerTop->Add(sizer_status, wxSizerFlags(1).Expand().Border());
+
+    sizerTop->Add(CreateStdDialogButtonSizer(wxCLOSE), wxSizerFlags().Right().Border());
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            Close();
+        }, wxID_CLOSE);
+
+    m_Timer = new wxTimer(this);
+    Bind(wxEVT_TIMER, &CanStressDialog::OnTimer, this, m_Timer->GetId());
+
+    SetAutoLayout(true);
+    SetSizer(sizerTop);
+    sizerTop->Fit(this);
+    sizerTop->SetSizeHints(this);
+    CentreOnScreen();
+}
+
+CanStressDialog::~CanStressDialog()
+{
+    m_Timer->Stop();
+    delete m_Timer;
+}
+
+void CanStressDialog::ShowDialog()
+{
+    m_LastUpdate = std::chrono::steady_clock::now();
+    m_Timer->Start(CAN_STRESS_STATUS_PERIOD_MS);
+    Show();
+    Raise();
+}
+
+void CanStressDialog::OnClose(wxCloseEvent& event)
+{
+    m_Timer->Stop();
+    Hide();  /* Generator keeps running, it can be stopped when the dialog is opened again */
+}
+
+void CanStressDialog::OnTimer(wxTimerEvent& event)
+{
+    UpdateStatus();
+}
+
+bool CanStressDialog::GetConfig(CanStressConfig& config)
+{
+    try
+    {
+        config.id_mode = static_cast<CanStressIdMode>(m_IdMode->GetSelection());
+        config.id_min = static_cast<uint32_t>(std::stoul(m_IdMin->GetValue().ToStdString(), nullptr, 16));
+        config.id_max = static_cast<uint32_t>(std::stoul(m_IdMax->GetValue().ToStdString(), nullptr, 16));
+        if(config.id_mode == CSIM_FIXED)
+            config.id_max = config.id_min;
+        config.dlc_mode = static_cast<CanStressDlcMode>(m_DlcMode->GetSelection());
+        config.dlc_min = static_cast<uint8_t>(m_DlcMin->GetValue());
+        config.dlc_max = static_cast<uint8_t>(m_DlcMax->GetValue());
+        config.payload_mode = static_cast<CanStressPayloadMode>(m_PayloadMode->GetSelection());
+        config.mutations = static_cast<uint32_t>(m_Mutations->GetValue());
+
+        std::string payload = m_Payload->GetValue().ToStdString();
+        boost::algorithm::erase_all(payload, " ");
+        std::string bytes = boost::algorithm::unhex(payload);
+        if(bytes.size() > sizeof(config.payload))
+            throw std::invalid_argument("payload is longer than 8 bytes");
+        memcpy(config.payload, bytes.data(), bytes.size());
+
+        config.rate = std::stod(m_Rate->GetValue().ToStdString());
+        config.bus_load = std::stod(m_BusLoad->GetValue().ToStdString());
+        config.bitrate = static_cast<uint32_t>(std::stoul(m_Bitrate->GetValue().ToStdString()));
+        config.burst_size = static_cast<uint32_t>(std::stoul(m_BurstSize->GetValue().ToStdString()));
+        config.burst_period = std::chrono::milliseconds(std::stoul(m_BurstPeriod->GetValue().ToStdString()));
+        config.count = std::stoull(m_Count->GetValue().ToStdString());
+        config.duration = std::chrono::milliseconds(std::stoul(m_Duration->GetValue().ToStdString()));
+        config.seed = std::stoull(m_Seed->GetValue().ToStdString());
+    }
+    catch(const std::exception& e)
+    {
+        LOG(LogLevel::Error, "Invalid stress generator parameter, exception: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
+void CanStressDialog::UpdateStatus()
+{
+    CanStressGenerator& generator = CanSerialPort::Get()->GetStressGenerator();
+    CanStressStats stats = generator.GetStats();
+    CanStressConfig config = generator.GetConfig();
+    uint64_t tx_frames = wxGetApp().can_entry->GetTxFrameCount();
+    CanTxQueueCounters counters = CanSerialPort::Get()->GetTxQueue().GetCounters();
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - m_LastUpdate).count();
+    if(elapsed <= 0.0)
+        return;
+
+    double rate = static_cast<double>(stats.sent - m_LastStats.sent) / elapsed;
+    double bus_load = config.bitrate ? static_cast<double>(stats.bits - m_LastStats.bits) / elapsed / config.bitrate * 100.0 : 0.0;
+    double device_rate = static_cast<double>(tx_frames - m_LastTxFrames) / elapsed;
+
+    m_Status->SetLabel(std::format("{}, seed: {}\nGenerated: {:.0f} frames/s, bus load: {:.1f}%, rejected by TX queue: {} (total {}), overruns: {}\n"
+        "Device: {:.0f} frames/s\nTX queue: dropped: {} (total {}), high watermark: {}",
+        generator.IsRunning() ? "Running" : "Stopped", stats.seed, rate, bus_load, stats.dropped - m_LastStats.dropped, stats.dropped, stats.overruns,
+        device_rate, counters.GetDropped() - m_LastQueueDropped, counters.GetDropped(), counters.high_watermark));
+
+    m_LastStats = stats;
+    m_LastTxFrames = tx_frames;
+    m_LastQueueDropped = counters.GetDropped();
+    m_LastUpdate = now;
+}
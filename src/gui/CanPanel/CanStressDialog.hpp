@@ -0,0 +1,68 @@
+#pragma once
+
+#include <wx/wx.h>
+#include <wx/spinctrl.h>
+
+#include <chrono>
+
+#include "../../CanStressGenerator.hpp"
+
+class CanStressDialog : public wxDialog
+{
+public:
+    CanStressDialog(wxWindow* parent);
+    ~CanStressDialog();
+
+    // !\brief Show the dialog, it isn't modal, so the TX and RX lists can be watched during the test
+    void ShowDialog();
+
+protected:
+    void OnClose(wxCloseEvent& event);
+    void OnTimer(wxTimerEvent& event);
+
+private:
+    // !\brief Read configuration from the controls
+    // !\return False if a field is invalid
+    bool GetConfig(CanStressConfig& config);
+
+    // !\brief Update achieved rate, bus load and drops since the previous update
+    void UpdateStatus();
+
+    wxBoxSizer* sizerTop = nullptr;
+    wxChoice* m_IdMode = nullptr;
+    wxTextCtrl* m_IdMin = nullptr;
+    wxTextCtrl* m_IdMax = nullptr;
+    wxChoice* m_DlcMode = nullptr;
+    wxSpinCtrl* m_DlcMin = nullptr;
+    wxSpinCtrl* m_DlcMax = nullptr;
+    wxChoice* m_PayloadMode = nullptr;
+    wxTextCtrl* m_Payload = nullptr;
+    wxSpinCtrl* m_Mutations = nullptr;
+    wxTextCtrl* m_Rate = nullptr;
+    wxTextCtrl* m_BusLoad = nullptr;
+    wxTextCtrl* m_Bitrate = nullptr;
+    wxTextCtrl* m_BurstSize = nullptr;
+    wxTextCtrl* m_BurstPeriod = nullptr;
+    wxTextCtrl* m_Count = nullptr;
+    wxTextCtrl* m_Duration = nullptr;
+    wxTextCtrl* m_Seed = nullptr;
+    wxButton* m_StartBtn = nullptr;
+    wxButton* m_StopBtn = nullptr;
+    wxStaticText* m_Status = nullptr;
+    wxTimer* m_Timer = nullptr;
+
+    // !\brief Counters at the previous status update
+    CanStressStats m_LastStats;
+
+    // !\brief Frames sent by the CAN device at the previous status update
+    uint64_t m_LastTxFrames = 0;
+
+    // !\brief Frames dropped by the TX queue at the previous status update
+    uint64_t m_LastQueueDropped = 0;
+
+    // !\brief Time of the previous status update
+    std::chrono::steady_clock::time_point m_LastUpdate;
+
+    wxDECLARE_EVENT_TABLE();
+    wxDECLARE_NO_COPY_CLASS(CanStressDialog);
+};
@@ -179,6 +179,43 @@ DidPanel::DidPanel(wxFrame* parent)
         });
     h_sizer->Add(m_ClearDids);
 
+    wxArrayString periodic_rates;
+    periodic_rates.Add("Slow");
+    periodic_rates.Add("Medium");
+    periodic_rates.Add("Fast");
+    m_PeriodicRate = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, periodic_rates);
+    m_PeriodicRate->SetSelection(1);
+    m_PeriodicRate->SetToolTip("Transmission rate of periodic DIDs");
+    h_sizer->Add(m_PeriodicRate);
+
+    m_StreamSelected = new wxButton(this, wxID_ANY, "Stream selected", wxDefaultPosition, wxDefaultSize);
+    m_StreamSelected->SetToolTip("Schedule selected DIDs (F200-F2FF) for periodic transmission on the ECU");
+    m_StreamSelected->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::unique_ptr<DidHandler>& did_handler = wxGetApp().did_handler;
+            std::vector<uint16_t> dids = GetSelectedDids();
+            if(dids.empty()) return;
+
+            UdsPeriodicRate rate = static_cast<UdsPeriodicRate>(UDS_PERIODIC_SLOW + m_PeriodicRate->GetSelection());
+            did_handler->SchedulePeriodicDids(dids, rate);
+            did_handler->NotifyDidUpdate();
+        });
+    h_sizer->Add(m_StreamSelected);
+
+    m_StopStreaming = new wxButton(this, wxID_ANY, "Stop streaming", wxDefaultPosition, wxDefaultSize);
+    m_StopStreaming->SetToolTip("Stop periodic transmission of selected DIDs, or every DID if nothing is selected");
+    m_StopStreaming->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::unique_ptr<DidHandler>& did_handler = wxGetApp().did_handler;
+            std::vector<uint16_t> dids = GetSelectedDids();
+            if(dids.empty())
+                did_handler->StopPeriodicDids();
+            else
+                did_handler->SchedulePeriodicDids(dids, UDS_PERIODIC_STOP);
+            did_handler->NotifyDidUpdate();
+        });
+    h_sizer->Add(m_StopStreaming);
+
     wxBoxSizer* h_sizer_2 = new wxBoxSizer(wxHORIZONTAL);
     m_SaveCache = new wxButton(this, wxID_ANY, "Save cache", wxDefaultPosition, wxDefaultSize);
     m_SaveCache->SetToolTip("Save cached values for DIDs)");
@@ -199,11 +236,62 @@ DidPanel::DidPanel(wxFrame* parent)
 #endif
                 MyFrame* frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
                 std::unique_lock lock(frame->mtx);
-                frame->pending_msgs.push_back({ static_cast<uint8_t>(PopupMsgIds::DidCacheSaved), dif, std::string(work_dir) + "\\" + DID_CACHE_FILENAME });
+                frame->pending_msgs.push_back({ static_cast<uint8_t>(PopupMsgIds::DidCacheSaved), dif, std::string(work_dir) + "\\" + DID_BINARY_CACHE_FILENAME });
             }
         });
     h_sizer_2->Add(m_SaveCache);
 
+    m_ExportXml = new wxButton(this, wxID_ANY, "Export XML", wxDefaultPosition, wxDefaultSize);
+    m_ExportXml->SetToolTip("Export cached values for DIDs to XML format");
+    m_ExportXml->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            std::unique_ptr<DidHandler>& did_handler = wxGetApp().did_handler;
+
+            bool ret = did_handler->ExportCacheToXml(DID_CACHE_FILENAME);
+            if(ret)
+            {
+                std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+                int64_t dif = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+
+                char work_dir[1024] = {};
+#ifdef _WIN32
+                GetCurrentDirectoryA(sizeof(work_dir) - 1, work_dir);
+#endif
+                MyFrame* frame = ((MyFrame*)(wxGetApp().GetTopWindow()));
+                std::unique_lock lock(frame->mtx);
+                frame->pending_msgs.push_back({ static_cast<uint8_t>(PopupMsgIds::DidCacheSaved), dif, std::string(work_dir) + "\\" + DID_CACHE_FILENAME });
+            }
+        });
+    h_sizer_2->Add(m_ExportXml);
+
+    m_Discover = new wxButton(this, wxID_ANY, "Discover DIDs", wxDefaultPosition, wxDefaultSize);
+    m_Discover->SetToolTip("Scan DID ranges of one or more ECUs concurrently to find supported DIDs");
+    m_Discover->Bind(wxEVT_BUTTON, [this](wxCommandEvent& event)
+        {
+            std::unique_ptr<DidDiscovery>& did_discovery = wxGetApp().did_discovery;
+            std::unique_ptr<CanEntryHandler>& can_handler = wxGetApp().can_entry;
+            if(did_discovery->IsRunning())
+            {
+                did_discovery->Stop();
+                m_Discover->SetLabel("Discover DIDs");
+                return;
+            }
+
+            std::string default_targets = std::format("{:X}:{:X}:0000-FFFF", can_handler->GetDefaultEcuId(), can_handler->GetIsoTpResponseFrameId());
+            wxTextEntryDialog d(this, "Targets separated by comma\nFormat: ECU_ID:RESPONSE_ID[:FIRST-LAST][:strict]", "Discover DIDs", default_targets);
+            if(d.ShowModal() != wxID_OK)
+                return;
+
+            std::vector<DidDiscoveryTarget> targets;
+            if(DidDiscovery::ParseTargets(d.GetValue().ToStdString(), targets) && did_discovery->Start(targets))
+                m_Discover->SetLabel("Stop discovery");
+        });
+    h_sizer_2->Add(m_Discover);
+
+    m_DiscoverStatus = new wxStaticText(this, wxID_ANY, "", wxDefaultPosition, wxDefaultSize);
+    h_sizer_2->Add(m_DiscoverStatus, 0, wxALIGN_CENTER_VERTICAL | wxLEFT, 5);
+
     static_box_grid->Add(did_grid->m_grid, 0, wxALL, 5);
     bSizer1->Add(static_box_grid, wxSizerFlags(0).Top());
     bSizer1->Add(h_sizer);
@@ -220,6 +308,7 @@ void DidPanel::UpdateDidList()
         did_grid->m_grid->DeleteRows(0, did_grid->m_grid->GetNumberRows());
     did_grid->cnt = 0;
 
+    std::unique_lock lock{ did_handler->m };
     did_handler->m_UpdatedDids.clear();
     for(auto& i : did_handler->m_DidList)
     {
@@ -240,6 +329,24 @@ void DidPanel::UpdateDidList()
     }
 }
 
+std::vector<uint16_t> DidPanel::GetSelectedDids()
+{
+    std::vector<uint16_t> dids;
+    wxArrayInt rows = did_grid->m_grid->GetSelectedRows();
+    for(auto& i : rows)
+    {
+        try
+        {
+            dids.push_back(std::stoi(did_grid->m_grid->GetCellValue(wxGridCellCoords(i, DidGridCol::Did_ID)).ToStdString(), nullptr, 16));
+        }
+        catch(const std::exception& e)
+        {
+            LOG(LogLevel::Error, "stoi exception: {}", e.what());
+        }
+    }
+    return dids;
+}
+
 void DidPanel::On100msTimer()
 {
     std::unique_ptr<DidHandler>& did_handler = wxGetApp().did_handler;
@@ -247,6 +354,7 @@ void DidPanel::On100msTimer()
 
     if(!is_dids_initialized)
     {
+        std::unique_lock lock{ did_handler->m };
         for(auto& i : did_handler->m_DidList)
         {
             did_grid->AddRow(i.second);
@@ -254,52 +362,69 @@ void DidPanel::On100msTimer()
         is_dids_initialized = true;
     }
 
-    if(!did_handler->m_UpdatedDids.empty())
+    std::unique_ptr<DidDiscovery>& did_discovery = wxGetApp().did_discovery;
+    std::string discovery_status = did_discovery->GetProgressAsString();
+    if(m_DiscoverStatus->GetLabel() != discovery_status)
+        m_DiscoverStatus->SetLabel(discovery_status);
+    if(!did_discovery->IsRunning() && m_Discover->GetLabel() != "Discover DIDs")
+        m_Discover->SetLabel("Discover DIDs");
+
+    /* Values are copied under the lock, because periodic DIDs are updated from CAN thread */
+    std::vector<std::pair<uint16_t, DidHistoryEntry>> updated_dids;
     {
-        //std::unique_lock lock{ did_handler->m };
-        for(auto& did : did_handler->m_UpdatedDids)
+        std::unique_lock lock{ did_handler->m };
+        std::vector<uint16_t>& dids = did_handler->m_UpdatedDids;
+        std::sort(dids.begin(), dids.end());
+        dids.erase(std::unique(dids.begin(), dids.end()), dids.end());
+        for(auto& did : dids)
         {
-            auto& did_it = did_handler->m_DidList[did];
-            uint16_t did_row = did_grid->did_to_row[did];
+            auto did_it = did_handler->m_DidList.find(did);
+            if(did_it != did_handler->m_DidList.end())
+                updated_dids.push_back({ did, { did_it->second->last_update, did_it->second->value_str, did_it->second->nrc } });
+        }
+        dids.clear();
+    }
+
+    for(auto& [did, entry] : updated_dids)
+    {
+        uint16_t did_row = did_grid->did_to_row[did];
 
-            if(did_it->nrc != 0)
+        if(entry.nrc != 0)
+        {
+            switch(entry.nrc)
             {
-                switch(did_it->nrc)
+                case 0x78:
                 {
-                    case 0x78:
-                    {
-                        did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), "Pending... NRC 78");
-                        did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, *wxBLUE);
-                        break;
-                    }
-                    default:
-                    {
-                        did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), wxString::Format("NRC %X", did_it->nrc));
-                        did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, *wxRED);
+                    did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), "Pending... NRC 78");
+                    did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, *wxBLUE);
+                    break;
+                }
+                default:
+                {
+                    did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), wxString::Format("NRC %X", entry.nrc));
+                    did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, *wxRED);
 
-                        wxFont cell_font = did_grid->m_grid->GetCellFont(did_row, Did_Name);
-                        cell_font.SetWeight(wxFONTWEIGHT_NORMAL);
-                        did_grid->m_grid->SetCellFont(did_row, Did_Name, cell_font);
-                        break;
-                    }
+                    wxFont cell_font = did_grid->m_grid->GetCellFont(did_row, Did_Name);
+                    cell_font.SetWeight(wxFONTWEIGHT_NORMAL);
+                    did_grid->m_grid->SetCellFont(did_row, Did_Name, cell_font);
+                    break;
                 }
             }
-            else
-            {
-                did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), did_it->value_str);
-                wxFont cell_font = did_grid->m_grid->GetCellFont(did_row, Did_Name);
-                cell_font.SetWeight(wxFONTWEIGHT_BOLD);
-                did_grid->m_grid->SetCellFont(did_row, Did_Name, cell_font);
-                did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, (did_row & 1) ? 0xE6E6E6 : 0xFFFFFF);
-            }
+        }
+        else
+        {
+            did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Value), entry.value);
+            wxFont cell_font = did_grid->m_grid->GetCellFont(did_row, Did_Name);
+            cell_font.SetWeight(wxFONTWEIGHT_BOLD);
+            did_grid->m_grid->SetCellFont(did_row, Did_Name, cell_font);
+            did_grid->m_grid->SetCellBackgroundColour(did_row, DidGridCol::Did_Value, (did_row & 1) ? 0xE6E6E6 : 0xFFFFFF);
+        }
 
-            if(!did_it->last_update.is_not_a_date_time())
-            {
-                wxString last_update_str = boost::posix_time::to_iso_extended_string(did_it->last_update);
-                did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Timestamp), last_update_str);
-            }
+        if(!entry.timestamp.is_not_a_date_time())
+        {
+            wxString last_update_str = boost::posix_time::to_iso_extended_string(entry.timestamp);
+            did_grid->m_grid->SetCellValue(wxGridCellCoords(did_row, DidGridCol::Did_Timestamp), last_update_str);
         }
-        did_handler->m_UpdatedDids.clear();
     }
 }
 
@@ -44,12 +44,21 @@ public:
     wxButton* m_Abort = nullptr;
     wxButton* m_ClearDids = nullptr;
     wxButton* m_SaveCache = nullptr;
+    wxButton* m_ExportXml = nullptr;
+    wxChoice* m_PeriodicRate = nullptr;
+    wxButton* m_StreamSelected = nullptr;
+    wxButton* m_StopStreaming = nullptr;
+    wxButton* m_Discover = nullptr;
+    wxStaticText* m_DiscoverStatus = nullptr;
 
     void UpdateDidList();
     void WriteDid(uint16_t did, uint8_t* data_to_write, uint16_t size);
     void On100msTimer();
 
 private:
+    // !\brief Get DIDs of selected rows
+    std::vector<uint16_t> GetSelectedDids();
+
     void OnSize(wxSizeEvent& evt);
     void OnCellValueChanged(wxGridEvent& ev);
     void OnCellEditorShown(wxGridEvent& ev);
@@ -655,6 +655,17 @@ void MyFrame::HandleNotifications()
 						});
 					break;
 				}				
+				case CanLogImported:
+				{
+					int64_t time_elapsed = std::any_cast<decltype(time_elapsed)>(ret[1]);
+					std::string filename = std::any_cast<decltype(filename)>(ret[2]);
+					uint64_t frames = std::any_cast<decltype(frames)>(ret[3]);
+					ShowNotificaiton("CAN Log imported", wxString::Format("%llu frames imported in %.3fms\nPath: %s",
+						static_cast<unsigned long long>(frames), (double)time_elapsed / 1000000.0, filename), 3, wxICON_INFORMATION, [this](wxCommandEvent& event)
+						{
+						});
+					break;
+				}
 				case CommandsSaved:
 				{
 					int64_t time_elapsed = std::any_cast<decltype(time_elapsed)>(ret[1]);
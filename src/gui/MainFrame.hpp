@@ -44,6 +44,7 @@ enum PopupMsgIds : uint8_t
 	RxListLoadError,
 	FrameMappingLoadError,
 	CanLogSaved,
+	CanLogImported,
 	CommandsSaved,
 	DidCacheSaved,
 	DidUpdated,
@@ -13,5 +13,5 @@ public:
 
     // !\brief Send pending CAN frames from message queue
     // !\param serial_port [in] Reference to async serial port
-    virtual size_t PrepareSendDataFormat(const std::shared_ptr<CanData>& data_ptr, char* out, size_t max_size, bool& remove_from_queue) = 0;
+    virtual size_t PrepareSendDataFormat(const CanData& frame, char* out, size_t max_size, bool& remove_from_queue) = 0;
 };
\ No newline at end of file
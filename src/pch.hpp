@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef CAN_LOG_TOOL  /* Headless CAN log tool builds the GUI independent CAN sources with it's own headers */
+#include "CanLogTool/pch.hpp"
+#else
+
 #include <boost/asio.hpp>
 
 #ifdef _WIN32
@@ -31,6 +35,8 @@ namespace std
 #include "gui/CanPanel/CanPanel.hpp"
 #include "gui/CanPanel/CanScriptPanel.hpp"
 #include "gui/CanPanel/CanSenderPanel.hpp"
+#include "gui/CanPanel/CanSignalPlotDialog.hpp"
+#include "gui/CanPanel/CanStressDialog.hpp"
 #include "gui/CanPanel/CanUdsRawDialog.hpp"
 
 #include "gui/ConfigurationBackup.hpp"
@@ -63,12 +69,28 @@ namespace std
 #include "TerminalHotkey.hpp"
 #include "SerialPortBase.hpp"
 #include "SerialPort.hpp"
+#include "CanGateway.hpp"
+#include "CanTxQueue.hpp"
+#include "CanStressGenerator.hpp"
 #include "CanSerialPort.hpp"
 #include "CanDeviceStm32.hpp"
 #include "CanDeviceLawicel.hpp"
+#include "EcuSimulator.hpp"
+#include "CanDeviceSimulator.hpp"
 #include "CryptoPrice.hpp"
+#include "CanLogFilter.hpp"
+#include "CanLogStore.hpp"
+#include "CanTriggerCapture.hpp"
+#include "CanRecordingCodec.hpp"
+#include "CanSignalDecoder.hpp"
+#include "CanLogImporter.hpp"
+#include "CanChangeDetector.hpp"
+#include "CanSignalSeries.hpp"
 #include "CanEntryHandler.hpp"
+#include "UdsSessionManager.hpp"
 #include "DidHandler.hpp"
+#include "DidDiscovery.hpp"
+#include "CanScriptCompiler.hpp"
 #include "CanScriptHandler.hpp"
 #include "CorsairHid.hpp"
 #include "StringToCEscaper.hpp"
@@ -124,6 +146,7 @@ namespace std
 #include <wx/dirctrl.h>
 #include <wx/artprov.h>
 #include <wx/tipwin.h>
+#include <wx/dcbuffer.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/archive/iterators/binary_from_base64.hpp>
@@ -145,6 +168,8 @@ namespace std
 #include <boost/circular_buffer.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include <assert.h>
 
@@ -209,4 +234,5 @@ extern "C"
 #include <Windows.h>
 #endif
 
-using namespace std::chrono_literals;
\ No newline at end of file
+using namespace std::chrono_literals;
+#endif